@@ -42,6 +42,7 @@ struct _EvdBufferedOutputStreamPrivate
   GString *buffer;
   gsize buffer_size;
   gboolean auto_grow;
+  gsize high_water;
 
   gboolean auto_flush;
   gboolean flushing;
@@ -147,6 +148,7 @@ evd_buffered_output_stream_init (EvdBufferedOutputStream *self)
   priv->buffer = g_string_new ("");
   priv->buffer_size = DEFAULT_BUFFER_SIZE;
   priv->auto_grow = TRUE;
+  priv->high_water = 0;
 
   priv->auto_flush = TRUE;
   priv->flushing = FALSE;
@@ -232,7 +234,12 @@ evd_buffered_output_stream_fill (EvdBufferedOutputStream  *self,
     }
 
   if (size > 0)
-    g_string_append_len (self->priv->buffer, buf, size);
+    {
+      g_string_append_len (self->priv->buffer, buf, size);
+
+      if (self->priv->buffer->len > self->priv->high_water)
+        self->priv->high_water = self->priv->buffer->len;
+    }
 
   return size;
 }
@@ -664,6 +671,25 @@ evd_buffered_output_stream_get_auto_flush (EvdBufferedOutputStream *self)
   return self->priv->auto_flush;
 }
 
+/**
+ * evd_buffered_output_stream_get_buffered_size:
+ * @high_water: (out) (allow-none): the largest size the buffer has reached
+ *
+ * Returns: the number of bytes currently buffered, waiting to be written
+ * to the base stream.
+ **/
+gsize
+evd_buffered_output_stream_get_buffered_size (EvdBufferedOutputStream *self,
+                                              gsize                   *high_water)
+{
+  g_return_val_if_fail (EVD_IS_BUFFERED_OUTPUT_STREAM (self), 0);
+
+  if (high_water != NULL)
+    *high_water = self->priv->high_water;
+
+  return self->priv->buffer->len;
+}
+
 void
 evd_buffered_output_stream_notify_write (EvdBufferedOutputStream *self)
 {
@@ -88,6 +88,9 @@ void                    evd_buffered_output_stream_set_auto_flush    (EvdBuffere
                                                                       gboolean                 auto_flush);
 gboolean                evd_buffered_output_stream_get_auto_flush    (EvdBufferedOutputStream *self);
 
+gsize                   evd_buffered_output_stream_get_buffered_size (EvdBufferedOutputStream *self,
+                                                                      gsize                   *high_water);
+
 void                    evd_buffered_output_stream_notify_write      (EvdBufferedOutputStream *self);
 
 G_END_DECLS
@@ -35,7 +35,25 @@ G_DEFINE_TYPE (EvdConnectionPool, evd_connection_pool, EVD_TYPE_IO_STREAM_GROUP)
 #define DEFAULT_MIN_CONNS 1
 #define DEFAULT_MAX_CONNS 5
 
-#define RETRY_TIMEOUT 500 /* in miliseconds */
+#define DEFAULT_IDLE_TIMEOUT  60000 /* in miliseconds */
+#define DEFAULT_MAX_LIFETIME      0 /* in miliseconds, 0 is unlimited */
+#define DEFAULT_MAX_WAITERS    1024
+#define DEFAULT_WAIT_TIMEOUT  30000 /* in miliseconds */
+
+#define DEFAULT_CONNECT_ATTEMPT_DELAY 250 /* in miliseconds */
+
+/* expiry checks and demand sampling */
+#define HOUSEKEEPING_INTERVAL  1000 /* in miliseconds */
+
+/* weight of the last interval in the demand average used to pre-warm */
+#define DEMAND_EWMA_WEIGHT      0.3
+
+/* connection retries back off exponentially, in miliseconds */
+#define RETRY_TIMEOUT_MIN   500
+#define RETRY_TIMEOUT_MAX 30000
+
+#define REQUEST_DATA_KEY "org.eventdance.lib.connection-pool.request"
+#define CONN_DATA_KEY    "org.eventdance.lib.connection-pool.conn"
 
 #define TOTAL_SOCKETS(pool) (self->priv->connecting_sockets + \
                              g_queue_get_length (pool->priv->conns))
@@ -59,16 +77,53 @@ struct _EvdConnectionPoolPrivate
 
   gboolean tls_autostart;
   EvdTlsCredentials *tls_cred;
+  gchar *tls_resume_data;
+  gsize tls_resume_data_size;
 
   guint retry_src_id;
+  guint retry_timeout;
+
+  guint idle_timeout;
+  guint max_lifetime;
+  guint max_waiters;
+  guint wait_timeout;
+  guint connect_attempt_delay;
+
+  gboolean prewarm;
+  guint demand_count;
+  gdouble demand;
+  guint target_conns;
+
+  guint housekeeping_src_id;
 };
 
+typedef struct
+{
+  GCancellable *cancellable;
+  gulong handler_id;
+  gint64 deadline;
+} RequestData;
+
+typedef struct
+{
+  gint64 created;
+  gint64 idle_since;
+} ConnData;
+
 /* properties */
 enum
 {
   PROP_0,
   PROP_ADDRESS,
-  PROP_CONNECTION_TYPE
+  PROP_CONNECTION_TYPE,
+  PROP_MIN_CONNS,
+  PROP_MAX_CONNS,
+  PROP_IDLE_TIMEOUT,
+  PROP_MAX_LIFETIME,
+  PROP_MAX_WAITERS,
+  PROP_WAIT_TIMEOUT,
+  PROP_PREWARM,
+  PROP_CONNECT_ATTEMPT_DELAY
 };
 
 static void     evd_connection_pool_class_init            (EvdConnectionPoolClass *class);
@@ -97,6 +152,9 @@ static void     evd_connection_pool_create_new_socket     (EvdConnectionPool *se
 
 static gboolean evd_connection_pool_create_min_conns      (gpointer user_data);
 
+static gboolean evd_connection_pool_housekeeping          (gpointer user_data);
+static void     evd_connection_pool_update_target         (EvdConnectionPool *self);
+
 static void     free_connection_in_queue                  (gpointer user_data);
 
 static void
@@ -130,6 +188,84 @@ evd_connection_pool_class_init (EvdConnectionPoolClass *class)
                                                        G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY |
                                                        G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (obj_class, PROP_MIN_CONNS,
+                                   g_param_spec_uint ("min-conns",
+                                                      "Minimum connections",
+                                                      "The number of idle connections kept ready at all times",
+                                                      0,
+                                                      G_MAXUINT,
+                                                      DEFAULT_MIN_CONNS,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_MAX_CONNS,
+                                   g_param_spec_uint ("max-conns",
+                                                      "Maximum connections",
+                                                      "The maximum number of connections the pool opens or keeps",
+                                                      1,
+                                                      G_MAXUINT,
+                                                      DEFAULT_MAX_CONNS,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_IDLE_TIMEOUT,
+                                   g_param_spec_uint ("idle-timeout",
+                                                      "Idle timeout",
+                                                      "Miliseconds after which an idle connection above the target is closed, 0 to keep them",
+                                                      0,
+                                                      G_MAXUINT,
+                                                      DEFAULT_IDLE_TIMEOUT,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_MAX_LIFETIME,
+                                   g_param_spec_uint ("max-lifetime",
+                                                      "Maximum lifetime",
+                                                      "Miliseconds after which a connection is no longer handed out or taken back, 0 for no limit",
+                                                      0,
+                                                      G_MAXUINT,
+                                                      DEFAULT_MAX_LIFETIME,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_MAX_WAITERS,
+                                   g_param_spec_uint ("max-waiters",
+                                                      "Maximum waiters",
+                                                      "The maximum number of requests waiting for a connection, 0 for no limit",
+                                                      0,
+                                                      G_MAXUINT,
+                                                      DEFAULT_MAX_WAITERS,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_WAIT_TIMEOUT,
+                                   g_param_spec_uint ("wait-timeout",
+                                                      "Wait timeout",
+                                                      "Miliseconds a request may wait for a connection before failing, 0 for no limit",
+                                                      0,
+                                                      G_MAXUINT,
+                                                      DEFAULT_WAIT_TIMEOUT,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_PREWARM,
+                                   g_param_spec_boolean ("prewarm",
+                                                         "Pre-warm",
+                                                         "Whether to keep as many idle connections as recent demand needs, between min-conns and max-conns",
+                                                         TRUE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_CONNECT_ATTEMPT_DELAY,
+                                   g_param_spec_uint ("connect-attempt-delay",
+                                                      "Connection attempt delay",
+                                                      "Milliseconds new connections wait on an address before also trying the next one",
+                                                      0,
+                                                      G_MAXUINT,
+                                                      DEFAULT_CONNECT_ATTEMPT_DELAY,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
   g_type_class_add_private (obj_class, sizeof (EvdConnectionPoolPrivate));
 }
 
@@ -151,8 +287,24 @@ evd_connection_pool_init (EvdConnectionPool *self)
 
   priv->tls_autostart = FALSE;
   priv->tls_cred = NULL;
+  priv->tls_resume_data = NULL;
+  priv->tls_resume_data_size = 0;
 
   priv->retry_src_id = 0;
+  priv->retry_timeout = RETRY_TIMEOUT_MIN;
+
+  priv->idle_timeout = DEFAULT_IDLE_TIMEOUT;
+  priv->max_lifetime = DEFAULT_MAX_LIFETIME;
+  priv->max_waiters = DEFAULT_MAX_WAITERS;
+  priv->wait_timeout = DEFAULT_WAIT_TIMEOUT;
+  priv->connect_attempt_delay = DEFAULT_CONNECT_ATTEMPT_DELAY;
+
+  priv->prewarm = TRUE;
+  priv->demand_count = 0;
+  priv->demand = 0;
+  priv->target_conns = DEFAULT_MIN_CONNS;
+
+  priv->housekeeping_src_id = 0;
 }
 
 static void
@@ -162,6 +314,13 @@ evd_connection_pool_constructed (GObject *obj)
 
   evd_connection_pool_create_min_conns (self);
 
+  self->priv->housekeeping_src_id =
+    evd_timeout_add (NULL,
+                     HOUSEKEEPING_INTERVAL,
+                     G_PRIORITY_LOW,
+                     evd_connection_pool_housekeeping,
+                     self);
+
   G_OBJECT_CLASS (evd_connection_pool_parent_class)->constructed (obj);
 }
 
@@ -170,6 +329,12 @@ evd_connection_pool_dispose (GObject *obj)
 {
   EvdConnectionPool *self = EVD_CONNECTION_POOL (obj);
 
+  if (self->priv->housekeeping_src_id != 0)
+    {
+      g_source_remove (self->priv->housekeeping_src_id);
+      self->priv->housekeeping_src_id = 0;
+    }
+
   if (self->priv->conns != NULL)
     {
       g_queue_free_full (self->priv->conns, free_connection_in_queue);
@@ -193,6 +358,8 @@ evd_connection_pool_finalize (GObject *obj)
 
   g_free (self->priv->target);
 
+  g_free (self->priv->tls_resume_data);
+
   if (self->priv->retry_src_id != 0)
     {
       g_source_remove (self->priv->retry_src_id);
@@ -233,6 +400,41 @@ evd_connection_pool_set_property (GObject      *obj,
         break;
       }
 
+    case PROP_MIN_CONNS:
+      self->priv->min_conns = g_value_get_uint (value);
+      evd_connection_pool_update_target (self);
+      break;
+
+    case PROP_MAX_CONNS:
+      self->priv->max_conns = g_value_get_uint (value);
+      evd_connection_pool_update_target (self);
+      break;
+
+    case PROP_IDLE_TIMEOUT:
+      self->priv->idle_timeout = g_value_get_uint (value);
+      break;
+
+    case PROP_MAX_LIFETIME:
+      self->priv->max_lifetime = g_value_get_uint (value);
+      break;
+
+    case PROP_MAX_WAITERS:
+      self->priv->max_waiters = g_value_get_uint (value);
+      break;
+
+    case PROP_WAIT_TIMEOUT:
+      self->priv->wait_timeout = g_value_get_uint (value);
+      break;
+
+    case PROP_PREWARM:
+      self->priv->prewarm = g_value_get_boolean (value);
+      evd_connection_pool_update_target (self);
+      break;
+
+    case PROP_CONNECT_ATTEMPT_DELAY:
+      self->priv->connect_attempt_delay = g_value_get_uint (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
       break;
@@ -259,6 +461,38 @@ evd_connection_pool_get_property (GObject    *obj,
       g_value_set_gtype (value, self->priv->connection_type);
       break;
 
+    case PROP_MIN_CONNS:
+      g_value_set_uint (value, self->priv->min_conns);
+      break;
+
+    case PROP_MAX_CONNS:
+      g_value_set_uint (value, self->priv->max_conns);
+      break;
+
+    case PROP_IDLE_TIMEOUT:
+      g_value_set_uint (value, self->priv->idle_timeout);
+      break;
+
+    case PROP_MAX_LIFETIME:
+      g_value_set_uint (value, self->priv->max_lifetime);
+      break;
+
+    case PROP_MAX_WAITERS:
+      g_value_set_uint (value, self->priv->max_waiters);
+      break;
+
+    case PROP_WAIT_TIMEOUT:
+      g_value_set_uint (value, self->priv->wait_timeout);
+      break;
+
+    case PROP_PREWARM:
+      g_value_set_boolean (value, self->priv->prewarm);
+      break;
+
+    case PROP_CONNECT_ATTEMPT_DELAY:
+      g_value_set_uint (value, self->priv->connect_attempt_delay);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
       break;
@@ -290,6 +524,109 @@ free_connection_in_queue (gpointer user_data)
   g_object_unref (io_stream);
 }
 
+static void
+conn_data_free (gpointer data)
+{
+  g_slice_free (ConnData, data);
+}
+
+static ConnData *
+connection_get_data (EvdConnection *conn)
+{
+  ConnData *data;
+
+  data = g_object_get_data (G_OBJECT (conn), CONN_DATA_KEY);
+  if (data == NULL)
+    {
+      data = g_slice_new (ConnData);
+      data->created = g_get_monotonic_time ();
+      data->idle_since = data->created;
+
+      g_object_set_data_full (G_OBJECT (conn),
+                              CONN_DATA_KEY,
+                              data,
+                              conn_data_free);
+    }
+
+  return data;
+}
+
+static gboolean
+connection_is_expired (EvdConnectionPool *self,
+                       EvdConnection     *conn,
+                       gint64             now)
+{
+  return self->priv->max_lifetime > 0 &&
+    now - connection_get_data (conn)->created >=
+    (gint64) self->priv->max_lifetime * 1000;
+}
+
+static void
+connection_discard (EvdConnectionPool *self, EvdConnection *conn)
+{
+  evd_io_stream_group_remove (EVD_IO_STREAM_GROUP (self), G_IO_STREAM (conn));
+  g_io_stream_close (G_IO_STREAM (conn), NULL, NULL);
+}
+
+/* most recently used first, so the least used ones age out */
+static EvdConnection *
+evd_connection_pool_pop_idle (EvdConnectionPool *self)
+{
+  EvdConnection *conn;
+  gint64 now;
+
+  now = g_get_monotonic_time ();
+
+  while ( (conn = g_queue_pop_tail (self->priv->conns)) != NULL)
+    {
+      if (! connection_is_expired (self, conn, now))
+        return conn;
+
+      connection_discard (self, conn);
+      g_object_unref (conn);
+    }
+
+  return NULL;
+}
+
+static void
+request_data_free (gpointer data)
+{
+  RequestData *req_data = data;
+
+  if (req_data->cancellable != NULL)
+    {
+      g_signal_handler_disconnect (req_data->cancellable,
+                                   req_data->handler_id);
+      g_object_unref (req_data->cancellable);
+    }
+
+  g_slice_free (RequestData, req_data);
+}
+
+static void
+request_on_cancelled (GCancellable *cancellable, gpointer user_data)
+{
+  GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (user_data);
+  EvdConnectionPool *self;
+
+  self = EVD_CONNECTION_POOL (g_async_result_get_source_object (G_ASYNC_RESULT (res)));
+
+  /* only requests still waiting for a connection can be cancelled */
+  if (self->priv->requests != NULL &&
+      g_queue_remove (self->priv->requests, res))
+    {
+      g_simple_async_result_set_error (res,
+                                       G_IO_ERROR,
+                                       G_IO_ERROR_CANCELLED,
+                                       "Operation was cancelled");
+      g_simple_async_result_complete_in_idle (res);
+      g_object_unref (res);
+    }
+
+  g_object_unref (self);
+}
+
 static void
 evd_connection_pool_finish_request (EvdConnectionPool  *self,
                                     EvdConnection      *conn,
@@ -323,10 +660,34 @@ connection_available (EvdConnectionPool *self, EvdConnection *conn)
                         G_CALLBACK (connection_on_close),
                         self);
 
+      connection_get_data (conn)->idle_since = g_get_monotonic_time ();
+
       g_queue_push_tail (self->priv->conns, g_object_ref (conn));
     }
 }
 
+static void
+connection_save_tls_session (EvdConnectionPool *self, EvdConnection *conn)
+{
+  gchar *data;
+  gsize size;
+
+  if (! evd_connection_get_tls_active (conn))
+    return;
+
+  /* keep the latest session parameters, to resume them on the next
+     connection instead of performing a full handshake */
+  data = evd_tls_session_get_resume_data (evd_connection_get_tls_session (conn),
+                                          &size,
+                                          NULL);
+  if (data != NULL)
+    {
+      g_free (self->priv->tls_resume_data);
+      self->priv->tls_resume_data = data;
+      self->priv->tls_resume_data_size = size;
+    }
+}
+
 static void
 connection_on_tls_started (GObject      *obj,
                            GAsyncResult *res,
@@ -338,6 +699,7 @@ connection_on_tls_started (GObject      *obj,
 
   if (evd_connection_starttls_finish (conn, res, &error))
     {
+      connection_save_tls_session (self, conn);
       connection_available (self, conn);
     }
   else
@@ -362,6 +724,11 @@ connection_starttls (EvdConnectionPool *self, EvdConnection *conn)
   tls_cred = evd_connection_pool_get_tls_credentials (self);
   evd_tls_session_set_credentials (tls_session, tls_cred);
 
+  if (self->priv->tls_resume_data != NULL)
+    evd_tls_session_set_resume_data (tls_session,
+                                     self->priv->tls_resume_data,
+                                     self->priv->tls_resume_data_size);
+
   g_object_ref (self);
   evd_connection_starttls (conn,
                            EVD_TLS_MODE_CLIENT,
@@ -426,10 +793,17 @@ static gboolean
 evd_connection_pool_create_min_conns (gpointer user_data)
 {
   EvdConnectionPool *self = EVD_CONNECTION_POOL (user_data);
+  guint wanted;
 
-  self->priv->retry_src_id = 0;
+  /* while backing off, only the retry timeout creates new sockets */
+  if (self->priv->retry_src_id != 0)
+    return FALSE;
+
+  /* the idle target, plus one for each waiter up to the pool's limit */
+  wanted = self->priv->target_conns + g_queue_get_length (self->priv->requests);
+  wanted = MIN (wanted, MAX (self->priv->max_conns, self->priv->target_conns));
 
-  while (TOTAL_SOCKETS (self) < self->priv->min_conns)
+  while (TOTAL_SOCKETS (self) < wanted)
     {
       evd_connection_pool_create_new_socket (self);
     }
@@ -437,6 +811,145 @@ evd_connection_pool_create_min_conns (gpointer user_data)
   return FALSE;
 }
 
+static void
+evd_connection_pool_update_target (EvdConnectionPool *self)
+{
+  guint target;
+
+  target = self->priv->min_conns;
+
+  if (self->priv->prewarm)
+    {
+      guint demand;
+
+      demand = (guint) (self->priv->demand + 0.5);
+      target = MAX (target, MIN (demand, self->priv->max_conns));
+    }
+
+  self->priv->target_conns = target;
+
+  if (self->priv->requests != NULL)
+    evd_connection_pool_create_min_conns (self);
+}
+
+static void
+evd_connection_pool_expire_requests (EvdConnectionPool *self, gint64 now)
+{
+  GList *node;
+
+  node = self->priv->requests->head;
+  while (node != NULL)
+    {
+      GSimpleAsyncResult *res = node->data;
+      RequestData *req_data;
+      GList *next = node->next;
+
+      req_data = g_object_get_data (G_OBJECT (res), REQUEST_DATA_KEY);
+      if (req_data->deadline > 0 && req_data->deadline <= now)
+        {
+          g_queue_delete_link (self->priv->requests, node);
+
+          g_simple_async_result_set_error (res,
+                                           G_IO_ERROR,
+                                           G_IO_ERROR_TIMED_OUT,
+                                           "Timed out waiting for a connection");
+          g_simple_async_result_complete_in_idle (res);
+          g_object_unref (res);
+        }
+
+      node = next;
+    }
+}
+
+static void
+evd_connection_pool_evict_idle (EvdConnectionPool *self, gint64 now)
+{
+  GList *evicted = NULL;
+  GList *node;
+  guint idle;
+
+  idle = g_queue_get_length (self->priv->conns);
+
+  /* oldest idle first; closing one removes it from the queue, so collect
+     them before */
+  for (node = self->priv->conns->head; node != NULL; node = node->next)
+    {
+      EvdConnection *conn = node->data;
+
+      if (connection_is_expired (self, conn, now) ||
+          (self->priv->idle_timeout > 0 &&
+           idle > self->priv->target_conns &&
+           now - connection_get_data (conn)->idle_since >=
+           (gint64) self->priv->idle_timeout * 1000))
+        {
+          evicted = g_list_prepend (evicted, g_object_ref (conn));
+          idle--;
+        }
+    }
+
+  for (node = evicted; node != NULL; node = node->next)
+    {
+      g_io_stream_close (G_IO_STREAM (node->data), NULL, NULL);
+      g_object_unref (node->data);
+    }
+  g_list_free (evicted);
+}
+
+static gboolean
+evd_connection_pool_housekeeping (gpointer user_data)
+{
+  EvdConnectionPool *self = EVD_CONNECTION_POOL (user_data);
+  gint64 now;
+
+  now = g_get_monotonic_time ();
+
+  /* connections handed out per interval, as the idle target to keep */
+  self->priv->demand += DEMAND_EWMA_WEIGHT *
+    (self->priv->demand_count - self->priv->demand);
+  self->priv->demand_count = 0;
+
+  evd_connection_pool_update_target (self);
+
+  evd_connection_pool_expire_requests (self, now);
+  evd_connection_pool_evict_idle (self, now);
+
+  return TRUE;
+}
+
+static gboolean
+evd_connection_pool_retry (gpointer user_data)
+{
+  EvdConnectionPool *self = EVD_CONNECTION_POOL (user_data);
+
+  self->priv->retry_src_id = 0;
+
+  return evd_connection_pool_create_min_conns (self);
+}
+
+static void
+evd_connection_pool_schedule_retry (EvdConnectionPool *self)
+{
+  guint timeout;
+
+  if (self->priv->retry_src_id != 0)
+    return;
+
+  /* random jitter over the upper half, so pools pointing to the same
+     dead target don't retry in lock-step */
+  timeout = self->priv->retry_timeout;
+  timeout = timeout / 2 + g_random_int_range (0, timeout / 2 + 1);
+
+  self->priv->retry_timeout = MIN (self->priv->retry_timeout * 2,
+                                   RETRY_TIMEOUT_MAX);
+
+  self->priv->retry_src_id =
+    evd_timeout_add (NULL,
+                     timeout,
+                     G_PRIORITY_LOW,
+                     evd_connection_pool_retry,
+                     self);
+}
+
 static void
 evd_connection_pool_socket_on_connect (GObject      *obj,
                                        GAsyncResult *res,
@@ -459,6 +972,7 @@ evd_connection_pool_socket_on_connect (GObject      *obj,
           g_source_remove (self->priv->retry_src_id);
           self->priv->retry_src_id = 0;
         }
+      self->priv->retry_timeout = RETRY_TIMEOUT_MIN;
 
       evd_io_stream_group_add (EVD_IO_STREAM_GROUP (self), io_stream);
       g_object_unref (io_stream);
@@ -470,12 +984,7 @@ evd_connection_pool_socket_on_connect (GObject      *obj,
       g_error_free (error);
 
       /* retry after a timeout */
-      self->priv->retry_src_id =
-        evd_timeout_add (NULL,
-                         RETRY_TIMEOUT,
-                         G_PRIORITY_LOW,
-                         evd_connection_pool_create_min_conns,
-                         self);
+      evd_connection_pool_schedule_retry (self);
     }
 
   g_object_unref (socket);
@@ -504,6 +1013,7 @@ evd_connection_pool_create_new_socket (EvdConnectionPool *self)
 
   g_object_set (socket,
                 "io-stream-type", self->priv->connection_type,
+                "connect-attempt-delay", self->priv->connect_attempt_delay,
                 NULL);
 
   self->priv->connecting_sockets++;
@@ -543,6 +1053,14 @@ evd_connection_pool_has_free_connections (EvdConnectionPool *self)
   return g_queue_get_length (self->priv->conns) > 0;
 }
 
+/**
+ * evd_connection_pool_get_connection:
+ * @cancellable: (allow-none): A #GCancellable, to withdraw a request that
+ * is still waiting for a connection
+ * @callback: (allow-none):
+ * @user_data: (allow-none):
+ *
+ **/
 void
 evd_connection_pool_get_connection (EvdConnectionPool   *self,
                                     GCancellable        *cancellable,
@@ -550,6 +1068,7 @@ evd_connection_pool_get_connection (EvdConnectionPool   *self,
                                     gpointer             user_data)
 {
   GSimpleAsyncResult *res;
+  EvdConnection *conn;
 
   g_return_if_fail (EVD_IS_CONNECTION_POOL (self));
 
@@ -558,18 +1077,64 @@ evd_connection_pool_get_connection (EvdConnectionPool   *self,
                                    user_data,
                                    evd_connection_pool_get_connection);
 
-  if (g_queue_get_length (self->priv->conns) > 0)
+  if (cancellable != NULL && g_cancellable_is_cancelled (cancellable))
     {
-      EvdConnection *conn;
+      g_simple_async_result_set_error (res,
+                                       G_IO_ERROR,
+                                       G_IO_ERROR_CANCELLED,
+                                       "Operation was cancelled");
+      g_simple_async_result_complete_in_idle (res);
+      g_object_unref (res);
+
+      return;
+    }
 
-      conn = EVD_CONNECTION (g_queue_pop_head (self->priv->conns));
+  self->priv->demand_count++;
+
+  if ( (conn = evd_connection_pool_pop_idle (self)) != NULL)
+    {
       evd_connection_pool_finish_request (self, conn, res);
       g_object_unref (conn);
 
       evd_connection_pool_create_min_conns (self);
     }
+  else if (self->priv->max_waiters > 0 &&
+           g_queue_get_length (self->priv->requests) >= self->priv->max_waiters)
+    {
+      /* fail fast instead of queueing without bound */
+      g_simple_async_result_set_error (res,
+                                       G_IO_ERROR,
+                                       G_IO_ERROR_BUSY,
+                                       "Too many requests waiting for a connection");
+      g_simple_async_result_complete_in_idle (res);
+      g_object_unref (res);
+    }
   else
     {
+      RequestData *req_data;
+
+      req_data = g_slice_new0 (RequestData);
+
+      if (self->priv->wait_timeout > 0)
+        req_data->deadline = g_get_monotonic_time () +
+          (gint64) self->priv->wait_timeout * 1000;
+
+      if (cancellable != NULL)
+        {
+          /* the handler lives as long as the request does */
+          req_data->cancellable = g_object_ref (cancellable);
+          req_data->handler_id =
+            g_signal_connect (cancellable,
+                              "cancelled",
+                              G_CALLBACK (request_on_cancelled),
+                              res);
+        }
+
+      g_object_set_data_full (G_OBJECT (res),
+                              REQUEST_DATA_KEY,
+                              req_data,
+                              request_data_free);
+
       g_queue_push_tail (self->priv->requests, res);
 
       evd_connection_pool_create_min_conns (self);
@@ -609,6 +1174,14 @@ evd_connection_pool_get_connection_finish (EvdConnectionPool  *self,
     }
 }
 
+/**
+ * evd_connection_pool_recycle:
+ *
+ * Gives @conn back to the pool, to be handed out again. A connection past
+ * #EvdConnectionPool:max-lifetime is closed instead.
+ *
+ * Returns: %TRUE if the pool took @conn.
+ **/
 gboolean
 evd_connection_pool_recycle (EvdConnectionPool *self, EvdConnection *conn)
 {
@@ -621,6 +1194,17 @@ evd_connection_pool_recycle (EvdConnectionPool *self, EvdConnection *conn)
   if (TOTAL_SOCKETS (self) >= self->priv->max_conns)
     return FALSE;
 
+  /* nobody else would take a connection past its lifetime */
+  if (connection_is_expired (self, conn, g_get_monotonic_time ()))
+    {
+      g_io_stream_close (G_IO_STREAM (conn), NULL, NULL);
+      return FALSE;
+    }
+
+  /* session tickets may arrive after the handshake (e.g, TLS 1.3), so
+     refresh the stored session with the one of a used connection */
+  connection_save_tls_session (self, conn);
+
   return evd_io_stream_group_add (EVD_IO_STREAM_GROUP (self),
                                   G_IO_STREAM (conn));
 }
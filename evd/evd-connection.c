@@ -20,6 +20,11 @@
  * for more details.
  */
 
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
 #ifdef HAVE_GIO_UNIX
 #include <gio/gunixsocketaddress.h>
 #endif
@@ -29,6 +34,7 @@
 #include "evd-error.h"
 #include "evd-utils.h"
 #include "evd-marshal.h"
+#include "evd-metrics.h"
 
 #include "evd-socket-input-stream.h"
 #include "evd-socket-output-stream.h"
@@ -73,6 +79,9 @@ struct _EvdConnectionPrivate
   gint close_src_id;
 
   gboolean tls_handshaking;
+  gboolean tls_handshake_pending;
+  gint64 tls_handshake_start;
+  gint64 tls_handshake_time;
   gboolean tls_active;
   EvdTlsSession *tls_session;
   GSimpleAsyncResult *async_result;
@@ -81,6 +90,9 @@ struct _EvdConnectionPrivate
   gboolean closing;
 
   gchar *remote_addr_st;
+
+  /* write queue high-water of buffered streams already replaced */
+  gsize write_high_water;
 };
 
 /* signals */
@@ -92,6 +104,10 @@ enum
 
 static guint evd_connection_signals[SIGNAL_LAST] = { 0 };
 
+static EvdMetric *metric_connections = NULL;
+static EvdMetric *metric_tls_handshake = NULL;
+static EvdMetric *metric_tls_handshake_failures = NULL;
+
 /* properties */
 enum
 {
@@ -118,10 +134,6 @@ static void           evd_connection_get_property      (GObject    *obj,
 static GInputStream  *evd_connection_get_input_stream  (GIOStream *stream);
 static GOutputStream *evd_connection_get_output_stream (GIOStream *stream);
 
-static void           on_group_changed                 (EvdIoStream      *io_stream,
-                                                        EvdIoStreamGroup *new_group,
-                                                        EvdIoStreamGroup *old_group);
-
 static gboolean       evd_connection_close_internal    (GIOStream     *stream,
                                                         GCancellable  *cancellable,
                                                         GError       **error);
@@ -153,7 +165,6 @@ evd_connection_class_init (EvdConnectionClass *class)
 {
   GObjectClass *obj_class;
   GIOStreamClass *io_stream_class;
-  EvdIoStreamClass *evd_io_stream_class;
 
   obj_class = G_OBJECT_CLASS (class);
 
@@ -166,9 +177,6 @@ evd_connection_class_init (EvdConnectionClass *class)
   io_stream_class->get_output_stream = evd_connection_get_output_stream;
   io_stream_class->close_fn = evd_connection_close_internal;
 
-  evd_io_stream_class = EVD_IO_STREAM_CLASS (class);
-  evd_io_stream_class->group_changed = on_group_changed;
-
   evd_connection_signals[SIGNAL_WRITE] =
     g_signal_new ("write",
                   G_TYPE_FROM_CLASS (obj_class),
@@ -214,6 +222,7 @@ evd_connection_init (EvdConnection *self)
   self->priv = priv;
 
   priv->tls_handshaking = FALSE;
+  priv->tls_handshake_pending = FALSE;
 
   priv->delayed_close = FALSE;
   priv->close_locked = FALSE;
@@ -225,6 +234,7 @@ evd_connection_init (EvdConnection *self)
   priv->async_result = NULL;
   priv->tls_session = NULL;
   priv->tls_active = FALSE;
+  priv->tls_handshake_time = -1;
 
   priv->connected = FALSE;
   priv->closing = FALSE;
@@ -232,6 +242,14 @@ evd_connection_init (EvdConnection *self)
   priv->cond = 0;
 
   priv->remote_addr_st = NULL;
+
+  priv->write_high_water = 0;
+
+  evd_metric_add (EVD_METRIC (metric_connections,
+                              "evd_connections",
+                              EVD_METRIC_GAUGE,
+                              "Connection objects currently alive"),
+                  1);
 }
 
 static void
@@ -249,6 +267,8 @@ evd_connection_finalize (GObject *obj)
 
   g_free (self->priv->remote_addr_st);
 
+  evd_metric_add (metric_connections, -1);
+
   G_OBJECT_CLASS (evd_connection_parent_class)->finalize (obj);
 }
 
@@ -320,48 +340,6 @@ evd_connection_get_output_stream (GIOStream *stream)
   return G_OUTPUT_STREAM (self->priv->buf_output_stream);
 }
 
-static void
-on_group_changed (EvdIoStream      *io_stream,
-                  EvdIoStreamGroup *new_group,
-                  EvdIoStreamGroup *old_group)
-{
-  EvdConnection *self = EVD_CONNECTION (io_stream);
-  EvdStreamThrottle *input_throttle;
-  EvdStreamThrottle *output_throttle;
-
-  if (old_group != NULL)
-    {
-      g_object_get (old_group,
-                    "input-throttle", &input_throttle,
-                    "output-throttle", &output_throttle,
-                    NULL);
-
-      evd_throttled_input_stream_remove_throttle (self->priv->throt_input_stream,
-                                                  input_throttle);
-      evd_throttled_output_stream_remove_throttle (self->priv->throt_output_stream,
-                                                   output_throttle);
-
-      g_object_unref (input_throttle);
-      g_object_unref (output_throttle);
-    }
-
-  if (new_group != NULL)
-    {
-      g_object_get (new_group,
-                    "input-throttle", &input_throttle,
-                    "output-throttle", &output_throttle,
-                    NULL);
-
-      evd_throttled_input_stream_add_throttle (self->priv->throt_input_stream,
-                                               input_throttle);
-      evd_throttled_output_stream_add_throttle (self->priv->throt_output_stream,
-                                                output_throttle);
-
-      g_object_unref (input_throttle);
-      g_object_unref (output_throttle);
-    }
-}
-
 static gboolean
 evd_connection_close_internal (GIOStream     *stream,
                                GCancellable  *cancellable,
@@ -548,25 +526,32 @@ evd_connection_close_in_idle (EvdConnection *self)
 }
 
 static void
-evd_connection_tls_handshake (EvdConnection *self)
+evd_connection_tls_handshake_done (EvdConnection *self,
+                                   gint           result,
+                                   GError        *error)
 {
-  GError *error = NULL;
-  GIOCondition direction;
-  gint result;
   GSimpleAsyncResult *res;
 
-  direction = evd_tls_session_get_direction (TLS_SESSION (self));
-  if ( (direction == G_IO_IN && self->priv->read_src_id != 0) ||
-       (direction == G_IO_OUT && self->priv->write_src_id != 0) )
-    return;
-
-  result = evd_tls_session_handshake (TLS_SESSION (self), &error);
-
-  if (result == 0)
-    return;
-
   self->priv->tls_handshaking = FALSE;
 
+  if (result > 0)
+    {
+      self->priv->tls_handshake_time =
+        g_get_monotonic_time () - self->priv->tls_handshake_start;
+
+      evd_metric_observe (EVD_METRIC (metric_tls_handshake,
+                                      "evd_tls_handshake_duration_seconds",
+                                      EVD_METRIC_LATENCY,
+                                      "Time taken by successful TLS handshakes"),
+                          self->priv->tls_handshake_time);
+    }
+  else
+    evd_metric_add (EVD_METRIC (metric_tls_handshake_failures,
+                                "evd_tls_handshake_failures_total",
+                                EVD_METRIC_COUNTER,
+                                "TLS handshakes that failed"),
+                    1);
+
   res = self->priv->async_result;
   self->priv->async_result = NULL;
 
@@ -594,6 +579,72 @@ evd_connection_tls_handshake (EvdConnection *self)
     }
 }
 
+static void
+evd_connection_on_tls_handshake_step (GObject      *obj,
+                                      GAsyncResult *res,
+                                      gpointer      user_data)
+{
+  EvdConnection *self = EVD_CONNECTION (user_data);
+  GError *error = NULL;
+  gint result;
+
+  self->priv->tls_handshake_pending = FALSE;
+
+  result = evd_tls_session_handshake_finish (EVD_TLS_SESSION (obj),
+                                             res,
+                                             &error);
+
+  /* connection was closed or reset while the step was running */
+  if (CLOSED (self) || ! self->priv->tls_handshaking)
+    {
+      if (error != NULL)
+        g_error_free (error);
+    }
+  else if (result != 0)
+    {
+      evd_connection_tls_handshake_done (self, result, error);
+    }
+
+  g_object_unref (self);
+}
+
+static void
+evd_connection_tls_handshake (EvdConnection *self)
+{
+  EvdTlsSession *session;
+  GError *error = NULL;
+  GIOCondition direction;
+  gboolean threaded;
+  gint result;
+
+  /* a worker thread is running a step, it will pick up new input */
+  if (self->priv->tls_handshake_pending)
+    return;
+
+  session = TLS_SESSION (self);
+
+  direction = evd_tls_session_get_direction (session);
+  if ( (direction == G_IO_IN && self->priv->read_src_id != 0) ||
+       (direction == G_IO_OUT && self->priv->write_src_id != 0) )
+    return;
+
+  g_object_get (session, "threaded-handshake", &threaded, NULL);
+  if (threaded)
+    {
+      self->priv->tls_handshake_pending = TRUE;
+      evd_tls_session_handshake_async (session,
+                                       NULL,
+                                       evd_connection_on_tls_handshake_step,
+                                       g_object_ref (self));
+      return;
+    }
+
+  result = evd_tls_session_handshake (session, &error);
+
+  if (result != 0)
+    evd_connection_tls_handshake_done (self, result, error);
+}
+
 static void
 evd_connection_manage_read_condition (EvdConnection *self)
 {
@@ -792,7 +843,6 @@ evd_connection_setup_streams (EvdConnection *self)
 {
   EvdStreamThrottle *input_throttle;
   EvdStreamThrottle *output_throttle;
-  EvdIoStreamGroup *group;
 
   /* socket input stream */
   self->priv->socket_input_stream =
@@ -840,26 +890,6 @@ evd_connection_setup_streams (EvdConnection *self)
                     G_CALLBACK (evd_connection_delay_write),
                     self);
 
-  group = evd_io_stream_get_group (EVD_IO_STREAM (self));
-  if (group != NULL)
-    {
-      EvdStreamThrottle *input_throttle;
-      EvdStreamThrottle *output_throttle;
-
-      g_object_get (group,
-                    "input-throttle", &input_throttle,
-                    "output-throttle", &output_throttle,
-                    NULL);
-
-      evd_throttled_input_stream_add_throttle (self->priv->throt_input_stream,
-                                               input_throttle);
-      evd_throttled_output_stream_add_throttle (self->priv->throt_output_stream,
-                                                output_throttle);
-
-      g_object_unref (input_throttle);
-      g_object_unref (output_throttle);
-    }
-
   /* buffered input stream */
   self->priv->buf_input_stream =
     evd_buffered_input_stream_new (G_INPUT_STREAM (self->priv->throt_input_stream));
@@ -905,6 +935,8 @@ evd_connection_teardown_streams (EvdConnection *self)
 
   g_object_unref (self->priv->socket_input_stream);
   g_object_unref (self->priv->socket_output_stream);
+
+  self->priv->write_high_water = 0;
 }
 
 static void
@@ -927,6 +959,17 @@ evd_connection_shutdown_on_flush (GObject      *obj,
   g_object_unref (self);
 }
 
+static void
+evd_connection_save_write_high_water (EvdConnection *self)
+{
+  gsize high_water;
+
+  evd_buffered_output_stream_get_buffered_size (self->priv->buf_output_stream,
+                                                &high_water);
+  self->priv->write_high_water = MAX (self->priv->write_high_water,
+                                      high_water);
+}
+
 /* public methods */
 
 EvdConnection *
@@ -982,6 +1025,7 @@ evd_connection_set_socket (EvdConnection *self, EvdSocket *socket)
       self->priv->tls_active = FALSE;
 
       self->priv->tls_handshaking = FALSE;
+      self->priv->tls_handshake_time = -1;
 
       g_assert (EVD_IS_TLS_INPUT_STREAM (self->priv->tls_input_stream));
       g_object_unref (self->priv->tls_input_stream);
@@ -1136,6 +1180,7 @@ evd_connection_starttls (EvdConnection       *self,
 
   g_filter_output_stream_set_close_base_stream (
     G_FILTER_OUTPUT_STREAM (self->priv->buf_output_stream), FALSE);
+  evd_connection_save_write_high_water (self);
   g_object_unref (self->priv->buf_output_stream);
 
   self->priv->buf_output_stream =
@@ -1147,6 +1192,7 @@ evd_connection_starttls (EvdConnection       *self,
                                              FALSE);
 
   self->priv->tls_handshaking = TRUE;
+  self->priv->tls_handshake_start = g_get_monotonic_time ();
 
   if (mode == EVD_TLS_MODE_CLIENT && self->priv->cond & G_IO_OUT)
     evd_connection_tls_handshake (self);
@@ -1335,3 +1381,76 @@ evd_connection_get_remote_address_as_string (EvdConnection  *self,
 
   return addr_str;
 }
+
+/**
+ * evd_connection_get_stats:
+ * @stats: (out caller-allocates): an #EvdConnectionStats to fill
+ *
+ * Takes a snapshot of the traffic counters of the connection. This is cheap
+ * enough to be called periodically for every connection.
+ *
+ * Since: 0.2.0
+ **/
+void
+evd_connection_get_stats (EvdConnection *self, EvdConnectionStats *stats)
+{
+  gint64 last_read = 0;
+  gint64 last_write = 0;
+  gsize high_water;
+#ifdef TCP_INFO
+  GSocket *socket;
+#endif
+
+  g_return_if_fail (EVD_IS_CONNECTION (self));
+  g_return_if_fail (stats != NULL);
+
+  memset (stats, 0, sizeof (EvdConnectionStats));
+  stats->rtt = -1;
+  stats->rtt_var = -1;
+  stats->tls_handshake_time = self->priv->tls_handshake_time;
+
+  if (self->priv->socket_input_stream == NULL)
+    return;
+
+  stats->bytes_read =
+    evd_socket_input_stream_get_total_read (self->priv->socket_input_stream,
+                                            &last_read);
+  stats->bytes_written =
+    evd_socket_output_stream_get_total_written (self->priv->socket_output_stream,
+                                                &last_write);
+  stats->last_activity = MAX (last_read, last_write);
+
+  /* data waiting to be written, including what TLS has already encrypted */
+  stats->write_queue =
+    evd_buffered_output_stream_get_buffered_size (self->priv->buf_output_stream,
+                                                  &high_water);
+  stats->write_queue_high_water = MAX (self->priv->write_high_water,
+                                       high_water);
+
+  if (self->priv->tls_output_stream != NULL)
+    {
+      stats->write_queue += evd_buffered_output_stream_get_buffered_size (
+                              EVD_BUFFERED_OUTPUT_STREAM (self->priv->tls_output_stream),
+                              NULL);
+    }
+
+#ifdef TCP_INFO
+  socket = evd_socket_get_socket (self->priv->socket);
+  if (socket != NULL &&
+      g_socket_get_protocol (socket) == G_SOCKET_PROTOCOL_TCP)
+    {
+      struct tcp_info info;
+      socklen_t len = sizeof (info);
+
+      if (getsockopt (g_socket_get_fd (socket),
+                      IPPROTO_TCP,
+                      TCP_INFO,
+                      &info,
+                      &len) == 0)
+        {
+          stats->rtt = info.tcpi_rtt;
+          stats->rtt_var = info.tcpi_rttvar;
+        }
+    }
+#endif
+}
@@ -40,6 +40,7 @@ G_BEGIN_DECLS
 typedef struct _EvdConnection EvdConnection;
 typedef struct _EvdConnectionClass EvdConnectionClass;
 typedef struct _EvdConnectionPrivate EvdConnectionPrivate;
+typedef struct _EvdConnectionStats EvdConnectionStats;
 
 struct _EvdConnection
 {
@@ -67,6 +68,37 @@ struct _EvdConnectionClass
   void (* _padding_7_) (void);
 };
 
+/**
+ * EvdConnectionStats:
+ * @bytes_read: bytes read from the socket
+ * @bytes_written: bytes written to the socket
+ * @write_queue: bytes buffered and not yet written to the socket
+ * @write_queue_high_water: the largest the write buffer has been
+ * @last_activity: monotonic time of the last read or write, or 0 if none
+ * @rtt: smoothed round-trip time in microseconds, or -1 if unknown
+ * @rtt_var: round-trip time variance in microseconds, or -1 if unknown
+ * @tls_handshake_time: duration of the TLS handshake in microseconds, or -1
+ *
+ * A snapshot of the traffic of an #EvdConnection, filled by
+ * evd_connection_get_stats(). The round-trip time is read from TCP_INFO and
+ * is only available on TCP sockets.
+ **/
+struct _EvdConnectionStats
+{
+  guint64 bytes_read;
+  guint64 bytes_written;
+
+  gsize write_queue;
+  gsize write_queue_high_water;
+
+  gint64 last_activity;
+
+  gint64 rtt;
+  gint64 rtt_var;
+
+  gint64 tls_handshake_time;
+};
+
 #define EVD_TYPE_CONNECTION           (evd_connection_get_type ())
 #define EVD_CONNECTION(obj)           (G_TYPE_CHECK_INSTANCE_CAST ((obj), EVD_TYPE_CONNECTION, EvdConnection))
 #define EVD_CONNECTION_CLASS(obj)     (G_TYPE_CHECK_CLASS_CAST ((obj), EVD_TYPE_CONNECTION, EvdConnectionClass))
@@ -112,6 +144,9 @@ void               evd_connection_flush_and_shutdown   (EvdConnection  *self,
 gchar *            evd_connection_get_remote_address_as_string (EvdConnection  *self,
                                                                 GError        **error);
 
+void               evd_connection_get_stats            (EvdConnection      *self,
+                                                        EvdConnectionStats *stats);
+
 G_END_DECLS
 
 #endif /* __EVD_CONNECTION_H__ */
@@ -20,6 +20,11 @@
  * for more details.
  */
 
+/* for accept4() and struct ucred */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -28,6 +33,12 @@
 #include <errno.h>
 #include <string.h>
 #include <pwd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include <glib/gprintf.h>
 #include <gio/gio.h>
@@ -36,6 +47,7 @@
 
 #include "evd-utils.h"
 #include "evd-error.h"
+#include "evd-socket.h"
 
 G_DEFINE_TYPE (EvdDaemon, evd_daemon, G_TYPE_OBJECT)
 
@@ -43,6 +55,27 @@ G_DEFINE_TYPE (EvdDaemon, evd_daemon, G_TYPE_OBJECT)
                                      EVD_TYPE_DAEMON, \
                                      EvdDaemonPrivate))
 
+/* a worker that dies younger than this is respawned after a delay,
+   in miliseconds */
+#define WORKER_MIN_LIFETIME     1000
+#define WORKER_RESPAWN_DELAY    1000
+
+/* on rolling restarts, time a new worker gets to start up before its
+   predecessor is told to quit, in miliseconds */
+#define ROLLING_RESTART_GRACE   1000
+
+/* time workers get to quit before being killed, in miliseconds */
+#define WORKER_STOP_TIMEOUT    10000
+
+/* listener handoff, see evd_daemon_set_handoff_path() */
+#define HANDOFF_TIMEOUT          5 /* in seconds */
+#define HANDOFF_ADOPT_TIMEOUT 5000 /* in miliseconds */
+#define DEFAULT_DRAIN_TIMEOUT 30000 /* in miliseconds */
+
+#define HANDOFF_MSG_REQUEST  'H'
+#define HANDOFF_MSG_FD       'F'
+#define HANDOFF_MSG_END      'E'
+
 /* private data */
 struct _EvdDaemonPrivate
 {
@@ -54,15 +87,58 @@ struct _EvdDaemonPrivate
   gint exit_code;
 
   gchar *pid_file;
+
+  /* worker mode */
+  guint workers;
+  gint worker_id;
+
+  GMainContext *supervisor_context;
+  GMainLoop *supervisor_loop;
+  GList *worker_list;
+  gint signal_pipe[2];
+  gint restart_slot;
+  gboolean stopping;
+
+  /* listener handoff */
+  gchar *handoff_path;
+  gint handoff_fd;
+  GSource *handoff_src;
+  gint handoff_client_fd;
+  GSource *handoff_client_src;
+  GSource *handoff_client_timeout_src;
+  guint drain_timeout;
 };
 
+/* signals */
+enum
+{
+  SIGNAL_DRAIN,
+  SIGNAL_LAST
+};
+
+static guint evd_daemon_signals[SIGNAL_LAST] = { 0 };
+
+typedef struct
+{
+  EvdDaemon *self;
+  guint slot;
+  GPid pid;
+  gint64 started;
+  gboolean retiring;
+} EvdDaemonWorker;
+
 static EvdDaemon *evd_daemon_default = NULL;
 
+/* the daemon whose signal pipe SIGCHLD is forwarded to */
+static EvdDaemon *evd_daemon_supervisor = NULL;
+
 static void     evd_daemon_class_init         (EvdDaemonClass *class);
 static void     evd_daemon_init               (EvdDaemon *self);
 
 static void     evd_daemon_finalize           (GObject *obj);
 
+static void     evd_daemon_handoff_stop       (EvdDaemon *self);
+
 static void
 evd_daemon_class_init (EvdDaemonClass *class)
 {
@@ -70,6 +146,23 @@ evd_daemon_class_init (EvdDaemonClass *class)
 
   obj_class->finalize = evd_daemon_finalize;
 
+  /**
+   * EvdDaemon::drain:
+   *
+   * Emitted when another process has taken over this daemon's
+   * listening sockets. No new connections arrive from then on; the
+   * daemon quits once the drain timeout expires, or earlier if
+   * evd_daemon_quit() is called once the existing connections are done.
+   **/
+  evd_daemon_signals[SIGNAL_DRAIN] =
+    g_signal_new ("drain",
+                  G_TYPE_FROM_CLASS (obj_class),
+                  G_SIGNAL_RUN_LAST,
+                  0,
+                  NULL, NULL,
+                  g_cclosure_marshal_VOID__VOID,
+                  G_TYPE_NONE, 0);
+
   g_type_class_add_private (obj_class, sizeof (EvdDaemonPrivate));
 }
 
@@ -90,6 +183,25 @@ evd_daemon_init (EvdDaemon *self)
   priv->exit_code = 0;
 
   priv->pid_file = NULL;
+
+  priv->workers = 0;
+  priv->worker_id = -1;
+
+  priv->supervisor_context = NULL;
+  priv->supervisor_loop = NULL;
+  priv->worker_list = NULL;
+  priv->signal_pipe[0] = -1;
+  priv->signal_pipe[1] = -1;
+  priv->restart_slot = -1;
+  priv->stopping = FALSE;
+
+  priv->handoff_path = NULL;
+  priv->handoff_fd = -1;
+  priv->handoff_src = NULL;
+  priv->handoff_client_fd = -1;
+  priv->handoff_client_src = NULL;
+  priv->handoff_client_timeout_src = NULL;
+  priv->drain_timeout = DEFAULT_DRAIN_TIMEOUT;
 }
 
 static void
@@ -101,6 +213,9 @@ evd_daemon_finalize (GObject *obj)
 
   g_free (self->priv->pid_file);
 
+  evd_daemon_handoff_stop (self);
+  g_free (self->priv->handoff_path);
+
   G_OBJECT_CLASS (evd_daemon_parent_class)->finalize (obj);
 
   if (evd_daemon_default == self)
@@ -117,6 +232,845 @@ evd_daemon_on_user_interrupt (gint sig)
     evd_daemon_quit (evd_daemon_default, -sig);
 }
 
+/* listener handoff */
+
+static void
+evd_daemon_handoff_drop_client (EvdDaemon *self)
+{
+  if (self->priv->handoff_client_src != NULL)
+    {
+      g_source_destroy (self->priv->handoff_client_src);
+      g_source_unref (self->priv->handoff_client_src);
+      self->priv->handoff_client_src = NULL;
+    }
+
+  if (self->priv->handoff_client_timeout_src != NULL)
+    {
+      g_source_destroy (self->priv->handoff_client_timeout_src);
+      g_source_unref (self->priv->handoff_client_timeout_src);
+      self->priv->handoff_client_timeout_src = NULL;
+    }
+
+  if (self->priv->handoff_client_fd != -1)
+    {
+      close (self->priv->handoff_client_fd);
+      self->priv->handoff_client_fd = -1;
+    }
+}
+
+static void
+evd_daemon_handoff_stop (EvdDaemon *self)
+{
+  evd_daemon_handoff_drop_client (self);
+
+  if (self->priv->handoff_src != NULL)
+    {
+      g_source_destroy (self->priv->handoff_src);
+      g_source_unref (self->priv->handoff_src);
+      self->priv->handoff_src = NULL;
+    }
+
+  if (self->priv->handoff_fd != -1)
+    {
+      close (self->priv->handoff_fd);
+      self->priv->handoff_fd = -1;
+    }
+}
+
+static gboolean
+evd_daemon_handoff_make_address (EvdDaemon           *self,
+                                 struct sockaddr_un  *addr,
+                                 GError             **error)
+{
+  if (strlen (self->priv->handoff_path) >= sizeof (addr->sun_path))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_ARGUMENT,
+                   "Handoff path too long: %s",
+                   self->priv->handoff_path);
+      return FALSE;
+    }
+
+  memset (addr, 0, sizeof (struct sockaddr_un));
+  addr->sun_family = AF_UNIX;
+  strcpy (addr->sun_path, self->priv->handoff_path);
+
+  return TRUE;
+}
+
+static gboolean
+evd_daemon_handoff_send (gint fd, gchar msg, gint passed_fd)
+{
+  struct msghdr hdr = { 0 };
+  struct iovec iov;
+  union
+  {
+    struct cmsghdr align;
+    gchar buf[CMSG_SPACE (sizeof (gint))];
+  } ctrl;
+
+  iov.iov_base = &msg;
+  iov.iov_len = 1;
+  hdr.msg_iov = &iov;
+  hdr.msg_iovlen = 1;
+
+  if (passed_fd >= 0)
+    {
+      struct cmsghdr *cmsg;
+
+      memset (&ctrl, 0, sizeof (ctrl));
+      hdr.msg_control = ctrl.buf;
+      hdr.msg_controllen = sizeof (ctrl.buf);
+
+      cmsg = CMSG_FIRSTHDR (&hdr);
+      cmsg->cmsg_level = SOL_SOCKET;
+      cmsg->cmsg_type = SCM_RIGHTS;
+      cmsg->cmsg_len = CMSG_LEN (sizeof (gint));
+      memcpy (CMSG_DATA (cmsg), &passed_fd, sizeof (gint));
+    }
+
+  return sendmsg (fd, &hdr, MSG_NOSIGNAL) == 1;
+}
+
+/* returns the message type, or 0 on error; *passed_fd is -1 if no
+   descriptor came with it */
+static gchar
+evd_daemon_handoff_recv (gint fd, gint *passed_fd)
+{
+  struct msghdr hdr = { 0 };
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  gchar msg;
+  union
+  {
+    struct cmsghdr align;
+    gchar buf[CMSG_SPACE (sizeof (gint))];
+  } ctrl;
+
+  *passed_fd = -1;
+
+  iov.iov_base = &msg;
+  iov.iov_len = 1;
+  hdr.msg_iov = &iov;
+  hdr.msg_iovlen = 1;
+  hdr.msg_control = ctrl.buf;
+  hdr.msg_controllen = sizeof (ctrl.buf);
+
+  if (recvmsg (fd, &hdr, MSG_CMSG_CLOEXEC) != 1)
+    return 0;
+
+  for (cmsg = CMSG_FIRSTHDR (&hdr); cmsg != NULL; cmsg = CMSG_NXTHDR (&hdr, cmsg))
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+      memcpy (passed_fd, CMSG_DATA (cmsg), sizeof (gint));
+
+  return msg;
+}
+
+static gboolean
+evd_daemon_on_drain_timeout (gpointer user_data)
+{
+  EvdDaemon *self = EVD_DAEMON (user_data);
+
+  evd_daemon_quit (self, 0);
+
+  return FALSE;
+}
+
+/* only a process of the same user, or root, gets the listeners */
+static gboolean
+evd_daemon_handoff_check_peer (gint fd)
+{
+  struct ucred cred;
+  socklen_t len = sizeof (cred);
+
+  if (getsockopt (fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+    return FALSE;
+
+  return cred.uid == geteuid () || cred.uid == 0;
+}
+
+static void
+evd_daemon_handoff_serve (EvdDaemon *self, gint fd)
+{
+  struct timeval timeout = { HANDOFF_TIMEOUT, 0 };
+  GList *listeners;
+  GList *node;
+
+  /* the messages are tiny, but don't wait forever on a stuck peer */
+  fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) & ~O_NONBLOCK);
+  setsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout));
+
+  listeners = evd_socket_get_listeners ();
+  for (node = listeners; node != NULL; node = node->next)
+    {
+      GSocket *socket;
+
+      socket = evd_socket_get_socket (EVD_SOCKET (node->data));
+      if (socket != NULL &&
+          ! evd_daemon_handoff_send (fd,
+                                     HANDOFF_MSG_FD,
+                                     g_socket_get_fd (socket)))
+        {
+          /* the new process is gone, keep serving */
+          g_list_free (listeners);
+          close (fd);
+
+          return;
+        }
+    }
+
+  evd_daemon_handoff_send (fd, HANDOFF_MSG_END, -1);
+  close (fd);
+
+  /* the new process owns the handoff path now, stop accepting on our
+     copies of the listeners and let the existing connections finish */
+  evd_daemon_handoff_stop (self);
+
+  for (node = listeners; node != NULL; node = node->next)
+    evd_socket_close (EVD_SOCKET (node->data), NULL);
+  g_list_free (listeners);
+
+  g_signal_emit (self, evd_daemon_signals[SIGNAL_DRAIN], 0, NULL);
+
+  evd_daemon_set_timeout (self,
+                          self->priv->drain_timeout,
+                          evd_daemon_on_drain_timeout,
+                          self);
+}
+
+static gboolean
+evd_daemon_handoff_on_client_timeout (gpointer user_data)
+{
+  EvdDaemon *self = EVD_DAEMON (user_data);
+
+  evd_daemon_handoff_drop_client (self);
+
+  return FALSE;
+}
+
+static gboolean
+evd_daemon_handoff_on_client (GIOChannel   *channel,
+                              GIOCondition  cond,
+                              gpointer      user_data)
+{
+  EvdDaemon *self = EVD_DAEMON (user_data);
+  gint passed_fd;
+  gint fd;
+  gchar msg;
+
+  errno = 0;
+  msg = evd_daemon_handoff_recv (self->priv->handoff_client_fd, &passed_fd);
+  if (msg == 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    return TRUE;
+
+  if (passed_fd >= 0)
+    close (passed_fd);
+
+  /* keep the connection, drop the watch and the timeout */
+  fd = self->priv->handoff_client_fd;
+  self->priv->handoff_client_fd = -1;
+  evd_daemon_handoff_drop_client (self);
+
+  if (msg == HANDOFF_MSG_REQUEST)
+    evd_daemon_handoff_serve (self, fd);
+  else
+    close (fd);
+
+  return FALSE;
+}
+
+static gboolean
+evd_daemon_handoff_on_request (GIOChannel   *channel,
+                               GIOCondition  cond,
+                               gpointer      user_data)
+{
+  EvdDaemon *self = EVD_DAEMON (user_data);
+  GIOChannel *client_channel;
+  gint fd;
+
+  fd = accept4 (self->priv->handoff_fd,
+                NULL,
+                NULL,
+                SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (fd < 0)
+    return TRUE;
+
+  if (! evd_daemon_handoff_check_peer (fd))
+    {
+      g_warning ("Refused listener handoff to a process of another user");
+      close (fd);
+
+      return TRUE;
+    }
+
+  /* one successor at a time, a newer one replaces a stalled one */
+  evd_daemon_handoff_drop_client (self);
+  self->priv->handoff_client_fd = fd;
+
+  client_channel = g_io_channel_unix_new (fd);
+  self->priv->handoff_client_src =
+    g_io_create_watch (client_channel, G_IO_IN | G_IO_HUP | G_IO_ERR);
+  g_source_set_callback (self->priv->handoff_client_src,
+                         (GSourceFunc) evd_daemon_handoff_on_client,
+                         self,
+                         NULL);
+  g_source_attach (self->priv->handoff_client_src,
+                   g_main_loop_get_context (self->priv->main_loop));
+  g_io_channel_unref (client_channel);
+
+  self->priv->handoff_client_timeout_src =
+    g_timeout_source_new_seconds (HANDOFF_TIMEOUT);
+  g_source_set_callback (self->priv->handoff_client_timeout_src,
+                         evd_daemon_handoff_on_client_timeout,
+                         self,
+                         NULL);
+  g_source_attach (self->priv->handoff_client_timeout_src,
+                   g_main_loop_get_context (self->priv->main_loop));
+
+  return TRUE;
+}
+
+static gboolean
+evd_daemon_on_adopt_timeout (gpointer user_data)
+{
+  evd_socket_drop_inherited_listeners ();
+
+  return FALSE;
+}
+
+/* asks a running instance for its listeners, fine if there is none */
+static void
+evd_daemon_handoff_receive (EvdDaemon *self)
+{
+  struct sockaddr_un addr;
+  struct timeval timeout = { HANDOFF_TIMEOUT, 0 };
+  gint fd;
+  gchar msg;
+  gint passed_fd;
+
+  if (! evd_daemon_handoff_make_address (self, &addr, NULL))
+    return;
+
+  fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return;
+
+  setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+  setsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout));
+
+  if (connect (fd, (struct sockaddr *) &addr, sizeof (addr)) != 0 ||
+      ! evd_daemon_handoff_send (fd, HANDOFF_MSG_REQUEST, -1))
+    {
+      close (fd);
+      return;
+    }
+
+  while ( (msg = evd_daemon_handoff_recv (fd, &passed_fd)) == HANDOFF_MSG_FD)
+    {
+      GError *error = NULL;
+
+      if (passed_fd < 0)
+        continue;
+
+      if (! evd_socket_inherit_listener (passed_fd, &error))
+        {
+          g_warning ("Ignoring handed over listener: %s", error->message);
+          g_error_free (error);
+          close (passed_fd);
+        }
+    }
+
+  if (passed_fd >= 0)
+    close (passed_fd);
+
+  if (msg != HANDOFF_MSG_END)
+    g_warning ("Listener handoff from %s was interrupted",
+               self->priv->handoff_path);
+
+  close (fd);
+
+  /* whatever the application doesn't listen on again by then is gone */
+  evd_daemon_set_timeout (self,
+                          HANDOFF_ADOPT_TIMEOUT,
+                          evd_daemon_on_adopt_timeout,
+                          self);
+}
+
+/* serves the listeners to the next instance */
+static gboolean
+evd_daemon_handoff_start (EvdDaemon *self, GError **error)
+{
+  struct sockaddr_un addr;
+  GIOChannel *channel;
+
+  if (! evd_daemon_handoff_make_address (self, &addr, error))
+    return FALSE;
+
+  self->priv->handoff_fd = socket (AF_UNIX,
+                                   SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                                   0);
+  if (self->priv->handoff_fd < 0)
+    goto error;
+
+  /* the previous instance, if any, is done with the path */
+  unlink (self->priv->handoff_path);
+
+  /* nobody can connect before listen(), so restricting the path right
+     after binding leaves no window for other users */
+  if (bind (self->priv->handoff_fd,
+            (struct sockaddr *) &addr,
+            sizeof (addr)) != 0 ||
+      chmod (self->priv->handoff_path, S_IRUSR | S_IWUSR) != 0 ||
+      listen (self->priv->handoff_fd, 1) != 0)
+    {
+      goto error;
+    }
+
+  channel = g_io_channel_unix_new (self->priv->handoff_fd);
+  self->priv->handoff_src = g_io_create_watch (channel, G_IO_IN);
+  g_source_set_callback (self->priv->handoff_src,
+                         (GSourceFunc) evd_daemon_handoff_on_request,
+                         self,
+                         NULL);
+  g_source_attach (self->priv->handoff_src,
+                   g_main_loop_get_context (self->priv->main_loop));
+  g_io_channel_unref (channel);
+
+  return TRUE;
+
+ error:
+  g_set_error (error,
+               G_IO_ERROR,
+               g_io_error_from_errno (errno),
+               "Failed to listen for handoff on %s: %s",
+               self->priv->handoff_path,
+               strerror (errno));
+
+  evd_daemon_handoff_stop (self);
+
+  return FALSE;
+}
+
+/* worker mode */
+
+static gboolean evd_daemon_spawn_worker (EvdDaemon *self, guint slot);
+
+static void evd_daemon_reap_workers (EvdDaemon *self);
+
+static void
+evd_daemon_on_supervisor_signal (gint sig)
+{
+  guchar sig_byte = (guchar) sig;
+  gint saved_errno = errno;
+
+  if (evd_daemon_supervisor != NULL &&
+      write (evd_daemon_supervisor->priv->signal_pipe[1], &sig_byte, 1) < 0)
+    {
+      /* nothing to do, pipe is full and a signal is already pending */
+    }
+
+  errno = saved_errno;
+}
+
+static gboolean
+evd_daemon_on_signal_pipe (GIOChannel   *channel,
+                           GIOCondition  cond,
+                           gpointer      user_data)
+{
+  EvdDaemon *self = EVD_DAEMON (user_data);
+  guchar sig;
+
+  while (read (self->priv->signal_pipe[0], &sig, 1) == 1)
+    {
+      if (sig == SIGCHLD)
+        evd_daemon_reap_workers (self);
+      else if (sig == SIGHUP)
+        evd_daemon_restart_workers (self);
+      else
+        evd_daemon_quit (self, -sig);
+
+      /* we are a new worker, stop acting as supervisor */
+      if (self->priv->worker_id >= 0)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static EvdDaemonWorker *
+evd_daemon_find_worker (EvdDaemon *self, guint slot)
+{
+  GList *node;
+
+  for (node = self->priv->worker_list; node != NULL; node = node->next)
+    {
+      EvdDaemonWorker *worker = node->data;
+
+      if (worker->slot == slot && ! worker->retiring)
+        return worker;
+    }
+
+  return NULL;
+}
+
+static void
+evd_daemon_restart_next (EvdDaemon *self)
+{
+  while (self->priv->restart_slot >= 0 &&
+         self->priv->restart_slot < (gint) self->priv->workers)
+    {
+      EvdDaemonWorker *worker;
+
+      worker = evd_daemon_find_worker (self, self->priv->restart_slot);
+      if (worker == NULL)
+        {
+          /* slot is waiting to be respawned, it will start fresh anyway */
+          self->priv->restart_slot++;
+          continue;
+        }
+
+      /* start the successor first so the listeners never go away, the
+         old worker is told to quit once the grace period is over */
+      worker->retiring = TRUE;
+      evd_daemon_spawn_worker (self, worker->slot);
+
+      return;
+    }
+
+  self->priv->restart_slot = -1;
+}
+
+static gboolean
+evd_daemon_retire_worker (gpointer user_data)
+{
+  EvdDaemon *self = EVD_DAEMON (user_data);
+  GList *node;
+
+  for (node = self->priv->worker_list; node != NULL; node = node->next)
+    {
+      EvdDaemonWorker *worker = node->data;
+
+      if (worker->retiring && (gint) worker->slot == self->priv->restart_slot)
+        kill (worker->pid, SIGTERM);
+    }
+
+  return FALSE;
+}
+
+static gboolean
+evd_daemon_respawn_worker (gpointer user_data)
+{
+  EvdDaemonWorker *worker = user_data;
+  EvdDaemon *self = worker->self;
+  guint slot = worker->slot;
+
+  g_slice_free (EvdDaemonWorker, worker);
+
+  if (! self->priv->stopping)
+    evd_daemon_spawn_worker (self, slot);
+
+  return FALSE;
+}
+
+static void
+evd_daemon_on_worker_exit (EvdDaemonWorker *worker, gint status)
+{
+  EvdDaemon *self = worker->self;
+
+  self->priv->worker_list = g_list_remove (self->priv->worker_list, worker);
+
+  if (self->priv->stopping)
+    {
+      g_slice_free (EvdDaemonWorker, worker);
+
+      if (self->priv->worker_list == NULL)
+        g_main_loop_quit (self->priv->supervisor_loop);
+    }
+  else if (worker->retiring)
+    {
+      g_slice_free (EvdDaemonWorker, worker);
+
+      if (self->priv->restart_slot >= 0)
+        {
+          self->priv->restart_slot++;
+          evd_daemon_restart_next (self);
+        }
+    }
+  else
+    {
+      gint64 lifetime;
+      GSource *src;
+
+      if (WIFSIGNALED (status))
+        g_warning ("Worker %u (pid %d) was killed by signal %d (%s)",
+                   worker->slot,
+                   worker->pid,
+                   WTERMSIG (status),
+                   g_strsignal (WTERMSIG (status)));
+      else
+        g_warning ("Worker %u (pid %d) exited unexpectedly with status %d",
+                   worker->slot,
+                   worker->pid,
+                   WEXITSTATUS (status));
+
+      /* don't fork in a loop if workers die right away */
+      lifetime = (g_get_monotonic_time () - worker->started) / 1000;
+
+      src = g_timeout_source_new (lifetime < WORKER_MIN_LIFETIME ?
+                                  WORKER_RESPAWN_DELAY : 0);
+      g_source_set_callback (src, evd_daemon_respawn_worker, worker, NULL);
+      g_source_attach (src, self->priv->supervisor_context);
+      g_source_unref (src);
+    }
+}
+
+/* Workers are reaped from the supervisor's own loop, on the SIGCHLD that
+   comes through the signal pipe, rather than with GLib child watches,
+   which need the GLib worker thread in the supervisor to deliver them. */
+static void
+evd_daemon_reap_workers (EvdDaemon *self)
+{
+  GList *node;
+
+  node = self->priv->worker_list;
+  while (node != NULL && self->priv->worker_id < 0)
+    {
+      EvdDaemonWorker *worker = node->data;
+      gint status;
+      pid_t pid;
+
+      node = node->next;
+
+      do
+        pid = waitpid (worker->pid, &status, WNOHANG);
+      while (pid < 0 && errno == EINTR);
+
+      if (pid == worker->pid)
+        evd_daemon_on_worker_exit (worker, status);
+    }
+}
+
+static void
+evd_daemon_become_worker (EvdDaemon *self, guint slot)
+{
+  self->priv->worker_id = slot;
+
+  signal (SIGHUP, SIG_DFL);
+  signal (SIGINT, SIG_DFL);
+  signal (SIGTERM, SIG_DFL);
+  signal (SIGCHLD, SIG_DFL);
+  evd_daemon_supervisor = NULL;
+
+  close (self->priv->signal_pipe[0]);
+  close (self->priv->signal_pipe[1]);
+  self->priv->signal_pipe[0] = -1;
+  self->priv->signal_pipe[1] = -1;
+
+  /* don't outlive the supervisor */
+  prctl (PR_SET_PDEATHSIG, SIGTERM);
+
+  if (self->priv->supervisor_loop != NULL)
+    g_main_loop_quit (self->priv->supervisor_loop);
+}
+
+/* returns TRUE in the new worker process */
+static gboolean
+evd_daemon_spawn_worker (EvdDaemon *self, guint slot)
+{
+  EvdDaemonWorker *worker;
+  GSource *src;
+  pid_t pid;
+
+  pid = fork ();
+  if (pid == 0)
+    {
+      evd_daemon_become_worker (self, slot);
+      return TRUE;
+    }
+  else if (pid < 0)
+    {
+      g_warning ("Failed to fork worker %u: %s", slot, strerror (errno));
+
+      /* try again later */
+      worker = g_slice_new0 (EvdDaemonWorker);
+      worker->self = self;
+      worker->slot = slot;
+
+      src = g_timeout_source_new (WORKER_RESPAWN_DELAY);
+      g_source_set_callback (src, evd_daemon_respawn_worker, worker, NULL);
+      g_source_attach (src, self->priv->supervisor_context);
+      g_source_unref (src);
+
+      return FALSE;
+    }
+
+  worker = g_slice_new0 (EvdDaemonWorker);
+  worker->self = self;
+  worker->slot = slot;
+  worker->pid = pid;
+  worker->started = g_get_monotonic_time ();
+  worker->retiring = FALSE;
+
+  self->priv->worker_list = g_list_prepend (self->priv->worker_list, worker);
+
+  /* on a rolling restart, retire the predecessor once this one is up */
+  if (self->priv->restart_slot == (gint) slot)
+    {
+      src = g_timeout_source_new (ROLLING_RESTART_GRACE);
+      g_source_set_callback (src, evd_daemon_retire_worker, self, NULL);
+      g_source_attach (src, self->priv->supervisor_context);
+      g_source_unref (src);
+    }
+
+  return FALSE;
+}
+
+static gboolean
+evd_daemon_kill_workers (gpointer user_data)
+{
+  EvdDaemon *self = EVD_DAEMON (user_data);
+  GList *node;
+
+  for (node = self->priv->worker_list; node != NULL; node = node->next)
+    {
+      EvdDaemonWorker *worker = node->data;
+
+      g_warning ("Worker %u (pid %d) did not quit in time, killing it",
+                 worker->slot,
+                 worker->pid);
+      kill (worker->pid, SIGKILL);
+    }
+
+  return FALSE;
+}
+
+static void
+evd_daemon_stop_workers (EvdDaemon *self)
+{
+  GList *node;
+  GSource *src;
+
+  self->priv->stopping = TRUE;
+  self->priv->restart_slot = -1;
+
+  if (self->priv->worker_list == NULL)
+    {
+      g_main_loop_quit (self->priv->supervisor_loop);
+      return;
+    }
+
+  for (node = self->priv->worker_list; node != NULL; node = node->next)
+    {
+      EvdDaemonWorker *worker = node->data;
+
+      kill (worker->pid, SIGTERM);
+    }
+
+  src = g_timeout_source_new (WORKER_STOP_TIMEOUT);
+  g_source_set_callback (src, evd_daemon_kill_workers, self, NULL);
+  g_source_attach (src, self->priv->supervisor_context);
+  g_source_unref (src);
+}
+
+static void
+evd_daemon_free_supervisor (EvdDaemon *self)
+{
+  GList *node;
+
+  for (node = self->priv->worker_list; node != NULL; node = node->next)
+    g_slice_free (EvdDaemonWorker, node->data);
+  g_list_free (self->priv->worker_list);
+  self->priv->worker_list = NULL;
+
+  /* the context owns whatever sources are left */
+  g_main_loop_unref (self->priv->supervisor_loop);
+  self->priv->supervisor_loop = NULL;
+  g_main_context_unref (self->priv->supervisor_context);
+  self->priv->supervisor_context = NULL;
+
+  if (self->priv->signal_pipe[0] != -1)
+    {
+      close (self->priv->signal_pipe[0]);
+      close (self->priv->signal_pipe[1]);
+      self->priv->signal_pipe[0] = -1;
+      self->priv->signal_pipe[1] = -1;
+    }
+}
+
+/* Runs the supervisor. Returns FALSE on error. Otherwise it returns in
+   the worker processes with @is_worker set to TRUE, that go on to run the
+   daemon's main loop, and in the supervisor once all workers have quit,
+   with @is_worker set to FALSE. The supervisor runs its own main context, so none
+   of the sources the application set up on the default one ever
+   dispatch in it; each worker starts from that untouched state. */
+static gboolean
+evd_daemon_supervise (EvdDaemon *self, gboolean *is_worker, GError **error)
+{
+  GIOChannel *channel;
+  GSource *src;
+  guint i;
+
+  if (pipe (self->priv->signal_pipe) != 0)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   "Failed to create signal pipe: %s",
+                   strerror (errno));
+      return FALSE;
+    }
+
+  fcntl (self->priv->signal_pipe[0], F_SETFL, O_NONBLOCK);
+  fcntl (self->priv->signal_pipe[1], F_SETFL, O_NONBLOCK);
+
+  self->priv->supervisor_context = g_main_context_new ();
+  self->priv->supervisor_loop = g_main_loop_new (self->priv->supervisor_context,
+                                                 FALSE);
+
+  channel = g_io_channel_unix_new (self->priv->signal_pipe[0]);
+  src = g_io_create_watch (channel, G_IO_IN);
+  g_source_set_callback (src,
+                         (GSourceFunc) evd_daemon_on_signal_pipe,
+                         self,
+                         NULL);
+  g_source_attach (src, self->priv->supervisor_context);
+  g_source_unref (src);
+  g_io_channel_unref (channel);
+
+  evd_daemon_supervisor = self;
+  signal (SIGCHLD, evd_daemon_on_supervisor_signal);
+
+  if (self == evd_daemon_default)
+    {
+      signal (SIGINT, evd_daemon_on_supervisor_signal);
+      signal (SIGTERM, evd_daemon_on_supervisor_signal);
+      signal (SIGHUP, evd_daemon_on_supervisor_signal);
+    }
+
+  for (i = 0; i < self->priv->workers; i++)
+    if (evd_daemon_spawn_worker (self, i))
+      break;
+
+  if (self->priv->worker_id < 0)
+    g_main_loop_run (self->priv->supervisor_loop);
+
+  evd_daemon_free_supervisor (self);
+
+  *is_worker = self->priv->worker_id >= 0;
+  if (*is_worker)
+    return TRUE;
+
+  signal (SIGCHLD, SIG_DFL);
+  evd_daemon_supervisor = NULL;
+
+  signal (SIGINT, SIG_DFL);
+  signal (SIGTERM, SIG_DFL);
+  signal (SIGHUP, SIG_DFL);
+
+  return TRUE;
+}
+
 /* public methods */
 
 /**
@@ -148,11 +1102,15 @@ evd_daemon_new (gint *argc, gchar **argv[])
 {
   EvdDaemon *self;
   gboolean daemonize = FALSE;
+  gint workers = 0;
+  gchar *handoff_path = NULL;
   GOptionContext *context;
 
   const GOptionEntry entries[] =
     {
       { "daemonize", 'D', 0, G_OPTION_ARG_NONE, &daemonize, NULL, NULL },
+      { "workers", 'W', 0, G_OPTION_ARG_INT, &workers, NULL, NULL },
+      { "handoff", 0, 0, G_OPTION_ARG_FILENAME, &handoff_path, NULL, NULL },
       { NULL }
     };
 
@@ -166,6 +1124,8 @@ evd_daemon_new (gint *argc, gchar **argv[])
   self = g_object_new (EVD_TYPE_DAEMON, NULL);
 
   self->priv->daemonize = daemonize;
+  self->priv->workers = MAX (workers, 0);
+  self->priv->handoff_path = handoff_path;
 
   if (evd_daemon_default == NULL)
     evd_daemon_default = self;
@@ -218,6 +1178,35 @@ evd_daemon_run (EvdDaemon *self, GError **error)
         }
     }
 
+  /* in worker mode, only the workers go on from here */
+  if (self->priv->workers > 0 && self->priv->worker_id < 0)
+    {
+      gboolean is_worker;
+
+      if (! evd_daemon_supervise (self, &is_worker, error))
+        return -1;
+
+      if (! is_worker)
+        return self->priv->exit_code;
+    }
+
+  /* take over the listeners of the running instance, and offer ours to
+     the next one */
+  if (self->priv->handoff_path != NULL)
+    {
+      if (self->priv->workers > 0)
+        {
+          g_warning ("Ignoring handoff path in worker mode, workers use SO_REUSEPORT");
+        }
+      else
+        {
+          evd_daemon_handoff_receive (self);
+
+          if (! evd_daemon_handoff_start (self, error))
+            return -1;
+        }
+    }
+
   /* hook SIGINT and SIGTERM if this is the default daemon */
   if (self == evd_daemon_default)
     {
@@ -236,7 +1225,12 @@ evd_daemon_quit (EvdDaemon *self, gint exit_code)
 {
   g_return_if_fail (EVD_IS_DAEMON (self));
 
-  g_main_loop_quit (self->priv->main_loop);
+  self->priv->exit_code = exit_code;
+
+  if (self->priv->supervisor_loop != NULL && self->priv->worker_id < 0)
+    evd_daemon_stop_workers (self);
+  else
+    g_main_loop_quit (self->priv->main_loop);
 }
 
 gboolean
@@ -399,3 +1393,128 @@ evd_daemon_get_pid_file (EvdDaemon *self)
 
   return self->priv->pid_file;
 }
+
+/**
+ * evd_daemon_set_workers:
+ * @workers: number of worker processes, 0 to run in a single process
+ *
+ * Makes evd_daemon_run() fork @workers processes that each run the
+ * daemon's main loop, and supervise them from the original process:
+ * workers that die are respawned, SIGHUP restarts them one at a time
+ * and SIGTERM/SIGINT stops them all. Also settable with --workers.
+ *
+ * Each worker sets up its listeners on its own, so #EvdSocket objects
+ * that listen must have #EvdSocket:reuse-port set.
+ **/
+void
+evd_daemon_set_workers (EvdDaemon *self, guint workers)
+{
+  g_return_if_fail (EVD_IS_DAEMON (self));
+
+  if (g_main_loop_is_running (self->priv->main_loop) ||
+      self->priv->supervisor_loop != NULL)
+    {
+      g_warning ("Ignoring workers change because daemon is already running");
+      return;
+    }
+
+  self->priv->workers = workers;
+}
+
+guint
+evd_daemon_get_workers (EvdDaemon *self)
+{
+  g_return_val_if_fail (EVD_IS_DAEMON (self), 0);
+
+  return self->priv->workers;
+}
+
+/**
+ * evd_daemon_get_worker_id:
+ *
+ * Returns: the index of this worker process, or -1 if this process is
+ * not a worker.
+ **/
+gint
+evd_daemon_get_worker_id (EvdDaemon *self)
+{
+  g_return_val_if_fail (EVD_IS_DAEMON (self), -1);
+
+  return self->priv->worker_id;
+}
+
+/**
+ * evd_daemon_restart_workers:
+ *
+ * Replaces every worker with a freshly forked one, one at a time. Each
+ * new worker gets a grace period to start up before its predecessor is
+ * sent SIGTERM. Only valid in the supervisor process.
+ **/
+void
+evd_daemon_restart_workers (EvdDaemon *self)
+{
+  g_return_if_fail (EVD_IS_DAEMON (self));
+
+  if (self->priv->supervisor_loop == NULL ||
+      self->priv->worker_id >= 0 ||
+      self->priv->stopping ||
+      self->priv->restart_slot >= 0)
+    {
+      return;
+    }
+
+  self->priv->restart_slot = 0;
+  evd_daemon_restart_next (self);
+}
+
+/**
+ * evd_daemon_set_handoff_path:
+ * @handoff_path: (allow-none): path of a Unix socket
+ *
+ * Enables zero-downtime upgrades. When evd_daemon_run() starts, it
+ * connects to @handoff_path and, if a previous instance is listening
+ * there, receives its listening sockets (with SCM_RIGHTS). Sockets
+ * that then listen on the same addresses adopt them instead of binding
+ * again, so no connection is refused during the switch. The new
+ * instance then listens on @handoff_path itself, waiting for its own
+ * successor; when one arrives it hands its listeners over, stops
+ * accepting and emits #EvdDaemon::drain. Only processes of the same user
+ * (or root) are handed the listeners. Also settable with --handoff.
+ **/
+void
+evd_daemon_set_handoff_path (EvdDaemon *self, const gchar *handoff_path)
+{
+  g_return_if_fail (EVD_IS_DAEMON (self));
+
+  if (g_main_loop_is_running (self->priv->main_loop))
+    {
+      g_warning ("Ignoring handoff path change because daemon is already running");
+      return;
+    }
+
+  g_free (self->priv->handoff_path);
+  self->priv->handoff_path = g_strdup (handoff_path);
+}
+
+const gchar *
+evd_daemon_get_handoff_path (EvdDaemon *self)
+{
+  g_return_val_if_fail (EVD_IS_DAEMON (self), NULL);
+
+  return self->priv->handoff_path;
+}
+
+/**
+ * evd_daemon_set_drain_timeout:
+ * @timeout: miliseconds
+ *
+ * Sets how long a daemon that handed its listeners over keeps running
+ * to let its connections finish. Defaults to 30 seconds.
+ **/
+void
+evd_daemon_set_drain_timeout (EvdDaemon *self, guint timeout)
+{
+  g_return_if_fail (EVD_IS_DAEMON (self));
+
+  self->priv->drain_timeout = timeout;
+}
@@ -88,6 +88,18 @@ void                evd_daemon_set_pid_file            (EvdDaemon   *self,
                                                         const gchar *pid_file);
 const gchar *       evd_daemon_get_pid_file            (EvdDaemon *self);
 
+void                evd_daemon_set_workers             (EvdDaemon *self,
+                                                        guint      workers);
+guint               evd_daemon_get_workers             (EvdDaemon *self);
+gint                evd_daemon_get_worker_id           (EvdDaemon *self);
+void                evd_daemon_restart_workers         (EvdDaemon *self);
+
+void                evd_daemon_set_handoff_path        (EvdDaemon   *self,
+                                                        const gchar *handoff_path);
+const gchar *       evd_daemon_get_handoff_path        (EvdDaemon *self);
+void                evd_daemon_set_drain_timeout       (EvdDaemon *self,
+                                                        guint      timeout);
+
 G_END_DECLS
 
 #endif /* __EVD_DAEMON_H__ */
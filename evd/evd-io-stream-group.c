@@ -37,6 +37,8 @@ struct _EvdIoStreamGroupPrivate
   EvdStreamThrottle *input_throttle;
   EvdStreamThrottle *output_throttle;
 
+  EvdIoStreamGroup *parent;
+
   gboolean recursed;
 };
 
@@ -45,7 +47,8 @@ enum
 {
   PROP_0,
   PROP_INPUT_THROTTLE,
-  PROP_OUTPUT_THROTTLE
+  PROP_OUTPUT_THROTTLE,
+  PROP_PARENT
 };
 
 static void     evd_io_stream_group_class_init         (EvdIoStreamGroupClass *class);
@@ -53,6 +56,10 @@ static void     evd_io_stream_group_init               (EvdIoStreamGroup *self);
 
 static void     evd_io_stream_group_dispose            (GObject *obj);
 
+static void     evd_io_stream_group_set_property       (GObject      *obj,
+                                                        guint         prop_id,
+                                                        const GValue *value,
+                                                        GParamSpec   *pspec);
 static void     evd_io_stream_group_get_property       (GObject    *obj,
                                                         guint       prop_id,
                                                         GValue     *value,
@@ -70,6 +77,7 @@ evd_io_stream_group_class_init (EvdIoStreamGroupClass *class)
 
   obj_class->dispose = evd_io_stream_group_dispose;
   obj_class->get_property = evd_io_stream_group_get_property;
+  obj_class->set_property = evd_io_stream_group_set_property;
 
   class->add = evd_io_stream_group_add_internal;
   class->remove = evd_io_stream_group_remove_internal;
@@ -90,6 +98,14 @@ evd_io_stream_group_class_init (EvdIoStreamGroupClass *class)
                                                         G_PARAM_READABLE |
                                                         G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (obj_class, PROP_PARENT,
+                                   g_param_spec_object ("parent",
+                                                        "Parent group",
+                                                        "The group whose bandwidth this group shares with its other members",
+                                                        EVD_TYPE_IO_STREAM_GROUP,
+                                                        G_PARAM_READWRITE |
+                                                        G_PARAM_STATIC_STRINGS));
+
   g_type_class_add_private (obj_class, sizeof (EvdIoStreamGroupPrivate));
 }
 
@@ -104,6 +120,8 @@ evd_io_stream_group_init (EvdIoStreamGroup *self)
   priv->input_throttle = evd_stream_throttle_new ();
   priv->output_throttle = evd_stream_throttle_new ();
 
+  priv->parent = NULL;
+
   priv->recursed = FALSE;
 }
 
@@ -112,6 +130,8 @@ evd_io_stream_group_dispose (GObject *obj)
 {
   EvdIoStreamGroup *self = EVD_IO_STREAM_GROUP (obj);
 
+  evd_io_stream_group_set_parent (self, NULL);
+
   if (self->priv->input_throttle != NULL)
     {
       g_object_unref (self->priv->input_throttle);
@@ -127,6 +147,28 @@ evd_io_stream_group_dispose (GObject *obj)
   G_OBJECT_CLASS (evd_io_stream_group_parent_class)->dispose (obj);
 }
 
+static void
+evd_io_stream_group_set_property (GObject      *obj,
+                                  guint         prop_id,
+                                  const GValue *value,
+                                  GParamSpec   *pspec)
+{
+  EvdIoStreamGroup *self;
+
+  self = EVD_IO_STREAM_GROUP (obj);
+
+  switch (prop_id)
+    {
+    case PROP_PARENT:
+      evd_io_stream_group_set_parent (self, g_value_get_object (value));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
+      break;
+    }
+}
+
 static void
 evd_io_stream_group_get_property (GObject    *obj,
                                   guint       prop_id,
@@ -147,6 +189,10 @@ evd_io_stream_group_get_property (GObject    *obj,
       g_value_set_object (value, self->priv->output_throttle);
       break;
 
+    case PROP_PARENT:
+      g_value_set_object (value, self->priv->parent);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
       break;
@@ -232,3 +278,103 @@ evd_io_stream_group_remove (EvdIoStreamGroup *self, GIOStream *io_stream)
 
   return result;
 }
+
+/**
+ * evd_io_stream_group_get_input_throttle:
+ *
+ * Returns: (transfer none):
+ **/
+EvdStreamThrottle *
+evd_io_stream_group_get_input_throttle (EvdIoStreamGroup *self)
+{
+  g_return_val_if_fail (EVD_IS_IO_STREAM_GROUP (self), NULL);
+
+  return self->priv->input_throttle;
+}
+
+/**
+ * evd_io_stream_group_get_output_throttle:
+ *
+ * Returns: (transfer none):
+ **/
+EvdStreamThrottle *
+evd_io_stream_group_get_output_throttle (EvdIoStreamGroup *self)
+{
+  g_return_val_if_fail (EVD_IS_IO_STREAM_GROUP (self), NULL);
+
+  return self->priv->output_throttle;
+}
+
+/**
+ * evd_io_stream_group_set_parent:
+ * @parent: (allow-none):
+ *
+ * Nests @self inside @parent. The bandwidth of @parent's throttles is
+ * divided among its member streams and nested groups by the "weight"
+ * of their throttles.
+ *
+ * Returns: %FALSE if @self is @parent or one of its ancestors, in which
+ * case nothing is changed, %TRUE otherwise
+ **/
+gboolean
+evd_io_stream_group_set_parent (EvdIoStreamGroup *self,
+                                EvdIoStreamGroup *parent)
+{
+  EvdIoStreamGroup *ancestor;
+
+  g_return_val_if_fail (EVD_IS_IO_STREAM_GROUP (self), FALSE);
+  g_return_val_if_fail (parent == NULL || EVD_IS_IO_STREAM_GROUP (parent),
+                        FALSE);
+
+  /* refuse cycles */
+  for (ancestor = parent; ancestor != NULL; ancestor = ancestor->priv->parent)
+    if (ancestor == self)
+      return FALSE;
+
+  if (parent == self->priv->parent)
+    return TRUE;
+
+  if (parent != NULL)
+    {
+      if (! evd_stream_throttle_set_parent (self->priv->input_throttle,
+                                            parent->priv->input_throttle) ||
+          ! evd_stream_throttle_set_parent (self->priv->output_throttle,
+                                            parent->priv->output_throttle))
+        {
+          /* throttles were re-parented directly into a cycle, leave
+             them as they were */
+          evd_stream_throttle_set_parent (self->priv->input_throttle,
+                                          self->priv->parent != NULL ?
+                                          self->priv->parent->priv->input_throttle :
+                                          NULL);
+          return FALSE;
+        }
+
+      g_object_ref (parent);
+    }
+  else
+    {
+      evd_stream_throttle_set_parent (self->priv->input_throttle, NULL);
+      evd_stream_throttle_set_parent (self->priv->output_throttle, NULL);
+    }
+
+  if (self->priv->parent != NULL)
+    g_object_unref (self->priv->parent);
+
+  self->priv->parent = parent;
+
+  return TRUE;
+}
+
+/**
+ * evd_io_stream_group_get_parent:
+ *
+ * Returns: (transfer none):
+ **/
+EvdIoStreamGroup *
+evd_io_stream_group_get_parent (EvdIoStreamGroup *self)
+{
+  g_return_val_if_fail (EVD_IS_IO_STREAM_GROUP (self), NULL);
+
+  return self->priv->parent;
+}
@@ -30,6 +30,8 @@
 #include <glib-object.h>
 #include <gio/gio.h>
 
+#include "evd-stream-throttle.h"
+
 G_BEGIN_DECLS
 
 typedef struct _EvdIoStreamGroup EvdIoStreamGroup;
@@ -81,6 +83,13 @@ gboolean            evd_io_stream_group_add              (EvdIoStreamGroup *self
 gboolean            evd_io_stream_group_remove           (EvdIoStreamGroup *self,
                                                           GIOStream        *io_stream);
 
+EvdStreamThrottle  *evd_io_stream_group_get_input_throttle  (EvdIoStreamGroup *self);
+EvdStreamThrottle  *evd_io_stream_group_get_output_throttle (EvdIoStreamGroup *self);
+
+gboolean            evd_io_stream_group_set_parent       (EvdIoStreamGroup *self,
+                                                          EvdIoStreamGroup *parent);
+EvdIoStreamGroup   *evd_io_stream_group_get_parent       (EvdIoStreamGroup *self);
+
 G_END_DECLS
 
 #endif /* __EVD_IO_STREAM_GROUP_H__ */
@@ -75,6 +75,8 @@ static gboolean io_stream_on_close               (GIOStream     *stream,
                                                   GCancellable  *cancellable,
                                                   GError       **error);
 
+static void     evd_io_stream_set_throttle_parents (EvdIoStream      *self,
+                                                    EvdIoStreamGroup *group);
 static void     on_group_destroyed               (gpointer  data,
                                                   GObject  *where_the_object_was);
 
@@ -175,6 +177,8 @@ evd_io_stream_dispose (GObject *obj)
 
   if (self->priv->input_throttle != NULL)
     {
+      evd_io_stream_set_throttle_parents (self, NULL);
+
       g_object_unref (self->priv->input_throttle);
       self->priv->input_throttle = NULL;
     }
@@ -256,6 +260,25 @@ io_stream_on_close (GIOStream     *stream,
   return TRUE;
 }
 
+/* the stream's throttles share the group's bandwidth with the rest of
+   its members */
+static void
+evd_io_stream_set_throttle_parents (EvdIoStream      *self,
+                                    EvdIoStreamGroup *group)
+{
+  EvdStreamThrottle *input_throttle = NULL;
+  EvdStreamThrottle *output_throttle = NULL;
+
+  if (group != NULL)
+    {
+      input_throttle = evd_io_stream_group_get_input_throttle (group);
+      output_throttle = evd_io_stream_group_get_output_throttle (group);
+    }
+
+  evd_stream_throttle_set_parent (self->priv->input_throttle, input_throttle);
+  evd_stream_throttle_set_parent (self->priv->output_throttle, output_throttle);
+}
+
 static void
 on_group_destroyed (gpointer  data,
                     GObject  *where_the_object_was)
@@ -267,6 +290,9 @@ on_group_destroyed (gpointer  data,
 
   self->priv->group = NULL;
 
+  if (self->priv->input_throttle != NULL)
+    evd_io_stream_set_throttle_parents (self, NULL);
+
   class = EVD_IO_STREAM_GET_CLASS (self);
   if (class->group_changed != NULL)
     class->group_changed (self, NULL, NULL);
@@ -341,6 +367,8 @@ evd_io_stream_set_group (EvdIoStream *self, EvdIoStreamGroup *group)
 
   self->priv->group = group;
 
+  evd_io_stream_set_throttle_parents (self, group);
+
   if (group != NULL)
     {
       g_object_weak_ref (G_OBJECT (group),
@@ -31,6 +31,7 @@ G_DEFINE_ABSTRACT_TYPE (EvdIpcMechanism, evd_ipc_mechanism, G_TYPE_OBJECT)
 struct _EvdIpcMechanismPrivate
 {
   GList *transports;
+  GHashTable *receive_handlers;
 };
 
 static void     evd_ipc_mechanism_class_init      (EvdIpcMechanismClass *class);
@@ -41,9 +42,12 @@ static void     evd_ipc_mechanism_finalize        (GObject *obj);
 static void     transport_on_new_peer             (EvdTransport *transport,
                                                    EvdPeer      *peer,
                                                    gpointer      user_data);
-static void     transport_on_receive              (EvdTransport *transport,
-                                                   EvdPeer      *peer,
-                                                   gpointer      user_data);
+static void     transport_on_receive              (EvdTransport   *transport,
+                                                   EvdPeer        *peer,
+                                                   const gchar    *buffer,
+                                                   gsize           size,
+                                                   EvdMessageType  type,
+                                                   gpointer        user_data);
 
 static void     transport_on_destroyed            (gpointer  user_data,
                                                    GObject  *where_the_object_was);
@@ -67,6 +71,7 @@ evd_ipc_mechanism_init (EvdIpcMechanism *self)
   self->priv = priv;
 
   priv->transports = NULL;
+  priv->receive_handlers = g_hash_table_new (g_direct_hash, g_direct_equal);
 }
 
 static void
@@ -81,15 +86,18 @@ evd_ipc_mechanism_finalize (GObject *obj)
       if (EVD_IS_TRANSPORT (node->data))
         {
           EvdTransport *transport;
+          guint handler_id;
 
           transport = EVD_TRANSPORT (node->data);
 
           g_signal_handlers_disconnect_by_func (transport,
                                                 transport_on_new_peer,
                                                 self);
-          g_signal_handlers_disconnect_by_func (transport,
-                                                transport_on_receive,
-                                                self);
+
+          handler_id =
+            GPOINTER_TO_UINT (g_hash_table_lookup (self->priv->receive_handlers,
+                                                   transport));
+          evd_transport_remove_receive_handler (transport, handler_id);
 
           g_object_weak_unref (G_OBJECT (transport),
                                transport_on_destroyed,
@@ -99,6 +107,7 @@ evd_ipc_mechanism_finalize (GObject *obj)
       node = node->next;
     }
   g_list_free (self->priv->transports);
+  g_hash_table_unref (self->priv->receive_handlers);
 
   G_OBJECT_CLASS (evd_ipc_mechanism_parent_class)->finalize (obj);
 }
@@ -117,27 +126,23 @@ transport_on_new_peer (EvdTransport *transport,
 }
 
 static void
-transport_on_receive (EvdTransport *transport,
-                      EvdPeer      *peer,
-                      gpointer      user_data)
+transport_on_receive (EvdTransport   *transport,
+                      EvdPeer        *peer,
+                      const gchar    *buffer,
+                      gsize           size,
+                      EvdMessageType  type,
+                      gpointer        user_data)
 {
   EvdIpcMechanism *self = EVD_IPC_MECHANISM (user_data);
   EvdIpcMechanismClass *class;
 
   class = EVD_IPC_MECHANISM_GET_CLASS (self);
   if (class->transport_receive != NULL)
-    {
-      const gchar *data;
-      gsize size;
-
-      data = evd_transport_receive (transport, peer, &size);
-
-      class->transport_receive (self,
-                                transport,
-                                peer,
-                                (const guchar *) data,
-                                size);
-    }
+    class->transport_receive (self,
+                              transport,
+                              peer,
+                              (const guchar *) buffer,
+                              size);
 }
 
 static void
@@ -147,6 +152,7 @@ transport_on_destroyed (gpointer user_data, GObject *where_the_object_was)
 
   self->priv->transports = g_list_remove (self->priv->transports,
                                           where_the_object_was);
+  g_hash_table_remove (self->priv->receive_handlers, where_the_object_was);
 }
 
 /* public methods */
@@ -154,6 +160,8 @@ transport_on_destroyed (gpointer user_data, GObject *where_the_object_was)
 void
 evd_ipc_mechanism_use_transport (EvdIpcMechanism *self, EvdTransport *transport)
 {
+  guint handler_id;
+
   g_return_if_fail (EVD_IS_IPC_MECHANISM (self));
   g_return_if_fail (EVD_IS_TRANSPORT (transport));
 
@@ -166,10 +174,13 @@ evd_ipc_mechanism_use_transport (EvdIpcMechanism *self, EvdTransport *transport)
                     "new-peer",
                     G_CALLBACK (transport_on_new_peer),
                     self);
-  g_signal_connect (transport,
-                    "receive",
-                    G_CALLBACK (transport_on_receive),
-                    self);
+  handler_id = evd_transport_add_receive_handler (transport,
+                                                  transport_on_receive,
+                                                  self,
+                                                  NULL);
+  g_hash_table_insert (self->priv->receive_handlers,
+                       transport,
+                       GUINT_TO_POINTER (handler_id));
 
   g_object_weak_ref (G_OBJECT (transport), transport_on_destroyed, self);
 }
@@ -178,6 +189,8 @@ void
 evd_ipc_mechanism_unuse_transport (EvdIpcMechanism *self,
                                    EvdTransport    *transport)
 {
+  guint handler_id;
+
   g_return_if_fail (EVD_IS_IPC_MECHANISM (self));
   g_return_if_fail (EVD_IS_TRANSPORT (transport));
 
@@ -187,9 +200,11 @@ evd_ipc_mechanism_unuse_transport (EvdIpcMechanism *self,
   g_signal_handlers_disconnect_by_func (transport,
                                         transport_on_new_peer,
                                         self);
-  g_signal_handlers_disconnect_by_func (transport,
-                                        transport_on_receive,
-                                        self);
+  handler_id =
+    GPOINTER_TO_UINT (g_hash_table_lookup (self->priv->receive_handlers,
+                                           transport));
+  evd_transport_remove_receive_handler (transport, handler_id);
+  g_hash_table_remove (self->priv->receive_handlers, transport);
 
   self->priv->transports = g_list_remove (self->priv->transports, transport);
 
@@ -25,6 +25,7 @@
 #include "evd-jsonrpc.h"
 
 #include "evd-json-filter.h"
+#include "evd-metrics.h"
 
 G_DEFINE_TYPE (EvdJsonrpc, evd_jsonrpc, EVD_TYPE_IPC_MECHANISM)
 
@@ -65,8 +66,12 @@ typedef struct
   GSimpleAsyncResult *result;
   JsonNode *remote_id;
   gpointer context;
+  gint64 start_time;
 } InvocationData;
 
+static EvdMetric *metric_call_duration = NULL;
+static EvdMetric *metric_method_duration = NULL;
+
 static void     evd_jsonrpc_class_init           (EvdJsonrpcClass *class);
 static void     evd_jsonrpc_init                 (EvdJsonrpc *self);
 
@@ -266,6 +271,7 @@ evd_jsonrpc_on_method_called (EvdJsonrpc  *self,
   inv_data = g_slice_new0 (InvocationData);
   inv_data->remote_id = id_node;
   inv_data->context = context;
+  inv_data->start_time = g_get_monotonic_time ();
 
   self->priv->invocation_counter++;
   id = self->priv->invocation_counter;
@@ -325,6 +331,12 @@ evd_jsonrpc_on_method_result (EvdJsonrpc  *self,
       return;
     }
 
+  evd_metric_observe (EVD_METRIC (metric_call_duration,
+                                  "evd_jsonrpc_call_duration_seconds",
+                                  EVD_METRIC_LATENCY,
+                                  "Time from calling a remote JSON-RPC method to receiving its response"),
+                      g_get_monotonic_time () - inv_data->start_time);
+
   res = inv_data->result;
   g_object_ref (res);
   g_hash_table_remove (self->priv->invocations, id);
@@ -550,6 +562,12 @@ evd_jsonrpc_respond_full (EvdJsonrpc  *self,
     }
   else
     {
+      evd_metric_observe (EVD_METRIC (metric_method_duration,
+                                      "evd_jsonrpc_method_duration_seconds",
+                                      EVD_METRIC_LATENCY,
+                                      "Time from receiving a JSON-RPC method call to responding it"),
+                          g_get_monotonic_time () - inv_data->start_time);
+
       id_node = inv_data->remote_id;
       inv_data->remote_id = NULL;
       context = inv_data->context;
@@ -704,6 +722,7 @@ evd_jsonrpc_call_method (EvdJsonrpc          *self,
   inv_data = g_slice_new0 (InvocationData);
   inv_data->result = res;
   inv_data->context = context;
+  inv_data->start_time = g_get_monotonic_time ();
 
   g_hash_table_insert (self->priv->invocations, id_st, inv_data);
 
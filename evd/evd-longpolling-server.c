@@ -38,6 +38,16 @@
 #define PEER_DATA_KEY       "org.eventdance.lib.LongpollingServer.PEER_DATA"
 #define CONN_PEER_KEY_GET   PEER_DATA_KEY ".GET"
 #define CONN_PEER_KEY_POST  PEER_DATA_KEY ".POST"
+#define CONN_BINARY_KEY     PEER_DATA_KEY ".BINARY"
+
+#define TEXT_CONTENT_TYPE   "text/plain; charset=utf-8"
+#define BINARY_CONTENT_TYPE "application/octet-stream"
+
+/* in binary framing, the first header byte holds the message type in its
+   high bit and the length, or how it is encoded, in the rest */
+#define BINARY_TYPE_BIT     0x80
+#define BINARY_LEN_16       126
+#define BINARY_LEN_64       127
 
 #define ACTION_RECEIVE   "receive"
 #define ACTION_SEND      "send"
@@ -82,6 +92,7 @@ static gboolean evd_longpolling_server_actual_send          (EvdLongpollingServe
                                                              EvdHttpConnection *conn,
                                                              const gchar        *buffer,
                                                              gsize               size,
+                                                             EvdMessageType      type,
                                                              GError            **error);
 
 static gboolean evd_longpolling_server_peer_is_connected    (EvdTransport *transport,
@@ -188,6 +199,88 @@ evd_longpolling_server_read_msg_header (const gchar *buf,
     }
 }
 
+/* returns FALSE if @buf does not hold a complete frame */
+static gboolean
+evd_longpolling_server_read_binary_msg_header (const guint8   *buf,
+                                               gsize           buf_len,
+                                               gsize          *hdr_len,
+                                               gsize          *msg_len,
+                                               EvdMessageType *type)
+{
+  guint64 len;
+  gsize i;
+
+  if (buf_len < 1)
+    return FALSE;
+
+  *type = (buf[0] & BINARY_TYPE_BIT) != 0 ?
+    EVD_MESSAGE_TYPE_BINARY : EVD_MESSAGE_TYPE_TEXT;
+  len = buf[0] & ~BINARY_TYPE_BIT;
+
+  if (len == BINARY_LEN_16)
+    *hdr_len = 3;
+  else if (len == BINARY_LEN_64)
+    *hdr_len = 9;
+  else
+    *hdr_len = 1;
+
+  if (buf_len < *hdr_len)
+    return FALSE;
+
+  if (*hdr_len > 1)
+    {
+      len = 0;
+      for (i = 1; i < *hdr_len; i++)
+        len = (len << 8) | buf[i];
+    }
+
+  if (len > buf_len - *hdr_len)
+    return FALSE;
+
+  *msg_len = (gsize) len;
+
+  return TRUE;
+}
+
+/* returns FALSE if @content is not a sequence of complete frames, in which
+   case the frames before the bad one have already been delivered */
+static gboolean
+evd_longpolling_server_read_binary_content (EvdLongpollingServer *self,
+                                            EvdPeer              *peer,
+                                            const gchar          *content,
+                                            gsize                 size)
+{
+  EvdTransportInterface *iface;
+  gsize i = 0;
+  gsize hdr_len;
+  gsize msg_len;
+  EvdMessageType type;
+
+  iface = EVD_TRANSPORT_GET_INTERFACE (self);
+
+  while (i < size)
+    {
+      if (! evd_longpolling_server_read_binary_msg_header ((const guint8 *) content + i,
+                                                          size - i,
+                                                          &hdr_len,
+                                                          &msg_len,
+                                                          &type))
+        {
+          return FALSE;
+        }
+
+      iface->receive (EVD_TRANSPORT (self),
+                      peer,
+                      content + i + hdr_len,
+                      msg_len,
+                      type);
+
+      i += hdr_len + msg_len;
+    }
+
+  return TRUE;
+}
+
 static void
 evd_longpolling_server_conn_on_content_read (GObject      *obj,
                                              GAsyncResult *res,
@@ -208,7 +301,35 @@ evd_longpolling_server_conn_on_content_read (GObject      *obj,
                                                                &size,
                                                                &error)) != NULL)
     {
-      if (size > 0)
+      if (size > 0 &&
+          GPOINTER_TO_INT (g_object_get_data (obj, CONN_BINARY_KEY)))
+        {
+          if (! evd_longpolling_server_read_binary_content (self,
+                                                            peer,
+                                                            content,
+                                                            size))
+            {
+              /* the framing of whatever follows can't be trusted */
+              g_free (content);
+
+              EVD_WEB_SERVICE_GET_CLASS (self)->respond (EVD_WEB_SERVICE (self),
+                                                         conn,
+                                                         SOUP_STATUS_BAD_REQUEST,
+                                                         NULL,
+                                                         NULL,
+                                                         0,
+                                                         NULL);
+
+              evd_transport_close_peer (EVD_TRANSPORT (self),
+                                        peer,
+                                        FALSE,
+                                        NULL);
+
+              g_object_unref (peer);
+              return;
+            }
+        }
+      else if (size > 0)
         {
           EvdTransportInterface *iface;
           gint i;
@@ -225,10 +346,13 @@ evd_longpolling_server_conn_on_content_read (GObject      *obj,
                                                       &msg_len,
                                                       NULL);
 
+              /* long-polling frames carry no type, and come from
+                 JavaScript strings */
               iface->receive (EVD_TRANSPORT (self),
                               peer,
                               content + i + hdr_len,
-                              (gsize) msg_len);
+                              (gsize) msg_len,
+                              EVD_MESSAGE_TYPE_TEXT);
 
               i += msg_len + hdr_len;
             }
@@ -247,6 +371,7 @@ evd_longpolling_server_conn_on_content_read (GObject      *obj,
                                 conn,
                                 NULL,
                                 0,
+                                EVD_MESSAGE_TYPE_TEXT,
                                 NULL);
 
   g_object_unref (peer);
@@ -278,6 +403,20 @@ evd_longpolling_server_resolve_action (EvdLongpollingServer *self,
   return action;
 }
 
+/* binary framing is used on connections whose requests accept it */
+static gboolean
+evd_longpolling_server_request_is_binary (EvdHttpRequest *request)
+{
+  SoupMessageHeaders *headers;
+  const gchar *accept;
+
+  headers = evd_http_message_get_headers (EVD_HTTP_MESSAGE (request));
+  accept = soup_message_headers_get_list (headers, "Accept");
+
+  return accept != NULL &&
+    soup_header_contains (accept, BINARY_CONTENT_TYPE);
+}
+
 static void
 evd_longpolling_server_free_peer_data (gpointer _data)
 {
@@ -317,6 +456,10 @@ evd_longpolling_server_request_handler (EvdWebService     *web_service,
 
   evd_peer_touch (peer);
 
+  g_object_set_data (G_OBJECT (conn),
+                     CONN_BINARY_KEY,
+                     GINT_TO_POINTER (evd_longpolling_server_request_is_binary (request)));
+
   action = evd_longpolling_server_resolve_action (self, request);
 
   /* receive? */
@@ -344,6 +487,7 @@ evd_longpolling_server_request_handler (EvdWebService     *web_service,
                                               conn,
                                               NULL,
                                               0,
+                                              EVD_MESSAGE_TYPE_TEXT,
                                               NULL);
         }
       else
@@ -390,18 +534,59 @@ evd_longpolling_server_request_handler (EvdWebService     *web_service,
   g_free (action);
 }
 
+static gsize
+evd_longpolling_server_build_binary_msg_header (guint8         *hdr,
+                                                gsize           size,
+                                                EvdMessageType  type)
+{
+  gsize hdr_len;
+  gint i;
+
+  if (size < BINARY_LEN_16)
+    {
+      hdr[0] = (guint8) size;
+      hdr_len = 1;
+    }
+  else if (size <= 0xFFFF)
+    {
+      hdr[0] = BINARY_LEN_16;
+      hdr_len = 3;
+    }
+  else
+    {
+      hdr[0] = BINARY_LEN_64;
+      hdr_len = 9;
+    }
+
+  for (i = hdr_len - 1; i > 0; i--)
+    {
+      hdr[i] = (guint8) (size & 0xFF);
+      size >>= 8;
+    }
+
+  if (type == EVD_MESSAGE_TYPE_BINARY)
+    hdr[0] |= BINARY_TYPE_BIT;
+
+  return hdr_len;
+}
+
 static gboolean
 evd_longpolling_server_write_frame_delivery (EvdLongpollingServer  *self,
                                              EvdHttpConnection     *conn,
                                              const gchar           *buf,
                                              gsize                  size,
+                                             EvdMessageType         type,
                                              GError               **error)
 {
   guint8 hdr[17];
   gsize hdr_len = 1;
   gchar *len_st;
 
-  if (size <= 0x7F - 2)
+  if (GPOINTER_TO_INT (g_object_get_data (G_OBJECT (conn), CONN_BINARY_KEY)))
+    {
+      hdr_len = evd_longpolling_server_build_binary_msg_header (hdr, size, type);
+    }
+  else if (size <= 0x7F - 2)
     {
       hdr_len = 1;
       hdr[0] = (guint8) size;
@@ -452,17 +637,22 @@ evd_longpolling_server_actual_send (EvdLongpollingServer  *self,
                                     EvdHttpConnection     *conn,
                                     const gchar           *buffer,
                                     gsize                  size,
+                                    EvdMessageType         type,
                                     GError               **error)
 {
   SoupMessageHeaders *headers;
   gboolean result = TRUE;
+  gboolean binary;
   EvdHttpRequest *request;
 
+  binary = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (conn),
+                                               CONN_BINARY_KEY));
+
   /* build and send HTTP headers */
   headers = soup_message_headers_new (SOUP_MESSAGE_HEADERS_RESPONSE);
   soup_message_headers_replace (headers,
                                 "Content-type",
-                                "text/plain; charset=utf-8");
+                                binary ? BINARY_CONTENT_TYPE : TEXT_CONTENT_TYPE);
   soup_message_headers_replace (headers, "Transfer-Encoding", "chunked");
 
   if (evd_http_connection_get_keepalive (conn))
@@ -505,6 +695,7 @@ evd_longpolling_server_actual_send (EvdLongpollingServer  *self,
                                                              conn,
                                                              frame,
                                                              frame_size,
+                                                             frame_type,
                                                              NULL))
             {
               evd_peer_unshift_message (peer, frame, frame_size, frame_type, NULL);
@@ -521,6 +712,7 @@ evd_longpolling_server_actual_send (EvdLongpollingServer  *self,
                                                    conn,
                                                    buffer,
                                                    size,
+                                                   type,
                                                    NULL))
         {
           result = FALSE;
@@ -573,6 +765,7 @@ evd_longpolling_server_select_conn_and_send (EvdLongpollingServer  *self,
                                           conn,
                                           buffer,
                                           size,
+                                          type,
                                           error))
     return TRUE;
   else
@@ -0,0 +1,476 @@
+/*
+ * evd-metrics.c
+ *
+ * EventDance, Peer-to-peer IPC library <http://eventdance.org>
+ *
+ * Copyright (C) 2026, the EventDance contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 3, or (at your option) any later version as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License at http://www.gnu.org/licenses/lgpl-3.0.txt
+ * for more details.
+ */
+
+#include <string.h>
+
+#include "evd-metrics.h"
+
+/* counters and histograms are sharded in slots, one per thread (modulo
+   SLOTS), so that threads updating the same metric don't bounce the same
+   cache line */
+#define SLOTS 8
+
+/* histograms are log-linear: each power of two is split in 2^SUB_BITS
+   linear buckets, which keeps the relative error under 25% over the
+   whole range, like a HDR histogram with one significant digit */
+#define SUB_BITS 2
+#define SUB      (1 << SUB_BITS)
+#define GROUPS   37                /* up to 2^38, 76 hours in microseconds */
+#define BUCKETS  (SUB * GROUPS)
+
+#define ATOMIC_GET(p)         (__sync_fetch_and_add ((p), 0))
+#define ATOMIC_SET(p, v)      (__sync_lock_test_and_set ((p), (v)))
+#define ATOMIC_ADD(p, v)      (__sync_fetch_and_add ((p), (v)))
+
+typedef struct
+{
+  gint64 value;
+  guint64 count;
+  guint64 *buckets;
+
+  /* pad to a cache line */
+  gchar _padding_[64 - 2 * sizeof (gint64) - sizeof (gpointer)];
+} EvdMetricSlot;
+
+struct _EvdMetric
+{
+  gchar *key;
+  gchar *name;
+  gchar *labels;
+  gchar *help;
+  EvdMetricType type;
+
+  gint64 gauge;
+  EvdMetricSlot slots[SLOTS];
+};
+
+G_LOCK_DEFINE_STATIC (metrics_mutex);
+static GHashTable *metrics = NULL;
+static GList *metrics_sorted = NULL;
+
+static gint next_slot = 0;
+static __thread gint thread_slot = -1;
+
+static inline EvdMetricSlot *
+evd_metric_get_slot (EvdMetric *self)
+{
+  if (G_UNLIKELY (thread_slot < 0))
+    thread_slot = ATOMIC_ADD (&next_slot, 1) % SLOTS;
+
+  return &self->slots[thread_slot];
+}
+
+static inline guint
+evd_metric_bucket_index (guint64 value)
+{
+  guint msb;
+  guint index;
+
+  if (value < SUB)
+    return value;
+
+  msb = 63 - __builtin_clzll (value);
+  index = (msb - SUB_BITS + 1) * SUB +
+    ((value >> (msb - SUB_BITS)) & (SUB - 1));
+
+  return MIN (index, BUCKETS - 1);
+}
+
+/* the largest value that falls in bucket @index */
+static guint64
+evd_metric_bucket_upper_bound (guint index)
+{
+  guint group;
+  guint sub;
+
+  if (index < SUB)
+    return index;
+
+  group = index / SUB;
+  sub = index % SUB;
+
+  return (((guint64) SUB + sub + 1) << (group - 1)) - 1;
+}
+
+/* keeps the series of a same family together, for rendering */
+static gint
+evd_metric_compare (gconstpointer a, gconstpointer b)
+{
+  const EvdMetric *m1 = a;
+  const EvdMetric *m2 = b;
+  gint result;
+
+  result = strcmp (m1->name, m2->name);
+  if (result == 0)
+    result = g_strcmp0 (m1->labels, m2->labels);
+
+  return result;
+}
+
+static void
+evd_metric_render_value (GString       *str,
+                         EvdMetricType  type,
+                         gdouble        value)
+{
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+  /* latencies are recorded in microseconds, exposed in seconds */
+  if (type == EVD_METRIC_LATENCY)
+    value /= G_USEC_PER_SEC;
+
+  g_string_append (str, g_ascii_formatd (buf, sizeof (buf), "%.9g", value));
+}
+
+static void
+evd_metric_render_labels (EvdMetric *self, GString *str)
+{
+  if (self->labels != NULL)
+    g_string_append_printf (str, "{%s}", self->labels);
+}
+
+static void
+evd_metric_render_histogram (EvdMetric *self, GString *str)
+{
+  guint64 buckets[BUCKETS] = { 0, };
+  guint64 cumulative = 0;
+  gint64 sum = 0;
+  gint last = -1;
+  gint i;
+  gint j;
+
+  for (i = 0; i < SLOTS; i++)
+    {
+      sum += ATOMIC_GET (&self->slots[i].value);
+
+      for (j = 0; j < BUCKETS; j++)
+        buckets[j] += ATOMIC_GET (&self->slots[i].buckets[j]);
+    }
+
+  for (j = 0; j < BUCKETS - 1; j++)
+    if (buckets[j] > 0)
+      last = j;
+
+  for (j = 0; j <= last; j++)
+    {
+      cumulative += buckets[j];
+
+      g_string_append_printf (str,
+                              "%s_bucket{%s%sle=\"",
+                              self->name,
+                              self->labels != NULL ? self->labels : "",
+                              self->labels != NULL ? "," : "");
+      evd_metric_render_value (str,
+                               self->type,
+                               evd_metric_bucket_upper_bound (j));
+      g_string_append_printf (str, "\"} %" G_GUINT64_FORMAT "\n", cumulative);
+    }
+
+  /* the overflow bucket only shows in +Inf */
+  for (; j < BUCKETS; j++)
+    cumulative += buckets[j];
+
+  g_string_append_printf (str,
+                          "%s_bucket{%s%sle=\"+Inf\"} %" G_GUINT64_FORMAT "\n",
+                          self->name,
+                          self->labels != NULL ? self->labels : "",
+                          self->labels != NULL ? "," : "",
+                          cumulative);
+
+  g_string_append_printf (str, "%s_sum", self->name);
+  evd_metric_render_labels (self, str);
+  g_string_append_c (str, ' ');
+  evd_metric_render_value (str, self->type, sum);
+
+  g_string_append_printf (str, "\n%s_count", self->name);
+  evd_metric_render_labels (self, str);
+  g_string_append_printf (str, " %" G_GUINT64_FORMAT "\n", cumulative);
+}
+
+/* public methods */
+
+/**
+ * evd_metrics_get:
+ * @name: the name of the metric, like "evd_socket_accepted_total"
+ * @type: the #EvdMetricType of the metric
+ * @help: (allow-none): a one-line description of the metric
+ *
+ * Gets the metric registered under @name, registering it first if it
+ * doesn't exist. Metrics live as long as the process.
+ *
+ * Returns: (transfer none):
+ **/
+EvdMetric *
+evd_metrics_get (const gchar   *name,
+                 EvdMetricType  type,
+                 const gchar   *help)
+{
+  return evd_metrics_get_labeled (name, type, help, NULL);
+}
+
+/**
+ * evd_metrics_get_labeled:
+ * @labels: (allow-none): the labels of the series, already formatted as
+ * in 'context="main",kind="io"'
+ *
+ * Like evd_metrics_get(), but gets one series of a metric family that is
+ * partitioned by @labels. All series of a family must share the type.
+ *
+ * Returns: (transfer none):
+ **/
+EvdMetric *
+evd_metrics_get_labeled (const gchar   *name,
+                         EvdMetricType  type,
+                         const gchar   *help,
+                         const gchar   *labels)
+{
+  EvdMetric *self;
+  gchar *key;
+
+  g_return_val_if_fail (name != NULL, NULL);
+
+  if (labels != NULL)
+    key = g_strdup_printf ("%s{%s}", name, labels);
+  else
+    key = g_strdup (name);
+
+  G_LOCK (metrics_mutex);
+
+  if (metrics == NULL)
+    metrics = g_hash_table_new (g_str_hash, g_str_equal);
+
+  self = g_hash_table_lookup (metrics, key);
+  if (self == NULL)
+    {
+      gint i;
+
+      self = g_new0 (EvdMetric, 1);
+      self->key = key;
+      key = NULL;
+      self->name = g_strdup (name);
+      self->labels = g_strdup (labels);
+      self->help = g_strdup (help);
+      self->type = type;
+
+      if (type == EVD_METRIC_HISTOGRAM || type == EVD_METRIC_LATENCY)
+        for (i = 0; i < SLOTS; i++)
+          self->slots[i].buckets = g_new0 (guint64, BUCKETS);
+
+      g_hash_table_insert (metrics, self->key, self);
+      metrics_sorted = g_list_insert_sorted (metrics_sorted,
+                                             self,
+                                             evd_metric_compare);
+    }
+  else if (self->type != type)
+    {
+      g_warning ("Metric '%s' already registered with a different type", name);
+    }
+
+  G_UNLOCK (metrics_mutex);
+
+  g_free (key);
+
+  return self;
+}
+
+/**
+ * evd_metrics_render:
+ *
+ * Renders all the registered metrics in the Prometheus text exposition
+ * format.
+ *
+ * Returns: (transfer full):
+ **/
+gchar *
+evd_metrics_render (void)
+{
+  GString *str;
+  GList *node;
+  const gchar *family = NULL;
+
+  str = g_string_new ("");
+
+  G_LOCK (metrics_mutex);
+
+  for (node = metrics_sorted; node != NULL; node = node->next)
+    {
+      EvdMetric *self = node->data;
+
+      /* HELP and TYPE go once per family, before its first series */
+      if (g_strcmp0 (family, self->name) != 0)
+        {
+          const gchar *type_st;
+
+          family = self->name;
+
+          if (self->help != NULL)
+            g_string_append_printf (str, "# HELP %s %s\n", self->name, self->help);
+
+          switch (self->type)
+            {
+            case EVD_METRIC_COUNTER:
+              type_st = "counter";
+              break;
+
+            case EVD_METRIC_GAUGE:
+              type_st = "gauge";
+              break;
+
+            default:
+              type_st = "histogram";
+              break;
+            }
+          g_string_append_printf (str, "# TYPE %s %s\n", self->name, type_st);
+        }
+
+      if (self->type == EVD_METRIC_HISTOGRAM ||
+          self->type == EVD_METRIC_LATENCY)
+        {
+          evd_metric_render_histogram (self, str);
+        }
+      else
+        {
+          g_string_append (str, self->name);
+          evd_metric_render_labels (self, str);
+          g_string_append_printf (str,
+                                  " %" G_GINT64_FORMAT "\n",
+                                  evd_metric_get_value (self));
+        }
+    }
+
+  G_UNLOCK (metrics_mutex);
+
+  return g_string_free (str, FALSE);
+}
+
+/**
+ * evd_metric_add:
+ *
+ * Adds @value to a counter or a gauge.
+ **/
+void
+evd_metric_add (EvdMetric *self, gint64 value)
+{
+  g_return_if_fail (self != NULL);
+
+  if (self->type == EVD_METRIC_GAUGE)
+    ATOMIC_ADD (&self->gauge, value);
+  else
+    ATOMIC_ADD (&evd_metric_get_slot (self)->value, value);
+}
+
+/**
+ * evd_metric_set:
+ *
+ * Sets the current value of a gauge.
+ **/
+void
+evd_metric_set (EvdMetric *self, gint64 value)
+{
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (self->type == EVD_METRIC_GAUGE);
+
+  ATOMIC_SET (&self->gauge, value);
+}
+
+/**
+ * evd_metric_observe:
+ *
+ * Records a sample in a histogram. Latencies are given in microseconds.
+ **/
+void
+evd_metric_observe (EvdMetric *self, gint64 value)
+{
+  EvdMetricSlot *slot;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (self->slots[0].buckets != NULL);
+
+  value = MAX (value, 0);
+
+  slot = evd_metric_get_slot (self);
+  ATOMIC_ADD (&slot->buckets[evd_metric_bucket_index (value)], 1);
+  ATOMIC_ADD (&slot->value, value);
+  ATOMIC_ADD (&slot->count, 1);
+}
+
+/**
+ * evd_metric_get_value:
+ *
+ * Returns: The value of a counter or a gauge, or the sum of the samples of
+ * a histogram.
+ **/
+gint64
+evd_metric_get_value (EvdMetric *self)
+{
+  gint64 value = 0;
+  gint i;
+
+  g_return_val_if_fail (self != NULL, 0);
+
+  if (self->type == EVD_METRIC_GAUGE)
+    return ATOMIC_GET (&self->gauge);
+
+  for (i = 0; i < SLOTS; i++)
+    value += ATOMIC_GET (&self->slots[i].value);
+
+  return value;
+}
+
+/**
+ * evd_metric_get_count:
+ *
+ * Returns: The number of samples recorded by a histogram.
+ **/
+guint64
+evd_metric_get_count (EvdMetric *self)
+{
+  guint64 count = 0;
+  gint i;
+
+  g_return_val_if_fail (self != NULL, 0);
+
+  for (i = 0; i < SLOTS; i++)
+    count += ATOMIC_GET (&self->slots[i].count);
+
+  return count;
+}
+
+const gchar *
+evd_metric_get_name (EvdMetric *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+
+  return self->name;
+}
+
+const gchar *
+evd_metric_get_labels (EvdMetric *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+
+  return self->labels;
+}
+
+EvdMetricType
+evd_metric_get_type (EvdMetric *self)
+{
+  g_return_val_if_fail (self != NULL, EVD_METRIC_COUNTER);
+
+  return self->type;
+}
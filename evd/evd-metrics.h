@@ -0,0 +1,71 @@
+/*
+ * evd-metrics.h
+ *
+ * EventDance, Peer-to-peer IPC library <http://eventdance.org>
+ *
+ * Copyright (C) 2026, the EventDance contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 3, or (at your option) any later version as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License at http://www.gnu.org/licenses/lgpl-3.0.txt
+ * for more details.
+ */
+
+#ifndef __EVD_METRICS_H__
+#define __EVD_METRICS_H__
+
+#if !defined (__EVD_H_INSIDE__) && !defined (EVD_COMPILATION)
+#error "Only <evd.h> can be included directly."
+#endif
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _EvdMetric EvdMetric;
+
+typedef enum
+{
+  EVD_METRIC_COUNTER,
+  EVD_METRIC_GAUGE,
+  EVD_METRIC_HISTOGRAM,
+  EVD_METRIC_LATENCY
+} EvdMetricType;
+
+/* resolves a metric once and caches it in @var, for use in hot paths */
+#define EVD_METRIC(var, name, type, help)                               \
+  ((var) != NULL ? (var) : ((var) = evd_metrics_get ((name), (type), (help))))
+
+EvdMetric *        evd_metrics_get           (const gchar   *name,
+                                              EvdMetricType  type,
+                                              const gchar   *help);
+EvdMetric *        evd_metrics_get_labeled   (const gchar   *name,
+                                              EvdMetricType  type,
+                                              const gchar   *help,
+                                              const gchar   *labels);
+
+gchar *            evd_metrics_render        (void);
+
+void               evd_metric_add            (EvdMetric *metric,
+                                              gint64     value);
+void               evd_metric_set            (EvdMetric *metric,
+                                              gint64     value);
+void               evd_metric_observe        (EvdMetric *metric,
+                                              gint64     value);
+
+gint64             evd_metric_get_value      (EvdMetric *metric);
+guint64            evd_metric_get_count      (EvdMetric *metric);
+
+const gchar *      evd_metric_get_name       (EvdMetric *metric);
+const gchar *      evd_metric_get_labels     (EvdMetric *metric);
+EvdMetricType      evd_metric_get_type       (EvdMetric *metric);
+
+G_END_DECLS
+
+#endif /* __EVD_METRICS_H__ */
@@ -0,0 +1,1178 @@
+/*
+ * evd-peer-cluster.c
+ *
+ * EventDance, Peer-to-peer IPC library <http://eventdance.org>
+ *
+ * Copyright (C) 2026, the EventDance contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 3, or (at your option) any later version as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License at http://www.gnu.org/licenses/lgpl-3.0.txt
+ * for more details.
+ */
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "evd-peer-cluster.h"
+
+#include "evd-transport.h"
+#include "evd-service.h"
+#include "evd-socket.h"
+#include "evd-connection.h"
+#include "evd-utils.h"
+#include "evd-metrics.h"
+
+/*
+ * Every process of a cluster listens on "<path>/<node-id>.sock" and connects
+ * to the sockets of the processes that were already there, forming a full
+ * mesh. Over each link, nodes announce the ids of their local peers and
+ * forward messages sent to peers living on the other side.
+ *
+ * Frames have an 8 bytes header: command (1 byte), message type (1 byte),
+ * id length (2 bytes, big endian) and payload length (4 bytes, big endian),
+ * followed by the id and the payload. A link that receives a frame larger
+ * than MAX_FRAME_SIZE, or fails to write, is closed.
+ */
+
+static void     evd_peer_cluster_transport_iface_init (EvdTransportInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (EvdPeerCluster, evd_peer_cluster, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (EVD_TYPE_TRANSPORT,
+                                                evd_peer_cluster_transport_iface_init));
+
+#define EVD_PEER_CLUSTER_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), \
+                                           EVD_TYPE_PEER_CLUSTER, \
+                                           EvdPeerClusterPrivate))
+
+#define SOCKET_SUFFIX ".sock"
+#define HEADER_SIZE   8
+#define BLOCK_SIZE    0x1000
+
+/* largest payload accepted from a link */
+#define MAX_FRAME_SIZE   (16 * 1024 * 1024)
+
+/* bytes a link may hold while the other node is not reading */
+#define MAX_PENDING_SIZE (4 * MAX_FRAME_SIZE)
+
+/* frame commands */
+enum
+{
+  CMD_HELLO = 1,
+  CMD_PEER_ADD,
+  CMD_PEER_DEL,
+  CMD_SEND
+};
+
+typedef struct
+{
+  gint ref_count;
+  gboolean closed;
+
+  EvdPeerCluster *cluster;
+  EvdConnection *conn;
+  gchar *node_id;
+
+  GString *buf;
+  gsize buf_len;
+
+  GString *out_buf;
+  guint close_src_id;
+} EvdPeerClusterLink;
+
+/* private data */
+struct _EvdPeerClusterPrivate
+{
+  EvdPeerManager *peer_manager;
+  gchar *path;
+  gchar *node_id;
+  gchar *address;
+
+  EvdService *service;
+  gboolean started;
+
+  GList *links;
+  GHashTable *remote_peers;
+  GHashTable *proxies;
+};
+
+static EvdMetric *metric_forwarded = NULL;
+static EvdMetric *metric_dropped = NULL;
+
+static void     evd_peer_cluster_class_init           (EvdPeerClusterClass *class);
+static void     evd_peer_cluster_init                 (EvdPeerCluster *self);
+
+static void     evd_peer_cluster_finalize             (GObject *obj);
+static void     evd_peer_cluster_dispose              (GObject *obj);
+
+static gboolean evd_peer_cluster_send                 (EvdTransport    *transport,
+                                                       EvdPeer         *peer,
+                                                       const gchar     *buffer,
+                                                       gsize            size,
+                                                       EvdMessageType   type,
+                                                       GError         **error);
+static gboolean evd_peer_cluster_peer_is_connected    (EvdTransport *transport,
+                                                       EvdPeer      *peer);
+static gboolean evd_peer_cluster_accept_peer          (EvdTransport *transport,
+                                                       EvdPeer      *peer);
+
+static void     evd_peer_cluster_on_new_peer          (EvdPeerManager *peer_manager,
+                                                       EvdPeer        *peer,
+                                                       gpointer        user_data);
+static void     evd_peer_cluster_on_peer_closed       (EvdPeerManager *peer_manager,
+                                                       EvdPeer        *peer,
+                                                       gboolean        gracefully,
+                                                       gpointer        user_data);
+
+static void     evd_peer_cluster_link_read            (EvdPeerClusterLink *link);
+static void     evd_peer_cluster_link_close           (EvdPeerClusterLink *link);
+
+static void     evd_peer_cluster_proxy_finalized      (gpointer  user_data,
+                                                       GObject  *where_the_object_was);
+
+static void
+evd_peer_cluster_class_init (EvdPeerClusterClass *class)
+{
+  GObjectClass *obj_class = G_OBJECT_CLASS (class);
+
+  obj_class->dispose = evd_peer_cluster_dispose;
+  obj_class->finalize = evd_peer_cluster_finalize;
+
+  g_type_class_add_private (obj_class, sizeof (EvdPeerClusterPrivate));
+}
+
+static void
+evd_peer_cluster_transport_iface_init (EvdTransportInterface *iface)
+{
+  iface->send = evd_peer_cluster_send;
+  iface->peer_is_connected = evd_peer_cluster_peer_is_connected;
+  iface->accept_peer = evd_peer_cluster_accept_peer;
+}
+
+static void
+evd_peer_cluster_init (EvdPeerCluster *self)
+{
+  EvdPeerClusterPrivate *priv;
+
+  priv = EVD_PEER_CLUSTER_GET_PRIVATE (self);
+  self->priv = priv;
+
+  priv->service = evd_service_new ();
+  priv->started = FALSE;
+
+  priv->links = NULL;
+  priv->remote_peers = g_hash_table_new_full (g_str_hash,
+                                              g_str_equal,
+                                              g_free,
+                                              NULL);
+  priv->proxies = g_hash_table_new_full (g_str_hash,
+                                         g_str_equal,
+                                         g_free,
+                                         NULL);
+}
+
+static EvdPeerClusterLink *
+evd_peer_cluster_link_ref (EvdPeerClusterLink *link)
+{
+  link->ref_count++;
+
+  return link;
+}
+
+static void
+evd_peer_cluster_link_unref (EvdPeerClusterLink *link)
+{
+  link->ref_count--;
+  if (link->ref_count > 0)
+    return;
+
+  g_object_unref (link->conn);
+  g_free (link->node_id);
+  g_string_free (link->buf, TRUE);
+  g_string_free (link->out_buf, TRUE);
+
+  g_slice_free (EvdPeerClusterLink, link);
+}
+
+static gboolean
+evd_peer_cluster_link_close_cb (gpointer user_data)
+{
+  EvdPeerClusterLink *link = user_data;
+
+  link->close_src_id = 0;
+  evd_peer_cluster_link_close (link);
+  evd_peer_cluster_link_unref (link);
+
+  return FALSE;
+}
+
+/* writes can fail while the cluster is walking its links or proxies, so
+   the link is closed from an idle callback */
+static void
+evd_peer_cluster_link_close_later (EvdPeerClusterLink *link)
+{
+  if (link->closed || link->close_src_id != 0)
+    return;
+
+  link->close_src_id = evd_timeout_add (NULL,
+                                        0,
+                                        G_PRIORITY_DEFAULT,
+                                        evd_peer_cluster_link_close_cb,
+                                        evd_peer_cluster_link_ref (link));
+}
+
+static gboolean
+evd_peer_cluster_link_flush (EvdPeerClusterLink  *link,
+                             GError             **error)
+{
+  GOutputStream *stream;
+  GError *_error = NULL;
+  gssize size;
+
+  if (link->out_buf->len == 0)
+    return TRUE;
+
+  stream = g_io_stream_get_output_stream (G_IO_STREAM (link->conn));
+  size = g_output_stream_write (stream,
+                                link->out_buf->str,
+                                link->out_buf->len,
+                                NULL,
+                                &_error);
+  if (size < 0)
+    {
+      g_debug ("Error writing to peer cluster link: %s", _error->message);
+      g_propagate_error (error, _error);
+
+      evd_peer_cluster_link_close_later (link);
+
+      return FALSE;
+    }
+
+  /* the rest is written when the connection becomes writable again */
+  g_string_erase (link->out_buf, 0, size);
+
+  if (link->out_buf->len > MAX_PENDING_SIZE)
+    {
+      g_set_error_literal (error,
+                           G_IO_ERROR,
+                           G_IO_ERROR_NO_SPACE,
+                           "Cluster link output buffer is full");
+
+      evd_peer_cluster_link_close_later (link);
+
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+evd_peer_cluster_link_on_write (EvdConnection *conn, gpointer user_data)
+{
+  EvdPeerClusterLink *link = user_data;
+
+  if (! link->closed && link->close_src_id == 0)
+    evd_peer_cluster_link_flush (link, NULL);
+}
+
+static gboolean
+evd_peer_cluster_link_write (EvdPeerClusterLink  *link,
+                             guint8               cmd,
+                             EvdMessageType       type,
+                             const gchar         *id,
+                             const gchar         *payload,
+                             gsize                size,
+                             GError             **error)
+{
+  guint8 hdr[HEADER_SIZE];
+  guint16 id_len;
+  guint32 payload_len;
+
+  if (link->closed || link->close_src_id != 0)
+    {
+      g_set_error_literal (error,
+                           G_IO_ERROR,
+                           G_IO_ERROR_CLOSED,
+                           "Cluster link is closed");
+      return FALSE;
+    }
+
+  if (size > MAX_FRAME_SIZE)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_ARGUMENT,
+                   "Message of %" G_GSIZE_FORMAT " bytes exceeds the cluster frame size",
+                   size);
+      return FALSE;
+    }
+
+  id_len = GUINT16_TO_BE ((guint16) strlen (id));
+  payload_len = GUINT32_TO_BE ((guint32) size);
+
+  hdr[0] = cmd;
+  hdr[1] = (guint8) type;
+  memcpy (hdr + 2, &id_len, 2);
+  memcpy (hdr + 4, &payload_len, 4);
+
+  /* queued behind whatever is still pending, to keep frames in order */
+  g_string_append_len (link->out_buf, (const gchar *) hdr, HEADER_SIZE);
+  g_string_append (link->out_buf, id);
+  if (size > 0)
+    g_string_append_len (link->out_buf, payload, size);
+
+  return evd_peer_cluster_link_flush (link, error);
+}
+
+static void
+evd_peer_cluster_broadcast (EvdPeerCluster *self,
+                            guint8          cmd,
+                            const gchar    *id)
+{
+  GList *node;
+
+  for (node = self->priv->links; node != NULL; node = node->next)
+    evd_peer_cluster_link_write (node->data, cmd, 0, id, NULL, 0, NULL);
+}
+
+static void
+evd_peer_cluster_close_proxy (EvdPeerCluster *self, const gchar *peer_id)
+{
+  EvdPeer *proxy;
+
+  proxy = g_hash_table_lookup (self->priv->proxies, peer_id);
+  if (proxy == NULL || evd_peer_is_closed (proxy))
+    return;
+
+  /* results in a 'peer-closed' signal on the cluster */
+  g_object_ref (proxy);
+  evd_peer_close (proxy, TRUE);
+  g_object_unref (proxy);
+}
+
+static void
+evd_peer_cluster_remote_peer_add (EvdPeerCluster     *self,
+                                  EvdPeerClusterLink *link,
+                                  const gchar        *peer_id)
+{
+  EvdPeer *proxy;
+  gchar *msg;
+  gsize size;
+  EvdMessageType type;
+
+  if (evd_peer_manager_lookup_peer (self->priv->peer_manager, peer_id) != NULL)
+    return;
+
+  g_hash_table_insert (self->priv->remote_peers, g_strdup (peer_id), link);
+
+  /* deliver what was sent while the peer's location was unknown */
+  proxy = g_hash_table_lookup (self->priv->proxies, peer_id);
+  if (proxy == NULL || evd_peer_is_closed (proxy))
+    return;
+
+  while ((msg = evd_peer_pop_message (proxy, &size, &type)) != NULL)
+    {
+      evd_peer_cluster_link_write (link, CMD_SEND, type, peer_id, msg, size, NULL);
+      g_free (msg);
+    }
+}
+
+static void
+evd_peer_cluster_remote_peer_del (EvdPeerCluster     *self,
+                                  EvdPeerClusterLink *link,
+                                  const gchar        *peer_id)
+{
+  if (g_hash_table_lookup (self->priv->remote_peers, peer_id) != link)
+    return;
+
+  g_hash_table_remove (self->priv->remote_peers, peer_id);
+
+  evd_peer_cluster_close_proxy (self, peer_id);
+}
+
+static void
+evd_peer_cluster_deliver (EvdPeerCluster *self,
+                          const gchar    *peer_id,
+                          const gchar    *payload,
+                          gsize           size,
+                          EvdMessageType  type)
+{
+  EvdPeer *peer;
+  GByteArray *msg;
+
+  peer = evd_peer_manager_lookup_peer (self->priv->peer_manager, peer_id);
+  if (peer == NULL || evd_peer_is_closed (peer))
+    {
+      evd_metric_add (EVD_METRIC (metric_dropped,
+                                  "evd_peer_cluster_dropped_messages_total",
+                                  EVD_METRIC_COUNTER,
+                                  "Forwarded messages whose peer was already gone"),
+                      1);
+      return;
+    }
+
+  msg = g_byte_array_sized_new (size);
+  g_byte_array_append (msg, (const guint8 *) payload, size);
+
+  evd_transport_send_shared (evd_peer_get_transport (peer),
+                             peer,
+                             msg,
+                             type,
+                             NULL);
+
+  g_byte_array_unref (msg);
+}
+
+static void
+evd_peer_cluster_handle_frame (EvdPeerClusterLink *link,
+                               guint8              cmd,
+                               EvdMessageType      type,
+                               const gchar        *id,
+                               const gchar        *payload,
+                               gsize               size)
+{
+  EvdPeerCluster *self = link->cluster;
+
+  switch (cmd)
+    {
+    case CMD_HELLO:
+      {
+        gchar **peer_ids;
+        gint i;
+
+        g_free (link->node_id);
+        link->node_id = g_strdup (id);
+
+        peer_ids = g_strsplit (payload, "\n", 0);
+        for (i = 0; peer_ids[i] != NULL; i++)
+          if (peer_ids[i][0] != '\0')
+            evd_peer_cluster_remote_peer_add (self, link, peer_ids[i]);
+        g_strfreev (peer_ids);
+
+        break;
+      }
+
+    case CMD_PEER_ADD:
+      evd_peer_cluster_remote_peer_add (self, link, id);
+      break;
+
+    case CMD_PEER_DEL:
+      evd_peer_cluster_remote_peer_del (self, link, id);
+      break;
+
+    case CMD_SEND:
+      evd_peer_cluster_deliver (self, id, payload, size, type);
+      break;
+
+    default:
+      g_debug ("Unknown peer cluster command %u", cmd);
+      break;
+    }
+}
+
+static void
+evd_peer_cluster_process_data (EvdPeerClusterLink *link)
+{
+  gsize offset = 0;
+
+  while (! link->closed && link->buf_len - offset >= HEADER_SIZE)
+    {
+      const gchar *hdr;
+      guint16 id_len;
+      guint32 payload_len;
+      gchar *id;
+      gchar *payload;
+
+      hdr = link->buf->str + offset;
+
+      memcpy (&id_len, hdr + 2, 2);
+      memcpy (&payload_len, hdr + 4, 4);
+      id_len = GUINT16_FROM_BE (id_len);
+      payload_len = GUINT32_FROM_BE (payload_len);
+
+      if (payload_len > MAX_FRAME_SIZE)
+        {
+          g_debug ("Closing peer cluster link, frame of %u bytes is too large",
+                   payload_len);
+          evd_peer_cluster_link_close (link);
+          return;
+        }
+
+      if (link->buf_len - offset < HEADER_SIZE + id_len + (gsize) payload_len)
+        break;
+
+      /* handlers expect NULL-terminated ids and payloads */
+      id = g_strndup (hdr + HEADER_SIZE, id_len);
+      payload = g_malloc (payload_len + 1);
+      memcpy (payload, hdr + HEADER_SIZE + id_len, payload_len);
+      payload[payload_len] = '\0';
+
+      offset += HEADER_SIZE + id_len + payload_len;
+
+      evd_peer_cluster_handle_frame (link,
+                                     (guint8) hdr[0],
+                                     (EvdMessageType) hdr[1],
+                                     id,
+                                     payload,
+                                     payload_len);
+
+      g_free (id);
+      g_free (payload);
+    }
+
+  if (offset > 0 && ! link->closed)
+    {
+      memmove (link->buf->str, link->buf->str + offset, link->buf_len - offset);
+      link->buf_len -= offset;
+    }
+}
+
+static void
+evd_peer_cluster_link_close (EvdPeerClusterLink *link)
+{
+  EvdPeerCluster *self = link->cluster;
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+  GList *gone = NULL;
+  GList *node;
+
+  if (link->closed)
+    return;
+
+  link->closed = TRUE;
+
+  g_signal_handlers_disconnect_by_func (link->conn,
+                                        evd_peer_cluster_link_on_write,
+                                        link);
+
+  self->priv->links = g_list_remove (self->priv->links, link);
+
+  /* peers reached through this link are gone */
+  g_hash_table_iter_init (&iter, self->priv->remote_peers);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    if (value == link)
+      {
+        gone = g_list_prepend (gone, g_strdup (key));
+        g_hash_table_iter_remove (&iter);
+      }
+
+  for (node = gone; node != NULL; node = node->next)
+    {
+      evd_peer_cluster_close_proxy (self, node->data);
+      g_free (node->data);
+    }
+  g_list_free (gone);
+
+  if (! g_io_stream_is_closed (G_IO_STREAM (link->conn)))
+    g_io_stream_close (G_IO_STREAM (link->conn), NULL, NULL);
+
+  evd_peer_cluster_link_unref (link);
+}
+
+static void
+evd_peer_cluster_link_on_read (GObject      *obj,
+                               GAsyncResult *res,
+                               gpointer      user_data)
+{
+  EvdPeerClusterLink *link = user_data;
+  GError *error = NULL;
+  gssize size;
+
+  size = g_input_stream_read_finish (G_INPUT_STREAM (obj), res, &error);
+  if (size <= 0)
+    {
+      if (error != NULL)
+        {
+          if (! g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CLOSED))
+            g_debug ("Error reading from peer cluster link: %s",
+                     error->message);
+          g_error_free (error);
+        }
+
+      evd_peer_cluster_link_close (link);
+    }
+  else if (! link->closed)
+    {
+      link->buf_len += size;
+
+      g_object_ref (link->cluster);
+      evd_peer_cluster_process_data (link);
+      evd_peer_cluster_link_read (link);
+      g_object_unref (link->cluster);
+    }
+
+  evd_peer_cluster_link_unref (link);
+}
+
+static void
+evd_peer_cluster_link_read (EvdPeerClusterLink *link)
+{
+  GInputStream *stream;
+
+  if (link->closed)
+    return;
+
+  if (link->buf_len + BLOCK_SIZE >= link->buf->len)
+    g_string_set_size (link->buf, link->buf_len + BLOCK_SIZE);
+
+  stream = g_io_stream_get_input_stream (G_IO_STREAM (link->conn));
+
+  g_input_stream_read_async (stream,
+                             link->buf->str + link->buf_len,
+                             BLOCK_SIZE,
+                             G_PRIORITY_DEFAULT,
+                             NULL,
+                             evd_peer_cluster_link_on_read,
+                             evd_peer_cluster_link_ref (link));
+}
+
+static void
+evd_peer_cluster_link_new (EvdPeerCluster *self, EvdConnection *conn)
+{
+  EvdPeerClusterLink *link;
+  GList *peers;
+  GList *node;
+  GString *ids;
+
+  link = g_slice_new0 (EvdPeerClusterLink);
+  link->ref_count = 1;
+  link->cluster = self;
+  link->conn = g_object_ref (conn);
+  link->buf = g_string_sized_new (BLOCK_SIZE);
+  link->out_buf = g_string_new ("");
+
+  self->priv->links = g_list_prepend (self->priv->links, link);
+
+  g_signal_connect (conn,
+                    "write",
+                    G_CALLBACK (evd_peer_cluster_link_on_write),
+                    link);
+
+  /* introduce ourselves along with our current peers */
+  ids = g_string_new ("");
+  peers = evd_peer_manager_get_all_peers (self->priv->peer_manager);
+  for (node = peers; node != NULL; node = node->next)
+    {
+      g_string_append (ids, evd_peer_get_id (EVD_PEER (node->data)));
+      g_string_append_c (ids, '\n');
+    }
+  g_list_free (peers);
+
+  evd_peer_cluster_link_write (link,
+                               CMD_HELLO,
+                               0,
+                               self->priv->node_id,
+                               ids->str,
+                               ids->len,
+                               NULL);
+  g_string_free (ids, TRUE);
+
+  evd_peer_cluster_link_read (link);
+}
+
+static guint
+evd_peer_cluster_on_validate_connection (EvdService    *service,
+                                         EvdConnection *conn,
+                                         gpointer       user_data)
+{
+  EvdPeerCluster *self = EVD_PEER_CLUSTER (user_data);
+
+  evd_peer_cluster_link_new (self, conn);
+
+  return EVD_VALIDATE_ACCEPT;
+}
+
+static void
+evd_peer_cluster_on_node_connected (GObject      *obj,
+                                    GAsyncResult *res,
+                                    gpointer      user_data)
+{
+  EvdPeerCluster *self = EVD_PEER_CLUSTER (user_data);
+  EvdSocket *socket = EVD_SOCKET (obj);
+  GIOStream *io_stream;
+  GError *error = NULL;
+
+  if ( (io_stream = evd_socket_connect_finish (socket, res, &error)) != NULL)
+    {
+      if (self->priv->started)
+        evd_peer_cluster_link_new (self, EVD_CONNECTION (io_stream));
+      else
+        g_io_stream_close (io_stream, NULL, NULL);
+
+      g_object_unref (io_stream);
+    }
+  else
+    {
+      /* most likely a stale socket of a node that is gone */
+      g_debug ("Failed to connect to cluster node: %s", error->message);
+      g_error_free (error);
+    }
+
+  g_object_unref (socket);
+  g_object_unref (self);
+}
+
+static void
+evd_peer_cluster_connect_to_nodes (EvdPeerCluster *self)
+{
+  GDir *dir;
+  const gchar *name;
+  gchar *own_name;
+
+  dir = g_dir_open (self->priv->path, 0, NULL);
+  if (dir == NULL)
+    return;
+
+  own_name = g_path_get_basename (self->priv->address);
+
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      EvdSocket *socket;
+      gchar *address;
+
+      if (! g_str_has_suffix (name, SOCKET_SUFFIX) ||
+          g_strcmp0 (name, own_name) == 0)
+        continue;
+
+      address = g_build_filename (self->priv->path, name, NULL);
+
+      socket = evd_socket_new ();
+      g_object_set (socket, "io-stream-type", EVD_TYPE_CONNECTION, NULL);
+
+      g_object_ref (self);
+      evd_socket_connect_to (socket,
+                             address,
+                             NULL,
+                             evd_peer_cluster_on_node_connected,
+                             self);
+
+      g_free (address);
+    }
+
+  g_free (own_name);
+  g_dir_close (dir);
+}
+
+static void
+evd_peer_cluster_on_listen (GObject      *obj,
+                            GAsyncResult *res,
+                            gpointer      user_data)
+{
+  GSimpleAsyncResult *result = G_SIMPLE_ASYNC_RESULT (user_data);
+  EvdPeerCluster *self;
+  GError *error = NULL;
+
+  self =
+    EVD_PEER_CLUSTER (g_async_result_get_source_object (G_ASYNC_RESULT (result)));
+
+  if (! evd_service_listen_finish (EVD_SERVICE (obj), res, &error))
+    {
+      g_simple_async_result_take_error (result, error);
+    }
+  else
+    {
+      self->priv->started = TRUE;
+
+      g_signal_connect (self->priv->peer_manager,
+                        "new-peer",
+                        G_CALLBACK (evd_peer_cluster_on_new_peer),
+                        self);
+      g_signal_connect (self->priv->peer_manager,
+                        "peer-closed",
+                        G_CALLBACK (evd_peer_cluster_on_peer_closed),
+                        self);
+
+      evd_peer_cluster_connect_to_nodes (self);
+    }
+
+  g_simple_async_result_complete (result);
+  g_object_unref (result);
+  g_object_unref (self);
+}
+
+static void
+evd_peer_cluster_on_new_peer (EvdPeerManager *peer_manager,
+                              EvdPeer        *peer,
+                              gpointer        user_data)
+{
+  EvdPeerCluster *self = EVD_PEER_CLUSTER (user_data);
+
+  evd_peer_cluster_broadcast (self, CMD_PEER_ADD, evd_peer_get_id (peer));
+}
+
+static void
+evd_peer_cluster_on_peer_closed (EvdPeerManager *peer_manager,
+                                 EvdPeer        *peer,
+                                 gboolean        gracefully,
+                                 gpointer        user_data)
+{
+  EvdPeerCluster *self = EVD_PEER_CLUSTER (user_data);
+
+  evd_peer_cluster_broadcast (self, CMD_PEER_DEL, evd_peer_get_id (peer));
+}
+
+static void
+evd_peer_cluster_dispose (GObject *obj)
+{
+  EvdPeerCluster *self = EVD_PEER_CLUSTER (obj);
+
+  if (self->priv->started)
+    {
+      self->priv->started = FALSE;
+
+      g_signal_handlers_disconnect_by_func (self->priv->peer_manager,
+                                            evd_peer_cluster_on_new_peer,
+                                            self);
+      g_signal_handlers_disconnect_by_func (self->priv->peer_manager,
+                                            evd_peer_cluster_on_peer_closed,
+                                            self);
+
+      g_unlink (self->priv->address);
+    }
+
+  while (self->priv->links != NULL)
+    evd_peer_cluster_link_close (self->priv->links->data);
+
+  if (self->priv->service != NULL)
+    {
+      g_object_unref (self->priv->service);
+      self->priv->service = NULL;
+    }
+
+  G_OBJECT_CLASS (evd_peer_cluster_parent_class)->dispose (obj);
+}
+
+static void
+evd_peer_cluster_finalize (GObject *obj)
+{
+  EvdPeerCluster *self = EVD_PEER_CLUSTER (obj);
+  GHashTableIter iter;
+  gpointer value;
+
+  /* a proxy drops its reference to us before its weak references are
+     notified, so we may be finalized while it is being disposed */
+  g_hash_table_iter_init (&iter, self->priv->proxies);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    g_object_weak_unref (G_OBJECT (value),
+                         evd_peer_cluster_proxy_finalized,
+                         self);
+
+  g_hash_table_unref (self->priv->remote_peers);
+  g_hash_table_unref (self->priv->proxies);
+
+  g_object_unref (self->priv->peer_manager);
+
+  g_free (self->priv->path);
+  g_free (self->priv->node_id);
+  g_free (self->priv->address);
+
+  G_OBJECT_CLASS (evd_peer_cluster_parent_class)->finalize (obj);
+}
+
+static gboolean
+evd_peer_cluster_send (EvdTransport    *transport,
+                       EvdPeer         *peer,
+                       const gchar     *buffer,
+                       gsize            size,
+                       EvdMessageType   type,
+                       GError         **error)
+{
+  EvdPeerCluster *self = EVD_PEER_CLUSTER (transport);
+  EvdPeerClusterLink *link;
+  const gchar *peer_id;
+
+  peer_id = evd_peer_get_id (peer);
+
+  /* unknown location, the message stays in the proxy's backlog until the
+     peer is announced */
+  link = g_hash_table_lookup (self->priv->remote_peers, peer_id);
+  if (link == NULL)
+    return FALSE;
+
+  if (! evd_peer_cluster_link_write (link,
+                                     CMD_SEND,
+                                     type,
+                                     peer_id,
+                                     buffer,
+                                     size,
+                                     error))
+    return FALSE;
+
+  evd_metric_add (EVD_METRIC (metric_forwarded,
+                              "evd_peer_cluster_forwarded_messages_total",
+                              EVD_METRIC_COUNTER,
+                              "Messages forwarded to peers in other cluster nodes"),
+                  1);
+
+  return TRUE;
+}
+
+static gboolean
+evd_peer_cluster_peer_is_connected (EvdTransport *transport,
+                                    EvdPeer      *peer)
+{
+  EvdPeerCluster *self = EVD_PEER_CLUSTER (transport);
+
+  return g_hash_table_lookup (self->priv->remote_peers,
+                              evd_peer_get_id (peer)) != NULL;
+}
+
+static gboolean
+evd_peer_cluster_accept_peer (EvdTransport *transport, EvdPeer *peer)
+{
+  /* remote peers are never registered in the local peer manager */
+  return FALSE;
+}
+
+static void
+evd_peer_cluster_proxy_finalized (gpointer  user_data,
+                                  GObject  *where_the_object_was)
+{
+  EvdPeerCluster *self = EVD_PEER_CLUSTER (user_data);
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, self->priv->proxies);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    if (value == (gpointer) where_the_object_was)
+      {
+        g_hash_table_iter_remove (&iter);
+        break;
+      }
+}
+
+/* public methods */
+
+/**
+ * evd_peer_cluster_new:
+ * @peer_manager: the local #EvdPeerManager to share
+ * @path: a directory shared by all the nodes of the cluster
+ * @node_id: (allow-none): a name for this node, unique in the cluster, or
+ * %NULL to use the process id
+ *
+ * Creates a cluster node that shares the location of the peers in
+ * @peer_manager with the other EventDance processes on the same host using
+ * @path, so that messages can be sent to peers connected to any of them.
+ *
+ * Returns: (transfer full):
+ *
+ * Since: 0.2.0
+ **/
+EvdPeerCluster *
+evd_peer_cluster_new (EvdPeerManager *peer_manager,
+                      const gchar    *path,
+                      const gchar    *node_id)
+{
+  EvdPeerCluster *self;
+  gchar *file_name;
+
+  g_return_val_if_fail (EVD_IS_PEER_MANAGER (peer_manager), NULL);
+  g_return_val_if_fail (path != NULL, NULL);
+
+  self = g_object_new (EVD_TYPE_PEER_CLUSTER, NULL);
+
+  self->priv->peer_manager = g_object_ref (peer_manager);
+  self->priv->path = g_strdup (path);
+
+  if (node_id != NULL)
+    self->priv->node_id = g_strdup (node_id);
+  else
+    self->priv->node_id = g_strdup_printf ("%d", (gint) getpid ());
+
+  file_name = g_strconcat (self->priv->node_id, SOCKET_SUFFIX, NULL);
+  self->priv->address = g_build_filename (path, file_name, NULL);
+  g_free (file_name);
+
+  g_signal_connect (self->priv->service,
+                    "validate-connection",
+                    G_CALLBACK (evd_peer_cluster_on_validate_connection),
+                    self);
+
+  return self;
+}
+
+const gchar *
+evd_peer_cluster_get_node_id (EvdPeerCluster *self)
+{
+  g_return_val_if_fail (EVD_IS_PEER_CLUSTER (self), NULL);
+
+  return self->priv->node_id;
+}
+
+/**
+ * evd_peer_cluster_start:
+ * @cancellable: (allow-none):
+ * @callback: (allow-none):
+ * @user_data: (allow-none):
+ *
+ * Starts listening for other nodes and connects to the ones already
+ * running. Connections to other nodes are established in the background,
+ * after @callback is called.
+ *
+ * Since: 0.2.0
+ **/
+void
+evd_peer_cluster_start (EvdPeerCluster      *self,
+                        GCancellable        *cancellable,
+                        GAsyncReadyCallback  callback,
+                        gpointer             user_data)
+{
+  GSimpleAsyncResult *res;
+
+  g_return_if_fail (EVD_IS_PEER_CLUSTER (self));
+
+  res = g_simple_async_result_new (G_OBJECT (self),
+                                   callback,
+                                   user_data,
+                                   evd_peer_cluster_start);
+
+  if (self->priv->started)
+    {
+      g_simple_async_result_set_error (res,
+                                       G_IO_ERROR,
+                                       G_IO_ERROR_PENDING,
+                                       "Cluster node already started");
+      g_simple_async_result_complete_in_idle (res);
+      g_object_unref (res);
+      return;
+    }
+
+  g_mkdir_with_parents (self->priv->path, 0700);
+
+  /* a socket with our name can only be left over by a dead process */
+  g_unlink (self->priv->address);
+
+  evd_service_listen (self->priv->service,
+                      self->priv->address,
+                      cancellable,
+                      evd_peer_cluster_on_listen,
+                      res);
+}
+
+/**
+ * evd_peer_cluster_start_finish:
+ *
+ * Returns: %TRUE if the node is listening, %FALSE otherwise.
+ *
+ * Since: 0.2.0
+ **/
+gboolean
+evd_peer_cluster_start_finish (EvdPeerCluster  *self,
+                               GAsyncResult    *result,
+                               GError         **error)
+{
+  g_return_val_if_fail (EVD_IS_PEER_CLUSTER (self), FALSE);
+  g_return_val_if_fail (g_simple_async_result_is_valid (result,
+                                                        G_OBJECT (self),
+                                                        evd_peer_cluster_start),
+                        FALSE);
+
+  return
+    ! g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (result),
+                                             error);
+}
+
+/**
+ * evd_peer_cluster_lookup_peer:
+ *
+ * Looks up a peer in the local #EvdPeerManager and, if not found there,
+ * among the peers announced by other nodes. Remote peers are represented by
+ * proxy #EvdPeer objects whose transport is @self: evd_peer_send() and
+ * evd_transport_send() on them forward the message to the node the peer is
+ * connected to.
+ *
+ * Returns: (transfer full): The #EvdPeer, or %NULL if not found.
+ *
+ * Since: 0.2.0
+ **/
+EvdPeer *
+evd_peer_cluster_lookup_peer (EvdPeerCluster *self, const gchar *peer_id)
+{
+  EvdPeer *peer;
+
+  g_return_val_if_fail (EVD_IS_PEER_CLUSTER (self), NULL);
+
+  if (peer_id == NULL)
+    return NULL;
+
+  peer = evd_peer_manager_lookup_peer (self->priv->peer_manager, peer_id);
+  if (peer != NULL)
+    return g_object_ref (peer);
+
+  if (g_hash_table_lookup (self->priv->remote_peers, peer_id) == NULL)
+    return NULL;
+
+  peer = g_hash_table_lookup (self->priv->proxies, peer_id);
+  if (peer != NULL && ! evd_peer_is_closed (peer))
+    return g_object_ref (peer);
+
+  if (peer != NULL)
+    g_object_weak_unref (G_OBJECT (peer),
+                         evd_peer_cluster_proxy_finalized,
+                         self);
+
+  peer = g_object_new (EVD_TYPE_PEER,
+                       "id", peer_id,
+                       "transport", self,
+                       NULL);
+
+  g_hash_table_insert (self->priv->proxies, g_strdup (peer_id), peer);
+  g_object_weak_ref (G_OBJECT (peer), evd_peer_cluster_proxy_finalized, self);
+
+  return peer;
+}
+
+/**
+ * evd_peer_cluster_is_remote_peer:
+ *
+ * Returns: %TRUE if a peer with @peer_id is connected to another node.
+ *
+ * Since: 0.2.0
+ **/
+gboolean
+evd_peer_cluster_is_remote_peer (EvdPeerCluster *self, const gchar *peer_id)
+{
+  g_return_val_if_fail (EVD_IS_PEER_CLUSTER (self), FALSE);
+  g_return_val_if_fail (peer_id != NULL, FALSE);
+
+  return g_hash_table_lookup (self->priv->remote_peers, peer_id) != NULL;
+}
+
+/**
+ * evd_peer_cluster_get_num_nodes:
+ *
+ * Returns: the number of other nodes this node is linked to.
+ *
+ * Since: 0.2.0
+ **/
+guint
+evd_peer_cluster_get_num_nodes (EvdPeerCluster *self)
+{
+  GHashTable *nodes;
+  GList *node;
+  guint count;
+
+  g_return_val_if_fail (EVD_IS_PEER_CLUSTER (self), 0);
+
+  /* two nodes starting at once may end up with two links between them */
+  nodes = g_hash_table_new (g_str_hash, g_str_equal);
+  for (node = self->priv->links; node != NULL; node = node->next)
+    {
+      EvdPeerClusterLink *link = node->data;
+
+      if (link->node_id != NULL)
+        g_hash_table_insert (nodes, link->node_id, link);
+    }
+
+  count = g_hash_table_size (nodes);
+  g_hash_table_unref (nodes);
+
+  return count;
+}
@@ -0,0 +1,89 @@
+/*
+ * evd-peer-cluster.h
+ *
+ * EventDance, Peer-to-peer IPC library <http://eventdance.org>
+ *
+ * Copyright (C) 2026, the EventDance contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 3, or (at your option) any later version as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License at http://www.gnu.org/licenses/lgpl-3.0.txt
+ * for more details.
+ */
+
+#ifndef __EVD_PEER_CLUSTER_H__
+#define __EVD_PEER_CLUSTER_H__
+
+#if !defined (__EVD_H_INSIDE__) && !defined (EVD_COMPILATION)
+#error "Only <evd.h> can be included directly."
+#endif
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "evd-peer-manager.h"
+#include "evd-peer.h"
+
+G_BEGIN_DECLS
+
+typedef struct _EvdPeerCluster EvdPeerCluster;
+typedef struct _EvdPeerClusterClass EvdPeerClusterClass;
+typedef struct _EvdPeerClusterPrivate EvdPeerClusterPrivate;
+
+struct _EvdPeerCluster
+{
+  GObject parent;
+
+  EvdPeerClusterPrivate *priv;
+};
+
+struct _EvdPeerClusterClass
+{
+  GObjectClass parent_class;
+
+  /* padding for future expansion */
+  void (* _padding_0_) (void);
+  void (* _padding_1_) (void);
+  void (* _padding_2_) (void);
+  void (* _padding_3_) (void);
+};
+
+#define EVD_TYPE_PEER_CLUSTER           (evd_peer_cluster_get_type ())
+#define EVD_PEER_CLUSTER(obj)           (G_TYPE_CHECK_INSTANCE_CAST ((obj), EVD_TYPE_PEER_CLUSTER, EvdPeerCluster))
+#define EVD_PEER_CLUSTER_CLASS(obj)     (G_TYPE_CHECK_CLASS_CAST ((obj), EVD_TYPE_PEER_CLUSTER, EvdPeerClusterClass))
+#define EVD_IS_PEER_CLUSTER(obj)        (G_TYPE_CHECK_INSTANCE_TYPE ((obj), EVD_TYPE_PEER_CLUSTER))
+#define EVD_IS_PEER_CLUSTER_CLASS(obj)  (G_TYPE_CHECK_CLASS_TYPE ((obj), EVD_TYPE_PEER_CLUSTER))
+#define EVD_PEER_CLUSTER_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS ((obj), EVD_TYPE_PEER_CLUSTER, EvdPeerClusterClass))
+
+
+GType               evd_peer_cluster_get_type               (void) G_GNUC_CONST;
+
+EvdPeerCluster     *evd_peer_cluster_new                    (EvdPeerManager *peer_manager,
+                                                             const gchar    *path,
+                                                             const gchar    *node_id);
+
+const gchar        *evd_peer_cluster_get_node_id            (EvdPeerCluster *self);
+
+void                evd_peer_cluster_start                  (EvdPeerCluster      *self,
+                                                             GCancellable        *cancellable,
+                                                             GAsyncReadyCallback  callback,
+                                                             gpointer             user_data);
+gboolean            evd_peer_cluster_start_finish           (EvdPeerCluster  *self,
+                                                             GAsyncResult    *result,
+                                                             GError         **error);
+
+EvdPeer            *evd_peer_cluster_lookup_peer            (EvdPeerCluster *self,
+                                                             const gchar    *peer_id);
+gboolean            evd_peer_cluster_is_remote_peer         (EvdPeerCluster *self,
+                                                             const gchar    *peer_id);
+guint               evd_peer_cluster_get_num_nodes          (EvdPeerCluster *self);
+
+G_END_DECLS
+
+#endif /* __EVD_PEER_CLUSTER_H__ */
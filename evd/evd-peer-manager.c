@@ -24,8 +24,10 @@
 
 #include "evd-peer-manager.h"
 
+#include "evd-transport.h"
 #include "evd-marshal.h"
 #include "evd-utils.h"
+#include "evd-metrics.h"
 
 G_DEFINE_TYPE (EvdPeerManager, evd_peer_manager, G_TYPE_OBJECT)
 
@@ -47,6 +49,9 @@ struct _EvdPeerManagerPrivate
   guint peer_cleanup_src_id;
 
   GQueue *removal_list;
+
+  GHashTable *groups;
+  GHashTable *peer_groups;
 };
 
 /* signals */
@@ -61,6 +66,14 @@ static guint evd_peer_manager_signals[SIGNAL_LAST] = { 0 };
 
 static EvdPeerManager *evd_peer_manager_default = NULL;
 
+static EvdMetric *metric_peers = NULL;
+
+typedef struct
+{
+  gchar *name;
+  GHashTable *peers;
+} EvdPeerGroup;
+
 static void     evd_peer_manager_class_init          (EvdPeerManagerClass *class);
 static void     evd_peer_manager_init                (EvdPeerManager *self);
 
@@ -71,6 +84,10 @@ static void     evd_peer_manager_close_peer_internal (EvdPeerManager *self,
                                                       EvdPeer        *peer,
                                                       gboolean        gracefully);
 
+static void     evd_peer_manager_free_peer           (gpointer peer);
+
+static void     evd_peer_manager_free_group          (gpointer data);
+
 static void
 evd_peer_manager_class_init (EvdPeerManagerClass *class)
 {
@@ -114,12 +131,21 @@ evd_peer_manager_init (EvdPeerManager *self)
   priv->peers = g_hash_table_new_full (g_str_hash,
                                        g_str_equal,
                                        g_free,
-                                       g_object_unref);
+                                       evd_peer_manager_free_peer);
 
   priv->peer_cleanup_timer = g_timer_new ();
   priv->peer_cleanup_interval = DEFAULT_PEER_CLEANUP_INTERVAL;
 
   priv->removal_list = g_queue_new ();
+
+  priv->groups = g_hash_table_new_full (g_str_hash,
+                                        g_str_equal,
+                                        NULL,
+                                        evd_peer_manager_free_group);
+  priv->peer_groups = g_hash_table_new_full (g_direct_hash,
+                                             g_direct_equal,
+                                             NULL,
+                                             (GDestroyNotify) g_list_free);
 }
 
 static void
@@ -139,6 +165,9 @@ evd_peer_manager_dispose (GObject *obj)
         }
       g_queue_free (self->priv->removal_list);
 
+      g_hash_table_unref (self->priv->peer_groups);
+      g_hash_table_unref (self->priv->groups);
+
       g_hash_table_unref (self->priv->peers);
       self->priv->peers = NULL;
     }
@@ -162,11 +191,61 @@ evd_peer_manager_finalize (GObject *obj)
     evd_peer_manager_default = NULL;
 }
 
+static void
+evd_peer_manager_free_peer (gpointer peer)
+{
+  evd_metric_add (metric_peers, -1);
+
+  g_object_unref (peer);
+}
+
+static void
+evd_peer_manager_free_group (gpointer data)
+{
+  EvdPeerGroup *group = data;
+
+  g_hash_table_unref (group->peers);
+  g_free (group->name);
+
+  g_slice_free (EvdPeerGroup, group);
+}
+
+static void
+evd_peer_manager_remove_from_group (EvdPeerManager *self,
+                                    EvdPeerGroup   *group,
+                                    EvdPeer        *peer)
+{
+  g_hash_table_remove (group->peers, peer);
+
+  if (g_hash_table_size (group->peers) == 0)
+    g_hash_table_remove (self->priv->groups, group->name);
+}
+
+static void
+evd_peer_manager_leave_all_groups (EvdPeerManager *self, EvdPeer *peer)
+{
+  GList *groups;
+  GList *node;
+
+  groups = g_hash_table_lookup (self->priv->peer_groups, peer);
+  if (groups == NULL)
+    return;
+
+  g_hash_table_steal (self->priv->peer_groups, peer);
+
+  for (node = groups; node != NULL; node = node->next)
+    evd_peer_manager_remove_from_group (self, node->data, peer);
+
+  g_list_free (groups);
+}
+
 static void
 evd_peer_manager_close_peer_internal (EvdPeerManager *self,
                                       EvdPeer        *peer,
                                       gboolean        gracefully)
 {
+  evd_peer_manager_leave_all_groups (self, peer);
+
   evd_peer_close (peer, gracefully);
 
   g_signal_emit (self,
@@ -197,6 +276,20 @@ evd_peer_manager_check_peer (gpointer key,
     }
 }
 
+static void
+evd_peer_manager_flush_removal_list (EvdPeerManager *self)
+{
+  while (g_queue_get_length (self->priv->removal_list) > 0)
+    {
+      EvdPeer *peer;
+
+      peer = EVD_PEER (g_queue_pop_head (self->priv->removal_list));
+
+      evd_peer_manager_close_peer_internal (self, peer, FALSE);
+      g_object_unref (peer);
+    }
+}
+
 static void
 evd_peer_manager_cleanup_peers (EvdPeerManager *self)
 {
@@ -210,15 +303,7 @@ evd_peer_manager_cleanup_peers (EvdPeerManager *self)
                                evd_peer_manager_check_peer,
                                self);
 
-  while (g_queue_get_length (self->priv->removal_list) > 0)
-    {
-      EvdPeer *peer;
-
-      peer = EVD_PEER (g_queue_pop_head (self->priv->removal_list));
-
-      evd_peer_manager_close_peer_internal (self, peer, FALSE);
-      g_object_unref (peer);
-    }
+  evd_peer_manager_flush_removal_list (self);
 }
 
 static gboolean
@@ -284,6 +369,12 @@ evd_peer_manager_add_peer (EvdPeerManager *self, EvdPeer *peer)
   g_return_if_fail (EVD_IS_PEER_MANAGER (self));
   g_return_if_fail (EVD_IS_PEER (peer));
 
+  evd_metric_add (EVD_METRIC (metric_peers,
+                              "evd_peers",
+                              EVD_METRIC_GAUGE,
+                              "Peers registered in peer managers"),
+                  1);
+
   g_object_ref (peer);
   g_hash_table_insert (self->priv->peers,
                        g_strdup (evd_peer_get_id (peer)),
@@ -353,6 +444,298 @@ evd_peer_manager_close_peer (EvdPeerManager *self,
   g_return_if_fail (EVD_IS_PEER_MANAGER (self));
   g_return_if_fail (EVD_IS_PEER (peer));
 
-  if (g_hash_table_remove (self->priv->peers, evd_peer_get_id (peer)))
-    evd_peer_manager_close_peer_internal (self, peer, gracefully);
+  /* proxies of peers in other cluster nodes share their ids */
+  if (g_hash_table_lookup (self->priv->peers, evd_peer_get_id (peer)) != peer)
+    return;
+
+  g_hash_table_remove (self->priv->peers, evd_peer_get_id (peer));
+  evd_peer_manager_close_peer_internal (self, peer, gracefully);
+}
+
+/**
+ * evd_peer_manager_foreach_stats:
+ * @func: (scope call): function called with every peer and its stats
+ * @user_data: (allow-none): data passed to @func
+ *
+ * Calls @func with a snapshot of the #EvdPeerStats of every peer. Peers for
+ * which @func returns %TRUE are closed, ungracefully, once the iteration
+ * finishes; this allows shedding stuck or abusive peers in a single pass.
+ *
+ * Since: 0.2.0
+ **/
+void
+evd_peer_manager_foreach_stats (EvdPeerManager   *self,
+                                EvdPeerStatsFunc  func,
+                                gpointer          user_data)
+{
+  GList *peers;
+  GList *to_close = NULL;
+  GList *node;
+
+  g_return_if_fail (EVD_IS_PEER_MANAGER (self));
+  g_return_if_fail (func != NULL);
+
+  /* expired peers are purged first, so @func only sees live ones */
+  g_hash_table_foreach_remove (self->priv->peers,
+                               evd_peer_manager_check_peer,
+                               self);
+  evd_peer_manager_flush_removal_list (self);
+
+  /* @func is called on a snapshot, outside of the hash table walk, so it
+     can safely use the manager (e.g, to send to or close other peers) */
+  peers = g_hash_table_get_values (self->priv->peers);
+  g_list_foreach (peers, (GFunc) g_object_ref, NULL);
+
+  for (node = peers; node != NULL; node = node->next)
+    {
+      EvdPeer *peer = EVD_PEER (node->data);
+      EvdPeerStats stats;
+
+      /* it could have been closed by @func on an earlier peer */
+      if (g_hash_table_lookup (self->priv->peers,
+                               evd_peer_get_id (peer)) != peer)
+        continue;
+
+      evd_peer_get_stats (peer, &stats);
+
+      if (func (peer, &stats, user_data))
+        to_close = g_list_prepend (to_close, g_object_ref (peer));
+    }
+
+  g_list_foreach (peers, (GFunc) g_object_unref, NULL);
+  g_list_free (peers);
+
+  to_close = g_list_reverse (to_close);
+  for (node = to_close; node != NULL; node = node->next)
+    {
+      EvdPeer *peer = EVD_PEER (node->data);
+
+      evd_peer_manager_close_peer (self, peer, FALSE);
+      g_object_unref (peer);
+    }
+  g_list_free (to_close);
+}
+
+/**
+ * evd_peer_manager_join_group:
+ * @group: the name of the group
+ *
+ * Adds @peer to @group, creating the group if it doesn't exist. Groups are
+ * removed automatically once their last peer leaves, and peers leave all
+ * their groups when closed.
+ *
+ * Returns: %TRUE if @peer was added, %FALSE if it was already a member or
+ * is not handled by @self.
+ *
+ * Since: 0.2.0
+ **/
+gboolean
+evd_peer_manager_join_group (EvdPeerManager *self,
+                             EvdPeer        *peer,
+                             const gchar    *group)
+{
+  EvdPeerGroup *peer_group;
+  GList *groups;
+
+  g_return_val_if_fail (EVD_IS_PEER_MANAGER (self), FALSE);
+  g_return_val_if_fail (EVD_IS_PEER (peer), FALSE);
+  g_return_val_if_fail (group != NULL, FALSE);
+
+  /* only peers we will see closing can join, otherwise they'd never leave */
+  if (g_hash_table_lookup (self->priv->peers, evd_peer_get_id (peer)) != peer)
+    return FALSE;
+
+  peer_group = g_hash_table_lookup (self->priv->groups, group);
+  if (peer_group == NULL)
+    {
+      peer_group = g_slice_new (EvdPeerGroup);
+      peer_group->name = g_strdup (group);
+      peer_group->peers = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+      g_hash_table_insert (self->priv->groups, peer_group->name, peer_group);
+    }
+  else if (g_hash_table_lookup (peer_group->peers, peer) != NULL)
+    {
+      return FALSE;
+    }
+
+  g_hash_table_insert (peer_group->peers, peer, peer);
+
+  groups = g_hash_table_lookup (self->priv->peer_groups, peer);
+  g_hash_table_steal (self->priv->peer_groups, peer);
+  g_hash_table_insert (self->priv->peer_groups,
+                       peer,
+                       g_list_prepend (groups, peer_group));
+
+  return TRUE;
+}
+
+/**
+ * evd_peer_manager_leave_group:
+ * @group: the name of the group
+ *
+ * Returns: %TRUE if @peer was a member of @group.
+ *
+ * Since: 0.2.0
+ **/
+gboolean
+evd_peer_manager_leave_group (EvdPeerManager *self,
+                              EvdPeer        *peer,
+                              const gchar    *group)
+{
+  EvdPeerGroup *peer_group;
+  GList *groups;
+
+  g_return_val_if_fail (EVD_IS_PEER_MANAGER (self), FALSE);
+  g_return_val_if_fail (EVD_IS_PEER (peer), FALSE);
+  g_return_val_if_fail (group != NULL, FALSE);
+
+  peer_group = g_hash_table_lookup (self->priv->groups, group);
+  if (peer_group == NULL ||
+      g_hash_table_lookup (peer_group->peers, peer) == NULL)
+    return FALSE;
+
+  groups = g_hash_table_lookup (self->priv->peer_groups, peer);
+  g_hash_table_steal (self->priv->peer_groups, peer);
+  groups = g_list_remove (groups, peer_group);
+  if (groups != NULL)
+    g_hash_table_insert (self->priv->peer_groups, peer, groups);
+
+  evd_peer_manager_remove_from_group (self, peer_group, peer);
+
+  return TRUE;
+}
+
+/**
+ * evd_peer_manager_is_in_group:
+ *
+ * Since: 0.2.0
+ **/
+gboolean
+evd_peer_manager_is_in_group (EvdPeerManager *self,
+                              EvdPeer        *peer,
+                              const gchar    *group)
+{
+  EvdPeerGroup *peer_group;
+
+  g_return_val_if_fail (EVD_IS_PEER_MANAGER (self), FALSE);
+  g_return_val_if_fail (EVD_IS_PEER (peer), FALSE);
+  g_return_val_if_fail (group != NULL, FALSE);
+
+  peer_group = g_hash_table_lookup (self->priv->groups, group);
+
+  return peer_group != NULL &&
+    g_hash_table_lookup (peer_group->peers, peer) != NULL;
+}
+
+/**
+ * evd_peer_manager_get_group_size:
+ *
+ * Returns: the number of peers in @group.
+ *
+ * Since: 0.2.0
+ **/
+guint
+evd_peer_manager_get_group_size (EvdPeerManager *self, const gchar *group)
+{
+  EvdPeerGroup *peer_group;
+
+  g_return_val_if_fail (EVD_IS_PEER_MANAGER (self), 0);
+  g_return_val_if_fail (group != NULL, 0);
+
+  peer_group = g_hash_table_lookup (self->priv->groups, group);
+
+  return peer_group != NULL ? g_hash_table_size (peer_group->peers) : 0;
+}
+
+/**
+ * evd_peer_manager_get_group_peers:
+ *
+ * Returns: (transfer container) (element-type Evd.Peer):
+ *
+ * Since: 0.2.0
+ **/
+GList *
+evd_peer_manager_get_group_peers (EvdPeerManager *self, const gchar *group)
+{
+  EvdPeerGroup *peer_group;
+
+  g_return_val_if_fail (EVD_IS_PEER_MANAGER (self), NULL);
+  g_return_val_if_fail (group != NULL, NULL);
+
+  peer_group = g_hash_table_lookup (self->priv->groups, group);
+  if (peer_group == NULL)
+    return NULL;
+
+  return g_hash_table_get_keys (peer_group->peers);
+}
+
+/**
+ * evd_peer_manager_send_to_group:
+ * @group: the name of the group
+ * @buffer: (array length=size) (element-type guint8): the message
+ * @exclude: (allow-none): a peer that should not get the message, usually
+ * its sender
+ *
+ * Sends a message to every peer in @group. The payload is copied once and
+ * shared by all the peers that have to queue it, instead of once per peer
+ * as when calling evd_transport_send() in a loop.
+ *
+ * Returns: the number of peers the message was delivered or queued to.
+ *
+ * Since: 0.2.0
+ **/
+guint
+evd_peer_manager_send_to_group (EvdPeerManager  *self,
+                                const gchar     *group,
+                                const gchar     *buffer,
+                                gsize            size,
+                                EvdMessageType   type,
+                                EvdPeer         *exclude)
+{
+  EvdPeerGroup *peer_group;
+  GPtrArray *peers;
+  GByteArray *message;
+  GHashTableIter iter;
+  gpointer peer;
+  guint count = 0;
+  guint i;
+
+  g_return_val_if_fail (EVD_IS_PEER_MANAGER (self), 0);
+  g_return_val_if_fail (group != NULL, 0);
+  g_return_val_if_fail (buffer != NULL || size == 0, 0);
+
+  peer_group = g_hash_table_lookup (self->priv->groups, group);
+  if (peer_group == NULL)
+    return 0;
+
+  /* sending may close peers and so change the group, take a snapshot */
+  peers = g_ptr_array_sized_new (g_hash_table_size (peer_group->peers));
+  g_hash_table_iter_init (&iter, peer_group->peers);
+  while (g_hash_table_iter_next (&iter, &peer, NULL))
+    if (peer != exclude)
+      g_ptr_array_add (peers, g_object_ref (peer));
+
+  message = g_byte_array_sized_new (size);
+  g_byte_array_append (message, (const guint8 *) buffer, size);
+
+  for (i = 0; i < peers->len; i++)
+    {
+      EvdPeer *member = g_ptr_array_index (peers, i);
+
+      if (! evd_peer_is_closed (member) &&
+          evd_transport_send_shared (evd_peer_get_transport (member),
+                                     member,
+                                     message,
+                                     type,
+                                     NULL))
+        count++;
+
+      g_object_unref (member);
+    }
+
+  g_byte_array_unref (message);
+  g_ptr_array_free (peers, TRUE);
+
+  return count;
 }
@@ -37,6 +37,10 @@ typedef struct _EvdPeerManager EvdPeerManager;
 typedef struct _EvdPeerManagerClass EvdPeerManagerClass;
 typedef struct _EvdPeerManagerPrivate EvdPeerManagerPrivate;
 
+typedef gboolean (* EvdPeerStatsFunc) (EvdPeer            *peer,
+                                       const EvdPeerStats *stats,
+                                       gpointer            user_data);
+
 struct _EvdPeerManager
 {
   GObject parent;
@@ -84,6 +88,31 @@ void                evd_peer_manager_close_peer               (EvdPeerManager *s
                                                                EvdPeer        *peer,
                                                                gboolean        gracefully);
 
+void                evd_peer_manager_foreach_stats            (EvdPeerManager   *self,
+                                                               EvdPeerStatsFunc  func,
+                                                               gpointer          user_data);
+
+gboolean            evd_peer_manager_join_group               (EvdPeerManager *self,
+                                                               EvdPeer        *peer,
+                                                               const gchar    *group);
+gboolean            evd_peer_manager_leave_group              (EvdPeerManager *self,
+                                                               EvdPeer        *peer,
+                                                               const gchar    *group);
+gboolean            evd_peer_manager_is_in_group              (EvdPeerManager *self,
+                                                               EvdPeer        *peer,
+                                                               const gchar    *group);
+guint               evd_peer_manager_get_group_size           (EvdPeerManager *self,
+                                                               const gchar    *group);
+GList              *evd_peer_manager_get_group_peers          (EvdPeerManager *self,
+                                                               const gchar    *group);
+
+guint               evd_peer_manager_send_to_group            (EvdPeerManager  *self,
+                                                               const gchar     *group,
+                                                               const gchar     *buffer,
+                                                               gsize            size,
+                                                               EvdMessageType   type,
+                                                               EvdPeer         *exclude);
+
 G_END_DECLS
 
 #endif /* __EVD_PEER_MANAGER_H__ */
@@ -26,6 +26,7 @@
 
 #include "evd-transport.h"
 #include "evd-utils.h"
+#include "evd-metrics.h"
 
 G_DEFINE_TYPE (EvdPeer, evd_peer, G_TYPE_OBJECT)
 
@@ -48,6 +49,8 @@ struct _EvdPeerPrivate
   guint timeout_interval;
 
   EvdTransport *transport;
+
+  EvdPeerStats stats;
 };
 
 typedef struct
@@ -55,8 +58,11 @@ typedef struct
   EvdMessageType type;
   gsize len;
   gchar *buf;
+  GByteArray *shared;
 } BacklogFrame;
 
+static EvdMetric *metric_backlog = NULL;
+
 /* properties */
 enum
 {
@@ -98,7 +104,7 @@ evd_peer_class_init (EvdPeerClass *class)
                                                         "Peer's UUID",
                                                         "A string representing the UUID of the peer",
                                                         NULL,
-                                                        G_PARAM_READABLE |
+                                                        G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY |
                                                         G_PARAM_STATIC_STRINGS));
 
   g_object_class_install_property (obj_class, PROP_TRANSPORT,
@@ -129,6 +135,8 @@ evd_peer_init (EvdPeer *self)
   priv->idle_timer = g_timer_new ();
   priv->timeout_interval = DEFAULT_TIMEOUT_INTERVAL;
 
+  memset (&priv->stats, 0, sizeof (EvdPeerStats));
+
   self->priv->id = evd_uuid_new ();
 }
 
@@ -175,6 +183,15 @@ evd_peer_set_property (GObject      *obj,
 
   switch (prop_id)
     {
+    case PROP_ID:
+      /* peers living in another process keep their id, see EvdPeerCluster */
+      if (g_value_get_string (value) != NULL)
+        {
+          g_free (self->priv->id);
+          self->priv->id = g_value_dup_string (value);
+        }
+      break;
+
     case PROP_TRANSPORT:
       self->priv->transport = EVD_TRANSPORT (g_value_dup_object (value));
       break;
@@ -219,25 +236,60 @@ free_backlog_frame (gpointer data, gpointer user_data)
   if (frame->buf != NULL)
     g_free (frame->buf);
 
+  if (frame->shared != NULL)
+    g_byte_array_unref (frame->shared);
+
   g_slice_free (BacklogFrame, frame);
+
+  evd_metric_add (metric_backlog, -1);
 }
 
 static BacklogFrame *
-create_new_backlog_frame (const gchar *message, gsize size, EvdMessageType type)
+create_new_backlog_frame (const gchar    *message,
+                          gsize           size,
+                          GByteArray     *shared,
+                          EvdMessageType  type)
 {
   BacklogFrame *frame;
 
   frame = g_slice_new0 (BacklogFrame);
   frame->type = type;
-  frame->len = size;
 
-  frame->buf = g_new (gchar, size + 1);
-  memcpy (frame->buf, message, size);
-  frame->buf[size] = '\0';
+  if (shared != NULL)
+    {
+      /* copied only when popped, if ever */
+      frame->shared = g_byte_array_ref (shared);
+      frame->len = shared->len;
+    }
+  else
+    {
+      frame->len = size;
+
+      frame->buf = g_new (gchar, size + 1);
+      memcpy (frame->buf, message, size);
+      frame->buf[size] = '\0';
+    }
+
+  evd_metric_add (EVD_METRIC (metric_backlog,
+                              "evd_peer_backlog_messages",
+                              EVD_METRIC_GAUGE,
+                              "Messages queued in peer backlogs"),
+                  1);
 
   return frame;
 }
 
+static void
+evd_peer_backlog_grow (EvdPeer *self, BacklogFrame *frame)
+{
+  EvdPeerStats *stats = &self->priv->stats;
+
+  stats->backlog_size += frame->len;
+
+  if (g_queue_get_length (self->priv->backlog) > stats->backlog_high_water)
+    stats->backlog_high_water = g_queue_get_length (self->priv->backlog);
+}
+
 /* public methods */
 
 const gchar *
@@ -308,6 +360,7 @@ evd_peer_touch (EvdPeer *self)
   g_return_if_fail (EVD_IS_PEER (self));
 
   g_timer_start (self->priv->idle_timer);
+  self->priv->stats.last_activity = g_get_monotonic_time ();
 }
 
 gboolean
@@ -396,9 +449,43 @@ evd_peer_push_message (EvdPeer         *self,
 
   /* TODO: check backlog limits here */
 
-  frame = create_new_backlog_frame (message, size, type);
+  frame = create_new_backlog_frame (message, size, NULL, type);
 
   g_queue_push_tail (self->priv->backlog, frame);
+  evd_peer_backlog_grow (self, frame);
+
+  return TRUE;
+}
+
+/**
+ * evd_peer_push_shared_message:
+ * @message: the payload, which must not be modified afterwards
+ *
+ * Like evd_peer_push_message(), but the backlog keeps a reference to
+ * @message instead of a copy. Useful when the same message is queued to
+ * many peers.
+ *
+ * Returns:
+ *
+ * Since: 0.2.0
+ **/
+gboolean
+evd_peer_push_shared_message (EvdPeer         *self,
+                              GByteArray      *message,
+                              EvdMessageType   type,
+                              GError         **error)
+{
+  BacklogFrame *frame;
+
+  g_return_val_if_fail (EVD_IS_PEER (self), FALSE);
+  g_return_val_if_fail (message != NULL, FALSE);
+
+  /* TODO: check backlog limits here */
+
+  frame = create_new_backlog_frame (NULL, 0, message, type);
+
+  g_queue_push_tail (self->priv->backlog, frame);
+  evd_peer_backlog_grow (self, frame);
 
   return TRUE;
 }
@@ -427,9 +514,10 @@ evd_peer_unshift_message (EvdPeer         *self,
 
   /* TODO: check backlog limits here */
 
-  frame = create_new_backlog_frame (message, size, type);
+  frame = create_new_backlog_frame (message, size, NULL, type);
 
   g_queue_push_head (self->priv->backlog, frame);
+  evd_peer_backlog_grow (self, frame);
 
   return TRUE;
 }
@@ -456,7 +544,18 @@ evd_peer_pop_message (EvdPeer *self, gsize *size, EvdMessageType *type)
     {
       gchar *str;
 
-      str = frame->buf;
+      if (frame->shared != NULL)
+        {
+          str = g_new (gchar, frame->len + 1);
+          memcpy (str, frame->shared->data, frame->len);
+          str[frame->len] = '\0';
+
+          g_byte_array_unref (frame->shared);
+        }
+      else
+        {
+          str = frame->buf;
+        }
 
       if (size != NULL)
         *size = frame->len;
@@ -464,8 +563,12 @@ evd_peer_pop_message (EvdPeer *self, gsize *size, EvdMessageType *type)
       if (type != NULL)
         *type = frame->type;
 
+      self->priv->stats.backlog_size -= frame->len;
+
       g_slice_free (BacklogFrame, frame);
 
+      evd_metric_add (metric_backlog, -1);
+
       return str;
     }
   else
@@ -473,3 +576,44 @@ evd_peer_pop_message (EvdPeer *self, gsize *size, EvdMessageType *type)
       return NULL;
     }
 }
+
+/**
+ * evd_peer_get_stats:
+ * @stats: (out caller-allocates): an #EvdPeerStats to fill
+ *
+ * Takes a snapshot of the message counters of the peer.
+ *
+ * Since: 0.2.0
+ **/
+void
+evd_peer_get_stats (EvdPeer *self, EvdPeerStats *stats)
+{
+  g_return_if_fail (EVD_IS_PEER (self));
+  g_return_if_fail (stats != NULL);
+
+  *stats = self->priv->stats;
+  stats->backlog_length = g_queue_get_length (self->priv->backlog);
+}
+
+/* called by EvdTransport for every message a peer sends or receives */
+void
+evd_peer_count_message (EvdPeer *self, gsize size, gboolean received)
+{
+  EvdPeerStats *stats;
+
+  g_return_if_fail (EVD_IS_PEER (self));
+
+  stats = &self->priv->stats;
+
+  if (received)
+    {
+      stats->messages_received++;
+      stats->bytes_received += size;
+      stats->last_activity = g_get_monotonic_time ();
+    }
+  else
+    {
+      stats->messages_sent++;
+      stats->bytes_sent += size;
+    }
+}
@@ -40,6 +40,7 @@ typedef enum
 typedef struct _EvdPeer EvdPeer;
 typedef struct _EvdPeerClass EvdPeerClass;
 typedef struct _EvdPeerPrivate EvdPeerPrivate;
+typedef struct _EvdPeerStats EvdPeerStats;
 
 struct _EvdPeer
 {
@@ -63,6 +64,34 @@ struct _EvdPeerClass
   void (* _padding_7_) (void);
 };
 
+/**
+ * EvdPeerStats:
+ * @messages_received: messages received from the peer
+ * @messages_sent: messages sent to the peer, delivered or queued
+ * @bytes_received: payload bytes received from the peer
+ * @bytes_sent: payload bytes sent to the peer
+ * @backlog_length: messages currently queued in the backlog
+ * @backlog_size: payload bytes currently queued in the backlog
+ * @backlog_high_water: the longest the backlog has been, in messages
+ * @last_activity: monotonic time the peer was last seen, or 0
+ *
+ * A snapshot of the message traffic of an #EvdPeer, filled by
+ * evd_peer_get_stats().
+ **/
+struct _EvdPeerStats
+{
+  guint64 messages_received;
+  guint64 messages_sent;
+  guint64 bytes_received;
+  guint64 bytes_sent;
+
+  guint backlog_length;
+  gsize backlog_size;
+  guint backlog_high_water;
+
+  gint64 last_activity;
+};
+
 #define EVD_TYPE_PEER           (evd_peer_get_type ())
 #define EVD_PEER(obj)           (G_TYPE_CHECK_INSTANCE_CAST ((obj), EVD_TYPE_PEER, EvdPeer))
 #define EVD_PEER_CLASS(obj)     (G_TYPE_CHECK_CLASS_CAST ((obj), EVD_TYPE_PEER, EvdPeerClass))
@@ -107,6 +136,10 @@ gboolean          evd_peer_push_message            (EvdPeer         *self,
                                                     gsize            size,
                                                     EvdMessageType   type,
                                                     GError         **error);
+gboolean          evd_peer_push_shared_message     (EvdPeer         *self,
+                                                    GByteArray      *message,
+                                                    EvdMessageType   type,
+                                                    GError         **error);
 gchar *           evd_peer_pop_message             (EvdPeer        *self,
                                                     gsize          *size,
                                                     EvdMessageType *type);
@@ -116,6 +149,9 @@ gboolean          evd_peer_unshift_message         (EvdPeer         *self,
                                                     EvdMessageType   type,
                                                     GError         **error);
 
+void              evd_peer_get_stats               (EvdPeer      *self,
+                                                    EvdPeerStats *stats);
+
 G_END_DECLS
 
 #endif /* __EVD_PEER_H__ */
@@ -0,0 +1,294 @@
+/*
+ * evd-pki-batch.c
+ *
+ * EventDance, Peer-to-peer IPC library <http://eventdance.org>
+ *
+ * Copyright (C) 2026, the EventDance contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 3, or (at your option) any later version as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License at http://www.gnu.org/licenses/lgpl-3.0.txt
+ * for more details.
+ */
+
+#include <string.h>
+
+#include "evd-pki-batch.h"
+
+#include "evd-error.h"
+#include "evd-tls-common.h"
+
+/* used when the worker pool has no thread limit */
+#define DEFAULT_MAX_CHUNKS 4
+
+struct _EvdPkiBatch
+{
+  guint n_items;
+
+  gnutls_datum_t *inputs;
+  gnutls_datum_t *extras;
+  gnutls_datum_t *outputs;
+  gint *results;
+
+  gpointer key;
+  EvdPkiBatchFunc func;
+
+  guint pending_chunks;
+  gint cancelled;
+};
+
+typedef struct
+{
+  EvdPkiBatch *batch;
+  guint first;
+  guint last;
+} EvdPkiBatchChunk;
+
+static void
+evd_pki_batch_free_chunk (gpointer data)
+{
+  g_slice_free (EvdPkiBatchChunk, data);
+}
+
+static void
+evd_pki_batch_chunk_thread (GSimpleAsyncResult *res,
+                            GObject            *object,
+                            GCancellable       *cancellable)
+{
+  EvdPkiBatchChunk *chunk;
+  EvdPkiBatch *batch;
+  guint i;
+
+  chunk = g_simple_async_result_get_op_res_gpointer (res);
+  batch = chunk->batch;
+
+  for (i = chunk->first; i < chunk->last; i++)
+    {
+      if (g_cancellable_is_cancelled (cancellable))
+        {
+          g_atomic_int_set (&batch->cancelled, 1);
+          break;
+        }
+
+      batch->results[i] =
+        batch->func (batch->key,
+                     &batch->inputs[i],
+                     batch->extras != NULL ? &batch->extras[i] : NULL,
+                     &batch->outputs[i]);
+    }
+}
+
+static void
+evd_pki_batch_on_chunk_done (GObject      *obj,
+                             GAsyncResult *res,
+                             gpointer      user_data)
+{
+  GSimpleAsyncResult *result = G_SIMPLE_ASYNC_RESULT (user_data);
+  EvdPkiBatch *batch;
+
+  batch = g_simple_async_result_get_op_res_gpointer (result);
+
+  batch->pending_chunks--;
+  if (batch->pending_chunks > 0)
+    return;
+
+  if (batch->cancelled)
+    g_simple_async_result_set_error (result,
+                                     G_IO_ERROR,
+                                     G_IO_ERROR_CANCELLED,
+                                     "Operation was cancelled");
+
+  g_simple_async_result_complete (result);
+  g_object_unref (result);
+}
+
+/* internal API */
+
+EvdPkiBatch *
+evd_pki_batch_new (const gchar * const *inputs,
+                   const gsize         *input_sizes,
+                   const gchar * const *extras,
+                   const gsize         *extra_sizes,
+                   guint                n_items)
+{
+  EvdPkiBatch *batch;
+  guint i;
+
+  batch = g_slice_new0 (EvdPkiBatch);
+
+  batch->n_items = n_items;
+  batch->inputs = g_new (gnutls_datum_t, n_items);
+  batch->outputs = g_new0 (gnutls_datum_t, n_items);
+  batch->results = g_new0 (gint, n_items);
+
+  /* data is borrowed, callers keep it alive until the batch completes */
+  for (i = 0; i < n_items; i++)
+    {
+      batch->inputs[i].data = (guchar *) inputs[i];
+      batch->inputs[i].size = input_sizes[i];
+    }
+
+  if (extras != NULL)
+    {
+      batch->extras = g_new (gnutls_datum_t, n_items);
+
+      for (i = 0; i < n_items; i++)
+        {
+          batch->extras[i].data = (guchar *) extras[i];
+          batch->extras[i].size = extra_sizes[i];
+        }
+    }
+
+  return batch;
+}
+
+void
+evd_pki_batch_free (gpointer data)
+{
+  EvdPkiBatch *batch = data;
+  guint i;
+
+  for (i = 0; i < batch->n_items; i++)
+    if (batch->outputs[i].data != NULL)
+      gnutls_free (batch->outputs[i].data);
+
+  g_free (batch->inputs);
+  g_free (batch->extras);
+  g_free (batch->outputs);
+  g_free (batch->results);
+
+  g_slice_free (EvdPkiBatch, batch);
+}
+
+/*
+ * Splits @batch in as many chunks as worker threads are available and runs
+ * them in the TLS worker pool. @result takes ownership of @batch and is
+ * completed once all chunks are done. The caller's reference on @result is
+ * consumed.
+ */
+void
+evd_pki_batch_run (EvdPkiBatch        *batch,
+                   GSimpleAsyncResult *result,
+                   GObject            *object,
+                   gpointer            key,
+                   EvdPkiBatchFunc     func,
+                   GCancellable       *cancellable)
+{
+  gint max_chunks;
+  guint n_chunks;
+  guint chunk_size;
+  guint first;
+
+  batch->key = key;
+  batch->func = func;
+
+  g_simple_async_result_set_op_res_gpointer (result, batch, evd_pki_batch_free);
+
+  if (batch->n_items == 0)
+    {
+      g_simple_async_result_complete_in_idle (result);
+      g_object_unref (result);
+      return;
+    }
+
+  max_chunks = evd_tls_get_max_worker_threads ();
+  if (max_chunks <= 0)
+    max_chunks = DEFAULT_MAX_CHUNKS;
+
+  n_chunks = MIN (batch->n_items, (guint) max_chunks);
+  chunk_size = (batch->n_items + n_chunks - 1) / n_chunks;
+
+  batch->pending_chunks = 0;
+  for (first = 0; first < batch->n_items; first += chunk_size)
+    batch->pending_chunks++;
+
+  for (first = 0; first < batch->n_items; first += chunk_size)
+    {
+      GSimpleAsyncResult *res;
+      EvdPkiBatchChunk *chunk;
+
+      chunk = g_slice_new (EvdPkiBatchChunk);
+      chunk->batch = batch;
+      chunk->first = first;
+      chunk->last = MIN (first + chunk_size, batch->n_items);
+
+      res = g_simple_async_result_new (object,
+                                       evd_pki_batch_on_chunk_done,
+                                       result,
+                                       evd_pki_batch_run);
+      g_simple_async_result_set_op_res_gpointer (res,
+                                                 chunk,
+                                                 evd_pki_batch_free_chunk);
+
+      evd_tls_run_in_worker_thread (res,
+                                    evd_pki_batch_chunk_thread,
+                                    object,
+                                    cancellable);
+      g_object_unref (res);
+    }
+}
+
+/* propagates the error of the first failed item, if any */
+gboolean
+evd_pki_batch_propagate_error (EvdPkiBatch  *batch,
+                               GError      **error)
+{
+  guint i;
+
+  for (i = 0; i < batch->n_items; i++)
+    if (evd_error_propagate_gnutls (batch->results[i], error))
+      return TRUE;
+
+  return FALSE;
+}
+
+gchar **
+evd_pki_batch_steal_outputs (EvdPkiBatch  *batch,
+                             gsize       **sizes)
+{
+  gchar **outputs;
+  guint i;
+
+  outputs = g_new (gchar *, batch->n_items + 1);
+  if (sizes != NULL)
+    *sizes = g_new (gsize, batch->n_items);
+
+  /* outputs were allocated by GnuTLS and must be released with
+     gnutls_free(), so hand out GLib copies (nul-terminated for
+     convenience) that callers can free with g_strfreev() */
+  for (i = 0; i < batch->n_items; i++)
+    {
+      gsize size = batch->outputs[i].size;
+
+      outputs[i] = g_malloc (size + 1);
+      if (size > 0)
+        memcpy (outputs[i], batch->outputs[i].data, size);
+      outputs[i][size] = '\0';
+
+      if (sizes != NULL)
+        (*sizes)[i] = size;
+
+      if (batch->outputs[i].data != NULL)
+        gnutls_free (batch->outputs[i].data);
+      batch->outputs[i].data = NULL;
+      batch->outputs[i].size = 0;
+    }
+  outputs[batch->n_items] = NULL;
+
+  return outputs;
+}
+
+gint *
+evd_pki_batch_get_results (EvdPkiBatch *batch, guint *n_items)
+{
+  if (n_items != NULL)
+    *n_items = batch->n_items;
+
+  return batch->results;
+}
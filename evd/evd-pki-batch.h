@@ -0,0 +1,60 @@
+/*
+ * evd-pki-batch.h
+ *
+ * EventDance, Peer-to-peer IPC library <http://eventdance.org>
+ *
+ * Copyright (C) 2026, the EventDance contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 3, or (at your option) any later version as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License at http://www.gnu.org/licenses/lgpl-3.0.txt
+ * for more details.
+ */
+
+#ifndef __EVD_PKI_BATCH_H__
+#define __EVD_PKI_BATCH_H__
+
+#include <gio/gio.h>
+#include <gnutls/gnutls.h>
+
+G_BEGIN_DECLS
+
+typedef struct _EvdPkiBatch EvdPkiBatch;
+
+/* runs in a worker thread, once per item */
+typedef gint (* EvdPkiBatchFunc) (gpointer              key,
+                                  const gnutls_datum_t *input,
+                                  const gnutls_datum_t *extra,
+                                  gnutls_datum_t       *output);
+
+EvdPkiBatch *evd_pki_batch_new               (const gchar * const *inputs,
+                                              const gsize         *input_sizes,
+                                              const gchar * const *extras,
+                                              const gsize         *extra_sizes,
+                                              guint                n_items);
+void         evd_pki_batch_free              (gpointer data);
+
+void         evd_pki_batch_run               (EvdPkiBatch        *batch,
+                                              GSimpleAsyncResult *result,
+                                              GObject            *object,
+                                              gpointer            key,
+                                              EvdPkiBatchFunc     func,
+                                              GCancellable       *cancellable);
+
+gboolean     evd_pki_batch_propagate_error   (EvdPkiBatch  *batch,
+                                              GError      **error);
+
+gchar      **evd_pki_batch_steal_outputs     (EvdPkiBatch  *batch,
+                                              gsize       **sizes);
+gint        *evd_pki_batch_get_results       (EvdPkiBatch  *batch,
+                                              guint        *n_items);
+
+G_END_DECLS
+
+#endif /* __EVD_PKI_BATCH_H__ */
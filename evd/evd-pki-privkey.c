@@ -25,6 +25,8 @@
 #include "evd-pki-privkey.h"
 
 #include "evd-error.h"
+#include "evd-tls-common.h"
+#include "evd-pki-batch.h"
 
 G_DEFINE_TYPE (EvdPkiPrivkey, evd_pki_privkey, G_TYPE_OBJECT)
 
@@ -328,11 +330,10 @@ evd_pki_privkey_decrypt (EvdPkiPrivkey       *self,
 
   g_simple_async_result_set_op_res_gpointer (res, dec_data, g_free);
 
-  /* @TODO: use a thread pool to avoid overhead */
-  g_simple_async_result_run_in_thread (res,
-                                       decrypt_in_thread,
-                                       G_PRIORITY_DEFAULT,
-                                       cancellable);
+  evd_tls_run_in_worker_thread (res,
+                                decrypt_in_thread,
+                                G_OBJECT (self),
+                                cancellable);
 }
 
 gchar *
@@ -404,11 +405,10 @@ evd_pki_privkey_sign_data (EvdPkiPrivkey       *self,
 
   g_simple_async_result_set_op_res_gpointer (res, sign_data, g_free);
 
-  /* @TODO: use a thread pool to avoid overhead */
-  g_simple_async_result_run_in_thread (res,
-                                       sign_in_thread,
-                                       G_PRIORITY_DEFAULT,
-                                       cancellable);
+  evd_tls_run_in_worker_thread (res,
+                                sign_in_thread,
+                                G_OBJECT (self),
+                                cancellable);
 }
 
 /**
@@ -445,6 +445,209 @@ evd_pki_privkey_sign_data_finish (EvdPkiPrivkey  *self,
     return NULL;
 }
 
+static gint
+evd_pki_privkey_sign_item (gpointer              key,
+                           const gnutls_datum_t *input,
+                           const gnutls_datum_t *extra,
+                           gnutls_datum_t       *output)
+{
+  return gnutls_privkey_sign_data ((gnutls_privkey_t) key,
+                                   GNUTLS_DIG_SHA256,
+                                   0,
+                                   input,
+                                   output);
+}
+
+static gint
+evd_pki_privkey_decrypt_item (gpointer              key,
+                              const gnutls_datum_t *input,
+                              const gnutls_datum_t *extra,
+                              gnutls_datum_t       *output)
+{
+  return gnutls_privkey_decrypt_data ((gnutls_privkey_t) key,
+                                      0,
+                                      input,
+                                      output);
+}
+
+static void
+evd_pki_privkey_run_batch (EvdPkiPrivkey       *self,
+                           gpointer             source_tag,
+                           EvdPkiBatchFunc      func,
+                           const gchar * const *data,
+                           const gsize         *sizes,
+                           guint                n_items,
+                           GCancellable        *cancellable,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data)
+{
+  GSimpleAsyncResult *res;
+
+  res = g_simple_async_result_new (G_OBJECT (self),
+                                   callback,
+                                   user_data,
+                                   source_tag);
+
+  if (self->priv->key == NULL)
+    {
+      g_simple_async_result_set_error (res,
+                                       G_IO_ERROR,
+                                       G_IO_ERROR_NOT_INITIALIZED,
+                                       "Private key not initialized");
+      g_simple_async_result_complete_in_idle (res);
+      g_object_unref (res);
+      return;
+    }
+
+  evd_pki_batch_run (evd_pki_batch_new (data, sizes, NULL, NULL, n_items),
+                     res,
+                     G_OBJECT (self),
+                     self->priv->key,
+                     func,
+                     cancellable);
+}
+
+static gchar **
+evd_pki_privkey_finish_batch (GAsyncResult  *result,
+                              gsize        **sizes,
+                              GError       **error)
+{
+  GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (result);
+  EvdPkiBatch *batch;
+
+  if (g_simple_async_result_propagate_error (res, error))
+    return NULL;
+
+  batch = g_simple_async_result_get_op_res_gpointer (res);
+  if (evd_pki_batch_propagate_error (batch, error))
+    return NULL;
+
+  return evd_pki_batch_steal_outputs (batch, sizes);
+}
+
+/**
+ * evd_pki_privkey_sign_data_batch:
+ * @self: The #EvdPkiPrivkey
+ * @data: (array length=n_items): The buffers to sign
+ * @sizes: (array length=n_items): The size of each buffer
+ * @n_items: Number of buffers
+ * @cancellable: (allow-none):
+ * @callback: (scope async) (allow-none):
+ * @user_data: (allow-none):
+ *
+ * Signs many buffers in one call, spreading them over the TLS worker pool
+ * (see evd_tls_set_max_worker_threads()). Buffers are not copied and must
+ * stay valid until @callback is called.
+ **/
+void
+evd_pki_privkey_sign_data_batch (EvdPkiPrivkey       *self,
+                                 const gchar * const *data,
+                                 const gsize         *sizes,
+                                 guint                n_items,
+                                 GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data)
+{
+  g_return_if_fail (EVD_IS_PKI_PRIVKEY (self));
+  g_return_if_fail (n_items == 0 || (data != NULL && sizes != NULL));
+
+  evd_pki_privkey_run_batch (self,
+                             evd_pki_privkey_sign_data_batch,
+                             evd_pki_privkey_sign_item,
+                             data,
+                             sizes,
+                             n_items,
+                             cancellable,
+                             callback,
+                             user_data);
+}
+
+/**
+ * evd_pki_privkey_sign_data_batch_finish:
+ * @self: The #EvdPkiPrivkey
+ * @result: The #GAsyncResult
+ * @sizes: (out) (allow-none): Return location for the size of each signature
+ * @error: (allow-none):
+ *
+ * Returns: (transfer full): A %NULL-terminated array with the signatures, in
+ * the same order as the input buffers, or %NULL if any of them failed.
+ **/
+gchar **
+evd_pki_privkey_sign_data_batch_finish (EvdPkiPrivkey  *self,
+                                        GAsyncResult   *result,
+                                        gsize         **sizes,
+                                        GError        **error)
+{
+  g_return_val_if_fail (EVD_IS_PKI_PRIVKEY (self), NULL);
+  g_return_val_if_fail (g_simple_async_result_is_valid (result,
+                                               G_OBJECT (self),
+                                               evd_pki_privkey_sign_data_batch),
+                        NULL);
+
+  return evd_pki_privkey_finish_batch (result, sizes, error);
+}
+
+/**
+ * evd_pki_privkey_decrypt_batch:
+ * @self: The #EvdPkiPrivkey
+ * @data: (array length=n_items): The buffers to decrypt
+ * @sizes: (array length=n_items): The size of each buffer
+ * @n_items: Number of buffers
+ * @cancellable: (allow-none):
+ * @callback: (scope async) (allow-none):
+ * @user_data: (allow-none):
+ *
+ * Batch version of evd_pki_privkey_decrypt(). Buffers are not copied and
+ * must stay valid until @callback is called.
+ **/
+void
+evd_pki_privkey_decrypt_batch (EvdPkiPrivkey       *self,
+                               const gchar * const *data,
+                               const gsize         *sizes,
+                               guint                n_items,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data)
+{
+  g_return_if_fail (EVD_IS_PKI_PRIVKEY (self));
+  g_return_if_fail (n_items == 0 || (data != NULL && sizes != NULL));
+
+  evd_pki_privkey_run_batch (self,
+                             evd_pki_privkey_decrypt_batch,
+                             evd_pki_privkey_decrypt_item,
+                             data,
+                             sizes,
+                             n_items,
+                             cancellable,
+                             callback,
+                             user_data);
+}
+
+/**
+ * evd_pki_privkey_decrypt_batch_finish:
+ * @self: The #EvdPkiPrivkey
+ * @result: The #GAsyncResult
+ * @sizes: (out) (allow-none): Return location for the size of each message
+ * @error: (allow-none):
+ *
+ * Returns: (transfer full): A %NULL-terminated array with the decrypted
+ * messages, in the same order as the input buffers, or %NULL on error.
+ **/
+gchar **
+evd_pki_privkey_decrypt_batch_finish (EvdPkiPrivkey  *self,
+                                      GAsyncResult   *result,
+                                      gsize         **sizes,
+                                      GError        **error)
+{
+  g_return_val_if_fail (EVD_IS_PKI_PRIVKEY (self), NULL);
+  g_return_val_if_fail (g_simple_async_result_is_valid (result,
+                                                 G_OBJECT (self),
+                                                 evd_pki_privkey_decrypt_batch),
+                        NULL);
+
+  return evd_pki_privkey_finish_batch (result, sizes, error);
+}
+
 /**
  * evd_pki_privkey_generate:
  *
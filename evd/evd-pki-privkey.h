@@ -102,6 +102,30 @@ gboolean           evd_pki_privkey_generate_finish         (EvdPkiPrivkey  *self
                                                             GAsyncResult   *result,
                                                             GError        **error);
 
+void               evd_pki_privkey_sign_data_batch         (EvdPkiPrivkey       *self,
+                                                            const gchar * const *data,
+                                                            const gsize         *sizes,
+                                                            guint                n_items,
+                                                            GCancellable        *cancellable,
+                                                            GAsyncReadyCallback  callback,
+                                                            gpointer             user_data);
+gchar **           evd_pki_privkey_sign_data_batch_finish  (EvdPkiPrivkey  *self,
+                                                            GAsyncResult   *result,
+                                                            gsize         **sizes,
+                                                            GError        **error);
+
+void               evd_pki_privkey_decrypt_batch           (EvdPkiPrivkey       *self,
+                                                            const gchar * const *data,
+                                                            const gsize         *sizes,
+                                                            guint                n_items,
+                                                            GCancellable        *cancellable,
+                                                            GAsyncReadyCallback  callback,
+                                                            gpointer             user_data);
+gchar **           evd_pki_privkey_decrypt_batch_finish    (EvdPkiPrivkey  *self,
+                                                            GAsyncResult   *result,
+                                                            gsize         **sizes,
+                                                            GError        **error);
+
 EvdPkiPubkey *     evd_pki_privkey_get_public_key          (EvdPkiPrivkey  *self,
                                                             GError        **error);
 
@@ -25,6 +25,8 @@
 #include "evd-pki-pubkey.h"
 
 #include "evd-error.h"
+#include "evd-tls-common.h"
+#include "evd-pki-batch.h"
 
 G_DEFINE_TYPE (EvdPkiPubkey, evd_pki_pubkey, G_TYPE_OBJECT)
 
@@ -165,6 +167,41 @@ encrypt_in_thread (GSimpleAsyncResult *res,
   g_object_unref (res);
 }
 
+static gint
+evd_pki_pubkey_encrypt_item (gpointer              key,
+                             const gnutls_datum_t *input,
+                             const gnutls_datum_t *extra,
+                             gnutls_datum_t       *output)
+{
+  return gnutls_pubkey_encrypt_data ((gnutls_pubkey_t) key,
+                                     0,
+                                     input,
+                                     output);
+}
+
+static gint
+evd_pki_pubkey_verify_item (gpointer              key,
+                            const gnutls_datum_t *input,
+                            const gnutls_datum_t *extra,
+                            gnutls_datum_t       *output)
+{
+  gnutls_sign_algorithm_t sign_algo;
+
+  switch (gnutls_pubkey_get_pk_algorithm ((gnutls_pubkey_t) key, NULL))
+    {
+    case GNUTLS_PK_RSA: sign_algo = GNUTLS_SIGN_RSA_SHA256; break;
+    case GNUTLS_PK_DSA: sign_algo = GNUTLS_SIGN_DSA_SHA256; break;
+    case GNUTLS_PK_EC:  sign_algo = GNUTLS_SIGN_ECDSA_SHA256; break;
+    default: sign_algo = GNUTLS_SIGN_UNKNOWN;
+    }
+
+  return gnutls_pubkey_verify_data2 ((gnutls_pubkey_t) key,
+                                     sign_algo,
+                                     0,
+                                     input,
+                                     extra);
+}
+
 static void
 verify_in_thread (GSimpleAsyncResult *res,
                   GObject            *object,
@@ -175,24 +212,13 @@ verify_in_thread (GSimpleAsyncResult *res,
   gint err_code;
   GError *error = NULL;
 
-  gnutls_sign_algorithm_t sign_algo;
-
   verify_data = g_simple_async_result_get_op_res_gpointer (res);
 
   /* verify */
-  switch (self->priv->type)
-    {
-    case GNUTLS_PK_RSA: sign_algo = GNUTLS_SIGN_RSA_SHA256; break;
-    case GNUTLS_PK_DSA: sign_algo = GNUTLS_SIGN_DSA_SHA256; break;
-    case GNUTLS_PK_EC:  sign_algo = GNUTLS_SIGN_ECDSA_SHA256; break;
-    default: sign_algo = GNUTLS_SIGN_UNKNOWN;
-    }
-
-  err_code = gnutls_pubkey_verify_data2 (self->priv->key,
-                                         sign_algo,
-                                         0,
+  err_code = evd_pki_pubkey_verify_item (self->priv->key,
                                          &verify_data->data,
-                                         &verify_data->signature);
+                                         &verify_data->signature,
+                                         NULL);
 
   if (err_code < 0 && evd_error_propagate_gnutls (err_code, &error))
     g_simple_async_result_take_error (res, error);
@@ -283,11 +309,10 @@ evd_pki_pubkey_encrypt (EvdPkiPubkey        *self,
 
   g_simple_async_result_set_op_res_gpointer (res, enc_data, g_free);
 
-  /* @TODO: use a thread pool to avoid overhead */
-  g_simple_async_result_run_in_thread (res,
-                                       encrypt_in_thread,
-                                       G_PRIORITY_DEFAULT,
-                                       cancellable);
+  evd_tls_run_in_worker_thread (res,
+                                encrypt_in_thread,
+                                G_OBJECT (self),
+                                cancellable);
 }
 
 gchar *
@@ -365,11 +390,10 @@ evd_pki_pubkey_verify_data (EvdPkiPubkey        *self,
 
   g_simple_async_result_set_op_res_gpointer (res, verify_data, g_free);
 
-  /* @TODO: use a thread pool to avoid overhead */
-  g_simple_async_result_run_in_thread (res,
-                                       verify_in_thread,
-                                       G_PRIORITY_DEFAULT,
-                                       cancellable);
+  evd_tls_run_in_worker_thread (res,
+                                verify_in_thread,
+                                G_OBJECT (self),
+                                cancellable);
 }
 
 /**
@@ -392,3 +416,210 @@ evd_pki_pubkey_verify_data_finish (EvdPkiPubkey  *self,
 
   return ! g_simple_async_result_propagate_error (res, error);
 }
+
+static gboolean
+evd_pki_pubkey_check_key (EvdPkiPubkey *self, GSimpleAsyncResult *res)
+{
+  if (self->priv->key != NULL)
+    return TRUE;
+
+  g_simple_async_result_set_error (res,
+                                   G_IO_ERROR,
+                                   G_IO_ERROR_NOT_INITIALIZED,
+                                   "Public key not initialized");
+  g_simple_async_result_complete_in_idle (res);
+  g_object_unref (res);
+
+  return FALSE;
+}
+
+/**
+ * evd_pki_pubkey_encrypt_batch:
+ * @self: The #EvdPkiPubkey
+ * @data: (array length=n_items): The buffers to encrypt
+ * @sizes: (array length=n_items): The size of each buffer
+ * @n_items: Number of buffers
+ * @cancellable: (allow-none):
+ * @callback: (scope async) (allow-none):
+ * @user_data: (allow-none):
+ *
+ * Encrypts many buffers in one call, spreading them over the TLS worker pool
+ * (see evd_tls_set_max_worker_threads()). Buffers are not copied and must
+ * stay valid until @callback is called.
+ **/
+void
+evd_pki_pubkey_encrypt_batch (EvdPkiPubkey        *self,
+                              const gchar * const *data,
+                              const gsize         *sizes,
+                              guint                n_items,
+                              GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data)
+{
+  GSimpleAsyncResult *res;
+
+  g_return_if_fail (EVD_IS_PKI_PUBKEY (self));
+  g_return_if_fail (n_items == 0 || (data != NULL && sizes != NULL));
+
+  res = g_simple_async_result_new (G_OBJECT (self),
+                                   callback,
+                                   user_data,
+                                   evd_pki_pubkey_encrypt_batch);
+
+  if (! evd_pki_pubkey_check_key (self, res))
+    return;
+
+  evd_pki_batch_run (evd_pki_batch_new (data, sizes, NULL, NULL, n_items),
+                     res,
+                     G_OBJECT (self),
+                     self->priv->key,
+                     evd_pki_pubkey_encrypt_item,
+                     cancellable);
+}
+
+/**
+ * evd_pki_pubkey_encrypt_batch_finish:
+ * @self: The #EvdPkiPubkey
+ * @result: The #GAsyncResult
+ * @sizes: (out) (allow-none): Return location for the size of each buffer
+ * @error: (allow-none):
+ *
+ * Returns: (transfer full): A %NULL-terminated array with the encrypted
+ * buffers, in the same order as the input, or %NULL if any of them failed.
+ **/
+gchar **
+evd_pki_pubkey_encrypt_batch_finish (EvdPkiPubkey  *self,
+                                     GAsyncResult  *result,
+                                     gsize        **sizes,
+                                     GError       **error)
+{
+  GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (result);
+  EvdPkiBatch *batch;
+
+  g_return_val_if_fail (EVD_IS_PKI_PUBKEY (self), NULL);
+  g_return_val_if_fail (g_simple_async_result_is_valid (result,
+                                                  G_OBJECT (self),
+                                                  evd_pki_pubkey_encrypt_batch),
+                        NULL);
+
+  if (g_simple_async_result_propagate_error (res, error))
+    return NULL;
+
+  batch = g_simple_async_result_get_op_res_gpointer (res);
+  if (evd_pki_batch_propagate_error (batch, error))
+    return NULL;
+
+  return evd_pki_batch_steal_outputs (batch, sizes);
+}
+
+/**
+ * evd_pki_pubkey_verify_data_batch:
+ * @self: The #EvdPkiPubkey
+ * @data: (array length=n_items): The signed buffers
+ * @data_sizes: (array length=n_items): The size of each buffer
+ * @signatures: (array length=n_items): The signature of each buffer
+ * @signature_sizes: (array length=n_items): The size of each signature
+ * @n_items: Number of buffers
+ * @cancellable: (allow-none):
+ * @callback: (scope async) (allow-none):
+ * @user_data: (allow-none):
+ *
+ * Batch version of evd_pki_pubkey_verify_data(). Buffers are not copied and
+ * must stay valid until @callback is called.
+ **/
+void
+evd_pki_pubkey_verify_data_batch (EvdPkiPubkey        *self,
+                                  const gchar * const *data,
+                                  const gsize         *data_sizes,
+                                  const gchar * const *signatures,
+                                  const gsize         *signature_sizes,
+                                  guint                n_items,
+                                  GCancellable        *cancellable,
+                                  GAsyncReadyCallback  callback,
+                                  gpointer             user_data)
+{
+  GSimpleAsyncResult *res;
+
+  g_return_if_fail (EVD_IS_PKI_PUBKEY (self));
+  g_return_if_fail (n_items == 0 ||
+                    (data != NULL && data_sizes != NULL &&
+                     signatures != NULL && signature_sizes != NULL));
+
+  res = g_simple_async_result_new (G_OBJECT (self),
+                                   callback,
+                                   user_data,
+                                   evd_pki_pubkey_verify_data_batch);
+
+  if (! evd_pki_pubkey_check_key (self, res))
+    return;
+
+  evd_pki_batch_run (evd_pki_batch_new (data,
+                                        data_sizes,
+                                        signatures,
+                                        signature_sizes,
+                                        n_items),
+                     res,
+                     G_OBJECT (self),
+                     self->priv->key,
+                     evd_pki_pubkey_verify_item,
+                     cancellable);
+}
+
+/**
+ * evd_pki_pubkey_verify_data_batch_finish:
+ * @self: The #EvdPkiPubkey
+ * @result: The #GAsyncResult
+ * @error: (allow-none):
+ *
+ * A signature that doesn't match is not an error, it just yields %FALSE
+ * for that item.
+ *
+ * Returns: (transfer full): An array of booleans telling whether each
+ * signature is valid, in the same order as the input, or %NULL on error.
+ * Free with g_free().
+ **/
+gboolean *
+evd_pki_pubkey_verify_data_batch_finish (EvdPkiPubkey  *self,
+                                         GAsyncResult  *result,
+                                         GError       **error)
+{
+  GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (result);
+  EvdPkiBatch *batch;
+  gboolean *valid;
+  gint *results;
+  guint n_items;
+  guint i;
+
+  g_return_val_if_fail (EVD_IS_PKI_PUBKEY (self), NULL);
+  g_return_val_if_fail (g_simple_async_result_is_valid (result,
+                                              G_OBJECT (self),
+                                              evd_pki_pubkey_verify_data_batch),
+                        NULL);
+
+  if (g_simple_async_result_propagate_error (res, error))
+    return NULL;
+
+  batch = g_simple_async_result_get_op_res_gpointer (res);
+  results = evd_pki_batch_get_results (batch, &n_items);
+
+  valid = g_new (gboolean, n_items);
+  for (i = 0; i < n_items; i++)
+    {
+      if (results[i] >= 0)
+        {
+          valid[i] = TRUE;
+        }
+      else if (results[i] == GNUTLS_E_PK_SIG_VERIFY_FAILED)
+        {
+          valid[i] = FALSE;
+        }
+      else
+        {
+          evd_error_propagate_gnutls (results[i], error);
+          g_free (valid);
+          return NULL;
+        }
+    }
+
+  return valid;
+}
@@ -92,6 +92,31 @@ gboolean           evd_pki_pubkey_verify_data_finish      (EvdPkiPubkey  *self,
                                                            GAsyncResult  *result,
                                                            GError       **error);
 
+void               evd_pki_pubkey_encrypt_batch           (EvdPkiPubkey        *self,
+                                                           const gchar * const *data,
+                                                           const gsize         *sizes,
+                                                           guint                n_items,
+                                                           GCancellable        *cancellable,
+                                                           GAsyncReadyCallback  callback,
+                                                           gpointer             user_data);
+gchar **           evd_pki_pubkey_encrypt_batch_finish    (EvdPkiPubkey  *self,
+                                                           GAsyncResult  *result,
+                                                           gsize        **sizes,
+                                                           GError       **error);
+
+void               evd_pki_pubkey_verify_data_batch       (EvdPkiPubkey        *self,
+                                                           const gchar * const *data,
+                                                           const gsize         *data_sizes,
+                                                           const gchar * const *signatures,
+                                                           const gsize         *signature_sizes,
+                                                           guint                n_items,
+                                                           GCancellable        *cancellable,
+                                                           GAsyncReadyCallback  callback,
+                                                           gpointer             user_data);
+gboolean *         evd_pki_pubkey_verify_data_batch_finish (EvdPkiPubkey  *self,
+                                                            GAsyncResult  *result,
+                                                            GError       **error);
+
 G_END_DECLS
 
 #endif /* __EVD_PKI_PUBKEY_H__ */
@@ -25,13 +25,30 @@
 #include <sys/epoll.h>
 #include <gio/gio.h>
 
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#endif
+
 #include "evd-poll.h"
 
 #include "evd-error.h"
 #include "evd-utils.h"
+#include "evd-metrics.h"
 
 #define DEFAULT_MAX_FDS 1000 /* maximum number of file descriptors to poll */
 
+#define TRACE_ENV_VAR "EVD_POLL_TRACE"
+
+/* USDT probes, for perf/systemtap, they are a nop unless attached:
+     evd:poll_wakeup (nfds, time)
+     evd:dispatch_start (fd, lag)
+     evd:dispatch_end (fd, start_time) */
+#ifdef HAVE_SYS_SDT_H
+#define PROBE2(name, a, b) STAP_PROBE2 (evd, name, a, b)
+#else
+#define PROBE2(name, a, b)
+#endif
+
 G_DEFINE_TYPE (EvdPoll, evd_poll, G_TYPE_OBJECT)
 
 #define EVD_POLL_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), \
@@ -52,6 +69,8 @@ struct _EvdPollPrivate
   gint nr_events;
 
   gint interrupt_fds[2];
+
+  gboolean tracing;
 };
 
 struct _EvdPollSession
@@ -68,6 +87,11 @@ struct _EvdPollSession
   gpointer user_data;
   GDestroyNotify user_data_free_func;
   gint src_id;
+  gint64 ready_time;
+
+  /* per-context histograms, only set when tracing */
+  EvdMetric *trace_lag;
+  EvdMetric *trace_run;
 };
 
 G_LOCK_DEFINE_STATIC (epoll_mutex);
@@ -75,6 +99,13 @@ G_LOCK_DEFINE_STATIC (interrupt_mutex);
 
 static EvdPoll *evd_poll_default = NULL;
 
+static EvdMetric *metric_batch_size = NULL;
+static EvdMetric *metric_dispatch_latency = NULL;
+
+/* labels of the main contexts traced so far, guarded by epoll_mutex */
+static GHashTable *context_labels = NULL;
+static guint context_count = 0;
+
 static void     evd_poll_class_init   (EvdPollClass *class);
 static void     evd_poll_init         (EvdPoll *self);
 static void     evd_poll_finalize     (GObject *obj);
@@ -113,6 +144,8 @@ evd_poll_init (EvdPoll *self)
   priv->max_fds = DEFAULT_MAX_FDS;
 
   priv->main_loop = NULL;
+
+  priv->tracing = g_getenv (TRACE_ENV_VAR) != NULL;
 }
 
 static void
@@ -173,12 +206,51 @@ evd_poll_session_unref (EvdPollSession *session)
     }
 }
 
+/* called with epoll_mutex held */
+static void
+evd_poll_session_trace (EvdPollSession *session)
+{
+  gchar *label;
+
+  if (context_labels == NULL)
+    context_labels = g_hash_table_new_full (g_direct_hash,
+                                            g_direct_equal,
+                                            NULL,
+                                            g_free);
+
+  label = g_hash_table_lookup (context_labels, session->main_context);
+  if (label == NULL)
+    {
+      if (session->main_context == g_main_context_default ())
+        label = g_strdup ("context=\"default\"");
+      else
+        label = g_strdup_printf ("context=\"%u\"", ++context_count);
+
+      g_hash_table_insert (context_labels, session->main_context, label);
+    }
+
+  session->trace_lag =
+    evd_metrics_get_labeled ("evd_poll_context_lag_seconds",
+                             EVD_METRIC_LATENCY,
+                             "Time from epoll_wait() reporting an event to its callback running, per main context",
+                             label);
+  session->trace_run =
+    evd_metrics_get_labeled ("evd_poll_context_callback_seconds",
+                             EVD_METRIC_LATENCY,
+                             "Time spent in poll callbacks, per main context",
+                             label);
+}
+
 static gboolean
 evd_poll_callback_wrapper (gpointer user_data)
 {
   EvdPollSession *session;
   GIOCondition cond_out = 0;
   EvdPollCallback callback = NULL;
+  gint64 ready_time = 0;
+  gint64 start_time;
+  EvdMetric *trace_run = NULL;
+  gint fd;
 
   G_LOCK (epoll_mutex);
 
@@ -189,6 +261,8 @@ evd_poll_callback_wrapper (gpointer user_data)
   if (evd_poll_session_unref (session))
     {
       callback = session->callback;
+      ready_time = session->ready_time;
+      trace_run = session->trace_run;
 
       cond_out = session->cond_out;
 
@@ -198,7 +272,29 @@ evd_poll_callback_wrapper (gpointer user_data)
   G_UNLOCK (epoll_mutex);
 
   if (callback != NULL)
-    callback (session->self, cond_out, session->user_data);
+    {
+      start_time = g_get_monotonic_time ();
+      fd = session->fd;
+
+      evd_metric_observe (EVD_METRIC (metric_dispatch_latency,
+                                      "evd_poll_dispatch_latency_seconds",
+                                      EVD_METRIC_LATENCY,
+                                      "Time from epoll_wait() reporting an event to its callback running"),
+                          start_time - ready_time);
+
+      if (trace_run != NULL)
+        evd_metric_observe (session->trace_lag, start_time - ready_time);
+
+      PROBE2 (dispatch_start, fd, start_time - ready_time);
+
+      /* the callback may drop the last reference to the session */
+      callback (session->self, cond_out, session->user_data);
+
+      PROBE2 (dispatch_end, fd, start_time);
+
+      if (trace_run != NULL)
+        evd_metric_observe (trace_run, g_get_monotonic_time () - start_time);
+    }
 
   return FALSE;
 }
@@ -229,6 +325,7 @@ evd_poll_dispatch (gpointer user_data)
   gint nfds;
   gboolean started;
   struct epoll_event *events;
+  gint64 now;
 
   G_LOCK (interrupt_mutex);
   self->priv->nr_events = epoll_wait (self->priv->epoll_fd,
@@ -237,13 +334,24 @@ evd_poll_dispatch (gpointer user_data)
                                       -1);
   G_UNLOCK (interrupt_mutex);
 
+  now = g_get_monotonic_time ();
+
   G_LOCK (epoll_mutex);
 
   events = self->priv->events;
   nfds = self->priv->nr_events;
 
+  PROBE2 (poll_wakeup, nfds, now);
+
   started = self->priv->started;
 
+  if (nfds > 0)
+    evd_metric_observe (EVD_METRIC (metric_batch_size,
+                                    "evd_poll_batch_size",
+                                    EVD_METRIC_HISTOGRAM,
+                                    "Number of events returned by each epoll_wait()"),
+                        nfds);
+
   if (started && nfds > 0)
     for (i=0; i < nfds; i++)
       {
@@ -281,6 +389,8 @@ evd_poll_dispatch (gpointer user_data)
 
         if (session->src_id == 0)
           {
+            session->ready_time = now;
+
             evd_poll_session_ref (session);
             session->src_id = evd_timeout_add (session->main_context,
                                                0,
@@ -472,6 +582,30 @@ evd_poll_get_default (void)
   return evd_poll_default;
 }
 
+/**
+ * evd_poll_set_tracing:
+ *
+ * Enables or disables recording, per main context, the lag between
+ * epoll_wait() reporting an event and its callback running, and the time
+ * the callback takes. It only affects sessions added afterwards. Tracing
+ * can also be enabled by setting the EVD_POLL_TRACE environment variable.
+ **/
+void
+evd_poll_set_tracing (EvdPoll *self, gboolean tracing)
+{
+  g_return_if_fail (EVD_IS_POLL (self));
+
+  self->priv->tracing = tracing;
+}
+
+gboolean
+evd_poll_get_tracing (EvdPoll *self)
+{
+  g_return_val_if_fail (EVD_IS_POLL (self), FALSE);
+
+  return self->priv->tracing;
+}
+
 /**
  * evd_poll_add:
  *
@@ -518,6 +652,9 @@ evd_poll_add (EvdPoll          *self,
   session->user_data_free_func = user_data_free_func;
   session->src_id = 0;
 
+  if (self->priv->tracing)
+    evd_poll_session_trace (session);
+
   if (! evd_poll_epoll_ctl (self,
                             fd,
                             EPOLL_CTL_ADD,
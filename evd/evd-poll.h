@@ -62,6 +62,10 @@ EvdPoll           *evd_poll_new           (void);
 
 EvdPoll           *evd_poll_get_default   (void);
 
+void               evd_poll_set_tracing   (EvdPoll  *self,
+                                           gboolean  tracing);
+gboolean           evd_poll_get_tracing   (EvdPoll *self);
+
 EvdPollSession    *evd_poll_add           (EvdPoll          *self,
                                            gint              fd,
                                            GIOCondition      condition,
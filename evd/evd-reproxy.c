@@ -20,11 +20,22 @@
  * for more details.
  */
 
+/* for splice() */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
 #include "evd-reproxy.h"
 
 #include "evd-utils.h"
 #include "evd-buffered-input-stream.h"
 #include "evd-connection.h"
+#include "evd-socket.h"
 
 G_DEFINE_TYPE (EvdReproxy, evd_reproxy, EVD_TYPE_SERVICE)
 
@@ -35,11 +46,29 @@ G_DEFINE_TYPE (EvdReproxy, evd_reproxy, EVD_TYPE_SERVICE)
 #define DEFAULT_BACKEND_MIN_CONNS   1
 #define DEFAULT_BACKEND_MAX_CONNS   2
 
+#define DEFAULT_HEALTH_CHECK_INTERVAL     0 /* in miliseconds, disabled */
+#define DEFAULT_HEALTH_CHECK_THRESHOLD    2
+
+/* an ejected backend is probed every 1, 2, 4 ... up to this many intervals */
+#define HEALTH_CHECK_MAX_BACKOFF    32
+
+/* weight of the newest sample in the latency moving average */
+#define LATENCY_EWMA_WEIGHT         0.2
+
+/* points per backend in the consistent hashing ring */
+#define HASH_RING_VNODES            64
+
+/* the copying bridge grows its buffer while reads keep filling it */
 #define BRIDGE_BLOCK_SIZE           8193
+#define BRIDGE_BLOCK_SIZE_MAX     262144
+
+/* most bytes moved by a single splice() call */
+#define SPLICE_CHUNK_SIZE          65536
 
-#define BRIDGE_DATA_KEY "org.eventdance.lib.reproxy.bridge"
+#define BRIDGE_DATA_KEY  "org.eventdance.lib.reproxy.bridge"
+#define BACKEND_DATA_KEY "org.eventdance.lib.reproxy.backend"
 
-typedef struct _EvdReproxySocketData EvdReproxySocketData;
+#define SPLICE_FLAGS (SPLICE_F_MOVE | SPLICE_F_NONBLOCK)
 
 /* private data */
 struct _EvdReproxyPrivate
@@ -50,27 +79,123 @@ struct _EvdReproxyPrivate
   guint backend_max_conns;
   guint backend_min_conns;
 
-  GQueue *conns;
+  EvdReproxyPolicy policy;
+  GArray *hash_ring;
+
+  guint health_check_interval;
+  guint health_check_threshold;
+  guint health_check_src_id;
+
+  gboolean splice;
+
+  gboolean disposed;
 };
 
+typedef struct
+{
+  EvdReproxy *self;
+  EvdConnectionPool *pool;
+  EvdSocket *socket;
+} EvdReproxyProbe;
+
+/* balancing and health state, attached to each backend's pool */
+typedef struct
+{
+  guint outstanding;
+  gdouble latency;
+  gboolean has_latency;
+
+  gboolean healthy;
+  guint failures;
+  guint check_backoff;
+  guint check_skip;
+  EvdReproxyProbe *probe;
+
+  GList *requests;
+} EvdReproxyBackend;
+
+typedef struct
+{
+  EvdReproxy *self;
+  EvdConnection *conn;
+  EvdConnectionPool *pool;
+  GCancellable *cancellable;
+  guint attempts;
+} EvdReproxyRequest;
+
+typedef struct
+{
+  guint32 hash;
+  EvdConnectionPool *pool;
+} EvdReproxyRingPoint;
+
 typedef struct
 {
   EvdConnection *conn;
   gchar *buf;
   gsize size;
+  gsize buf_size;
+  gsize size_allocated;
+
+  EvdConnectionPool *pool;
+  gboolean outstanding;
+  gint64 started;
 } EvdReproxyBridge;
 
+/* a client/backend pair moved through kernel pipes; index 0 is the
+   client and 1 the backend, and pipe[i] carries what conn[i] sent */
+typedef struct
+{
+  EvdConnection *conn[2];
+  EvdSocket *socket[2];
+  gint fd[2];
+  GIOCondition cond[2];
+
+  gint pipe[2][2];
+  gsize pending[2];
+  gboolean eof[2];
+
+  gboolean closed[2];
+
+  EvdConnectionPool *pool;
+  gint64 started;
+} EvdReproxySplice;
+
+/* properties */
+enum
+{
+  PROP_0,
+  PROP_POLICY,
+  PROP_HEALTH_CHECK_INTERVAL,
+  PROP_HEALTH_CHECK_THRESHOLD,
+  PROP_SPLICE
+};
+
 static void     evd_reproxy_class_init            (EvdReproxyClass *class);
 static void     evd_reproxy_init                  (EvdReproxy *self);
 
 static void     evd_reproxy_finalize              (GObject *obj);
 static void     evd_reproxy_dispose               (GObject *obj);
 
+static void     evd_reproxy_set_property          (GObject      *obj,
+                                                   guint         prop_id,
+                                                   const GValue *value,
+                                                   GParamSpec   *pspec);
+static void     evd_reproxy_get_property          (GObject    *obj,
+                                                   guint       prop_id,
+                                                   GValue     *value,
+                                                   GParamSpec *pspec);
+
 static void     evd_reproxy_connection_accepted   (EvdService    *service,
                                                    EvdConnection *conn);
 
 static gboolean evd_reproxy_bridge_read           (gpointer user_data);
 
+static void     evd_reproxy_dispatch              (EvdReproxy        *self,
+                                                   EvdReproxyRequest *req);
+
+static void     evd_reproxy_update_health_check   (EvdReproxy *self);
+
 static void
 evd_reproxy_class_init (EvdReproxyClass *class)
 {
@@ -80,10 +205,50 @@ evd_reproxy_class_init (EvdReproxyClass *class)
   obj_class = G_OBJECT_CLASS (class);
   obj_class->dispose = evd_reproxy_dispose;
   obj_class->finalize = evd_reproxy_finalize;
+  obj_class->get_property = evd_reproxy_get_property;
+  obj_class->set_property = evd_reproxy_set_property;
 
   service_class = EVD_SERVICE_CLASS (class);
   service_class->connection_accepted = evd_reproxy_connection_accepted;
 
+  g_object_class_install_property (obj_class, PROP_POLICY,
+                                   g_param_spec_uint ("policy",
+                                                      "Balancing policy",
+                                                      "The EvdReproxyPolicy used to pick a backend for each new connection",
+                                                      EVD_REPROXY_POLICY_ROUND_ROBIN,
+                                                      EVD_REPROXY_POLICY_CONSISTENT_HASH,
+                                                      EVD_REPROXY_POLICY_ROUND_ROBIN,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_HEALTH_CHECK_INTERVAL,
+                                   g_param_spec_uint ("health-check-interval",
+                                                      "Health check interval",
+                                                      "Miliseconds between active health checks of the backends, 0 to disable",
+                                                      0,
+                                                      G_MAXUINT,
+                                                      DEFAULT_HEALTH_CHECK_INTERVAL,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_HEALTH_CHECK_THRESHOLD,
+                                   g_param_spec_uint ("health-check-threshold",
+                                                      "Health check threshold",
+                                                      "Consecutive failed checks before a backend is ejected",
+                                                      1,
+                                                      G_MAXUINT,
+                                                      DEFAULT_HEALTH_CHECK_THRESHOLD,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_SPLICE,
+                                   g_param_spec_boolean ("splice",
+                                                         "Splice",
+                                                         "Whether to move bytes between plain, unthrottled connections with splice()",
+                                                         TRUE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_STRINGS));
+
   /* add private structure */
   g_type_class_add_private (obj_class, sizeof (EvdReproxyPrivate));
 }
@@ -104,23 +269,72 @@ evd_reproxy_init (EvdReproxy *self)
 
   priv->next_backend_node = NULL;
 
-  priv->conns = g_queue_new ();
+  priv->policy = EVD_REPROXY_POLICY_ROUND_ROBIN;
+  priv->hash_ring = g_array_new (FALSE, FALSE, sizeof (EvdReproxyRingPoint));
+
+  priv->health_check_interval = DEFAULT_HEALTH_CHECK_INTERVAL;
+  priv->health_check_threshold = DEFAULT_HEALTH_CHECK_THRESHOLD;
+  priv->health_check_src_id = 0;
+
+  priv->splice = TRUE;
+
+  priv->disposed = FALSE;
+}
+
+static EvdReproxyBackend *
+evd_reproxy_get_backend_data (EvdConnectionPool *pool)
+{
+  return g_object_get_data (G_OBJECT (pool), BACKEND_DATA_KEY);
 }
 
 static void
-evd_reproxy_free_backend (gpointer data, gpointer user_data)
+evd_reproxy_backend_data_free (gpointer data)
 {
-  EvdConnectionPool *backend = EVD_CONNECTION_POOL (data);
+  EvdReproxyBackend *backend = data;
 
-  g_object_unref (backend);
+  g_slice_free (EvdReproxyBackend, backend);
 }
 
 static void
-evd_reproxy_free_connection (gpointer data, gpointer user_data)
+evd_reproxy_withdraw_requests (EvdConnectionPool *pool)
 {
-  EvdConnection *conn = EVD_CONNECTION (data);
+  EvdReproxyBackend *backend;
+  GList *node;
 
-  g_object_unref (conn);
+  backend = evd_reproxy_get_backend_data (pool);
+
+  /* the cancelled requests come back through the pool callback, that
+     dispatches them again to another backend */
+  node = backend->requests;
+  while (node != NULL)
+    {
+      EvdReproxyRequest *req = node->data;
+
+      node = node->next;
+      g_cancellable_cancel (req->cancellable);
+    }
+}
+
+static void
+evd_reproxy_free_backend (gpointer data, gpointer user_data)
+{
+  EvdConnectionPool *pool = EVD_CONNECTION_POOL (data);
+  EvdReproxyBackend *backend;
+
+  backend = evd_reproxy_get_backend_data (pool);
+  if (backend->probe != NULL)
+    {
+      EvdSocket *socket = g_object_ref (backend->probe->socket);
+
+      /* closing completes the connect synchronously, which drops the
+         probe's reference to the socket */
+      evd_socket_close (socket, NULL);
+      g_object_unref (socket);
+    }
+
+  evd_reproxy_withdraw_requests (pool);
+
+  g_object_unref (pool);
 }
 
 static void
@@ -128,11 +342,20 @@ evd_reproxy_dispose (GObject *obj)
 {
   EvdReproxy *self = EVD_REPROXY (obj);
 
+  self->priv->disposed = TRUE;
+
+  if (self->priv->health_check_src_id != 0)
+    {
+      g_source_remove (self->priv->health_check_src_id);
+      self->priv->health_check_src_id = 0;
+    }
+
   g_list_foreach (self->priv->backends,
                   evd_reproxy_free_backend,
                   NULL);
   g_list_free (self->priv->backends);
   self->priv->backends = NULL;
+  self->priv->next_backend_node = NULL;
 
   G_OBJECT_CLASS (evd_reproxy_parent_class)->dispose (obj);
 }
@@ -142,14 +365,80 @@ evd_reproxy_finalize (GObject *obj)
 {
   EvdReproxy *self = EVD_REPROXY (obj);
 
-  g_queue_foreach (self->priv->conns,
-                   evd_reproxy_free_connection,
-                   NULL);
-  g_queue_free (self->priv->conns);
+  g_array_free (self->priv->hash_ring, TRUE);
 
   G_OBJECT_CLASS (evd_reproxy_parent_class)->finalize (obj);
 }
 
+static void
+evd_reproxy_set_property (GObject      *obj,
+                          guint         prop_id,
+                          const GValue *value,
+                          GParamSpec   *pspec)
+{
+  EvdReproxy *self;
+
+  self = EVD_REPROXY (obj);
+
+  switch (prop_id)
+    {
+    case PROP_POLICY:
+      evd_reproxy_set_policy (self, g_value_get_uint (value));
+      break;
+
+    case PROP_HEALTH_CHECK_INTERVAL:
+      self->priv->health_check_interval = g_value_get_uint (value);
+      evd_reproxy_update_health_check (self);
+      break;
+
+    case PROP_HEALTH_CHECK_THRESHOLD:
+      self->priv->health_check_threshold = g_value_get_uint (value);
+      break;
+
+    case PROP_SPLICE:
+      self->priv->splice = g_value_get_boolean (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+evd_reproxy_get_property (GObject    *obj,
+                          guint       prop_id,
+                          GValue     *value,
+                          GParamSpec *pspec)
+{
+  EvdReproxy *self;
+
+  self = EVD_REPROXY (obj);
+
+  switch (prop_id)
+    {
+    case PROP_POLICY:
+      g_value_set_uint (value, self->priv->policy);
+      break;
+
+    case PROP_HEALTH_CHECK_INTERVAL:
+      g_value_set_uint (value, self->priv->health_check_interval);
+      break;
+
+    case PROP_HEALTH_CHECK_THRESHOLD:
+      g_value_set_uint (value, self->priv->health_check_threshold);
+      break;
+
+    case PROP_SPLICE:
+      g_value_set_boolean (value, self->priv->splice);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
+      break;
+    }
+}
+
 static EvdConnectionPool *
 evd_reproxy_get_backend_from_node (GList *backend_node)
 {
@@ -181,40 +470,437 @@ evd_reproxy_hop_backend (EvdReproxy *self)
                                        self->priv->next_backend_node);
 }
 
-static void
-evd_reproxy_enqueue_connection (EvdReproxy    *self,
-                                EvdConnection *conn)
+static gboolean
+evd_reproxy_backend_is_usable (EvdConnectionPool *pool, gboolean ignore_health)
 {
-  g_object_ref (conn);
-  g_queue_push_tail (self->priv->conns, (gpointer) conn);
+  return ignore_health || evd_reproxy_get_backend_data (pool)->healthy;
+}
+
+static gboolean
+evd_reproxy_has_healthy_backends (EvdReproxy *self)
+{
+  GList *node;
+
+  for (node = self->priv->backends; node != NULL; node = node->next)
+    if (evd_reproxy_get_backend_data (node->data)->healthy)
+      return TRUE;
+
+  return FALSE;
 }
 
 static EvdConnectionPool *
-evd_reproxy_get_backend_with_free_connections (EvdReproxy *self)
+evd_reproxy_select_round_robin (EvdReproxy *self, gboolean ignore_health)
 {
-  EvdConnectionPool *backend;
+  EvdConnectionPool *pool;
+  EvdConnectionPool *fallback = NULL;
   GList *orig_node;
 
-  if (self->priv->next_backend_node == NULL)
-    return NULL;
+  orig_node = self->priv->next_backend_node;
+
+  /* prefer a backend that has a connection ready */
+  do
+    {
+      pool = evd_reproxy_get_backend_from_node (self->priv->next_backend_node);
+      evd_reproxy_hop_backend (self);
+
+      if (evd_reproxy_backend_is_usable (pool, ignore_health))
+        {
+          if (evd_connection_pool_has_free_connections (pool))
+            return pool;
+          else if (fallback == NULL)
+            fallback = pool;
+        }
+    }
+  while (self->priv->next_backend_node != orig_node);
+
+  return fallback;
+}
+
+/* picks the usable backend of lowest cost, scanning from the round-robin
+   position so that ties are spread evenly */
+static EvdConnectionPool *
+evd_reproxy_select_lowest_cost (EvdReproxy *self, gboolean ignore_health)
+{
+  EvdConnectionPool *best = NULL;
+  gdouble best_cost = 0;
+  GList *orig_node;
+  GList *node;
 
   orig_node = self->priv->next_backend_node;
+  node = orig_node;
+  evd_reproxy_hop_backend (self);
 
   do
     {
-      backend =
-        evd_reproxy_get_backend_from_node (self->priv->next_backend_node);
+      EvdConnectionPool *pool;
+      EvdReproxyBackend *backend;
+      gdouble cost;
 
-      if (evd_connection_pool_has_free_connections (backend))
-        return backend;
+      pool = evd_reproxy_get_backend_from_node (node);
+      backend = evd_reproxy_get_backend_data (pool);
+
+      if (self->priv->policy == EVD_REPROXY_POLICY_EWMA_LATENCY)
+        {
+          /* backends without samples yet go first, to get one */
+          if (! backend->has_latency)
+            cost = -1;
+          else
+            cost = backend->latency * (backend->outstanding + 1);
+        }
       else
-        evd_reproxy_hop_backend (self);
+        {
+          cost = backend->outstanding;
+        }
+
+      if (evd_reproxy_backend_is_usable (pool, ignore_health) &&
+          (best == NULL || cost < best_cost))
+        {
+          best = pool;
+          best_cost = cost;
+        }
+
+      node = evd_reproxy_get_next_backend_node (self, node);
+    }
+  while (node != orig_node);
+
+  return best;
+}
+
+/* FNV-1a, with a final avalanche so that close keys spread on the ring */
+static guint32
+evd_reproxy_hash (const gchar *key)
+{
+  guint32 h = 2166136261U;
+
+  while (*key != '\0')
+    {
+      h ^= (guchar) *key;
+      h *= 16777619U;
+      key++;
+    }
+
+  h ^= h >> 16;
+  h *= 0x85ebca6bU;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35U;
+  h ^= h >> 16;
+
+  return h;
+}
+
+static gint
+evd_reproxy_ring_point_compare (gconstpointer a, gconstpointer b)
+{
+  const EvdReproxyRingPoint *p1 = a;
+  const EvdReproxyRingPoint *p2 = b;
+
+  return (p1->hash > p2->hash) - (p1->hash < p2->hash);
+}
+
+static void
+evd_reproxy_rebuild_hash_ring (EvdReproxy *self)
+{
+  GList *node;
+
+  g_array_set_size (self->priv->hash_ring, 0);
+
+  for (node = self->priv->backends; node != NULL; node = node->next)
+    {
+      EvdReproxyRingPoint point;
+      gchar *address;
+      gint i;
+
+      point.pool = EVD_CONNECTION_POOL (node->data);
+      g_object_get (point.pool, "address", &address, NULL);
+
+      for (i = 0; i < HASH_RING_VNODES; i++)
+        {
+          gchar *key;
+
+          key = g_strdup_printf ("%s#%d", address, i);
+          point.hash = evd_reproxy_hash (key);
+          g_free (key);
+
+          g_array_append_val (self->priv->hash_ring, point);
+        }
+
+      g_free (address);
+    }
+
+  g_array_sort (self->priv->hash_ring, evd_reproxy_ring_point_compare);
+}
+
+static EvdConnectionPool *
+evd_reproxy_select_consistent_hash (EvdReproxy    *self,
+                                    EvdConnection *conn,
+                                    gboolean       ignore_health)
+{
+  GArray *ring = self->priv->hash_ring;
+  gchar *addr;
+  guint32 hash;
+  guint lo;
+  guint hi;
+  guint i;
+
+  addr = evd_connection_get_remote_address_as_string (conn, NULL);
+  if (addr == NULL)
+    return evd_reproxy_select_round_robin (self, ignore_health);
+
+  hash = evd_reproxy_hash (addr);
+  g_free (addr);
+
+  /* first point clockwise from the client's hash */
+  lo = 0;
+  hi = ring->len;
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+
+      if (g_array_index (ring, EvdReproxyRingPoint, mid).hash < hash)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  /* if that backend is out, the next one on the ring takes over, so only
+     its clients move */
+  for (i = 0; i < ring->len; i++)
+    {
+      EvdReproxyRingPoint *point;
+
+      point = &g_array_index (ring, EvdReproxyRingPoint, (lo + i) % ring->len);
+      if (evd_reproxy_backend_is_usable (point->pool, ignore_health))
+        return point->pool;
     }
-  while (self->priv->next_backend_node != orig_node);
 
   return NULL;
 }
 
+static EvdConnectionPool *
+evd_reproxy_select_backend (EvdReproxy *self, EvdConnection *conn)
+{
+  gboolean ignore_health;
+
+  if (self->priv->next_backend_node == NULL)
+    return NULL;
+
+  /* if every backend is out, keep trying them rather than dropping
+     all traffic */
+  ignore_health = ! evd_reproxy_has_healthy_backends (self);
+
+  switch (self->priv->policy)
+    {
+    case EVD_REPROXY_POLICY_LEAST_OUTSTANDING:
+    case EVD_REPROXY_POLICY_EWMA_LATENCY:
+      return evd_reproxy_select_lowest_cost (self, ignore_health);
+
+    case EVD_REPROXY_POLICY_CONSISTENT_HASH:
+      return evd_reproxy_select_consistent_hash (self, conn, ignore_health);
+
+    default:
+      return evd_reproxy_select_round_robin (self, ignore_health);
+    }
+}
+
+static void
+evd_reproxy_backend_record_latency (EvdConnectionPool *pool, gint64 latency)
+{
+  EvdReproxyBackend *backend;
+
+  backend = evd_reproxy_get_backend_data (pool);
+
+  if (backend->has_latency)
+    backend->latency += LATENCY_EWMA_WEIGHT * (latency - backend->latency);
+  else
+    backend->latency = latency;
+
+  backend->has_latency = TRUE;
+}
+
+static void
+evd_reproxy_backend_set_healthy (EvdReproxy        *self,
+                                 EvdConnectionPool *pool,
+                                 gboolean           healthy)
+{
+  EvdReproxyBackend *backend;
+
+  backend = evd_reproxy_get_backend_data (pool);
+
+  if (healthy)
+    {
+      backend->failures = 0;
+      backend->check_backoff = 0;
+      backend->check_skip = 0;
+    }
+  else
+    {
+      backend->failures++;
+
+      if (backend->healthy)
+        {
+          if (backend->failures < self->priv->health_check_threshold)
+            return;
+        }
+      else
+        {
+          /* already out, probe it less and less often */
+          backend->check_backoff = CLAMP (backend->check_backoff * 2,
+                                          1,
+                                          HEALTH_CHECK_MAX_BACKOFF);
+          backend->check_skip = backend->check_backoff;
+        }
+    }
+
+  if (backend->healthy == healthy)
+    return;
+
+  backend->healthy = healthy;
+
+  if (healthy)
+    {
+      g_debug ("reproxy backend back in rotation");
+    }
+  else
+    {
+      g_debug ("reproxy backend ejected after %u failed checks",
+               backend->failures);
+
+      backend->check_backoff = 1;
+      backend->check_skip = 1;
+
+      if (evd_reproxy_has_healthy_backends (self))
+        evd_reproxy_withdraw_requests (pool);
+    }
+}
+
+static void
+evd_reproxy_health_check_on_connect (GObject      *obj,
+                                     GAsyncResult *res,
+                                     gpointer      user_data)
+{
+  EvdReproxyProbe *probe = user_data;
+  EvdReproxy *self = probe->self;
+  EvdConnectionPool *pool = probe->pool;
+  EvdReproxyBackend *backend;
+  GIOStream *io_stream;
+  GError *error = NULL;
+
+  io_stream = evd_socket_connect_finish (EVD_SOCKET (obj), res, &error);
+
+  /* a probe that timed out was already accounted as a failure */
+  backend = evd_reproxy_get_backend_data (pool);
+  if (backend->probe == probe)
+    {
+      backend->probe = NULL;
+
+      if (! self->priv->disposed &&
+          g_list_find (self->priv->backends, pool) != NULL)
+        evd_reproxy_backend_set_healthy (self, pool, io_stream != NULL);
+    }
+
+  if (io_stream != NULL)
+    {
+      g_io_stream_close (io_stream, NULL, NULL);
+      g_object_unref (io_stream);
+    }
+  else
+    {
+      g_error_free (error);
+    }
+
+  g_object_unref (obj);
+  g_object_unref (pool);
+  g_object_unref (self);
+  g_slice_free (EvdReproxyProbe, probe);
+}
+
+static void
+evd_reproxy_health_check_backend (EvdReproxy *self, EvdConnectionPool *pool)
+{
+  EvdReproxyBackend *backend;
+  EvdReproxyProbe *probe;
+  EvdSocket *socket;
+  gchar *address;
+
+  backend = evd_reproxy_get_backend_data (pool);
+
+  /* a probe still pending from the last round is a failure by itself.
+     Connecting to a black-holed address may never complete, so the
+     failure is accounted here and the probe's socket closed. */
+  if (backend->probe != NULL)
+    {
+      probe = backend->probe;
+      backend->probe = NULL;
+
+      evd_reproxy_backend_set_healthy (self, pool, FALSE);
+
+      /* the probe releases the socket from within the close */
+      socket = g_object_ref (probe->socket);
+      evd_socket_close (socket, NULL);
+      g_object_unref (socket);
+      return;
+    }
+
+  if (backend->check_skip > 0)
+    {
+      backend->check_skip--;
+      return;
+    }
+
+  g_object_get (pool, "address", &address, NULL);
+
+  probe = g_slice_new (EvdReproxyProbe);
+  probe->self = g_object_ref (self);
+  probe->pool = g_object_ref (pool);
+
+  socket = evd_socket_new ();
+  probe->socket = socket;
+
+  backend->probe = probe;
+
+  evd_socket_connect_to (socket,
+                         address,
+                         NULL,
+                         evd_reproxy_health_check_on_connect,
+                         probe);
+
+  g_free (address);
+}
+
+static gboolean
+evd_reproxy_health_check (gpointer user_data)
+{
+  EvdReproxy *self = EVD_REPROXY (user_data);
+  GList *node;
+
+  for (node = self->priv->backends; node != NULL; node = node->next)
+    evd_reproxy_health_check_backend (self, EVD_CONNECTION_POOL (node->data));
+
+  return TRUE;
+}
+
+static void
+evd_reproxy_update_health_check (EvdReproxy *self)
+{
+  if (self->priv->health_check_src_id != 0)
+    {
+      g_source_remove (self->priv->health_check_src_id);
+      self->priv->health_check_src_id = 0;
+    }
+
+  if (self->priv->health_check_interval > 0 &&
+      self->priv->backends != NULL &&
+      ! self->priv->disposed)
+    {
+      self->priv->health_check_src_id =
+        evd_timeout_add (NULL,
+                         self->priv->health_check_interval,
+                         G_PRIORITY_LOW,
+                         evd_reproxy_health_check,
+                         self);
+    }
+}
+
 static gboolean
 evd_reproxy_bridge_write (gpointer user_data)
 {
@@ -274,8 +960,30 @@ evd_reproxy_bridge_on_read (GObject      *obj,
                                            res,
                                            &error)) > 0)
     {
+      /* time to first byte from the backend feeds its latency average */
+      if (bridge->started > 0)
+        {
+          evd_reproxy_backend_record_latency (bridge->pool,
+                                              g_get_monotonic_time () -
+                                              bridge->started);
+          bridge->started = 0;
+        }
+
       bridge->size = (gsize) size;
 
+      /* a full read means more is waiting, read bigger next time; a
+         mostly empty one gives memory back */
+      if (bridge->size == bridge->buf_size &&
+          bridge->buf_size < BRIDGE_BLOCK_SIZE_MAX)
+        {
+          bridge->buf_size = MIN (bridge->buf_size * 2, BRIDGE_BLOCK_SIZE_MAX);
+        }
+      else if (bridge->size < bridge->buf_size / 4 &&
+               bridge->buf_size > BRIDGE_BLOCK_SIZE)
+        {
+          bridge->buf_size = MAX (bridge->buf_size / 2, BRIDGE_BLOCK_SIZE);
+        }
+
       evd_reproxy_bridge_write (conn0);
     }
   else if (size < 0)
@@ -300,13 +1008,24 @@ evd_reproxy_bridge_read (gpointer user_data)
       stream = g_io_stream_get_input_stream (G_IO_STREAM (conn0));
 
       if (! g_input_stream_has_pending (stream))
-        g_input_stream_read_async (stream,
-                                   bridge->buf,
-                                   BRIDGE_BLOCK_SIZE,
-                                   evd_connection_get_priority (conn0),
-                                   NULL,
-                                   evd_reproxy_bridge_on_read,
-                                   conn0);
+        {
+          /* the buffer is free here, any unwritten tail was unread back
+             into the input stream */
+          if (bridge->buf_size != bridge->size_allocated)
+            {
+              g_free (bridge->buf);
+              bridge->buf = g_new (gchar, bridge->buf_size);
+              bridge->size_allocated = bridge->buf_size;
+            }
+
+          g_input_stream_read_async (stream,
+                                     bridge->buf,
+                                     bridge->buf_size,
+                                     evd_connection_get_priority (conn0),
+                                     NULL,
+                                     evd_reproxy_bridge_on_read,
+                                     conn0);
+        }
     }
   else
     {
@@ -324,9 +1043,11 @@ evd_reproxy_bridge_on_write (EvdConnection *bridge, gpointer user_data)
 }
 
 static void
-evd_reproxy_connection_setup_bridge (EvdReproxy    *self,
-                                     EvdConnection *conn0,
-                                     EvdConnection *conn1)
+evd_reproxy_connection_setup_bridge (EvdReproxy        *self,
+                                     EvdConnection     *conn0,
+                                     EvdConnection     *conn1,
+                                     EvdConnectionPool *pool,
+                                     gboolean           from_backend)
 {
   EvdReproxyBridge *bridge;
 
@@ -336,6 +1057,14 @@ evd_reproxy_connection_setup_bridge (EvdReproxy    *self,
   g_object_ref (conn1);
 
   bridge->buf = g_new (gchar, BRIDGE_BLOCK_SIZE);
+  bridge->buf_size = BRIDGE_BLOCK_SIZE;
+  bridge->size_allocated = BRIDGE_BLOCK_SIZE;
+
+  /* the client side holds the backend's outstanding slot, the backend
+     side measures its latency */
+  bridge->pool = g_object_ref (pool);
+  bridge->outstanding = ! from_backend;
+  bridge->started = from_backend ? g_get_monotonic_time () : 0;
 
   g_object_set_data (G_OBJECT (conn0), BRIDGE_DATA_KEY, bridge);
 
@@ -362,6 +1091,10 @@ evd_reproxy_connection_on_flush (GObject      *obj,
   if (! g_io_stream_is_closed (G_IO_STREAM (conn)))
     g_io_stream_close (G_IO_STREAM (conn), NULL, NULL);
 
+  if (bridge->outstanding)
+    evd_reproxy_get_backend_data (bridge->pool)->outstanding--;
+  g_object_unref (bridge->pool);
+
   g_free (bridge->buf);
   g_free (bridge);
 
@@ -384,67 +1117,406 @@ evd_reproxy_connection_on_close (EvdConnection *conn, gpointer user_data)
                                bridge);
 }
 
+static gboolean
+evd_reproxy_throttle_is_limited (EvdStreamThrottle *throttle)
+{
+  /* a group's limits reach the connection through the throttle's parents */
+  while (throttle != NULL)
+    {
+      gfloat bandwidth;
+      gfloat latency;
+
+      g_object_get (throttle,
+                    "bandwidth", &bandwidth,
+                    "latency", &latency,
+                    NULL);
+
+      if (bandwidth > 0.0 || latency > 0.0)
+        return TRUE;
+
+      throttle = evd_stream_throttle_get_parent (throttle);
+    }
+
+  return FALSE;
+}
+
+/* splice() skips the connection's stream stack, so it is only valid when
+   nothing in that stack transforms or paces the bytes */
+static gboolean
+evd_reproxy_connection_can_splice (EvdConnection *conn)
+{
+  if (evd_connection_get_tls_active (conn))
+    return FALSE;
+
+  if (evd_reproxy_throttle_is_limited (evd_io_stream_get_input_throttle (EVD_IO_STREAM (conn))) ||
+      evd_reproxy_throttle_is_limited (evd_io_stream_get_output_throttle (EVD_IO_STREAM (conn))))
+    return FALSE;
+
+  return G_IS_SOCKET (evd_socket_get_socket (evd_connection_get_socket (conn)));
+}
+
+static void
+evd_reproxy_splice_free (EvdReproxySplice *pair)
+{
+  gint i;
+
+  evd_reproxy_get_backend_data (pair->pool)->outstanding--;
+  g_object_unref (pair->pool);
+
+  for (i = 0; i < 2; i++)
+    {
+      close (pair->pipe[i][0]);
+      close (pair->pipe[i][1]);
+
+      g_object_unref (pair->socket[i]);
+      g_object_unref (pair->conn[i]);
+    }
+
+  g_slice_free (EvdReproxySplice, pair);
+}
+
+static void
+evd_reproxy_splice_on_close (EvdConnection *conn, gpointer user_data)
+{
+  EvdReproxySplice *pair = user_data;
+  gint i;
+
+  i = (conn == pair->conn[0]) ? 0 : 1;
+  if (pair->closed[i])
+    return;
+
+  pair->closed[i] = TRUE;
+  g_signal_handlers_disconnect_by_func (conn,
+                                        evd_reproxy_splice_on_close,
+                                        pair);
+
+  if (pair->closed[1 - i] ||
+      g_io_stream_is_closed (G_IO_STREAM (pair->conn[1 - i])))
+    {
+      evd_reproxy_splice_free (pair);
+    }
+  else
+    {
+      /* the other side's handler runs from here and frees the pair */
+      g_io_stream_close (G_IO_STREAM (pair->conn[1 - i]), NULL, NULL);
+    }
+}
+
+static void
+evd_reproxy_splice_watch (EvdReproxySplice *pair, gint i, GIOCondition cond)
+{
+  pair->cond[i] &= ~cond;
+
+  /* as EvdConnection does when its streams drain, so the next edge from
+     the poll with these bits gets delivered again */
+  evd_socket_watch_condition (pair->socket[i], ~pair->cond[i], NULL);
+}
+
+/* moves what is readable on conn[src] to conn[1 - src] through the pipe,
+   until either side would block; returns FALSE if it closed the pair */
+static gboolean
+evd_reproxy_splice_pump (EvdReproxySplice *pair, gint src)
+{
+  gint dst = 1 - src;
+  gboolean progress;
+
+  do
+    {
+      gssize size;
+
+      progress = FALSE;
+
+      if ((pair->cond[src] & G_IO_IN) > 0 && ! pair->eof[src] &&
+          pair->pending[src] < SPLICE_CHUNK_SIZE)
+        {
+          size = splice (pair->fd[src], NULL,
+                         pair->pipe[src][1], NULL,
+                         SPLICE_CHUNK_SIZE - pair->pending[src],
+                         SPLICE_FLAGS);
+          if (size > 0)
+            {
+              pair->pending[src] += size;
+              progress = TRUE;
+
+              evd_stream_throttle_report (evd_io_stream_get_input_throttle (EVD_IO_STREAM (pair->conn[src])),
+                                          size);
+
+              if (src == 1 && pair->started > 0)
+                {
+                  evd_reproxy_backend_record_latency (pair->pool,
+                                                      g_get_monotonic_time () -
+                                                      pair->started);
+                  pair->started = 0;
+                }
+            }
+          else if (size == 0)
+            {
+              pair->eof[src] = TRUE;
+            }
+          else if (errno == EAGAIN)
+            {
+              evd_reproxy_splice_watch (pair, src, G_IO_IN);
+            }
+          else if (errno != EINTR)
+            {
+              g_debug ("reproxy splice read error: %s", g_strerror (errno));
+              g_io_stream_close (G_IO_STREAM (pair->conn[src]), NULL, NULL);
+              return FALSE;
+            }
+        }
+
+      if ((pair->cond[dst] & G_IO_OUT) > 0 && pair->pending[src] > 0)
+        {
+          size = splice (pair->pipe[src][0], NULL,
+                         pair->fd[dst], NULL,
+                         pair->pending[src],
+                         SPLICE_FLAGS);
+          if (size > 0)
+            {
+              pair->pending[src] -= size;
+              progress = TRUE;
+
+              evd_stream_throttle_report (evd_io_stream_get_output_throttle (EVD_IO_STREAM (pair->conn[dst])),
+                                          size);
+            }
+          else if (size < 0 && errno == EAGAIN)
+            {
+              evd_reproxy_splice_watch (pair, dst, G_IO_OUT);
+            }
+          else if (size < 0 && errno != EINTR)
+            {
+              g_debug ("reproxy splice write error: %s", g_strerror (errno));
+              g_io_stream_close (G_IO_STREAM (pair->conn[dst]), NULL, NULL);
+              return FALSE;
+            }
+        }
+    }
+  while (progress);
+
+  /* close once everything the peer sent before leaving is delivered */
+  if (pair->eof[src] && pair->pending[src] == 0)
+    {
+      g_io_stream_close (G_IO_STREAM (pair->conn[src]), NULL, NULL);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+evd_reproxy_splice_on_condition (EvdSocket    *socket,
+                                 GIOCondition  condition,
+                                 gpointer      user_data)
+{
+  EvdReproxySplice *pair = user_data;
+  gint i;
+
+  i = (socket == pair->socket[0]) ? 0 : 1;
+
+  if (condition & G_IO_ERR)
+    {
+      g_io_stream_close (G_IO_STREAM (pair->conn[i]), NULL, NULL);
+      return;
+    }
+
+  /* a hang-up still leaves data to read, until splice() returns 0 */
+  if (condition & G_IO_HUP)
+    condition |= G_IO_IN;
+
+  pair->cond[i] |= condition;
+
+  if (evd_reproxy_splice_pump (pair, i))
+    evd_reproxy_splice_pump (pair, 1 - i);
+}
+
+static gboolean
+evd_reproxy_connection_setup_splice (EvdReproxy        *self,
+                                     EvdConnection     *conn0,
+                                     EvdConnection     *conn1,
+                                     EvdConnectionPool *pool)
+{
+  EvdReproxySplice *pair;
+  gint i;
+
+  if (! self->priv->splice ||
+      ! evd_reproxy_connection_can_splice (conn0) ||
+      ! evd_reproxy_connection_can_splice (conn1))
+    {
+      return FALSE;
+    }
+
+  pair = g_slice_new0 (EvdReproxySplice);
+
+  if (pipe2 (pair->pipe[0], O_NONBLOCK | O_CLOEXEC) != 0)
+    {
+      g_slice_free (EvdReproxySplice, pair);
+      return FALSE;
+    }
+  if (pipe2 (pair->pipe[1], O_NONBLOCK | O_CLOEXEC) != 0)
+    {
+      close (pair->pipe[0][0]);
+      close (pair->pipe[0][1]);
+      g_slice_free (EvdReproxySplice, pair);
+      return FALSE;
+    }
+
+  pair->conn[0] = g_object_ref (conn0);
+  pair->conn[1] = g_object_ref (conn1);
+
+  pair->pool = g_object_ref (pool);
+  pair->started = g_get_monotonic_time ();
+
+  for (i = 0; i < 2; i++)
+    {
+      pair->socket[i] =
+        g_object_ref (evd_connection_get_socket (pair->conn[i]));
+      pair->fd[i] =
+        g_socket_get_fd (evd_socket_get_socket (pair->socket[i]));
+
+      /* take the socket's readiness away from the connection, whose
+         streams stay idle from now on */
+      pair->cond[i] = evd_socket_get_condition (pair->socket[i]);
+      evd_socket_set_notify_condition_callback (pair->socket[i],
+                                                evd_reproxy_splice_on_condition,
+                                                pair);
+
+      g_signal_connect (pair->conn[i],
+                        "close",
+                        G_CALLBACK (evd_reproxy_splice_on_close),
+                        pair);
+    }
+
+  if (evd_reproxy_splice_pump (pair, 0))
+    evd_reproxy_splice_pump (pair, 1);
+
+  return TRUE;
+}
+
+static void
+evd_reproxy_request_free (EvdReproxyRequest *req)
+{
+  g_object_unref (req->conn);
+  g_object_unref (req->cancellable);
+  g_object_unref (req->self);
+
+  g_slice_free (EvdReproxyRequest, req);
+}
+
 static void
 evd_reproxy_backend_on_connection (GObject      *obj,
                                    GAsyncResult *res,
                                    gpointer      user_data)
 {
-  EvdReproxy *self = EVD_REPROXY (user_data);
+  EvdReproxyRequest *req = user_data;
+  EvdReproxy *self = req->self;
+  EvdConnectionPool *pool = EVD_CONNECTION_POOL (obj);
+  EvdReproxyBackend *backend;
   EvdConnection *conn1;
   GError *error = NULL;
 
-  if ( (conn1 =
-        evd_connection_pool_get_connection_finish (EVD_CONNECTION_POOL (obj),
-                                                   res,
-                                                   &error)) != NULL)
+  backend = evd_reproxy_get_backend_data (pool);
+  backend->requests = g_list_remove (backend->requests, req);
+
+  conn1 = evd_connection_pool_get_connection_finish (pool, res, &error);
+
+  if (conn1 != NULL && g_io_stream_is_closed (G_IO_STREAM (req->conn)))
+    {
+      /* client left while waiting, give the connection back */
+      evd_connection_pool_recycle (pool, conn1);
+      g_object_unref (conn1);
+      backend->outstanding--;
+    }
+  else if (conn1 != NULL)
     {
-      EvdConnection *conn0;
+      EvdConnection *conn0 = req->conn;
+
+      if (evd_reproxy_connection_setup_splice (self, conn0, conn1, pool))
+        {
+          g_object_unref (conn1);
+          evd_reproxy_request_free (req);
+          return;
+        }
 
       g_signal_connect (conn1,
                         "close",
                         G_CALLBACK (evd_reproxy_connection_on_close),
                         self);
 
-      conn0 = g_queue_pop_head (self->priv->conns);
-
       g_signal_connect (conn0,
                         "close",
                         G_CALLBACK (evd_reproxy_connection_on_close),
                         self);
 
-      evd_reproxy_connection_setup_bridge (self, conn0, conn1);
-      evd_reproxy_connection_setup_bridge (self, conn1, conn0);
+      evd_reproxy_connection_setup_bridge (self, conn0, conn1, pool, FALSE);
+      evd_reproxy_connection_setup_bridge (self, conn1, conn0, pool, TRUE);
 
-      g_object_unref (conn0);
+      g_object_unref (conn1);
     }
   else
     {
-      g_debug ("reproxy new conn error: %s", error->message);
+      backend->outstanding--;
+
+      if (! g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_debug ("reproxy new conn error: %s", error->message);
       g_error_free (error);
 
-      /* @TODO: retry, but wisely */
+      /* a request withdrawn from an ejected backend tries the rest */
+      if (! self->priv->disposed &&
+          req->attempts < g_list_length (self->priv->backends) &&
+          ! g_io_stream_is_closed (G_IO_STREAM (req->conn)))
+        {
+          g_object_unref (req->cancellable);
+          req->cancellable = g_cancellable_new ();
+
+          evd_reproxy_dispatch (self, req);
+          return;
+        }
+
+      g_io_stream_close (G_IO_STREAM (req->conn), NULL, NULL);
     }
+
+  evd_reproxy_request_free (req);
 }
 
 static void
-evd_reproxy_connection_accepted (EvdService *service, EvdConnection *conn)
+evd_reproxy_dispatch (EvdReproxy *self, EvdReproxyRequest *req)
 {
-  EvdReproxy *self = EVD_REPROXY (service);
-  EvdConnectionPool *backend;
+  EvdConnectionPool *pool;
+  EvdReproxyBackend *backend;
 
-  backend = evd_reproxy_get_backend_with_free_connections (self);
-  if (backend == NULL)
+  pool = evd_reproxy_select_backend (self, req->conn);
+  if (pool == NULL)
     {
-      backend = evd_reproxy_get_backend_from_node (self->priv->next_backend_node);
-      evd_reproxy_hop_backend (self);
+      g_io_stream_close (G_IO_STREAM (req->conn), NULL, NULL);
+      evd_reproxy_request_free (req);
+      return;
     }
 
-  evd_connection_pool_get_connection (backend,
-                                      NULL,
+  backend = evd_reproxy_get_backend_data (pool);
+  backend->outstanding++;
+  backend->requests = g_list_prepend (backend->requests, req);
+
+  req->pool = pool;
+  req->attempts++;
+
+  evd_connection_pool_get_connection (pool,
+                                      req->cancellable,
                                       evd_reproxy_backend_on_connection,
-                                      self);
+                                      req);
+}
 
-  evd_reproxy_enqueue_connection (self, conn);
+static void
+evd_reproxy_connection_accepted (EvdService *service, EvdConnection *conn)
+{
+  EvdReproxy *self = EVD_REPROXY (service);
+  EvdReproxyRequest *req;
+
+  req = g_slice_new0 (EvdReproxyRequest);
+  req->self = g_object_ref (self);
+  req->conn = g_object_ref (conn);
+  req->cancellable = g_cancellable_new ();
+
+  evd_reproxy_dispatch (self, req);
 }
 
 /* public methods */
@@ -468,26 +1540,92 @@ evd_reproxy_new (void)
 EvdConnectionPool *
 evd_reproxy_add_backend (EvdReproxy *self, const gchar *address)
 {
-  EvdConnectionPool *backend;
+  EvdConnectionPool *pool;
+  EvdReproxyBackend *backend;
 
   g_return_val_if_fail (EVD_IS_REPROXY (self), NULL);
   g_return_val_if_fail (address != NULL, NULL);
 
-  backend = evd_connection_pool_new (address, EVD_TYPE_CONNECTION);
+  pool = evd_connection_pool_new (address, EVD_TYPE_CONNECTION);
+
+  backend = g_slice_new0 (EvdReproxyBackend);
+  backend->healthy = TRUE;
+  g_object_set_data_full (G_OBJECT (pool),
+                          BACKEND_DATA_KEY,
+                          backend,
+                          evd_reproxy_backend_data_free);
 
-  self->priv->backends = g_list_append (self->priv->backends, backend);
+  self->priv->backends = g_list_append (self->priv->backends, pool);
 
   if (self->priv->next_backend_node == NULL)
     self->priv->next_backend_node = self->priv->backends;
 
-  return backend;
+  evd_reproxy_rebuild_hash_ring (self);
+
+  if (self->priv->health_check_src_id == 0)
+    evd_reproxy_update_health_check (self);
+
+  return pool;
 }
 
 void
 evd_reproxy_remove_backend (EvdReproxy *self, EvdConnectionPool *backend)
 {
   g_return_if_fail (EVD_IS_REPROXY (self));
-  g_return_if_fail (EVD_IS_CONNECTION_POOL (self));
+  g_return_if_fail (EVD_IS_CONNECTION_POOL (backend));
+
+  if (g_list_find (self->priv->backends, backend) == NULL)
+    return;
+
+  if (self->priv->next_backend_node != NULL &&
+      self->priv->next_backend_node->data == backend)
+    evd_reproxy_hop_backend (self);
+
+  self->priv->backends = g_list_remove (self->priv->backends, backend);
+
+  if (self->priv->backends == NULL)
+    {
+      self->priv->next_backend_node = NULL;
+      evd_reproxy_update_health_check (self);
+    }
+
+  evd_reproxy_rebuild_hash_ring (self);
+
+  evd_reproxy_free_backend (backend, NULL);
+}
+
+void
+evd_reproxy_set_policy (EvdReproxy *self, EvdReproxyPolicy policy)
+{
+  g_return_if_fail (EVD_IS_REPROXY (self));
+  g_return_if_fail (policy <= EVD_REPROXY_POLICY_CONSISTENT_HASH);
+
+  self->priv->policy = policy;
+}
+
+EvdReproxyPolicy
+evd_reproxy_get_policy (EvdReproxy *self)
+{
+  g_return_val_if_fail (EVD_IS_REPROXY (self), EVD_REPROXY_POLICY_ROUND_ROBIN);
+
+  return self->priv->policy;
+}
+
+/**
+ * evd_reproxy_backend_is_healthy:
+ *
+ * Returns: %FALSE if @backend has been ejected after failing
+ * #EvdReproxy:health-check-threshold consecutive health checks.
+ **/
+gboolean
+evd_reproxy_backend_is_healthy (EvdReproxy        *self,
+                                EvdConnectionPool *backend)
+{
+  g_return_val_if_fail (EVD_IS_REPROXY (self), FALSE);
+  g_return_val_if_fail (EVD_IS_CONNECTION_POOL (backend), FALSE);
+
+  if (g_list_find (self->priv->backends, backend) == NULL)
+    return FALSE;
 
-  self->priv->backends = g_list_remove_all (self->priv->backends, backend);
+  return evd_reproxy_get_backend_data (backend)->healthy;
 }
@@ -32,6 +32,25 @@
 
 G_BEGIN_DECLS
 
+/**
+ * EvdReproxyPolicy:
+ * @EVD_REPROXY_POLICY_ROUND_ROBIN: rotate over backends, preferring those
+ * with an idle connection
+ * @EVD_REPROXY_POLICY_LEAST_OUTSTANDING: the backend with fewest
+ * connections in flight
+ * @EVD_REPROXY_POLICY_EWMA_LATENCY: the backend with the lowest moving
+ * average of time to first byte, weighted by its connections in flight
+ * @EVD_REPROXY_POLICY_CONSISTENT_HASH: a hash of the client address on a
+ * ring of backends, so a client sticks to the same one
+ **/
+typedef enum
+{
+  EVD_REPROXY_POLICY_ROUND_ROBIN,
+  EVD_REPROXY_POLICY_LEAST_OUTSTANDING,
+  EVD_REPROXY_POLICY_EWMA_LATENCY,
+  EVD_REPROXY_POLICY_CONSISTENT_HASH
+} EvdReproxyPolicy;
+
 typedef struct _EvdReproxy EvdReproxy;
 typedef struct _EvdReproxyClass EvdReproxyClass;
 typedef struct _EvdReproxyPrivate EvdReproxyPrivate;
@@ -76,6 +95,13 @@ EvdConnectionPool *evd_reproxy_add_backend       (EvdReproxy  *self,
 void               evd_reproxy_remove_backend    (EvdReproxy        *self,
                                                   EvdConnectionPool *backend);
 
+void               evd_reproxy_set_policy        (EvdReproxy       *self,
+                                                  EvdReproxyPolicy  policy);
+EvdReproxyPolicy   evd_reproxy_get_policy        (EvdReproxy *self);
+
+gboolean           evd_reproxy_backend_is_healthy (EvdReproxy        *self,
+                                                   EvdConnectionPool *backend);
+
 G_END_DECLS
 
 #endif /* __EVD_REPROXY_H__ */
@@ -28,18 +28,79 @@
 
 G_DEFINE_TYPE (EvdResolver, evd_resolver, G_TYPE_OBJECT)
 
+#define EVD_RESOLVER_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), \
+                                       EVD_TYPE_RESOLVER, \
+                                       EvdResolverPrivate))
+
+#define DEFAULT_CACHE_TTL     60 /* in seconds */
+#define DEFAULT_NEGATIVE_TTL   5 /* in seconds */
+#define DEFAULT_CACHE_SIZE  1024
+
+/* a hit within the last 1/REFRESH_AHEAD_RATIO of the TTL of an entry
+   triggers a lookup in background, so that hot names never expire */
+#define REFRESH_AHEAD_RATIO   10
+
+/* private data */
+struct _EvdResolverPrivate
+{
+  GHashTable *cache;
+
+  guint cache_ttl;
+  guint negative_ttl;
+  guint cache_size;
+};
+
+typedef struct
+{
+  gchar *name;
+  GList *addresses;
+  GError *error;
+  gint64 expires;
+  gboolean in_flight;
+  GList *waiters;
+} EvdResolverEntry;
+
 typedef struct
 {
   guint16 port;
   GList *addresses;
   EvdResolver *resolver;
+  gchar *name;
+  GCancellable *cancellable;
+  gulong cancel_id;
 } EvdResolverData;
 
+typedef struct
+{
+  EvdResolver *resolver;
+  gchar *name;
+} EvdResolverLookup;
+
+/* properties */
+enum
+{
+  PROP_0,
+  PROP_CACHE_TTL,
+  PROP_NEGATIVE_TTL,
+  PROP_CACHE_SIZE
+};
+
 static void     evd_resolver_class_init         (EvdResolverClass *class);
 static void     evd_resolver_init               (EvdResolver *self);
 
 static void     evd_resolver_finalize           (GObject *obj);
 
+static void     evd_resolver_set_property       (GObject      *obj,
+                                                 guint         prop_id,
+                                                 const GValue *value,
+                                                 GParamSpec   *pspec);
+static void     evd_resolver_get_property       (GObject    *obj,
+                                                 guint       prop_id,
+                                                 GValue     *value,
+                                                 GParamSpec *pspec);
+
+static void     evd_resolver_entry_free         (gpointer data);
+
 static EvdResolver *evd_resolver_default = NULL;
 
 /**
@@ -66,22 +127,134 @@ evd_resolver_class_init (EvdResolverClass *class)
   obj_class = G_OBJECT_CLASS (class);
 
   obj_class->finalize = evd_resolver_finalize;
+  obj_class->get_property = evd_resolver_get_property;
+  obj_class->set_property = evd_resolver_set_property;
+
+  g_object_class_install_property (obj_class, PROP_CACHE_TTL,
+                                   g_param_spec_uint ("cache-ttl",
+                                                      "Cache TTL",
+                                                      "Seconds a resolved name is served from cache, 0 to disable caching",
+                                                      0,
+                                                      G_MAXUINT,
+                                                      DEFAULT_CACHE_TTL,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_NEGATIVE_TTL,
+                                   g_param_spec_uint ("negative-ttl",
+                                                      "Negative cache TTL",
+                                                      "Seconds a failed resolution is served from cache, 0 to disable negative caching",
+                                                      0,
+                                                      G_MAXUINT,
+                                                      DEFAULT_NEGATIVE_TTL,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_CACHE_SIZE,
+                                   g_param_spec_uint ("cache-size",
+                                                      "Cache size",
+                                                      "Maximum number of names kept in cache",
+                                                      1,
+                                                      G_MAXUINT,
+                                                      DEFAULT_CACHE_SIZE,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  /* add private structure */
+  g_type_class_add_private (obj_class, sizeof (EvdResolverPrivate));
 }
 
 static void
 evd_resolver_init (EvdResolver *self)
 {
+  EvdResolverPrivate *priv;
+
+  priv = EVD_RESOLVER_GET_PRIVATE (self);
+  self->priv = priv;
+
+  priv->cache = g_hash_table_new_full (g_str_hash,
+                                       g_str_equal,
+                                       NULL,
+                                       evd_resolver_entry_free);
+
+  priv->cache_ttl = DEFAULT_CACHE_TTL;
+  priv->negative_ttl = DEFAULT_NEGATIVE_TTL;
+  priv->cache_size = DEFAULT_CACHE_SIZE;
 }
 
 static void
 evd_resolver_finalize (GObject *obj)
 {
+  EvdResolver *self = EVD_RESOLVER (obj);
+
+  g_hash_table_destroy (self->priv->cache);
+
   G_OBJECT_CLASS (evd_resolver_parent_class)->finalize (obj);
 
   if (obj == G_OBJECT (evd_resolver_default))
     evd_resolver_default = NULL;
 }
 
+static void
+evd_resolver_set_property (GObject      *obj,
+                           guint         prop_id,
+                           const GValue *value,
+                           GParamSpec   *pspec)
+{
+  EvdResolver *self;
+
+  self = EVD_RESOLVER (obj);
+
+  switch (prop_id)
+    {
+    case PROP_CACHE_TTL:
+      self->priv->cache_ttl = g_value_get_uint (value);
+      break;
+
+    case PROP_NEGATIVE_TTL:
+      self->priv->negative_ttl = g_value_get_uint (value);
+      break;
+
+    case PROP_CACHE_SIZE:
+      self->priv->cache_size = g_value_get_uint (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+evd_resolver_get_property (GObject    *obj,
+                           guint       prop_id,
+                           GValue     *value,
+                           GParamSpec *pspec)
+{
+  EvdResolver *self;
+
+  self = EVD_RESOLVER (obj);
+
+  switch (prop_id)
+    {
+    case PROP_CACHE_TTL:
+      g_value_set_uint (value, self->priv->cache_ttl);
+      break;
+
+    case PROP_NEGATIVE_TTL:
+      g_value_set_uint (value, self->priv->negative_ttl);
+      break;
+
+    case PROP_CACHE_SIZE:
+      g_value_set_uint (value, self->priv->cache_size);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
+      break;
+    }
+}
+
 static void
 evd_resolver_free_data (gpointer _data)
 {
@@ -95,49 +268,295 @@ evd_resolver_free_data (gpointer _data)
       g_list_free (data->addresses);
     }
 
+  if (data->cancellable != NULL)
+    {
+      if (data->cancel_id != 0)
+        g_cancellable_disconnect (data->cancellable, data->cancel_id);
+      g_object_unref (data->cancellable);
+    }
+
+  g_free (data->name);
+
   g_slice_free (EvdResolverData, data);
 }
 
 static void
-evd_resolver_on_resolver_result (GResolver    *resolver,
-                                 GAsyncResult *async_result,
-                                 gpointer      user_data)
+evd_resolver_entry_free (gpointer data)
+{
+  EvdResolverEntry *entry = (EvdResolverEntry *) data;
+
+  g_free (entry->name);
+
+  if (entry->addresses != NULL)
+    g_resolver_free_addresses (entry->addresses);
+
+  if (entry->error != NULL)
+    g_error_free (entry->error);
+
+  g_slice_free (EvdResolverEntry, entry);
+}
+
+static EvdResolverEntry *
+evd_resolver_entry_new (EvdResolver *self, const gchar *name)
+{
+  EvdResolverEntry *entry;
+
+  if (g_hash_table_size (self->priv->cache) >= self->priv->cache_size)
+    {
+      GHashTableIter iter;
+      gint64 now;
+      gboolean evicted = FALSE;
+
+      /* drop expired names first, or any one if none has expired */
+      now = g_get_monotonic_time ();
+
+      g_hash_table_iter_init (&iter, self->priv->cache);
+      while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+        if (! entry->in_flight && entry->expires <= now)
+          {
+            g_hash_table_iter_remove (&iter);
+            evicted = TRUE;
+          }
+
+      g_hash_table_iter_init (&iter, self->priv->cache);
+      while (! evicted &&
+             g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+        if (! entry->in_flight)
+          {
+            g_hash_table_iter_remove (&iter);
+            evicted = TRUE;
+          }
+    }
+
+  entry = g_slice_new0 (EvdResolverEntry);
+  entry->name = g_strdup (name);
+
+  g_hash_table_insert (self->priv->cache, entry->name, entry);
+
+  return entry;
+}
+
+static void
+evd_resolver_complete_from_entry (GSimpleAsyncResult *res,
+                                  EvdResolverEntry   *entry)
 {
-  GList *result = NULL;
-  GError *error = NULL;
-  GSimpleAsyncResult *res;
   EvdResolverData *data;
 
-  res = G_SIMPLE_ASYNC_RESULT (user_data);
   data = (EvdResolverData *) g_simple_async_result_get_op_res_gpointer (res);
 
-  if ((result = g_resolver_lookup_by_name_finish (resolver,
-						  async_result,
-						  &error)) != NULL)
+  if (data->cancel_id != 0)
+    {
+      g_cancellable_disconnect (data->cancellable, data->cancel_id);
+      data->cancel_id = 0;
+    }
+
+  if (entry->error != NULL)
+    {
+      g_simple_async_result_set_from_error (res, entry->error);
+    }
+  else
     {
-      GList *node = result;
-      GInetAddress *inet_addr;
+      GList *node = entry->addresses;
       GSocketAddress *addr;
 
       while (node != NULL)
         {
-          inet_addr = G_INET_ADDRESS (node->data);
-
-          addr = g_inet_socket_address_new (inet_addr, data->port);
+          addr = g_inet_socket_address_new (G_INET_ADDRESS (node->data),
+                                            data->port);
           data->addresses = g_list_append (data->addresses, addr);
 
           node = node->next;
         }
+    }
+}
 
-      g_resolver_free_addresses (result);
+static void
+evd_resolver_on_resolver_result (GResolver    *resolver,
+                                 GAsyncResult *async_result,
+                                 gpointer      user_data)
+{
+  EvdResolverLookup *lookup = (EvdResolverLookup *) user_data;
+  EvdResolver *self = lookup->resolver;
+  EvdResolverEntry *entry;
+  GList *result;
+  GList *waiters;
+  GError *error = NULL;
+  gint64 now;
+
+  result = g_resolver_lookup_by_name_finish (resolver, async_result, &error);
+
+  entry = g_hash_table_lookup (self->priv->cache, lookup->name);
+  g_assert (entry != NULL);
+
+  entry->in_flight = FALSE;
+  now = g_get_monotonic_time ();
+
+  if (result != NULL)
+    {
+      if (entry->addresses != NULL)
+        g_resolver_free_addresses (entry->addresses);
+      entry->addresses = result;
+
+      if (entry->error != NULL)
+        {
+          g_error_free (entry->error);
+          entry->error = NULL;
+        }
+
+      entry->expires = now + (gint64) self->priv->cache_ttl * G_USEC_PER_SEC;
+    }
+  else if (entry->addresses != NULL && entry->expires > now)
+    {
+      /* a failed refresh keeps serving the addresses we already have
+         until they expire */
+      g_error_free (error);
     }
   else
+    {
+      if (entry->addresses != NULL)
+        {
+          g_resolver_free_addresses (entry->addresses);
+          entry->addresses = NULL;
+        }
+
+      if (entry->error != NULL)
+        g_error_free (entry->error);
+      entry->error = error;
+
+      entry->expires = now + (gint64) self->priv->negative_ttl * G_USEC_PER_SEC;
+    }
+
+  waiters = entry->waiters;
+  entry->waiters = NULL;
+
+  while (waiters != NULL)
+    {
+      GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (waiters->data);
+
+      evd_resolver_complete_from_entry (res, entry);
+
+      g_simple_async_result_complete (res);
+      g_object_unref (res);
+
+      waiters = g_list_delete_link (waiters, waiters);
+    }
+
+  /* the entry may have been refreshed again from a waiter's callback */
+  entry = g_hash_table_lookup (self->priv->cache, lookup->name);
+  if (entry != NULL && ! entry->in_flight && entry->expires <= now)
+    g_hash_table_remove (self->priv->cache, lookup->name);
+
+  g_free (lookup->name);
+  g_slice_free (EvdResolverLookup, lookup);
+
+  g_object_unref (self);
+}
+
+static void
+evd_resolver_lookup (EvdResolver *self, EvdResolverEntry *entry)
+{
+  EvdResolverLookup *lookup;
+  GResolver *resolver;
+
+  entry->in_flight = TRUE;
+
+  lookup = g_slice_new (EvdResolverLookup);
+  lookup->resolver = self;
+  lookup->name = g_strdup (entry->name);
+  g_object_ref (self);
+
+  /* the lookup is shared by all requests waiting on the name, so none
+     of their cancellables is passed on */
+  resolver = g_resolver_get_default ();
+  g_resolver_lookup_by_name_async (resolver,
+                          entry->name,
+                          NULL,
+                          (GAsyncReadyCallback) evd_resolver_on_resolver_result,
+                          lookup);
+  g_object_unref (resolver);
+}
+
+static void
+evd_resolver_on_cancelled (GCancellable *cancellable, gpointer user_data)
+{
+  GSimpleAsyncResult *res = G_SIMPLE_ASYNC_RESULT (user_data);
+  EvdResolverData *data;
+  EvdResolverEntry *entry;
+  GList *node;
+
+  data = (EvdResolverData *) g_simple_async_result_get_op_res_gpointer (res);
+
+  entry = g_hash_table_lookup (data->resolver->priv->cache, data->name);
+  if (entry == NULL || (node = g_list_find (entry->waiters, res)) == NULL)
+    return;
+
+  entry->waiters = g_list_delete_link (entry->waiters, node);
+
+  g_simple_async_result_set_error (res,
+                                   G_IO_ERROR,
+                                   G_IO_ERROR_CANCELLED,
+                                   "Operation was cancelled");
+  g_simple_async_result_complete_in_idle (res);
+  g_object_unref (res);
+}
+
+static void
+evd_resolver_resolve_name (EvdResolver        *self,
+                           GSimpleAsyncResult *res,
+                           GCancellable       *cancellable)
+{
+  EvdResolverData *data;
+  EvdResolverEntry *entry;
+  gint64 now;
+  GError *error = NULL;
+
+  data = (EvdResolverData *) g_simple_async_result_get_op_res_gpointer (res);
+
+  now = g_get_monotonic_time ();
+  entry = g_hash_table_lookup (self->priv->cache, data->name);
+
+  if (entry != NULL && entry->expires > now)
+    {
+      if (entry->error == NULL &&
+          ! entry->in_flight &&
+          entry->expires - now <
+          (gint64) self->priv->cache_ttl * G_USEC_PER_SEC / REFRESH_AHEAD_RATIO)
+        {
+          evd_resolver_lookup (self, entry);
+        }
+
+      evd_resolver_complete_from_entry (res, entry);
+    }
+  else if (g_cancellable_set_error_if_cancelled (cancellable, &error))
     {
       g_simple_async_result_set_from_error (res, error);
       g_error_free (error);
     }
+  else
+    {
+      if (entry == NULL)
+        entry = evd_resolver_entry_new (self, data->name);
+
+      if (! entry->in_flight)
+        evd_resolver_lookup (self, entry);
+
+      /* the entry keeps our reference until the lookup completes */
+      entry->waiters = g_list_append (entry->waiters, res);
+
+      if (cancellable != NULL)
+        {
+          data->cancellable = g_object_ref (cancellable);
+          data->cancel_id =
+            g_cancellable_connect (cancellable,
+                                   G_CALLBACK (evd_resolver_on_cancelled),
+                                   res,
+                                   NULL);
+        }
 
-  g_simple_async_result_complete (res);
+      return;
+    }
+
+  g_simple_async_result_complete_in_idle (res);
   g_object_unref (res);
 }
 
@@ -233,14 +652,11 @@ evd_resolver_resolve (EvdResolver         *self,
             }
           else
             {
-              g_resolver_lookup_by_name_async (g_resolver_get_default (),
-                          domain,
-                          cancellable,
-                          (GAsyncReadyCallback) evd_resolver_on_resolver_result,
-                          (gpointer) res);
-
+              data->name = g_ascii_strdown (domain, -1);
               g_free (domain);
 
+              evd_resolver_resolve_name (self, res, cancellable);
+
               return;
             }
         }
@@ -309,3 +725,23 @@ evd_resolver_free_addresses (GList *addresses)
 
   g_list_free (addresses);
 }
+
+/**
+ * evd_resolver_clear_cache:
+ *
+ * Forgets all the names resolved so far, so that next requests will
+ * look them up again. Lookups in progress are not affected.
+ **/
+void
+evd_resolver_clear_cache (EvdResolver *self)
+{
+  GHashTableIter iter;
+  EvdResolverEntry *entry;
+
+  g_return_if_fail (EVD_IS_RESOLVER (self));
+
+  g_hash_table_iter_init (&iter, self->priv->cache);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+    if (! entry->in_flight)
+      g_hash_table_iter_remove (&iter);
+}
@@ -30,10 +30,13 @@ G_BEGIN_DECLS
 
 typedef struct _EvdResolver EvdResolver;
 typedef struct _EvdResolverClass EvdResolverClass;
+typedef struct _EvdResolverPrivate EvdResolverPrivate;
 
 struct _EvdResolver
 {
   GObject parent;
+
+  EvdResolverPrivate *priv;
 };
 
 struct _EvdResolverClass
@@ -65,6 +68,8 @@ GList              *evd_resolver_resolve_finish       (EvdResolver   *self,
 
 void                evd_resolver_free_addresses       (GList *addresses);
 
+void                evd_resolver_clear_cache          (EvdResolver *self);
+
 G_END_DECLS
 
 #endif /* __EVD_RESOLVER_H__ */
@@ -45,8 +45,30 @@ struct _EvdServicePrivate
 
   gboolean tls_autostart;
   EvdTlsCredentials *tls_cred;
+
+  EvdSocket *socket_options;
+  GHashTable *socket_options_set;
 };
 
+/* socket properties that evd_service_set_socket_options() forwards to
+   the listeners */
+static const gchar *socket_option_names[] =
+  {
+    "backlog",
+    "reuse-port",
+    "tcp-nodelay",
+    "keepalive",
+    "keepalive-idle",
+    "keepalive-interval",
+    "keepalive-count",
+    "send-buffer-size",
+    "receive-buffer-size",
+    "busy-poll",
+    "tcp-fastopen",
+    "defer-accept",
+    NULL
+  };
+
 /* signals */
 enum
 {
@@ -178,6 +200,9 @@ evd_service_init (EvdService *self)
 
   priv->tls_autostart = FALSE;
   priv->tls_cred = NULL;
+
+  priv->socket_options = NULL;
+  priv->socket_options_set = g_hash_table_new (g_str_hash, g_str_equal);
 }
 
 static void
@@ -202,6 +227,10 @@ evd_service_finalize (GObject *obj)
   if (self->priv->tls_cred != NULL)
     g_object_unref (self->priv->tls_cred);
 
+  if (self->priv->socket_options != NULL)
+    g_object_unref (self->priv->socket_options);
+  g_hash_table_destroy (self->priv->socket_options_set);
+
   G_OBJECT_CLASS (evd_service_parent_class)->finalize (obj);
 }
 
@@ -487,6 +516,53 @@ evd_service_add (EvdIoStreamGroup *group, GIOStream *io_stream)
   return TRUE;
 }
 
+static void
+evd_service_apply_socket_options (EvdService *self, EvdSocket *socket)
+{
+  gint i;
+
+  if (self->priv->socket_options == NULL)
+    return;
+
+  for (i = 0; socket_option_names[i] != NULL; i++)
+    {
+      GValue value = {0, };
+      GParamSpec *pspec;
+
+      /* leave alone what the listener was configured with, unless it
+         was explicitly set on the service */
+      if (! g_hash_table_lookup_extended (self->priv->socket_options_set,
+                                          socket_option_names[i],
+                                          NULL,
+                                          NULL))
+        continue;
+
+      pspec =
+        g_object_class_find_property (G_OBJECT_GET_CLASS (self->priv->socket_options),
+                                      socket_option_names[i]);
+
+      g_value_init (&value, G_PARAM_SPEC_VALUE_TYPE (pspec));
+      g_object_get_property (G_OBJECT (self->priv->socket_options),
+                             socket_option_names[i],
+                             &value);
+      g_object_set_property (G_OBJECT (socket), socket_option_names[i], &value);
+      g_value_unset (&value);
+    }
+}
+
+static void
+evd_service_socket_options_on_notify (GObject    *obj,
+                                      GParamSpec *pspec,
+                                      gpointer    user_data)
+{
+  EvdService *self = EVD_SERVICE (user_data);
+
+  /* pspecs live as long as the class, no need to copy their names */
+  g_hash_table_insert (self->priv->socket_options_set,
+                       (gpointer) pspec->name,
+                       NULL);
+}
+
 static void
 evd_service_socket_on_listen (GObject      *obj,
                               GAsyncResult *result,
@@ -607,6 +683,7 @@ evd_service_add_listener (EvdService  *self, EvdSocket *socket)
   g_object_ref (socket);
 
   g_object_set (socket, "io-stream-type", self->priv->io_stream_type, NULL);
+  evd_service_apply_socket_options (self, socket);
 
   g_hash_table_insert (self->priv->listeners,
                        (gpointer) socket,
@@ -654,6 +731,7 @@ evd_service_listen (EvdService          *self,
   g_return_if_fail (address != NULL);
 
   socket = evd_socket_new ();
+  evd_service_apply_socket_options (self, socket);
 
   res = g_simple_async_result_new (G_OBJECT (self),
                                    callback,
@@ -667,6 +745,54 @@ evd_service_listen (EvdService          *self,
                      res);
 }
 
+/**
+ * evd_service_set_socket_options:
+ * @first_option_name: name of the first #EvdSocket tuning property to set
+ * @...: value of the first property, followed optionally by more name/value
+ * pairs, terminated by %NULL
+ *
+ * Sets tuning properties of #EvdSocket (like "tcp-nodelay", "backlog" or
+ * "keepalive-idle") on all the listeners of the service, current and future.
+ * Only the options ever set through this function are forwarded, the rest
+ * keep the value each listener was configured with. Connections accepted
+ * afterwards inherit them from their listener.
+ *
+ * Options that take effect when the socket starts listening ("backlog",
+ * "reuse-port", "tcp-fastopen" and "defer-accept") are only stored on
+ * listeners that are already listening, and apply the next time they
+ * listen.
+ **/
+void
+evd_service_set_socket_options (EvdService  *self,
+                                const gchar *first_option_name,
+                                ...)
+{
+  va_list args;
+  GHashTableIter iter;
+  gpointer key;
+
+  g_return_if_fail (EVD_IS_SERVICE (self));
+
+  if (self->priv->socket_options == NULL)
+    {
+      self->priv->socket_options = evd_socket_new ();
+      g_signal_connect (self->priv->socket_options,
+                        "notify",
+                        G_CALLBACK (evd_service_socket_options_on_notify),
+                        self);
+    }
+
+  va_start (args, first_option_name);
+  g_object_set_valist (G_OBJECT (self->priv->socket_options),
+                       first_option_name,
+                       args);
+  va_end (args);
+
+  g_hash_table_iter_init (&iter, self->priv->listeners);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    evd_service_apply_socket_options (self, EVD_SOCKET (key));
+}
+
 gboolean
 evd_service_listen_finish (EvdService    *self,
                            GAsyncResult  *result,
@@ -115,6 +115,10 @@ gboolean           evd_service_listen_finish       (EvdService    *self,
                                                     GAsyncResult  *result,
                                                     GError       **error);
 
+void               evd_service_set_socket_options  (EvdService  *self,
+                                                    const gchar *first_option_name,
+                                                    ...) G_GNUC_NULL_TERMINATED;
+
 void               evd_service_accept_connection   (EvdService    *self,
                                                     EvdConnection *conn);
 void               evd_service_reject_connection   (EvdService    *self,
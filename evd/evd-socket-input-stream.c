@@ -21,6 +21,7 @@
  */
 
 #include "evd-error.h"
+#include "evd-metrics.h"
 #include "evd-socket-input-stream.h"
 
 G_DEFINE_TYPE (EvdSocketInputStream, evd_socket_input_stream, G_TYPE_INPUT_STREAM)
@@ -29,6 +30,8 @@ G_DEFINE_TYPE (EvdSocketInputStream, evd_socket_input_stream, G_TYPE_INPUT_STREA
                                                   EVD_TYPE_SOCKET_INPUT_STREAM, \
                                                   EvdSocketInputStreamPrivate))
 
+static EvdMetric *metric_bytes = NULL;
+
 /* private data */
 struct _EvdSocketInputStreamPrivate
 {
@@ -36,6 +39,9 @@ struct _EvdSocketInputStreamPrivate
 
   gchar bag;
   gboolean has_bag;
+
+  guint64 total_read;
+  gint64 last_read_time;
 };
 
 /* signals */
@@ -118,6 +124,9 @@ evd_socket_input_stream_init (EvdSocketInputStream *self)
 
   priv->bag = 0;
   priv->has_bag = FALSE;
+
+  priv->total_read = 0;
+  priv->last_read_time = 0;
 }
 
 static void
@@ -248,6 +257,18 @@ evd_socket_input_stream_read (GInputStream  *stream,
       self->priv->has_bag = TRUE;
     }
 
+  if (actual_size + bag_size > 0)
+    {
+      self->priv->total_read += actual_size + bag_size;
+      self->priv->last_read_time = g_get_monotonic_time ();
+
+      evd_metric_add (EVD_METRIC (metric_bytes,
+                                  "evd_socket_read_bytes_total",
+                                  EVD_METRIC_COUNTER,
+                                  "Bytes read from sockets"),
+                      actual_size + bag_size);
+    }
+
   if (drained)
     {
       g_object_ref (self);
@@ -303,3 +324,21 @@ evd_socket_input_stream_get_socket (EvdSocketInputStream *self)
 
   return self->priv->socket;
 }
+
+/**
+ * evd_socket_input_stream_get_total_read:
+ * @last_read_time: (out) (allow-none): monotonic time of the last read, or 0
+ *
+ * Returns: the number of bytes read through this stream so far.
+ **/
+guint64
+evd_socket_input_stream_get_total_read (EvdSocketInputStream *self,
+                                        gint64               *last_read_time)
+{
+  g_return_val_if_fail (EVD_IS_SOCKET_INPUT_STREAM (self), 0);
+
+  if (last_read_time != NULL)
+    *last_read_time = self->priv->last_read_time;
+
+  return self->priv->total_read;
+}
@@ -65,6 +65,9 @@ EvdSocket            *evd_socket_input_stream_get_socket                   (EvdS
 void                  evd_socket_input_stream_set_socket                   (EvdSocketInputStream *self,
                                                                             EvdSocket            *socket);
 
+guint64               evd_socket_input_stream_get_total_read               (EvdSocketInputStream *self,
+                                                                            gint64               *last_read_time);
+
 G_END_DECLS
 
 #endif /* __EVD_SOCKET_INPUT_STREAM_H__ */
@@ -21,6 +21,7 @@
  */
 
 #include "evd-error.h"
+#include "evd-metrics.h"
 #include "evd-socket-output-stream.h"
 
 G_DEFINE_TYPE (EvdSocketOutputStream, evd_socket_output_stream, G_TYPE_OUTPUT_STREAM)
@@ -29,10 +30,15 @@ G_DEFINE_TYPE (EvdSocketOutputStream, evd_socket_output_stream, G_TYPE_OUTPUT_ST
                                                    EVD_TYPE_SOCKET_OUTPUT_STREAM, \
                                                    EvdSocketOutputStreamPrivate))
 
+static EvdMetric *metric_bytes = NULL;
+
 /* private data */
 struct _EvdSocketOutputStreamPrivate
 {
   EvdSocket *socket;
+
+  guint64 total_written;
+  gint64 last_write_time;
 };
 
 /* signals */
@@ -112,6 +118,9 @@ evd_socket_output_stream_init (EvdSocketOutputStream *self)
 
   priv = EVD_SOCKET_OUTPUT_STREAM_GET_PRIVATE (self);
   self->priv = priv;
+
+  priv->total_written = 0;
+  priv->last_write_time = 0;
 }
 
 static void
@@ -210,6 +219,18 @@ evd_socket_output_stream_write (GOutputStream  *stream,
       filled = TRUE;
     }
 
+  if (actual_size > 0)
+    {
+      self->priv->total_written += actual_size;
+      self->priv->last_write_time = g_get_monotonic_time ();
+
+      evd_metric_add (EVD_METRIC (metric_bytes,
+                                  "evd_socket_written_bytes_total",
+                                  EVD_METRIC_COUNTER,
+                                  "Bytes written to sockets"),
+                      actual_size);
+    }
+
   if (filled)
     {
       g_object_ref (self);
@@ -265,3 +286,21 @@ evd_socket_output_stream_get_socket (EvdSocketOutputStream *self)
 
   return self->priv->socket;
 }
+
+/**
+ * evd_socket_output_stream_get_total_written:
+ * @last_write_time: (out) (allow-none): monotonic time of the last write, or 0
+ *
+ * Returns: the number of bytes written through this stream so far.
+ **/
+guint64
+evd_socket_output_stream_get_total_written (EvdSocketOutputStream *self,
+                                            gint64                *last_write_time)
+{
+  g_return_val_if_fail (EVD_IS_SOCKET_OUTPUT_STREAM (self), 0);
+
+  if (last_write_time != NULL)
+    *last_write_time = self->priv->last_write_time;
+
+  return self->priv->total_written;
+}
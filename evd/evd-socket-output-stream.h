@@ -65,6 +65,9 @@ void                   evd_socket_output_stream_set_socket                  (Evd
                                                                              EvdSocket             *socket);
 EvdSocket             *evd_socket_output_stream_get_socket                  (EvdSocketOutputStream *self);
 
+guint64                evd_socket_output_stream_get_total_written           (EvdSocketOutputStream *self,
+                                                                             gint64                *last_write_time);
+
 G_END_DECLS
 
 #endif /* __EVD_SOCKET_OUTPUT_STREAM_H__ */
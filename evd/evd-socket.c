@@ -41,7 +41,13 @@
 #include "evd-poll.h"
 #include "evd-resolver.h"
 #include "evd-connection.h"
+#include "evd-metrics.h"
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 G_DEFINE_TYPE (EvdSocket, evd_socket, G_TYPE_OBJECT)
 
@@ -49,6 +55,10 @@ G_DEFINE_TYPE (EvdSocket, evd_socket, G_TYPE_OBJECT)
                                      EVD_TYPE_SOCKET, \
                                      EvdSocketPrivate))
 
+/* delay before racing the next resolved address, as in RFC 8305 */
+#define DEFAULT_CONNECT_ATTEMPT_DELAY 250 /* in miliseconds */
+#define DEFAULT_BACKLOG                10000
+
 #define SOCKET_ACTIVE(socket)       (socket->priv->status == EVD_SOCKET_STATE_CONNECTED || \
                                      (socket->priv->status == EVD_SOCKET_STATE_BOUND && \
                                       socket->priv->protocol == G_SOCKET_PROTOCOL_UDP))
@@ -82,8 +92,38 @@ struct _EvdSocketPrivate
 
   EvdPoll *poll;
   EvdPollSession *poll_session;
+
+  guint connect_attempt_delay;
+  GList *connect_addrs;
+  GList *connect_attempts;
+  guint connect_attempt_src_id;
+  GError *connect_error;
+
+  gboolean reuse_port;
+
+  /* tuning */
+  guint backlog;
+  gboolean tcp_nodelay;
+  gboolean keepalive;
+  guint keepalive_idle;
+  guint keepalive_interval;
+  guint keepalive_count;
+  guint send_buffer_size;
+  guint receive_buffer_size;
+  guint busy_poll;
+  guint tcp_fastopen;
+  guint defer_accept;
 };
 
+/* one of the connections racing towards a multi-address host */
+typedef struct
+{
+  EvdSocket *self;
+  GSocket *socket;
+  GSocketAddress *address;
+  EvdPollSession *session;
+} EvdSocketConnectAttempt;
+
 /* signals */
 enum
 {
@@ -96,6 +136,13 @@ enum
 
 static guint evd_socket_signals[SIGNAL_LAST] = { 0 };
 
+/* listening sockets of this process, and the ones handed over by a
+   previous one waiting to be adopted, keyed by local address */
+static GList *evd_socket_listeners = NULL;
+static GHashTable *evd_socket_inherited = NULL;
+
+static EvdMetric *metric_accepted = NULL;
+
 /* properties */
 enum
 {
@@ -106,7 +153,20 @@ enum
   PROP_PROTOCOL,
   PROP_PRIORITY,
   PROP_STATUS,
-  PROP_IO_STREAM_TYPE
+  PROP_IO_STREAM_TYPE,
+  PROP_CONNECT_ATTEMPT_DELAY,
+  PROP_REUSE_PORT,
+  PROP_BACKLOG,
+  PROP_TCP_NODELAY,
+  PROP_KEEPALIVE,
+  PROP_KEEPALIVE_IDLE,
+  PROP_KEEPALIVE_INTERVAL,
+  PROP_KEEPALIVE_COUNT,
+  PROP_SEND_BUFFER_SIZE,
+  PROP_RECEIVE_BUFFER_SIZE,
+  PROP_BUSY_POLL,
+  PROP_TCP_FASTOPEN,
+  PROP_DEFER_ACCEPT
 };
 
 static void       evd_socket_class_init                 (EvdSocketClass *class);
@@ -154,6 +214,8 @@ static void       evd_socket_handle_condition           (EvdSocket    *self,
 static EvdSocket *evd_socket_accept                     (EvdSocket  *self,
                                                          GError    **error);
 
+static void       evd_socket_connect_race_abort         (EvdSocket *self);
+
 static void
 evd_socket_class_init (EvdSocketClass *class)
 {
@@ -276,6 +338,130 @@ evd_socket_class_init (EvdSocketClass *class)
                                                        G_PARAM_READWRITE |
                                                        G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (obj_class, PROP_CONNECT_ATTEMPT_DELAY,
+                                   g_param_spec_uint ("connect-attempt-delay",
+                                                      "Connection attempt delay",
+                                                      "Milliseconds to wait on a connection attempt before also trying the next resolved address, 0 to try them one at a time",
+                                                      0,
+                                                      G_MAXUINT,
+                                                      DEFAULT_CONNECT_ATTEMPT_DELAY,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_REUSE_PORT,
+                                   g_param_spec_boolean ("reuse-port",
+                                                         "Reuse port",
+                                                         "Whether to bind with SO_REUSEPORT, so that several processes can listen on the same address",
+                                                         FALSE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_BACKLOG,
+                                   g_param_spec_uint ("backlog",
+                                                      "Listen backlog",
+                                                      "Maximum number of pending connections queued on a listening socket",
+                                                      0,
+                                                      G_MAXINT,
+                                                      DEFAULT_BACKLOG,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_TCP_NODELAY,
+                                   g_param_spec_boolean ("tcp-nodelay",
+                                                         "TCP no-delay",
+                                                         "Whether to disable Nagle's algorithm on TCP sockets",
+                                                         TRUE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_KEEPALIVE,
+                                   g_param_spec_boolean ("keepalive",
+                                                         "Keepalive",
+                                                         "Whether to send keepalive probes on idle connections",
+                                                         TRUE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_KEEPALIVE_IDLE,
+                                   g_param_spec_uint ("keepalive-idle",
+                                                      "Keepalive idle time",
+                                                      "Seconds a connection stays idle before the first keepalive probe, 0 for the system default",
+                                                      0,
+                                                      G_MAXINT,
+                                                      0,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_KEEPALIVE_INTERVAL,
+                                   g_param_spec_uint ("keepalive-interval",
+                                                      "Keepalive interval",
+                                                      "Seconds between keepalive probes, 0 for the system default",
+                                                      0,
+                                                      G_MAXINT,
+                                                      0,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_KEEPALIVE_COUNT,
+                                   g_param_spec_uint ("keepalive-count",
+                                                      "Keepalive probe count",
+                                                      "Unanswered keepalive probes before dropping the connection, 0 for the system default",
+                                                      0,
+                                                      G_MAXINT,
+                                                      0,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_SEND_BUFFER_SIZE,
+                                   g_param_spec_uint ("send-buffer-size",
+                                                      "Send buffer size",
+                                                      "Size in bytes of the kernel send buffer, 0 for the system default",
+                                                      0,
+                                                      G_MAXINT,
+                                                      0,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_RECEIVE_BUFFER_SIZE,
+                                   g_param_spec_uint ("receive-buffer-size",
+                                                      "Receive buffer size",
+                                                      "Size in bytes of the kernel receive buffer, 0 for the system default",
+                                                      0,
+                                                      G_MAXINT,
+                                                      0,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_BUSY_POLL,
+                                   g_param_spec_uint ("busy-poll",
+                                                      "Busy poll",
+                                                      "Microseconds to busy-poll the device queue on blocking reads, 0 to disable",
+                                                      0,
+                                                      G_MAXINT,
+                                                      0,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_TCP_FASTOPEN,
+                                   g_param_spec_uint ("tcp-fastopen",
+                                                      "TCP Fast Open queue",
+                                                      "Length of the TCP Fast Open queue of a listening socket, 0 to disable",
+                                                      0,
+                                                      G_MAXINT,
+                                                      0,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_DEFER_ACCEPT,
+                                   g_param_spec_uint ("defer-accept",
+                                                      "Defer accept",
+                                                      "Seconds a listening socket waits for the first data before accepting a connection, 0 to disable",
+                                                      0,
+                                                      G_MAXINT,
+                                                      0,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
   /* add private structure */
   g_type_class_add_private (obj_class, sizeof (EvdSocketPrivate));
 }
@@ -311,6 +497,27 @@ evd_socket_init (EvdSocket *self)
 
   priv->poll = evd_poll_get_default ();
   priv->poll_session = NULL;
+
+  priv->connect_attempt_delay = DEFAULT_CONNECT_ATTEMPT_DELAY;
+
+  priv->reuse_port = FALSE;
+
+  priv->backlog = DEFAULT_BACKLOG;
+  priv->tcp_nodelay = TRUE;
+  priv->keepalive = TRUE;
+  priv->keepalive_idle = 0;
+  priv->keepalive_interval = 0;
+  priv->keepalive_count = 0;
+  priv->send_buffer_size = 0;
+  priv->receive_buffer_size = 0;
+  priv->busy_poll = 0;
+  priv->tcp_fastopen = 0;
+  priv->defer_accept = 0;
+
+  priv->connect_addrs = NULL;
+  priv->connect_attempts = NULL;
+  priv->connect_attempt_src_id = 0;
+  priv->connect_error = NULL;
 }
 
 static void
@@ -367,6 +574,58 @@ evd_socket_set_property (GObject      *obj,
       self->priv->io_stream_type = g_value_get_gtype (value);
       break;
 
+    case PROP_CONNECT_ATTEMPT_DELAY:
+      self->priv->connect_attempt_delay = g_value_get_uint (value);
+      break;
+
+    case PROP_REUSE_PORT:
+      self->priv->reuse_port = g_value_get_boolean (value);
+      break;
+
+    case PROP_BACKLOG:
+      self->priv->backlog = g_value_get_uint (value);
+      break;
+
+    case PROP_TCP_NODELAY:
+      self->priv->tcp_nodelay = g_value_get_boolean (value);
+      break;
+
+    case PROP_KEEPALIVE:
+      self->priv->keepalive = g_value_get_boolean (value);
+      break;
+
+    case PROP_KEEPALIVE_IDLE:
+      self->priv->keepalive_idle = g_value_get_uint (value);
+      break;
+
+    case PROP_KEEPALIVE_INTERVAL:
+      self->priv->keepalive_interval = g_value_get_uint (value);
+      break;
+
+    case PROP_KEEPALIVE_COUNT:
+      self->priv->keepalive_count = g_value_get_uint (value);
+      break;
+
+    case PROP_SEND_BUFFER_SIZE:
+      self->priv->send_buffer_size = g_value_get_uint (value);
+      break;
+
+    case PROP_RECEIVE_BUFFER_SIZE:
+      self->priv->receive_buffer_size = g_value_get_uint (value);
+      break;
+
+    case PROP_BUSY_POLL:
+      self->priv->busy_poll = g_value_get_uint (value);
+      break;
+
+    case PROP_TCP_FASTOPEN:
+      self->priv->tcp_fastopen = g_value_get_uint (value);
+      break;
+
+    case PROP_DEFER_ACCEPT:
+      self->priv->defer_accept = g_value_get_uint (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
       break;
@@ -427,6 +686,58 @@ evd_socket_get_property (GObject    *obj,
       g_value_set_gtype (value, self->priv->io_stream_type);
       break;
 
+    case PROP_CONNECT_ATTEMPT_DELAY:
+      g_value_set_uint (value, self->priv->connect_attempt_delay);
+      break;
+
+    case PROP_REUSE_PORT:
+      g_value_set_boolean (value, self->priv->reuse_port);
+      break;
+
+    case PROP_BACKLOG:
+      g_value_set_uint (value, self->priv->backlog);
+      break;
+
+    case PROP_TCP_NODELAY:
+      g_value_set_boolean (value, self->priv->tcp_nodelay);
+      break;
+
+    case PROP_KEEPALIVE:
+      g_value_set_boolean (value, self->priv->keepalive);
+      break;
+
+    case PROP_KEEPALIVE_IDLE:
+      g_value_set_uint (value, self->priv->keepalive_idle);
+      break;
+
+    case PROP_KEEPALIVE_INTERVAL:
+      g_value_set_uint (value, self->priv->keepalive_interval);
+      break;
+
+    case PROP_KEEPALIVE_COUNT:
+      g_value_set_uint (value, self->priv->keepalive_count);
+      break;
+
+    case PROP_SEND_BUFFER_SIZE:
+      g_value_set_uint (value, self->priv->send_buffer_size);
+      break;
+
+    case PROP_RECEIVE_BUFFER_SIZE:
+      g_value_set_uint (value, self->priv->receive_buffer_size);
+      break;
+
+    case PROP_BUSY_POLL:
+      g_value_set_uint (value, self->priv->busy_poll);
+      break;
+
+    case PROP_TCP_FASTOPEN:
+      g_value_set_uint (value, self->priv->tcp_fastopen);
+      break;
+
+    case PROP_DEFER_ACCEPT:
+      g_value_set_uint (value, self->priv->defer_accept);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
       break;
@@ -434,14 +745,114 @@ evd_socket_get_property (GObject    *obj,
 }
 
 static void
-evd_socket_set_socket (EvdSocket *self, GSocket *socket)
+evd_socket_set_option (GSocket *socket, gint level, gint option, guint value)
 {
-  self->priv->socket = socket;
+  gint v = (gint) value;
+
+  /* tuning is best effort, an option the kernel doesn't know about
+     shouldn't prevent the socket from working */
+  setsockopt (g_socket_get_fd (socket), level, option, &v, sizeof (v));
+}
+
+static void
+evd_socket_apply_options (EvdSocket *self, GSocket *socket)
+{
+  GSocketFamily family;
 
   g_object_set (socket,
                 "blocking", FALSE,
-                "keepalive", TRUE,
+                "keepalive", self->priv->keepalive,
                 NULL);
+
+  if (self->priv->send_buffer_size > 0)
+    evd_socket_set_option (socket,
+                           SOL_SOCKET,
+                           SO_SNDBUF,
+                           self->priv->send_buffer_size);
+
+  if (self->priv->receive_buffer_size > 0)
+    evd_socket_set_option (socket,
+                           SOL_SOCKET,
+                           SO_RCVBUF,
+                           self->priv->receive_buffer_size);
+
+#ifdef SO_BUSY_POLL
+  if (self->priv->busy_poll > 0)
+    evd_socket_set_option (socket,
+                           SOL_SOCKET,
+                           SO_BUSY_POLL,
+                           self->priv->busy_poll);
+#endif
+
+  family = g_socket_get_family (socket);
+  if ( (family != G_SOCKET_FAMILY_IPV4 && family != G_SOCKET_FAMILY_IPV6) ||
+       g_socket_get_socket_type (socket) != G_SOCKET_TYPE_STREAM)
+    return;
+
+  if (self->priv->tcp_nodelay)
+    evd_socket_set_option (socket, IPPROTO_TCP, TCP_NODELAY, 1);
+
+  if (self->priv->keepalive)
+    {
+#ifdef TCP_KEEPIDLE
+      if (self->priv->keepalive_idle > 0)
+        evd_socket_set_option (socket,
+                               IPPROTO_TCP,
+                               TCP_KEEPIDLE,
+                               self->priv->keepalive_idle);
+#endif
+#ifdef TCP_KEEPINTVL
+      if (self->priv->keepalive_interval > 0)
+        evd_socket_set_option (socket,
+                               IPPROTO_TCP,
+                               TCP_KEEPINTVL,
+                               self->priv->keepalive_interval);
+#endif
+#ifdef TCP_KEEPCNT
+      if (self->priv->keepalive_count > 0)
+        evd_socket_set_option (socket,
+                               IPPROTO_TCP,
+                               TCP_KEEPCNT,
+                               self->priv->keepalive_count);
+#endif
+    }
+}
+
+static void
+evd_socket_apply_listen_options (EvdSocket *self)
+{
+  GSocketFamily family;
+
+  g_socket_set_listen_backlog (self->priv->socket, self->priv->backlog);
+
+  family = g_socket_get_family (self->priv->socket);
+  if ( (family != G_SOCKET_FAMILY_IPV4 && family != G_SOCKET_FAMILY_IPV6) ||
+       g_socket_get_socket_type (self->priv->socket) != G_SOCKET_TYPE_STREAM)
+    return;
+
+#ifdef TCP_FASTOPEN
+  if (self->priv->tcp_fastopen > 0)
+    evd_socket_set_option (self->priv->socket,
+                           IPPROTO_TCP,
+                           TCP_FASTOPEN,
+                           self->priv->tcp_fastopen);
+#endif
+
+#ifdef TCP_DEFER_ACCEPT
+  if (self->priv->defer_accept > 0)
+    evd_socket_set_option (self->priv->socket,
+                           IPPROTO_TCP,
+                           TCP_DEFER_ACCEPT,
+                           self->priv->defer_accept);
+#endif
+}
+
+static void
+evd_socket_set_socket (EvdSocket *self, GSocket *socket)
+{
+  self->priv->socket = socket;
+
+  evd_socket_apply_options (self, socket);
 }
 
 static gboolean
@@ -625,6 +1036,27 @@ evd_socket_bind_addr_internal (EvdSocket       *self,
   if (! evd_socket_setup (self, error))
     return FALSE;
 
+  if (self->priv->reuse_port)
+    {
+      gint on = 1;
+
+      if (setsockopt (g_socket_get_fd (self->priv->socket),
+                      SOL_SOCKET,
+                      SO_REUSEPORT,
+                      &on,
+                      sizeof (on)) != 0)
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       g_io_error_from_errno (errno),
+                       "Failed to set SO_REUSEPORT: %s",
+                       g_strerror (errno));
+          evd_socket_cleanup (self, NULL);
+
+          return FALSE;
+        }
+    }
+
   if (! g_socket_bind (self->priv->socket,
                        address,
                        allow_reuse,
@@ -641,12 +1073,79 @@ evd_socket_bind_addr_internal (EvdSocket       *self,
   return TRUE;
 }
 
+static gchar *
+evd_socket_address_to_key (GSocketAddress *address)
+{
+#ifdef HAVE_GIO_UNIX
+  if (G_IS_UNIX_SOCKET_ADDRESS (address))
+    return g_strdup (g_unix_socket_address_get_path (G_UNIX_SOCKET_ADDRESS (address)));
+#endif
+
+  if (G_IS_INET_SOCKET_ADDRESS (address))
+    {
+      GInetSocketAddress *inet_addr = G_INET_SOCKET_ADDRESS (address);
+      gchar *addr_st;
+      gchar *key;
+
+      addr_st =
+        g_inet_address_to_string (g_inet_socket_address_get_address (inet_addr));
+      key = g_strdup_printf ("%s:%u",
+                             addr_st,
+                             g_inet_socket_address_get_port (inet_addr));
+      g_free (addr_st);
+
+      return key;
+    }
+
+  return NULL;
+}
+
+/* takes over a listening socket handed over for @address, if any */
 static gboolean
-evd_socket_listen_addr_internal (EvdSocket *self, GSocketAddress *address, GError **error)
+evd_socket_adopt_inherited (EvdSocket *self, GSocketAddress *address)
 {
-  if (address != NULL && ! evd_socket_bind_addr_internal (self, address, TRUE, error))
+  gchar *key;
+  gpointer fd;
+  GSocket *socket;
+
+  if (evd_socket_inherited == NULL || self->priv->socket != NULL)
+    return FALSE;
+
+  key = evd_socket_address_to_key (address);
+  if (key == NULL)
+    return FALSE;
+
+  /* fds are stored plus one, so that 0 is not NULL */
+  fd = g_hash_table_lookup (evd_socket_inherited, key);
+  g_hash_table_remove (evd_socket_inherited, key);
+  g_free (key);
+
+  if (fd == NULL)
     return FALSE;
 
+  if (! evd_socket_check_address (self, address, NULL) ||
+      (socket = g_socket_new_from_fd (GPOINTER_TO_INT (fd) - 1, NULL)) == NULL)
+    {
+      close (GPOINTER_TO_INT (fd) - 1);
+      return FALSE;
+    }
+
+  evd_socket_set_socket (self, socket);
+  evd_socket_set_status (self, EVD_SOCKET_STATE_BOUND);
+
+  return TRUE;
+}
+
+static gboolean
+evd_socket_listen_addr_internal (EvdSocket *self, GSocketAddress *address, GError **error)
+{
+  if (address != NULL &&
+      ! evd_socket_adopt_inherited (self, address) &&
+      ! evd_socket_bind_addr_internal (self, address, TRUE, error))
+    {
+      return FALSE;
+    }
+
   if (self->priv->status != EVD_SOCKET_STATE_BOUND)
     {
       /* this is to consider that socket could have been closed
@@ -660,13 +1159,14 @@ evd_socket_listen_addr_internal (EvdSocket *self, GSocketAddress *address, GErro
       return FALSE;
     }
 
-  g_socket_set_listen_backlog (self->priv->socket, 10000); /* TODO: change by a max-conn prop */
+  evd_socket_apply_listen_options (self);
   if (g_socket_listen (self->priv->socket, error))
     {
       if (evd_socket_watch (self, G_IO_IN, error))
         {
           self->priv->cond = 0;
           self->priv->actual_priority = G_PRIORITY_HIGH + 1;
+          evd_socket_listeners = g_list_prepend (evd_socket_listeners, self);
           evd_socket_set_status (self, EVD_SOCKET_STATE_LISTENING);
         }
       else
@@ -738,6 +1238,385 @@ evd_socket_connect_addr_internal (EvdSocket        *self,
     }
 }
 
+static void
+evd_socket_connect_attempt_free (EvdSocketConnectAttempt *attempt)
+{
+  if (attempt->session != NULL)
+    evd_poll_del (attempt->self->priv->poll, attempt->session, NULL);
+
+  if (attempt->socket != NULL)
+    {
+      g_socket_close (attempt->socket, NULL);
+      g_object_unref (attempt->socket);
+    }
+
+  g_object_unref (attempt->address);
+
+  g_slice_free (EvdSocketConnectAttempt, attempt);
+}
+
+static void
+evd_socket_connect_race_abort (EvdSocket *self)
+{
+  if (self->priv->connect_attempt_src_id != 0)
+    {
+      g_source_remove (self->priv->connect_attempt_src_id);
+      self->priv->connect_attempt_src_id = 0;
+    }
+
+  g_list_foreach (self->priv->connect_attempts,
+                  (GFunc) evd_socket_connect_attempt_free,
+                  NULL);
+  g_list_free (self->priv->connect_attempts);
+  self->priv->connect_attempts = NULL;
+
+  g_list_foreach (self->priv->connect_addrs, (GFunc) g_object_unref, NULL);
+  g_list_free (self->priv->connect_addrs);
+  self->priv->connect_addrs = NULL;
+
+  if (self->priv->connect_error != NULL)
+    {
+      g_error_free (self->priv->connect_error);
+      self->priv->connect_error = NULL;
+    }
+}
+
+static void
+evd_socket_connect_race_set_error (EvdSocket *self, GError *error)
+{
+  if (self->priv->connect_error != NULL)
+    g_error_free (self->priv->connect_error);
+
+  self->priv->connect_error = error;
+}
+
+static void
+evd_socket_connect_race_fail (EvdSocket *self)
+{
+  GError *error;
+
+  error = self->priv->connect_error;
+  self->priv->connect_error = NULL;
+
+  if (error == NULL)
+    error = g_error_new (G_IO_ERROR,
+                         G_IO_ERROR_CONNECTION_REFUSED,
+                         "Connection refused");
+
+  evd_socket_connect_race_abort (self);
+
+  if (self->priv->async_result != NULL)
+    {
+      evd_socket_deliver_async_result_error (self,
+                                             self->priv->async_result,
+                                             g_error_copy (error),
+                                             NULL,
+                                             NULL,
+                                             TRUE);
+      self->priv->async_result = NULL;
+    }
+
+  g_object_ref (self);
+  evd_socket_throw_error (self, error);
+  evd_socket_close (self, NULL);
+  g_object_unref (self);
+}
+
+static void
+evd_socket_connect_race_win (EvdSocket               *self,
+                             EvdSocketConnectAttempt *attempt)
+{
+  GSocket *socket;
+  GSocketAddress *address;
+  GError *error = NULL;
+
+  self->priv->connect_attempts =
+    g_list_remove (self->priv->connect_attempts, attempt);
+
+  socket = attempt->socket;
+  attempt->socket = NULL;
+  address = g_object_ref (attempt->address);
+
+  evd_socket_connect_attempt_free (attempt);
+  evd_socket_connect_race_abort (self);
+
+  /* adopt the winner, watching it delivers the connect as usual */
+  evd_socket_check_address (self, address, NULL);
+  g_object_unref (address);
+
+  evd_socket_set_socket (self, socket);
+
+  self->priv->actual_priority = G_PRIORITY_HIGH + 2;
+  if (! evd_socket_watch (self, G_IO_IN | G_IO_OUT, &error))
+    {
+      evd_socket_connect_race_set_error (self, error);
+      evd_socket_connect_race_fail (self);
+    }
+}
+
+static gboolean evd_socket_connect_race_next (gpointer user_data);
+
+static GIOCondition
+evd_socket_connect_attempt_on_condition (EvdPoll      *poll,
+                                         GIOCondition  cond,
+                                         gpointer      user_data)
+{
+  EvdSocketConnectAttempt *attempt = user_data;
+  EvdSocket *self = attempt->self;
+  gint err = 0;
+  socklen_t len = sizeof (err);
+
+  if ((cond & (G_IO_OUT | G_IO_ERR | G_IO_HUP)) == 0)
+    return cond;
+
+  if (getsockopt (g_socket_get_fd (attempt->socket),
+                  SOL_SOCKET,
+                  SO_ERROR,
+                  &err,
+                  &len) != 0)
+    err = errno;
+
+  if (err == 0 && (cond & G_IO_ERR) == 0)
+    {
+      evd_socket_connect_race_win (self, attempt);
+      return cond;
+    }
+
+  if (err == 0)
+    err = ECONNREFUSED;
+
+  evd_socket_connect_race_set_error (self,
+                                     g_error_new (G_IO_ERROR,
+                                                  g_io_error_from_errno (err),
+                                                  "%s",
+                                                  g_strerror (err)));
+
+  self->priv->connect_attempts =
+    g_list_remove (self->priv->connect_attempts, attempt);
+  evd_socket_connect_attempt_free (attempt);
+
+  /* a failure lets the next address start right away */
+  if (self->priv->connect_attempt_src_id != 0)
+    {
+      g_source_remove (self->priv->connect_attempt_src_id);
+      self->priv->connect_attempt_src_id = 0;
+    }
+
+  if (self->priv->connect_addrs != NULL)
+    evd_socket_connect_race_next (self);
+  else if (self->priv->connect_attempts == NULL)
+    evd_socket_connect_race_fail (self);
+
+  return cond;
+}
+
+static gboolean
+evd_socket_connect_attempt_start (EvdSocket       *self,
+                                  GSocketAddress  *address,
+                                  GError         **error)
+{
+  EvdSocketConnectAttempt *attempt;
+  GSocket *socket;
+  GError *_error = NULL;
+
+  if ( (socket = g_socket_new (g_socket_address_get_family (address),
+                               self->priv->type,
+                               self->priv->protocol,
+                               error)) == NULL)
+    {
+      return FALSE;
+    }
+
+  evd_socket_apply_options (self, socket);
+
+  if (! g_socket_connect (socket, address, NULL, &_error) &&
+      _error->code != G_IO_ERROR_PENDING)
+    {
+      g_propagate_error (error, _error);
+      g_object_unref (socket);
+
+      return FALSE;
+    }
+  if (_error != NULL)
+    g_error_free (_error);
+
+  attempt = g_slice_new0 (EvdSocketConnectAttempt);
+  attempt->self = self;
+  attempt->socket = socket;
+  attempt->address = g_object_ref (address);
+
+  attempt->session = evd_poll_add (self->priv->poll,
+                                   g_socket_get_fd (socket),
+                                   G_IO_OUT,
+                                   G_PRIORITY_HIGH + 2,
+                                   evd_socket_connect_attempt_on_condition,
+                                   attempt,
+                                   NULL,
+                                   error);
+  if (attempt->session == NULL)
+    {
+      evd_socket_connect_attempt_free (attempt);
+      return FALSE;
+    }
+
+  self->priv->connect_attempts =
+    g_list_prepend (self->priv->connect_attempts, attempt);
+
+  return TRUE;
+}
+
+static gboolean
+evd_socket_connect_race_next (gpointer user_data)
+{
+  EvdSocket *self = EVD_SOCKET (user_data);
+
+  self->priv->connect_attempt_src_id = 0;
+
+  /* addresses that fail synchronously don't count as an attempt */
+  while (self->priv->connect_addrs != NULL)
+    {
+      GSocketAddress *address;
+      GError *error = NULL;
+      gboolean started;
+
+      address = self->priv->connect_addrs->data;
+      self->priv->connect_addrs =
+        g_list_delete_link (self->priv->connect_addrs,
+                            self->priv->connect_addrs);
+
+      started = evd_socket_connect_attempt_start (self, address, &error);
+      g_object_unref (address);
+
+      if (started)
+        break;
+
+      evd_socket_connect_race_set_error (self, error);
+    }
+
+  if (self->priv->connect_attempts == NULL)
+    {
+      evd_socket_connect_race_fail (self);
+    }
+  else if (self->priv->connect_addrs != NULL &&
+           self->priv->connect_attempt_delay > 0)
+    {
+      self->priv->connect_attempt_src_id =
+        evd_timeout_add (NULL,
+                         self->priv->connect_attempt_delay,
+                         G_PRIORITY_HIGH + 2,
+                         evd_socket_connect_race_next,
+                         self);
+    }
+
+  return FALSE;
+}
+
+/* the candidates that fit the socket's family, alternating families
+   starting with the resolver's first choice (RFC 8305, section 4) */
+static GList *
+evd_socket_sort_connect_addresses (EvdSocket *self, GList *addresses)
+{
+  GList *first = NULL;
+  GList *second = NULL;
+  GList *result = NULL;
+  GSocketFamily first_family = G_SOCKET_FAMILY_INVALID;
+  GList *node;
+
+  for (node = addresses; node != NULL; node = node->next)
+    {
+      GSocketAddress *address = G_SOCKET_ADDRESS (node->data);
+      GSocketFamily family;
+
+      family = g_socket_address_get_family (address);
+
+      if (self->priv->family != G_SOCKET_FAMILY_INVALID &&
+          self->priv->family != family)
+        continue;
+
+      if (first_family == G_SOCKET_FAMILY_INVALID)
+        first_family = family;
+
+      if (family == first_family)
+        first = g_list_prepend (first, g_object_ref (address));
+      else
+        second = g_list_prepend (second, g_object_ref (address));
+    }
+
+  first = g_list_reverse (first);
+  second = g_list_reverse (second);
+
+  while (first != NULL || second != NULL)
+    {
+      if (first != NULL)
+        {
+          result = g_list_prepend (result, first->data);
+          first = g_list_delete_link (first, first);
+        }
+
+      if (second != NULL)
+        {
+          result = g_list_prepend (result, second->data);
+          second = g_list_delete_link (second, second);
+        }
+    }
+
+  return g_list_reverse (result);
+}
+
+static gboolean
+evd_socket_connect_addresses (EvdSocket  *self,
+                              GList      *addresses,
+                              GError    **error)
+{
+  GList *candidates;
+
+  candidates = evd_socket_sort_connect_addresses (self, addresses);
+
+  if (candidates == NULL)
+    {
+      g_set_error_literal (error,
+                           G_IO_ERROR,
+                           G_IO_ERROR_INVALID_ARGUMENT,
+                           "None of the resolved addresses match socket family");
+      return FALSE;
+    }
+
+  /* a single address takes the plain path */
+  if (candidates->next == NULL)
+    {
+      gboolean result;
+
+      result = evd_socket_connect_addr_internal (self,
+                                                 candidates->data,
+                                                 error);
+      g_object_unref (candidates->data);
+      g_list_free (candidates);
+
+      return result;
+    }
+
+  if (self->priv->type == G_SOCKET_TYPE_INVALID)
+    {
+      if (self->priv->protocol == G_SOCKET_PROTOCOL_UDP)
+        self->priv->type = G_SOCKET_TYPE_DATAGRAM;
+      else
+        self->priv->type = G_SOCKET_TYPE_STREAM;
+    }
+
+  if (self->priv->protocol == G_SOCKET_PROTOCOL_UNKNOWN)
+    self->priv->protocol = G_SOCKET_PROTOCOL_DEFAULT;
+
+  self->priv->connect_addrs = candidates;
+
+  evd_socket_set_status (self, EVD_SOCKET_STATE_CONNECTING);
+
+  /* it may have been closed from the 'state-changed' handler */
+  if (self->priv->status == EVD_SOCKET_STATE_CONNECTING)
+    evd_socket_connect_race_next (self);
+
+  return TRUE;
+}
+
 static void
 evd_socket_on_address_resolved (GObject      *obj,
                                 GAsyncResult *res,
@@ -753,7 +1632,16 @@ evd_socket_on_address_resolved (GObject      *obj,
 
   if ( (addresses = evd_resolver_resolve_finish (EVD_RESOLVER (obj),
                                                  res,
-                                                 &error)) != NULL)
+                                                 &error)) != NULL &&
+       self->priv->sub_status == EVD_SOCKET_STATE_CONNECTING)
+    {
+      self->priv->sub_status = EVD_SOCKET_STATE_CLOSED;
+
+      evd_socket_connect_addresses (self, addresses, &error);
+
+      evd_resolver_free_addresses (addresses);
+    }
+  else if (addresses != NULL)
     {
       GSocketAddress *socket_address;
       GList *node = addresses;
@@ -813,11 +1701,6 @@ evd_socket_on_address_resolved (GObject      *obj,
                   }
                 break;
               }
-            case EVD_SOCKET_STATE_CONNECTING:
-              {
-                evd_socket_connect_addr_internal (self, socket_address, &error);
-                break;
-              }
             default:
               {
               }
@@ -880,6 +1763,21 @@ evd_socket_copy_properties (EvdSocket *self, EvdSocket *target)
   evd_socket_set_priority (target, self->priv->priority);
 
   target->priv->io_stream_type = self->priv->io_stream_type;
+
+  target->priv->connect_attempt_delay = self->priv->connect_attempt_delay;
+  target->priv->reuse_port = self->priv->reuse_port;
+
+  target->priv->backlog = self->priv->backlog;
+  target->priv->tcp_nodelay = self->priv->tcp_nodelay;
+  target->priv->keepalive = self->priv->keepalive;
+  target->priv->keepalive_idle = self->priv->keepalive_idle;
+  target->priv->keepalive_interval = self->priv->keepalive_interval;
+  target->priv->keepalive_count = self->priv->keepalive_count;
+  target->priv->send_buffer_size = self->priv->send_buffer_size;
+  target->priv->receive_buffer_size = self->priv->receive_buffer_size;
+  target->priv->busy_poll = self->priv->busy_poll;
+  target->priv->tcp_fastopen = self->priv->tcp_fastopen;
+  target->priv->defer_accept = self->priv->defer_accept;
 }
 
 static gboolean
@@ -964,7 +1862,11 @@ evd_socket_handle_condition (EvdSocket *self, GIOCondition condition)
       while ( (self->priv->status == EVD_SOCKET_STATE_LISTENING) &&
               ((client = evd_socket_accept (self, &error)) != NULL) )
         {
-          evd_socket_copy_properties (self, client);
+          evd_metric_add (EVD_METRIC (metric_accepted,
+                                      "evd_socket_accepted_total",
+                                      EVD_METRIC_COUNTER,
+                                      "Connections accepted by listening sockets"),
+                          1);
 
           conn = g_object_new (self->priv->io_stream_type,
                                "socket", client,
@@ -1067,6 +1969,10 @@ evd_socket_cleanup_internal (EvdSocket *self, GError **error)
 {
   gboolean result = TRUE;
 
+  evd_socket_connect_race_abort (self);
+
+  evd_socket_listeners = g_list_remove (evd_socket_listeners, self);
+
   self->priv->family = G_SOCKET_FAMILY_INVALID;
 
   self->priv->cond = 0;
@@ -1104,6 +2010,9 @@ evd_socket_accept (EvdSocket *self, GError **error)
   if ( (client_socket = g_socket_accept (self->priv->socket, NULL, error)) != NULL)
     {
       client = EVD_SOCKET (g_object_new (G_OBJECT_TYPE (self), NULL, NULL));
+
+      /* before adopting the socket, so that it gets tuned as the listener */
+      evd_socket_copy_properties (self, client);
       evd_socket_set_socket (client, client_socket);
 
       if (evd_socket_watch (client, G_IO_IN | G_IO_OUT, error))
@@ -1645,3 +2554,97 @@ evd_socket_get_remote_address_str (EvdSocket *self, gsize *len, GError **error)
 
   return result;
 }
+
+/**
+ * evd_socket_get_listeners:
+ *
+ * Returns: (transfer container) (element-type Evd.Socket): The sockets
+ * of this process that are currently listening.
+ **/
+GList *
+evd_socket_get_listeners (void)
+{
+  return g_list_copy (evd_socket_listeners);
+}
+
+/**
+ * evd_socket_inherit_listener:
+ * @fd: a listening socket handed over by another process
+ *
+ * Takes ownership of @fd. The next #EvdSocket that listens on the
+ * address @fd is bound to adopts it instead of binding again, so the
+ * listening queue (and any connection waiting in it) survives the
+ * process restart.
+ **/
+gboolean
+evd_socket_inherit_listener (gint fd, GError **error)
+{
+  struct sockaddr_storage native;
+  socklen_t len = sizeof (native);
+  GSocketAddress *address;
+  gchar *key;
+  gpointer old_fd;
+
+  if (getsockname (fd, (struct sockaddr *) &native, &len) != 0)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errno),
+                   "Failed to get inherited socket address: %s",
+                   g_strerror (errno));
+      return FALSE;
+    }
+
+  address = g_socket_address_new_from_native (&native, len);
+  key = address != NULL ? evd_socket_address_to_key (address) : NULL;
+  if (address != NULL)
+    g_object_unref (address);
+
+  if (key == NULL)
+    {
+      g_set_error_literal (error,
+                           G_IO_ERROR,
+                           G_IO_ERROR_NOT_SUPPORTED,
+                           "Socket family not supported");
+      return FALSE;
+    }
+
+  if (evd_socket_inherited == NULL)
+    evd_socket_inherited = g_hash_table_new_full (g_str_hash,
+                                                  g_str_equal,
+                                                  g_free,
+                                                  NULL);
+
+  old_fd = g_hash_table_lookup (evd_socket_inherited, key);
+  if (old_fd != NULL)
+    close (GPOINTER_TO_INT (old_fd) - 1);
+
+  g_hash_table_insert (evd_socket_inherited, key, GINT_TO_POINTER (fd + 1));
+
+  return TRUE;
+}
+
+static gboolean
+evd_socket_close_inherited (gpointer key, gpointer value, gpointer user_data)
+{
+  close (GPOINTER_TO_INT (value) - 1);
+
+  return TRUE;
+}
+
+/**
+ * evd_socket_drop_inherited_listeners:
+ *
+ * Closes the listeners handed over by another process that no socket
+ * has adopted, so that clients don't wait in a queue nobody accepts.
+ **/
+void
+evd_socket_drop_inherited_listeners (void)
+{
+  if (evd_socket_inherited == NULL)
+    return;
+
+  g_hash_table_foreach_remove (evd_socket_inherited,
+                               evd_socket_close_inherited,
+                               NULL);
+}
@@ -179,6 +179,11 @@ GIOStream      *evd_socket_connect_finish                (EvdSocket     *self,
                                                           GAsyncResult  *result,
                                                           GError       **error);
 
+GList          *evd_socket_get_listeners                 (void);
+gboolean        evd_socket_inherit_listener              (gint     fd,
+                                                          GError **error);
+void            evd_socket_drop_inherited_listeners      (void);
+
 G_END_DECLS
 
 #endif /* __EVD_SOCKET_H__ */
@@ -20,7 +20,6 @@
  * for more details.
  */
 
-#include <math.h>
 #include <string.h>
 
 #include "evd-stream-throttle.h"
@@ -31,17 +30,56 @@ G_DEFINE_TYPE (EvdStreamThrottle, evd_stream_throttle, G_TYPE_OBJECT)
                                               EVD_TYPE_STREAM_THROTTLE, \
                                               EvdStreamThrottlePrivate))
 
+/* default burst, as a fraction of a second of bandwidth */
+#define DEFAULT_BURST_DIVISOR 10
+
+/* a child counts for its parent's fair sharing if it asked for bandwidth
+   this recently, in microseconds */
+#define ACTIVE_WINDOW       100000
+#define ACTIVE_REFRESH       10000
+
+#define DEFAULT_WEIGHT 1
+#define MAX_WEIGHT     G_MAXUINT16
+
+/* GLib before 2.30 has no 64 bits atomics, use the compiler's */
+#define ATOMIC_GET(p)         (__sync_fetch_and_add ((p), 0))
+#define ATOMIC_SET(p, v)      (__sync_lock_test_and_set ((p), (v)))
+#define ATOMIC_ADD(p, v)      (__sync_fetch_and_add ((p), (v)))
+#define ATOMIC_CAS(p, o, n)   (__sync_bool_compare_and_swap ((p), (o), (n)))
+
 /* private data */
 struct _EvdStreamThrottlePrivate
 {
   gsize  bandwidth;
+  gsize  burst;
   gulong latency;
 
-  GTimeVal current_time;
-  gsize    bytes;
-  gsize    actual_bandwidth;
-  guint64  total;
-  GTimeVal last;
+  /* token bucket as a "theoretical arrival time": the instant (monotonic,
+     in microseconds) at which the bucket will be full again */
+  gint64 tat;
+
+  gint64 last;
+
+  gint64 window_start;
+  gsize  window_bytes;
+  gsize  actual_bandwidth;
+
+  guint64 total;
+
+  /* hierarchical fair sharing */
+  EvdStreamThrottle *parent;
+  guint weight;
+  gint64 share_tat;
+  gint64 last_request;
+
+  GList *children;
+  guint active_weight;
+  gint64 active_weight_time;
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+  GMutex *children_mutex;
+#else
+  GMutex children_mutex;
+#endif
 };
 
 /* properties */
@@ -49,15 +87,19 @@ enum
 {
   PROP_0,
   PROP_BANDWIDTH,
+  PROP_BURST,
   PROP_LATENCY,
-  PROP_TOTAL
+  PROP_TOTAL,
+  PROP_PARENT,
+  PROP_WEIGHT
 };
 
-G_LOCK_DEFINE_STATIC (counters);
-
 static void     evd_stream_throttle_class_init         (EvdStreamThrottleClass *class);
 static void     evd_stream_throttle_init               (EvdStreamThrottle *self);
 
+static void     evd_stream_throttle_dispose            (GObject *obj);
+static void     evd_stream_throttle_finalize           (GObject *obj);
+
 static void     evd_stream_throttle_set_property       (GObject      *obj,
                                                         guint         prop_id,
                                                         const GValue *value,
@@ -74,6 +116,8 @@ evd_stream_throttle_class_init (EvdStreamThrottleClass *class)
 
   obj_class = G_OBJECT_CLASS (class);
 
+  obj_class->dispose = evd_stream_throttle_dispose;
+  obj_class->finalize = evd_stream_throttle_finalize;
   obj_class->get_property = evd_stream_throttle_get_property;
   obj_class->set_property = evd_stream_throttle_set_property;
 
@@ -87,6 +131,16 @@ evd_stream_throttle_class_init (EvdStreamThrottleClass *class)
                                                        G_PARAM_READWRITE |
                                                        G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (obj_class, PROP_BURST,
+                                   g_param_spec_float ("burst",
+                                                       "Burst size",
+                                                       "The maximum kilobytes allowed at once above the bandwidth rate, 0 for a tenth of a second of bandwidth",
+                                                       0.0,
+                                                       G_MAXFLOAT,
+                                                       0.0,
+                                                       G_PARAM_READWRITE |
+                                                       G_PARAM_STATIC_STRINGS));
+
   g_object_class_install_property (obj_class, PROP_LATENCY,
                                    g_param_spec_float ("latency",
                                                        "Minimum latency",
@@ -107,6 +161,24 @@ evd_stream_throttle_class_init (EvdStreamThrottleClass *class)
                                                         G_PARAM_READABLE |
                                                         G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (obj_class, PROP_PARENT,
+                                   g_param_spec_object ("parent",
+                                                        "Parent throttle",
+                                                        "The throttle whose bandwidth this one shares fairly with its siblings",
+                                                        EVD_TYPE_STREAM_THROTTLE,
+                                                        G_PARAM_READWRITE |
+                                                        G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_WEIGHT,
+                                   g_param_spec_uint ("weight",
+                                                      "Weight",
+                                                      "The relative share of the parent's bandwidth this throttle gets",
+                                                      1,
+                                                      MAX_WEIGHT,
+                                                      DEFAULT_WEIGHT,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
   g_type_class_add_private (obj_class, sizeof (EvdStreamThrottlePrivate));
 }
 
@@ -119,14 +191,58 @@ evd_stream_throttle_init (EvdStreamThrottle *self)
   self->priv = priv;
 
   priv->bandwidth = 0;
+  priv->burst = 0;
   priv->latency = 0;
 
-  priv->current_time.tv_sec = 0;
-  priv->current_time.tv_usec = 0;
+  priv->tat = 0;
+  priv->last = 0;
 
-  priv->bytes = 0;
-  priv->total = 0;
+  priv->window_start = g_get_monotonic_time ();
+  priv->window_bytes = 0;
   priv->actual_bandwidth = 0;
+
+  priv->total = 0;
+
+  priv->parent = NULL;
+  priv->weight = DEFAULT_WEIGHT;
+  priv->share_tat = 0;
+  priv->last_request = 0;
+
+  priv->children = NULL;
+  priv->active_weight = 0;
+  priv->active_weight_time = 0;
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+  priv->children_mutex = g_mutex_new ();
+#else
+  g_mutex_init (&priv->children_mutex);
+#endif
+}
+
+static void
+evd_stream_throttle_dispose (GObject *obj)
+{
+  EvdStreamThrottle *self = EVD_STREAM_THROTTLE (obj);
+
+  evd_stream_throttle_set_parent (self, NULL);
+
+  G_OBJECT_CLASS (evd_stream_throttle_parent_class)->dispose (obj);
+}
+
+static void
+evd_stream_throttle_finalize (GObject *obj)
+{
+  EvdStreamThrottle *self = EVD_STREAM_THROTTLE (obj);
+
+  /* children keep a reference to their parent */
+  g_assert (self->priv->children == NULL);
+
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+  g_mutex_free (self->priv->children_mutex);
+#else
+  g_mutex_clear (&self->priv->children_mutex);
+#endif
+
+  G_OBJECT_CLASS (evd_stream_throttle_parent_class)->finalize (obj);
 }
 
 static void
@@ -145,6 +261,10 @@ evd_stream_throttle_set_property (GObject      *obj,
       self->priv->bandwidth = (gsize) (g_value_get_float (value) * 1024.0);
       break;
 
+    case PROP_BURST:
+      self->priv->burst = (gsize) (g_value_get_float (value) * 1024.0);
+      break;
+
       /* Latency properties are in miliseconds, but we store the value
          internally  in microseconds, to allow up to 1/1000 fraction of a
          milisecond */
@@ -152,6 +272,14 @@ evd_stream_throttle_set_property (GObject      *obj,
       self->priv->latency = (gulong) (g_value_get_float (value) * 1000.0);
       break;
 
+    case PROP_PARENT:
+      evd_stream_throttle_set_parent (self, g_value_get_object (value));
+      break;
+
+    case PROP_WEIGHT:
+      self->priv->weight = g_value_get_uint (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
       break;
@@ -174,6 +302,10 @@ evd_stream_throttle_get_property (GObject    *obj,
       g_value_set_float (value, self->priv->bandwidth / 1024.0);
       break;
 
+    case PROP_BURST:
+      g_value_set_float (value, self->priv->burst / 1024.0);
+      break;
+
       /* Latency values are stored in microseconds internally */
     case PROP_LATENCY:
       g_value_set_float (value, self->priv->latency / 1000.0);
@@ -183,94 +315,277 @@ evd_stream_throttle_get_property (GObject    *obj,
       g_value_set_uint64 (value, evd_stream_throttle_get_total (self));
       break;
 
+    case PROP_PARENT:
+      g_value_set_object (value, self->priv->parent);
+      break;
+
+    case PROP_WEIGHT:
+      g_value_set_uint (value, self->priv->weight);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
       break;
     }
 }
 
-static void
-evd_stream_throttle_update_current_time (EvdStreamThrottle *self)
+static gsize
+evd_stream_throttle_get_burst (EvdStreamThrottle *self, gsize bandwidth)
 {
-  GTimeVal time_val;
-
-  g_get_current_time (&time_val);
-
-  if (time_val.tv_sec != self->priv->current_time.tv_sec)
-    {
-      G_LOCK (counters);
-
-      self->priv->actual_bandwidth = self->priv->bytes;
-      self->priv->bytes = 0;
-
-      G_UNLOCK (counters);
-    }
-
-  g_memmove (&self->priv->current_time, &time_val, sizeof (GTimeVal));
+  if (self->priv->burst > 0)
+    return self->priv->burst;
+  else
+    return MAX (bandwidth / DEFAULT_BURST_DIVISOR, 1);
 }
 
-static gulong
-g_timeval_get_diff_micro (GTimeVal *time1, GTimeVal *time2)
+/* microseconds the bucket needs to refill @size bytes */
+static gint64
+evd_stream_throttle_bytes_to_usec (gsize bandwidth, gsize size)
 {
-  gulong result;
-
-  result = ABS (time2->tv_sec - time1->tv_sec) * G_USEC_PER_SEC;
-  result += ABS (time2->tv_usec - time1->tv_usec);
+  return ((gint64) size * G_USEC_PER_SEC + bandwidth - 1) / bandwidth;
+}
 
-  return result;
+static void
+evd_stream_throttle_set_wait (guint *wait, gint64 wait_usec)
+{
+  if (wait != NULL && wait_usec > 0)
+    *wait = MAX ((guint) ((wait_usec + 999) / 1000) + 1, *wait);
 }
 
 static gsize
 evd_stream_throttle_request_internal (EvdStreamThrottle *self,
-                                      gsize              bandwidth,
-                                      gulong             latency,
-                                      gsize              bytes,
-                                      GTimeVal          *last,
+                                      gint64             now,
                                       gsize              size,
                                       guint             *wait)
 {
+  gsize bandwidth;
+  gulong latency;
   gsize actual_size = size;
+  gint64 wait_usec = 0;
 
-  if ( (wait != NULL) && (*wait < 0) )
-    *wait = 0;
-
-  G_LOCK (counters);
+  bandwidth = self->priv->bandwidth;
+  latency = self->priv->latency;
 
   /*  latency check */
   if (latency > 0)
     {
-      gulong elapsed;
+      gint64 elapsed;
 
-      elapsed = g_timeval_get_diff_micro (&self->priv->current_time,
-                                          last);
+      elapsed = now - ATOMIC_GET (&self->priv->last);
 
-      if (elapsed < latency)
+      if (elapsed < (gint64) latency)
         {
           actual_size = 0;
-
-          if (wait != NULL)
-            *wait = MAX ((gulong) (latency - elapsed) / 1000 + 2,
-                         *wait);
+          wait_usec = latency - elapsed;
         }
     }
 
   /* bandwidth check */
-  if ( (bandwidth > 0) && (actual_size > 0) )
+  if (bandwidth > 0 && actual_size > 0)
     {
-      actual_size = MAX ((gssize) (bandwidth - bytes), 0);
-      actual_size = MIN (actual_size, size);
+      gsize burst;
+      gint64 tat;
+      gint64 tau;
+      gint64 room;
+
+      burst = evd_stream_throttle_get_burst (self, bandwidth);
+      tau = evd_stream_throttle_bytes_to_usec (bandwidth, burst);
+
+      tat = MAX (ATOMIC_GET (&self->priv->tat), now);
+
+      /* the bucket holds what fits between now + tau and the tat */
+      room = now + tau - tat;
+      if (room > 0)
+        actual_size = MIN ((gint64) size,
+                           room * (gint64) bandwidth / G_USEC_PER_SEC);
+      else
+        actual_size = 0;
+
+      if (actual_size < size)
+        {
+          gsize missing;
 
-      if (wait != NULL)
-        if (actual_size < size)
-          *wait = MAX ((guint) (((1000001 - self->priv->current_time.tv_usec) / 1000)) + 1,
-                       *wait);
+          /* until the rest fits, assuming what's granted now gets used */
+          missing = MIN (size - actual_size, burst);
+          tat += evd_stream_throttle_bytes_to_usec (bandwidth,
+                                                    actual_size + missing);
+
+          wait_usec = MAX (wait_usec, tat - tau - now);
+        }
     }
 
-  G_UNLOCK (counters);
+  evd_stream_throttle_set_wait (wait, wait_usec);
 
   return actual_size;
 }
 
+/* sum of the weights of the children that asked for bandwidth lately */
+static guint
+evd_stream_throttle_get_active_weight (EvdStreamThrottle *self, gint64 now)
+{
+  GList *node;
+  guint weight = 0;
+
+  if (now - ATOMIC_GET (&self->priv->active_weight_time) < ACTIVE_REFRESH)
+    return g_atomic_int_get (&self->priv->active_weight);
+
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+  g_mutex_lock (self->priv->children_mutex);
+#else
+  g_mutex_lock (&self->priv->children_mutex);
+#endif
+
+  for (node = self->priv->children; node != NULL; node = node->next)
+    {
+      EvdStreamThrottle *child = node->data;
+
+      if (now - ATOMIC_GET (&child->priv->last_request) < ACTIVE_WINDOW)
+        weight += child->priv->weight;
+    }
+
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+  g_mutex_unlock (self->priv->children_mutex);
+#else
+  g_mutex_unlock (&self->priv->children_mutex);
+#endif
+
+  g_atomic_int_set (&self->priv->active_weight, weight);
+  ATOMIC_SET (&self->priv->active_weight_time, now);
+
+  return weight;
+}
+
+/* the part of the parent's bandwidth that belongs to @child */
+static gsize
+evd_stream_throttle_get_share (EvdStreamThrottle *self,
+                               EvdStreamThrottle *child,
+                               gint64             now,
+                               gsize             *burst)
+{
+  guint total_weight;
+  guint weight;
+  gsize bandwidth;
+  gsize parent_burst;
+
+  bandwidth = self->priv->bandwidth;
+  if (bandwidth == 0)
+    return 0;
+
+  weight = child->priv->weight;
+  total_weight = evd_stream_throttle_get_active_weight (self, now);
+  if (total_weight <= weight)
+    return 0;
+
+  parent_burst = evd_stream_throttle_get_burst (self, bandwidth);
+  *burst = MAX ((gsize) ((gdouble) parent_burst * weight / total_weight), 1);
+
+  return MAX ((gsize) ((gdouble) bandwidth * weight / total_weight), 1);
+}
+
+static gsize evd_stream_throttle_request_full (EvdStreamThrottle *self,
+                                               gint64             now,
+                                               gsize              size,
+                                               guint             *wait);
+
+/* Weighted fair sharing: each active child gets its own bucket refilling
+   at its weighted part of the parent's bandwidth. A child may go above
+   its part by borrowing what is left in the parent's bucket after setting
+   aside the bursts of its active siblings, so idle bandwidth is not
+   wasted but a bulk transfer can't drain what interactive siblings need. */
+static gsize
+evd_stream_throttle_request_share (EvdStreamThrottle *self,
+                                   EvdStreamThrottle *child,
+                                   gint64             now,
+                                   gsize              size,
+                                   guint             *wait)
+{
+  gsize parent_size;
+  gsize rate;
+  gsize burst = 0;
+  gsize share_size;
+  gsize reserve;
+  gsize borrow;
+  gint64 tau;
+  gint64 tat;
+  gint64 room;
+
+  ATOMIC_SET (&child->priv->last_request, now);
+
+  parent_size = evd_stream_throttle_request_full (self, now, size, wait);
+  if (parent_size == 0)
+    return 0;
+
+  rate = evd_stream_throttle_get_share (self, child, now, &burst);
+  if (rate == 0)
+    return parent_size;
+
+  tau = evd_stream_throttle_bytes_to_usec (rate, burst);
+  tat = MAX (ATOMIC_GET (&child->priv->share_tat), now);
+
+  room = now + tau - tat;
+  if (room > 0)
+    share_size = MIN ((gint64) size, room * (gint64) rate / G_USEC_PER_SEC);
+  else
+    share_size = 0;
+
+  reserve = evd_stream_throttle_get_burst (self, self->priv->bandwidth) - burst;
+  borrow = parent_size > reserve ? parent_size - reserve : 0;
+
+  if (share_size < size && borrow < size)
+    {
+      gsize missing;
+
+      missing = MIN (size - share_size, burst);
+      tat += evd_stream_throttle_bytes_to_usec (rate, share_size + missing);
+
+      evd_stream_throttle_set_wait (wait, tat - tau - now);
+    }
+
+  return MIN (parent_size, MAX (share_size, borrow));
+}
+
+static gsize
+evd_stream_throttle_request_full (EvdStreamThrottle *self,
+                                  gint64             now,
+                                  gsize              size,
+                                  guint             *wait)
+{
+  size = evd_stream_throttle_request_internal (self, now, size, wait);
+
+  if (size > 0 && self->priv->parent != NULL)
+    size = evd_stream_throttle_request_share (self->priv->parent,
+                                              self,
+                                              now,
+                                              size,
+                                              wait);
+
+  return size;
+}
+
+static void
+evd_stream_throttle_update_actual_bandwidth (EvdStreamThrottle *self,
+                                             gint64             now)
+{
+  gint64 start;
+  gint64 elapsed;
+  gsize bytes;
+
+  start = ATOMIC_GET (&self->priv->window_start);
+  elapsed = now - start;
+
+  if (elapsed < G_USEC_PER_SEC ||
+      ! ATOMIC_CAS (&self->priv->window_start, start, now))
+    return;
+
+  /* the winner of the CAS takes the window's bytes */
+  do
+    bytes = ATOMIC_GET (&self->priv->window_bytes);
+  while (! ATOMIC_CAS (&self->priv->window_bytes, bytes, 0));
+
+  ATOMIC_SET (&self->priv->actual_bandwidth,
+              (gsize) ((gint64) bytes * G_USEC_PER_SEC / elapsed));
+}
+
 /* public methods */
 
 EvdStreamThrottle *
@@ -290,34 +605,67 @@ evd_stream_throttle_request  (EvdStreamThrottle *self,
 {
   g_return_val_if_fail (EVD_IS_STREAM_THROTTLE (self), -1);
 
-  evd_stream_throttle_update_current_time (self);
-
-  return evd_stream_throttle_request_internal (self,
-                                               self->priv->bandwidth,
-                                               self->priv->latency,
-                                               self->priv->bytes,
-                                               &self->priv->last,
-                                               size,
-                                               wait);
+  return evd_stream_throttle_request_full (self,
+                                           g_get_monotonic_time (),
+                                           size,
+                                           wait);
 }
 
 void
 evd_stream_throttle_report (EvdStreamThrottle *self, gsize size)
 {
+  gint64 now;
+  gsize bandwidth;
+
   g_return_if_fail (EVD_IS_STREAM_THROTTLE (self));
 
-  evd_stream_throttle_update_current_time (self);
+  now = g_get_monotonic_time ();
+
+  bandwidth = self->priv->bandwidth;
+  if (bandwidth > 0)
+    {
+      gint64 cost;
+      gint64 tat;
+
+      cost = evd_stream_throttle_bytes_to_usec (bandwidth, size);
+
+      do
+        tat = ATOMIC_GET (&self->priv->tat);
+      while (! ATOMIC_CAS (&self->priv->tat, tat, MAX (tat, now) + cost));
+    }
+
+  ATOMIC_ADD (&self->priv->window_bytes, size);
+  ATOMIC_ADD (&self->priv->total, size);
+
+  ATOMIC_SET (&self->priv->last, now);
 
-  G_LOCK (counters);
+  evd_stream_throttle_update_actual_bandwidth (self, now);
 
-  self->priv->bytes += size;
-  self->priv->total += size;
+  if (self->priv->parent != NULL)
+    {
+      gsize rate;
+      gsize burst;
+
+      rate = evd_stream_throttle_get_share (self->priv->parent,
+                                            self,
+                                            now,
+                                            &burst);
+      if (rate > 0)
+        {
+          gint64 cost;
+          gint64 tat;
 
-  g_memmove (&self->priv->last,
-             &self->priv->current_time,
-             sizeof (GTimeVal));
+          cost = evd_stream_throttle_bytes_to_usec (rate, size);
 
-  G_UNLOCK (counters);
+          do
+            tat = ATOMIC_GET (&self->priv->share_tat);
+          while (! ATOMIC_CAS (&self->priv->share_tat,
+                               tat,
+                               MAX (tat, now) + cost));
+        }
+
+      evd_stream_throttle_report (self->priv->parent, size);
+    }
 }
 
 gfloat
@@ -325,6 +673,8 @@ evd_stream_throttle_get_actual_bandwidth (EvdStreamThrottle *self)
 {
   g_return_val_if_fail (EVD_IS_STREAM_THROTTLE (self), -1.0);
 
+  evd_stream_throttle_update_actual_bandwidth (self, g_get_monotonic_time ());
+
   return self->priv->actual_bandwidth / 1024.0;
 }
 
@@ -333,5 +683,94 @@ evd_stream_throttle_get_total (EvdStreamThrottle *self)
 {
   g_return_val_if_fail (EVD_IS_STREAM_THROTTLE (self), 0);
 
-  return self->priv->total;
+  return ATOMIC_GET (&self->priv->total);
+}
+
+/**
+ * evd_stream_throttle_set_parent:
+ * @parent: (allow-none):
+ *
+ * Makes @self take its bandwidth out of @parent's, sharing it with the
+ * other children of @parent in proportion to their weights. Whatever
+ * is reported to @self is also reported to @parent.
+ *
+ * Returns: %FALSE if @self is @parent or one of its ancestors, in which
+ * case nothing is changed, %TRUE otherwise
+ **/
+gboolean
+evd_stream_throttle_set_parent (EvdStreamThrottle *self,
+                                EvdStreamThrottle *parent)
+{
+  EvdStreamThrottle *ancestor;
+
+  g_return_val_if_fail (EVD_IS_STREAM_THROTTLE (self), FALSE);
+  g_return_val_if_fail (parent == NULL || EVD_IS_STREAM_THROTTLE (parent),
+                        FALSE);
+
+  /* refuse cycles */
+  for (ancestor = parent; ancestor != NULL; ancestor = ancestor->priv->parent)
+    if (ancestor == self)
+      return FALSE;
+
+  if (parent == self->priv->parent)
+    return TRUE;
+
+  if (self->priv->parent != NULL)
+    {
+      EvdStreamThrottle *old_parent = self->priv->parent;
+
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+      g_mutex_lock (old_parent->priv->children_mutex);
+#else
+      g_mutex_lock (&old_parent->priv->children_mutex);
+#endif
+
+      old_parent->priv->children = g_list_remove (old_parent->priv->children,
+                                                  self);
+
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+      g_mutex_unlock (old_parent->priv->children_mutex);
+#else
+      g_mutex_unlock (&old_parent->priv->children_mutex);
+#endif
+
+      self->priv->parent = NULL;
+      g_object_unref (old_parent);
+    }
+
+  self->priv->share_tat = 0;
+
+  if (parent != NULL)
+    {
+      self->priv->parent = g_object_ref (parent);
+
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+      g_mutex_lock (parent->priv->children_mutex);
+#else
+      g_mutex_lock (&parent->priv->children_mutex);
+#endif
+
+      parent->priv->children = g_list_prepend (parent->priv->children, self);
+
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+      g_mutex_unlock (parent->priv->children_mutex);
+#else
+      g_mutex_unlock (&parent->priv->children_mutex);
+#endif
+    }
+
+  return TRUE;
+}
+
+/**
+ * evd_stream_throttle_get_parent:
+ *
+ * Returns: (transfer none):
+ **/
+EvdStreamThrottle *
+evd_stream_throttle_get_parent (EvdStreamThrottle *self)
+{
+  g_return_val_if_fail (EVD_IS_STREAM_THROTTLE (self), NULL);
+
+  return self->priv->parent;
 }
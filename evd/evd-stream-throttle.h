@@ -69,6 +69,10 @@ gfloat             evd_stream_throttle_get_actual_bandwidth (EvdStreamThrottle *
 
 guint64            evd_stream_throttle_get_total            (EvdStreamThrottle *self);
 
+gboolean           evd_stream_throttle_set_parent           (EvdStreamThrottle *self,
+                                                             EvdStreamThrottle *parent);
+EvdStreamThrottle *evd_stream_throttle_get_parent           (EvdStreamThrottle *self);
+
 G_END_DECLS
 
 #endif /* __EVD_STREAM_THROTTLE_H__ */
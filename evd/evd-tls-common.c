@@ -35,6 +35,24 @@ static gboolean evd_tls_initialized = FALSE;
 
 static EvdTlsDhGenerator *evd_tls_dh_gen;
 
+static gchar *evd_tls_dh_cache_dir = NULL;
+static guint evd_tls_dh_max_age = 0;
+static gboolean evd_tls_dh_use_ffdhe = FALSE;
+
+#define DEFAULT_MAX_WORKER_THREADS 4
+
+typedef struct
+{
+  GSimpleAsyncResult *result;
+  GSimpleAsyncThreadFunc func;
+  GObject *object;
+  GCancellable *cancellable;
+} EvdTlsWorkerJob;
+
+G_LOCK_DEFINE_STATIC (evd_tls_worker_pool);
+static GThreadPool *evd_tls_worker_pool = NULL;
+static gint evd_tls_max_worker_threads = DEFAULT_MAX_WORKER_THREADS;
+
 gboolean
 evd_tls_init (GError **error)
 {
@@ -58,6 +76,12 @@ evd_tls_init (GError **error)
       if (! evd_error_propagate_gnutls (err_code, error))
         {
           evd_tls_dh_gen = evd_tls_dh_generator_new ();
+          evd_tls_dh_generator_set_cache_dir (evd_tls_dh_gen,
+                                              evd_tls_dh_cache_dir);
+          evd_tls_dh_generator_set_max_age (evd_tls_dh_gen,
+                                            evd_tls_dh_max_age);
+          evd_tls_dh_generator_set_use_ffdhe (evd_tls_dh_gen,
+                                              evd_tls_dh_use_ffdhe);
 
           result = TRUE;
         }
@@ -82,6 +106,7 @@ evd_tls_deinit (void)
   if (evd_tls_initialized)
     {
       g_object_unref (evd_tls_dh_gen);
+      evd_tls_dh_gen = NULL;
 
       /* check why after calling 'gnutls_global_deinit', calling again
          'gnutls_global_init' throws a segfault */
@@ -145,3 +170,192 @@ evd_tls_generate_dh_params_finish (GAsyncResult  *result,
                                                result,
                                                error);
 }
+
+/**
+ * evd_tls_set_dh_params_cache_dir:
+ * @cache_dir: (allow-none): A directory path, or %NULL to disable persistence
+ *
+ * Sets the directory where generated DH params are saved and loaded from,
+ * so they survive restarts. Call this before evd_tls_init().
+ **/
+void
+evd_tls_set_dh_params_cache_dir (const gchar *cache_dir)
+{
+  G_LOCK (evd_tls_init);
+
+  g_free (evd_tls_dh_cache_dir);
+  evd_tls_dh_cache_dir = g_strdup (cache_dir);
+
+  if (evd_tls_initialized)
+    evd_tls_dh_generator_set_cache_dir (evd_tls_dh_gen, cache_dir);
+
+  G_UNLOCK (evd_tls_init);
+}
+
+/**
+ * evd_tls_set_dh_params_max_age:
+ * @max_age: Lifetime of DH params in seconds, or 0 to never rotate them
+ *
+ * DH params older than @max_age are regenerated in background.
+ **/
+void
+evd_tls_set_dh_params_max_age (guint max_age)
+{
+  G_LOCK (evd_tls_init);
+
+  evd_tls_dh_max_age = max_age;
+  if (evd_tls_initialized)
+    evd_tls_dh_generator_set_max_age (evd_tls_dh_gen, max_age);
+
+  G_UNLOCK (evd_tls_init);
+}
+
+/**
+ * evd_tls_set_dh_params_use_ffdhe:
+ * @use_ffdhe: Whether to use RFC 7919 FFDHE groups
+ *
+ * If %TRUE, DH params of 2048, 3072 and 4096 bits come from the predefined
+ * RFC 7919 groups and are never generated.
+ **/
+void
+evd_tls_set_dh_params_use_ffdhe (gboolean use_ffdhe)
+{
+  G_LOCK (evd_tls_init);
+
+  evd_tls_dh_use_ffdhe = use_ffdhe;
+  if (evd_tls_initialized)
+    evd_tls_dh_generator_set_use_ffdhe (evd_tls_dh_gen, use_ffdhe);
+
+  G_UNLOCK (evd_tls_init);
+}
+
+/**
+ * evd_tls_pregenerate_dh_params:
+ * @bit_length: Bit depth of the DH params
+ *
+ * Starts loading or generating DH params in background, e.g. at startup
+ * before any TLS listener is created. Requires evd_tls_init().
+ **/
+void
+evd_tls_pregenerate_dh_params (guint bit_length)
+{
+  g_return_if_fail (evd_tls_dh_gen != NULL);
+
+  evd_tls_dh_generator_pregenerate (evd_tls_dh_gen, bit_length);
+}
+
+/**
+ * evd_tls_get_dh_params:
+ * @bit_length: Bit depth of the DH params
+ *
+ * Returns: (transfer full): the current DH params of @bit_length, or %NULL
+ * if they are not ready. Release them with evd_tls_release_dh_params().
+ *
+ * Since: 0.2.0
+ **/
+gpointer
+evd_tls_get_dh_params (guint bit_length)
+{
+  g_return_val_if_fail (evd_tls_dh_gen != NULL, NULL);
+
+  return evd_tls_dh_generator_get_params (evd_tls_dh_gen, bit_length);
+}
+
+/**
+ * evd_tls_release_dh_params:
+ * @dh_params: (allow-none): DH params from evd_tls_get_dh_params()
+ *
+ * Since: 0.2.0
+ **/
+void
+evd_tls_release_dh_params (gpointer dh_params)
+{
+  if (dh_params == NULL || evd_tls_dh_gen == NULL)
+    return;
+
+  evd_tls_dh_generator_unref_params (evd_tls_dh_gen, dh_params);
+}
+
+static void
+evd_tls_worker_thread (gpointer data, gpointer user_data)
+{
+  EvdTlsWorkerJob *job = data;
+
+  job->func (job->result, job->object, job->cancellable);
+
+  g_simple_async_result_complete_in_idle (job->result);
+
+  g_object_unref (job->result);
+  if (job->object != NULL)
+    g_object_unref (job->object);
+  if (job->cancellable != NULL)
+    g_object_unref (job->cancellable);
+  g_slice_free (EvdTlsWorkerJob, job);
+}
+
+/**
+ * evd_tls_set_max_worker_threads:
+ * @max_threads: maximum number of threads, or -1 for no limit
+ *
+ * Sets the maximum number of threads used to run CPU-bound TLS and PKI
+ * operations (like threaded handshakes or batched signing) off the main loop.
+ * Defaults to 4.
+ **/
+void
+evd_tls_set_max_worker_threads (gint max_threads)
+{
+  G_LOCK (evd_tls_worker_pool);
+
+  evd_tls_max_worker_threads = max_threads;
+  if (evd_tls_worker_pool != NULL)
+    g_thread_pool_set_max_threads (evd_tls_worker_pool, max_threads, NULL);
+
+  G_UNLOCK (evd_tls_worker_pool);
+}
+
+gint
+evd_tls_get_max_worker_threads (void)
+{
+  return evd_tls_max_worker_threads;
+}
+
+/**
+ * evd_tls_run_in_worker_thread:
+ * @result: a #GSimpleAsyncResult
+ * @func: (scope async): the function to run
+ * @object: (allow-none): the object to pass to @func
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ *
+ * Like g_simple_async_result_run_in_thread(), but @func runs on the bounded
+ * TLS worker pool. @result is completed in idle once @func returns.
+ **/
+void
+evd_tls_run_in_worker_thread (GSimpleAsyncResult     *result,
+                              GSimpleAsyncThreadFunc  func,
+                              GObject                *object,
+                              GCancellable           *cancellable)
+{
+  EvdTlsWorkerJob *job;
+
+  g_return_if_fail (G_IS_SIMPLE_ASYNC_RESULT (result));
+  g_return_if_fail (func != NULL);
+
+  job = g_slice_new (EvdTlsWorkerJob);
+  job->result = g_object_ref (result);
+  job->func = func;
+  job->object = object != NULL ? g_object_ref (object) : NULL;
+  job->cancellable = cancellable != NULL ? g_object_ref (cancellable) : NULL;
+
+  G_LOCK (evd_tls_worker_pool);
+
+  if (evd_tls_worker_pool == NULL)
+    evd_tls_worker_pool = g_thread_pool_new (evd_tls_worker_thread,
+                                             NULL,
+                                             evd_tls_max_worker_threads,
+                                             FALSE,
+                                             NULL);
+
+  g_thread_pool_push (evd_tls_worker_pool, job, NULL);
+
+  G_UNLOCK (evd_tls_worker_pool);
+}
@@ -73,6 +73,21 @@ void     evd_tls_generate_dh_params        (guint                bit_length,
 gpointer evd_tls_generate_dh_params_finish (GAsyncResult  *result,
                                             GError       **error);
 
+void     evd_tls_set_dh_params_cache_dir   (const gchar *cache_dir);
+void     evd_tls_set_dh_params_max_age     (guint max_age);
+void     evd_tls_set_dh_params_use_ffdhe   (gboolean use_ffdhe);
+void     evd_tls_pregenerate_dh_params     (guint bit_length);
+gpointer evd_tls_get_dh_params             (guint bit_length);
+void     evd_tls_release_dh_params         (gpointer dh_params);
+
+void     evd_tls_set_max_worker_threads    (gint max_threads);
+gint     evd_tls_get_max_worker_threads    (void);
+
+void     evd_tls_run_in_worker_thread      (GSimpleAsyncResult     *result,
+                                            GSimpleAsyncThreadFunc  func,
+                                            GObject                *object,
+                                            GCancellable           *cancellable);
+
 G_END_DECLS
 
 #endif /* __EVD_TLS_COMMON_H__ */
@@ -20,6 +20,7 @@
  * for more details.
  */
 
+#include <string.h>
 #include <gnutls/openpgp.h>
 #include <gnutls/x509.h>
 
@@ -35,6 +36,62 @@ G_DEFINE_TYPE (EvdTlsCredentials, evd_tls_credentials, G_TYPE_OBJECT)
 
 #define MAX_DYNAMIC_CERTS 8
 
+#define DEFAULT_SESSION_CACHE_SIZE      0 /* disabled */
+#define DEFAULT_SESSION_CACHE_TIMEOUT   3600 /* in seconds */
+#define DEFAULT_TICKET_KEY_LIFETIME     3600 /* in seconds */
+#define DEFAULT_SNI_CACHE_SIZE           128
+
+#define SNI_CERT_DATA_KEY "org.eventdance.lib.TlsCredentials.sni-cert"
+#define CERT_CB_DATA_KEY  "org.eventdance.lib.TlsCredentials.cert-cb"
+
+typedef struct
+{
+  gchar *key;
+  gsize key_size;
+  gchar *data;
+  gsize data_size;
+  gint64 expires;
+  GList *lru_link;
+} EvdTlsCacheEntry;
+
+/* a parsed certificate chain and key, shared by the sessions using it */
+typedef struct
+{
+  gint ref_count;
+  gnutls_x509_crt_t *certs;
+  guint ncerts;
+  gnutls_x509_privkey_t key;
+} EvdTlsSniCert;
+
+typedef struct
+{
+  gchar *name;
+  gchar *cert_file;
+  gchar *key_file;
+  EvdTlsSniCert *cert;
+  GList *lru_link;
+} EvdTlsSniEntry;
+
+/* state of one certificate request, kept by the session that made it */
+typedef struct
+{
+  EvdTlsCredentials *self;
+  EvdTlsSession *session;
+  gnutls_retr2_st *st;
+  gpointer certs[MAX_DYNAMIC_CERTS];
+  gint result;
+
+  /* only used when the request comes from a handshake worker thread */
+  gboolean done;
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+  GMutex *mutex;
+  GCond *cond;
+#else
+  GMutex mutex;
+  GCond cond;
+#endif
+} CertCbData;
+
 /* private data */
 struct _EvdTlsCredentialsPrivate
 {
@@ -42,6 +99,7 @@ struct _EvdTlsCredentialsPrivate
 
   guint              dh_bits;
   gnutls_dh_params_t dh_params;
+  gnutls_dh_params_t prev_dh_params;
 
   gboolean ready;
   gboolean preparing;
@@ -49,15 +107,42 @@ struct _EvdTlsCredentialsPrivate
   EvdTlsCredentialsCertCb cert_cb;
   gpointer cert_cb_user_data;
   GDestroyNotify cert_cb_user_data_free_func;
-  gpointer cert_cb_certs[MAX_DYNAMIC_CERTS];
-  gnutls_retr2_st *cert_cb_ret_st;
-  gboolean inside_cert_cb;
-  gint cert_cb_result;
+  GMainContext *cert_cb_context;
+  GThread *cert_cb_thread;
+  CertCbData *current_cert_cb;
 
   guint async_ops_count;
 
   GList *x509_privkeys;
   GList *openpgp_privkeys;
+
+  /* server-side session resumption */
+  guint session_cache_size;
+  guint session_cache_timeout;
+  GHashTable *session_cache;
+  GQueue *session_cache_lru;
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+  GMutex *session_cache_mutex;
+#else
+  GMutex session_cache_mutex;
+#endif
+
+  gboolean session_tickets;
+  guint ticket_key_lifetime;
+  gnutls_datum_t ticket_key;
+  gint64 ticket_key_expires;
+
+  /* certificates indexed by server name (SNI) */
+  gboolean sni_enabled;
+  gchar *sni_dir;
+  guint sni_cache_size;
+  GHashTable *sni_index;
+  GQueue *sni_lru;
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+  GMutex *sni_mutex;
+#else
+  GMutex sni_mutex;
+#endif
 };
 
 struct CertData
@@ -79,7 +164,12 @@ static guint evd_tls_credentials_signals[SIGNAL_LAST] = { 0 };
 enum
 {
   PROP_0,
-  PROP_DH_BITS
+  PROP_DH_BITS,
+  PROP_SESSION_CACHE_SIZE,
+  PROP_SESSION_CACHE_TIMEOUT,
+  PROP_SESSION_TICKETS,
+  PROP_TICKET_KEY_LIFETIME,
+  PROP_SNI_CACHE_SIZE
 };
 
 static void     evd_tls_credentials_class_init         (EvdTlsCredentialsClass *class);
@@ -100,6 +190,16 @@ static void     evd_tls_credentials_get_property       (GObject    *obj,
 static void     evd_tls_credentials_free_x509_key      (gpointer data);
 static void     evd_tls_credentials_free_openpgp_key   (gpointer data);
 
+static void     evd_tls_credentials_free_cache_entry   (gpointer data);
+static guint    evd_tls_credentials_cache_entry_hash   (gconstpointer key);
+static gboolean evd_tls_credentials_cache_entry_equal  (gconstpointer a,
+                                                        gconstpointer b);
+
+static void     evd_tls_credentials_free_sni_entry     (gpointer data);
+static void     evd_tls_credentials_sni_lock           (EvdTlsCredentials *self);
+static void     evd_tls_credentials_sni_unlock         (EvdTlsCredentials *self);
+static void     evd_tls_credentials_sni_trim           (EvdTlsCredentials *self);
+
 static void
 evd_tls_credentials_class_init (EvdTlsCredentialsClass *class)
 {
@@ -132,6 +232,54 @@ evd_tls_credentials_class_init (EvdTlsCredentialsClass *class)
                                                       G_PARAM_READWRITE |
                                                       G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (obj_class, PROP_SESSION_CACHE_SIZE,
+                                   g_param_spec_uint ("session-cache-size",
+                                                      "Session cache size",
+                                                      "Maximum number of server-side TLS sessions kept for resumption, 0 to disable the cache",
+                                                      0,
+                                                      G_MAXUINT,
+                                                      DEFAULT_SESSION_CACHE_SIZE,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_SESSION_CACHE_TIMEOUT,
+                                   g_param_spec_uint ("session-cache-timeout",
+                                                      "Session cache timeout",
+                                                      "Time in seconds a cached TLS session can be resumed",
+                                                      1,
+                                                      G_MAXUINT,
+                                                      DEFAULT_SESSION_CACHE_TIMEOUT,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_SESSION_TICKETS,
+                                   g_param_spec_boolean ("session-tickets",
+                                                         "Session tickets",
+                                                         "Controls whether server-side TLS session tickets (RFC 5077) are issued",
+                                                         FALSE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_TICKET_KEY_LIFETIME,
+                                   g_param_spec_uint ("ticket-key-lifetime",
+                                                      "Session ticket key lifetime",
+                                                      "Time in seconds after which the session ticket key is rotated",
+                                                      1,
+                                                      G_MAXUINT,
+                                                      DEFAULT_TICKET_KEY_LIFETIME,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_SNI_CACHE_SIZE,
+                                   g_param_spec_uint ("sni-cache-size",
+                                                      "SNI certificate cache size",
+                                                      "Maximum number of parsed per-server-name certificates kept in memory",
+                                                      1,
+                                                      G_MAXUINT,
+                                                      DEFAULT_SNI_CACHE_SIZE,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
   /* add private structure */
   g_type_class_add_private (obj_class, sizeof (EvdTlsCredentialsPrivate));
 }
@@ -147,6 +295,7 @@ evd_tls_credentials_init (EvdTlsCredentials *self)
   priv->cred = NULL;
 
   priv->dh_params = NULL;
+  priv->prev_dh_params = NULL;
 
   priv->ready = FALSE;
   priv->preparing = FALSE;
@@ -154,12 +303,54 @@ evd_tls_credentials_init (EvdTlsCredentials *self)
   priv->cert_cb = NULL;
   priv->cert_cb_user_data = NULL;
   priv->cert_cb_user_data_free_func = NULL;
-  priv->cert_cb_result = 0;
-  priv->inside_cert_cb = FALSE;
+  priv->current_cert_cb = NULL;
+
+  /* the cert callback is always called from the context that created us */
+  priv->cert_cb_context = g_main_context_get_thread_default ();
+  if (priv->cert_cb_context == NULL)
+    priv->cert_cb_context = g_main_context_default ();
+  g_main_context_ref (priv->cert_cb_context);
+  priv->cert_cb_thread = g_thread_self ();
   priv->async_ops_count = 0;
 
   priv->x509_privkeys = NULL;
   priv->openpgp_privkeys = NULL;
+
+  priv->session_cache_size = DEFAULT_SESSION_CACHE_SIZE;
+  priv->session_cache_timeout = DEFAULT_SESSION_CACHE_TIMEOUT;
+  priv->session_cache =
+    g_hash_table_new_full (evd_tls_credentials_cache_entry_hash,
+                           evd_tls_credentials_cache_entry_equal,
+                           NULL,
+                           evd_tls_credentials_free_cache_entry);
+  priv->session_cache_lru = g_queue_new ();
+
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+  priv->session_cache_mutex = g_mutex_new ();
+#else
+  g_mutex_init (&priv->session_cache_mutex);
+#endif
+
+  priv->session_tickets = FALSE;
+  priv->ticket_key_lifetime = DEFAULT_TICKET_KEY_LIFETIME;
+  priv->ticket_key.data = NULL;
+  priv->ticket_key.size = 0;
+  priv->ticket_key_expires = 0;
+
+  priv->sni_enabled = FALSE;
+  priv->sni_dir = NULL;
+  priv->sni_cache_size = DEFAULT_SNI_CACHE_SIZE;
+  priv->sni_index = g_hash_table_new_full (g_str_hash,
+                                           g_str_equal,
+                                           NULL,
+                                           evd_tls_credentials_free_sni_entry);
+  priv->sni_lru = g_queue_new ();
+
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+  priv->sni_mutex = g_mutex_new ();
+#else
+  g_mutex_init (&priv->sni_mutex);
+#endif
 }
 
 static void
@@ -185,14 +376,42 @@ evd_tls_credentials_finalize (GObject *obj)
   if (self->priv->cred != NULL)
     gnutls_certificate_free_credentials (self->priv->cred);
 
-  if (self->priv->dh_params != NULL)
-    gnutls_dh_params_deinit (self->priv->dh_params);
+  /* dh_params are owned by the DH generator, we only hold references */
+  evd_tls_release_dh_params (self->priv->dh_params);
+  evd_tls_release_dh_params (self->priv->prev_dh_params);
+
+  g_main_context_unref (self->priv->cert_cb_context);
 
   g_list_free_full (self->priv->x509_privkeys,
                     evd_tls_credentials_free_x509_key);
   g_list_free_full (self->priv->openpgp_privkeys,
                     evd_tls_credentials_free_openpgp_key);
 
+  g_hash_table_destroy (self->priv->session_cache);
+  g_queue_free (self->priv->session_cache_lru);
+
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+  g_mutex_free (self->priv->session_cache_mutex);
+#else
+  g_mutex_clear (&self->priv->session_cache_mutex);
+#endif
+
+  if (self->priv->ticket_key.data != NULL)
+    {
+      memset (self->priv->ticket_key.data, 0, self->priv->ticket_key.size);
+      gnutls_free (self->priv->ticket_key.data);
+    }
+
+  g_hash_table_destroy (self->priv->sni_index);
+  g_queue_free (self->priv->sni_lru);
+  g_free (self->priv->sni_dir);
+
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+  g_mutex_free (self->priv->sni_mutex);
+#else
+  g_mutex_clear (&self->priv->sni_mutex);
+#endif
+
   G_OBJECT_CLASS (evd_tls_credentials_parent_class)->finalize (obj);
 }
 
@@ -213,16 +432,39 @@ evd_tls_credentials_set_property (GObject      *obj,
         {
           self->priv->dh_bits = g_value_get_uint (value);
 
-          if (self->priv->dh_params != NULL)
-            {
-              gnutls_dh_params_deinit (self->priv->dh_params);
-              self->priv->dh_params = NULL;
-            }
+          /* sessions already handshaking may still be using them */
+          evd_tls_release_dh_params (self->priv->prev_dh_params);
+          self->priv->prev_dh_params = self->priv->dh_params;
+          self->priv->dh_params = NULL;
 
           self->priv->ready = FALSE;
         }
       break;
 
+    case PROP_SESSION_CACHE_SIZE:
+      evd_tls_credentials_set_session_cache_size (self,
+                                                  g_value_get_uint (value));
+      break;
+
+    case PROP_SESSION_CACHE_TIMEOUT:
+      self->priv->session_cache_timeout = g_value_get_uint (value);
+      break;
+
+    case PROP_SESSION_TICKETS:
+      self->priv->session_tickets = g_value_get_boolean (value);
+      break;
+
+    case PROP_TICKET_KEY_LIFETIME:
+      self->priv->ticket_key_lifetime = g_value_get_uint (value);
+      break;
+
+    case PROP_SNI_CACHE_SIZE:
+      evd_tls_credentials_sni_lock (self);
+      self->priv->sni_cache_size = g_value_get_uint (value);
+      evd_tls_credentials_sni_trim (self);
+      evd_tls_credentials_sni_unlock (self);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
       break;
@@ -245,6 +487,26 @@ evd_tls_credentials_get_property (GObject    *obj,
       g_value_set_uint (value, self->priv->dh_bits);
       break;
 
+    case PROP_SESSION_CACHE_SIZE:
+      g_value_set_uint (value, self->priv->session_cache_size);
+      break;
+
+    case PROP_SESSION_CACHE_TIMEOUT:
+      g_value_set_uint (value, self->priv->session_cache_timeout);
+      break;
+
+    case PROP_SESSION_TICKETS:
+      g_value_set_boolean (value, self->priv->session_tickets);
+      break;
+
+    case PROP_TICKET_KEY_LIFETIME:
+      g_value_set_uint (value, self->priv->ticket_key_lifetime);
+      break;
+
+    case PROP_SNI_CACHE_SIZE:
+      g_value_set_uint (value, self->priv->sni_cache_size);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
       break;
@@ -263,6 +525,587 @@ evd_tls_credentials_free_openpgp_key (gpointer data)
   gnutls_openpgp_privkey_deinit (data);
 }
 
+static void
+evd_tls_credentials_free_cache_entry (gpointer data)
+{
+  EvdTlsCacheEntry *entry = data;
+
+  g_free (entry->key);
+  g_free (entry->data);
+
+  g_slice_free (EvdTlsCacheEntry, entry);
+}
+
+static guint
+evd_tls_credentials_cache_entry_hash (gconstpointer key)
+{
+  const EvdTlsCacheEntry *entry = key;
+  guint hash = 5381;
+  gsize i;
+
+  for (i = 0; i < entry->key_size; i++)
+    hash = (hash << 5) + hash + (guchar) entry->key[i];
+
+  return hash;
+}
+
+static gboolean
+evd_tls_credentials_cache_entry_equal (gconstpointer a, gconstpointer b)
+{
+  const EvdTlsCacheEntry *entry_a = a;
+  const EvdTlsCacheEntry *entry_b = b;
+
+  return entry_a->key_size == entry_b->key_size &&
+    memcmp (entry_a->key, entry_b->key, entry_a->key_size) == 0;
+}
+
+/* must be called with the session cache mutex held */
+static void
+evd_tls_credentials_cache_remove_entry (EvdTlsCredentials *self,
+                                        EvdTlsCacheEntry  *entry)
+{
+  g_queue_delete_link (self->priv->session_cache_lru, entry->lru_link);
+  g_hash_table_remove (self->priv->session_cache, entry);
+}
+
+/* must be called with the session cache mutex held */
+static void
+evd_tls_credentials_cache_trim (EvdTlsCredentials *self, guint max_size)
+{
+  EvdTlsCacheEntry *entry;
+
+  while (g_queue_get_length (self->priv->session_cache_lru) > max_size)
+    {
+      entry = g_queue_peek_tail (self->priv->session_cache_lru);
+      evd_tls_credentials_cache_remove_entry (self, entry);
+    }
+}
+
+static void
+evd_tls_credentials_cache_lock (EvdTlsCredentials *self)
+{
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+  g_mutex_lock (self->priv->session_cache_mutex);
+#else
+  g_mutex_lock (&self->priv->session_cache_mutex);
+#endif
+}
+
+static void
+evd_tls_credentials_cache_unlock (EvdTlsCredentials *self)
+{
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+  g_mutex_unlock (self->priv->session_cache_mutex);
+#else
+  g_mutex_unlock (&self->priv->session_cache_mutex);
+#endif
+}
+
+static gint
+evd_tls_credentials_cache_store (gpointer       user_data,
+                                 gnutls_datum_t key,
+                                 gnutls_datum_t data)
+{
+  EvdTlsCredentials *self = EVD_TLS_CREDENTIALS (user_data);
+  EvdTlsCacheEntry *entry;
+  EvdTlsCacheEntry *old_entry;
+
+  entry = g_slice_new (EvdTlsCacheEntry);
+  entry->key = g_memdup (key.data, key.size);
+  entry->key_size = key.size;
+  entry->data = g_memdup (data.data, data.size);
+  entry->data_size = data.size;
+  entry->expires = g_get_monotonic_time () +
+    (gint64) self->priv->session_cache_timeout * G_USEC_PER_SEC;
+
+  evd_tls_credentials_cache_lock (self);
+
+  old_entry = g_hash_table_lookup (self->priv->session_cache, entry);
+  if (old_entry != NULL)
+    evd_tls_credentials_cache_remove_entry (self, old_entry);
+
+  g_queue_push_head (self->priv->session_cache_lru, entry);
+  entry->lru_link = g_queue_peek_head_link (self->priv->session_cache_lru);
+  g_hash_table_insert (self->priv->session_cache, entry, entry);
+
+  evd_tls_credentials_cache_trim (self, self->priv->session_cache_size);
+
+  evd_tls_credentials_cache_unlock (self);
+
+  return 0;
+}
+
+static gnutls_datum_t
+evd_tls_credentials_cache_retrieve (gpointer       user_data,
+                                    gnutls_datum_t key)
+{
+  EvdTlsCredentials *self = EVD_TLS_CREDENTIALS (user_data);
+  EvdTlsCacheEntry lookup;
+  EvdTlsCacheEntry *entry;
+  gnutls_datum_t result = { NULL, 0 };
+
+  lookup.key = (gchar *) key.data;
+  lookup.key_size = key.size;
+
+  evd_tls_credentials_cache_lock (self);
+
+  entry = g_hash_table_lookup (self->priv->session_cache, &lookup);
+  if (entry != NULL)
+    {
+      if (entry->expires <= g_get_monotonic_time ())
+        {
+          evd_tls_credentials_cache_remove_entry (self, entry);
+        }
+      else
+        {
+          /* move to the front of the LRU list */
+          g_queue_unlink (self->priv->session_cache_lru, entry->lru_link);
+          g_queue_push_head_link (self->priv->session_cache_lru,
+                                  entry->lru_link);
+
+          /* GnuTLS takes ownership and releases it with gnutls_free() */
+          result.data = gnutls_malloc (entry->data_size);
+          if (result.data != NULL)
+            {
+              memcpy (result.data, entry->data, entry->data_size);
+              result.size = entry->data_size;
+            }
+        }
+    }
+
+  evd_tls_credentials_cache_unlock (self);
+
+  return result;
+}
+
+static gint
+evd_tls_credentials_cache_remove (gpointer       user_data,
+                                  gnutls_datum_t key)
+{
+  EvdTlsCredentials *self = EVD_TLS_CREDENTIALS (user_data);
+  EvdTlsCacheEntry lookup;
+  EvdTlsCacheEntry *entry;
+
+  lookup.key = (gchar *) key.data;
+  lookup.key_size = key.size;
+
+  evd_tls_credentials_cache_lock (self);
+
+  entry = g_hash_table_lookup (self->priv->session_cache, &lookup);
+  if (entry != NULL)
+    evd_tls_credentials_cache_remove_entry (self, entry);
+
+  evd_tls_credentials_cache_unlock (self);
+
+  return entry != NULL ? 0 : -1;
+}
+
+static gboolean
+evd_tls_credentials_rotate_ticket_key (EvdTlsCredentials  *self,
+                                       GError            **error)
+{
+  gint64 now;
+  gint err_code;
+
+  now = g_get_monotonic_time ();
+  if (self->priv->ticket_key.data != NULL && now < self->priv->ticket_key_expires)
+    return TRUE;
+
+  if (self->priv->ticket_key.data != NULL)
+    {
+      memset (self->priv->ticket_key.data, 0, self->priv->ticket_key.size);
+      gnutls_free (self->priv->ticket_key.data);
+      self->priv->ticket_key.data = NULL;
+      self->priv->ticket_key.size = 0;
+    }
+
+  err_code = gnutls_session_ticket_key_generate (&self->priv->ticket_key);
+  if (evd_error_propagate_gnutls (err_code, error))
+    return FALSE;
+
+  self->priv->ticket_key_expires = now +
+    (gint64) self->priv->ticket_key_lifetime * G_USEC_PER_SEC;
+
+  return TRUE;
+}
+
+static void
+evd_tls_credentials_sni_lock (EvdTlsCredentials *self)
+{
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+  g_mutex_lock (self->priv->sni_mutex);
+#else
+  g_mutex_lock (&self->priv->sni_mutex);
+#endif
+}
+
+static void
+evd_tls_credentials_sni_unlock (EvdTlsCredentials *self)
+{
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+  g_mutex_unlock (self->priv->sni_mutex);
+#else
+  g_mutex_unlock (&self->priv->sni_mutex);
+#endif
+}
+
+static EvdTlsSniCert *
+evd_tls_credentials_sni_cert_ref (EvdTlsSniCert *cert)
+{
+  g_atomic_int_inc (&cert->ref_count);
+
+  return cert;
+}
+
+static void
+evd_tls_credentials_sni_cert_unref (gpointer data)
+{
+  EvdTlsSniCert *cert = data;
+  guint i;
+
+  if (! g_atomic_int_dec_and_test (&cert->ref_count))
+    return;
+
+  for (i = 0; i < cert->ncerts; i++)
+    gnutls_x509_crt_deinit (cert->certs[i]);
+  gnutls_free (cert->certs);
+
+  if (cert->key != NULL)
+    gnutls_x509_privkey_deinit (cert->key);
+
+  g_slice_free (EvdTlsSniCert, cert);
+}
+
+static void
+evd_tls_credentials_free_sni_entry (gpointer data)
+{
+  EvdTlsSniEntry *entry = data;
+
+  if (entry->cert != NULL)
+    evd_tls_credentials_sni_cert_unref (entry->cert);
+
+  g_free (entry->name);
+  g_free (entry->cert_file);
+  g_free (entry->key_file);
+
+  g_slice_free (EvdTlsSniEntry, entry);
+}
+
+/* must be called with the SNI mutex held */
+static void
+evd_tls_credentials_sni_trim (EvdTlsCredentials *self)
+{
+  EvdTlsSniEntry *entry;
+
+  /* evicted entries keep their file paths and are parsed again on demand */
+  while (g_queue_get_length (self->priv->sni_lru) > self->priv->sni_cache_size)
+    {
+      entry = g_queue_pop_tail (self->priv->sni_lru);
+      entry->lru_link = NULL;
+
+      evd_tls_credentials_sni_cert_unref (entry->cert);
+      entry->cert = NULL;
+    }
+}
+
+static EvdTlsSniEntry *
+evd_tls_credentials_sni_add_entry (EvdTlsCredentials *self,
+                                   const gchar       *name,
+                                   const gchar       *cert_file,
+                                   const gchar       *key_file)
+{
+  EvdTlsSniEntry *entry;
+
+  entry = g_slice_new (EvdTlsSniEntry);
+  entry->name = g_strdup (name);
+  entry->cert_file = g_strdup (cert_file);
+  entry->key_file = g_strdup (key_file);
+  entry->cert = NULL;
+  entry->lru_link = NULL;
+
+  g_hash_table_replace (self->priv->sni_index, entry->name, entry);
+
+  return entry;
+}
+
+static gboolean
+evd_tls_credentials_sni_name_is_valid (const gchar *name)
+{
+  const gchar *p;
+
+  /* server names come from the peer and end up in file paths */
+  if (name[0] == '\0' || name[0] == '.' || strstr (name, "..") != NULL)
+    return FALSE;
+
+  for (p = name; *p != '\0'; p++)
+    if (! g_ascii_isalnum (*p) && *p != '-' && *p != '.' && *p != '_')
+      return FALSE;
+
+  return TRUE;
+}
+
+/* must be called with the SNI mutex held */
+static EvdTlsSniEntry *
+evd_tls_credentials_sni_find (EvdTlsCredentials *self, const gchar *name)
+{
+  EvdTlsSniEntry *entry;
+  gchar *file_name;
+  gchar *base;
+  gchar *cert_file;
+  gchar *key_file;
+
+  entry = g_hash_table_lookup (self->priv->sni_index, name);
+  if (entry != NULL || self->priv->sni_dir == NULL)
+    return entry;
+
+  /* wildcard names are stored in the directory with '_' in place of '*' */
+  file_name = g_strdup (name);
+  if (file_name[0] == '*')
+    file_name[0] = '_';
+
+  if (! evd_tls_credentials_sni_name_is_valid (file_name))
+    {
+      g_free (file_name);
+      return NULL;
+    }
+
+  base = g_build_filename (self->priv->sni_dir, file_name, NULL);
+  cert_file = g_strconcat (base, ".crt", NULL);
+  key_file = g_strconcat (base, ".key", NULL);
+
+  /* unknown names are not remembered, as peers can send anything */
+  if (g_file_test (cert_file, G_FILE_TEST_IS_REGULAR) &&
+      g_file_test (key_file, G_FILE_TEST_IS_REGULAR))
+    {
+      entry = evd_tls_credentials_sni_add_entry (self,
+                                                 name,
+                                                 cert_file,
+                                                 key_file);
+    }
+
+  g_free (key_file);
+  g_free (cert_file);
+  g_free (base);
+  g_free (file_name);
+
+  return entry;
+}
+
+static EvdTlsSniCert *
+evd_tls_credentials_sni_load (const gchar *cert_file, const gchar *key_file)
+{
+  EvdTlsSniCert *cert;
+  gnutls_datum_t datum;
+  gint err_code;
+
+  cert = g_slice_new0 (EvdTlsSniCert);
+  cert->ref_count = 1;
+
+  err_code = gnutls_load_file (cert_file, &datum);
+  if (err_code == GNUTLS_E_SUCCESS)
+    {
+      err_code = gnutls_x509_crt_list_import2 (&cert->certs,
+                                               &cert->ncerts,
+                                               &datum,
+                                               GNUTLS_X509_FMT_PEM,
+                                               0);
+      gnutls_free (datum.data);
+    }
+
+  if (err_code == GNUTLS_E_SUCCESS)
+    err_code = gnutls_load_file (key_file, &datum);
+
+  if (err_code == GNUTLS_E_SUCCESS)
+    {
+      err_code = gnutls_x509_privkey_init (&cert->key);
+      if (err_code == GNUTLS_E_SUCCESS)
+        err_code = gnutls_x509_privkey_import (cert->key,
+                                               &datum,
+                                               GNUTLS_X509_FMT_PEM);
+
+      memset (datum.data, 0, datum.size);
+      gnutls_free (datum.data);
+    }
+
+  if (err_code != GNUTLS_E_SUCCESS)
+    {
+      g_debug ("Failed to load certificate '%s': %s",
+               cert_file,
+               gnutls_strerror (err_code));
+
+      evd_tls_credentials_sni_cert_unref (cert);
+
+      return NULL;
+    }
+
+  return cert;
+}
+
+/* returns a new reference to the certificate matching @server_name */
+static EvdTlsSniCert *
+evd_tls_credentials_sni_lookup (EvdTlsCredentials *self,
+                                const gchar       *server_name)
+{
+  EvdTlsSniEntry *entry = NULL;
+  EvdTlsSniCert *cert = NULL;
+  gchar *name = NULL;
+  gchar *cert_file;
+  gchar *key_file;
+
+  evd_tls_credentials_sni_lock (self);
+
+  if (server_name != NULL)
+    {
+      const gchar *dot;
+
+      name = g_ascii_strdown (server_name, -1);
+
+      /* exact name first, then a wildcard for its parent domain */
+      entry = evd_tls_credentials_sni_find (self, name);
+      if (entry == NULL && (dot = strchr (name, '.')) != NULL)
+        {
+          gchar *wildcard;
+
+          wildcard = g_strconcat ("*", dot, NULL);
+          entry = evd_tls_credentials_sni_find (self, wildcard);
+          g_free (wildcard);
+        }
+    }
+
+  /* the default certificate, for peers not sending SNI */
+  if (entry == NULL)
+    entry = g_hash_table_lookup (self->priv->sni_index, "");
+
+  g_free (name);
+
+  if (entry == NULL)
+    {
+      evd_tls_credentials_sni_unlock (self);
+      return NULL;
+    }
+
+  if (entry->cert != NULL)
+    {
+      g_queue_unlink (self->priv->sni_lru, entry->lru_link);
+      g_queue_push_head_link (self->priv->sni_lru, entry->lru_link);
+
+      cert = evd_tls_credentials_sni_cert_ref (entry->cert);
+
+      evd_tls_credentials_sni_unlock (self);
+      return cert;
+    }
+
+  /* parse without holding the lock, files may be slow to read */
+  name = g_strdup (entry->name);
+  cert_file = g_strdup (entry->cert_file);
+  key_file = g_strdup (entry->key_file);
+
+  evd_tls_credentials_sni_unlock (self);
+
+  cert = evd_tls_credentials_sni_load (cert_file, key_file);
+
+  g_free (cert_file);
+  g_free (key_file);
+
+  if (cert == NULL)
+    {
+      g_free (name);
+      return NULL;
+    }
+
+  evd_tls_credentials_sni_lock (self);
+
+  entry = g_hash_table_lookup (self->priv->sni_index, name);
+  if (entry != NULL && entry->cert == NULL)
+    {
+      entry->cert = evd_tls_credentials_sni_cert_ref (cert);
+      g_queue_push_head (self->priv->sni_lru, entry);
+      entry->lru_link = g_queue_peek_head_link (self->priv->sni_lru);
+
+      evd_tls_credentials_sni_trim (self);
+    }
+
+  evd_tls_credentials_sni_unlock (self);
+
+  g_free (name);
+
+  return cert;
+}
+
+static gboolean
+evd_tls_credentials_sni_retrieve (EvdTlsCredentials *self,
+                                  EvdTlsSession     *session,
+                                  gnutls_retr2_st   *st)
+{
+  EvdTlsSniCert *cert;
+
+  cert = evd_tls_credentials_sni_lookup (self,
+                                   evd_tls_session_get_server_name (session));
+  if (cert == NULL)
+    return FALSE;
+
+  /* GnuTLS doesn't copy the key, so the session keeps the certificate
+     alive even if it gets evicted from the cache meanwhile */
+  g_object_set_data_full (G_OBJECT (session),
+                          SNI_CERT_DATA_KEY,
+                          cert,
+                          evd_tls_credentials_sni_cert_unref);
+
+  st->cert_type = GNUTLS_CRT_X509;
+  st->key_type = GNUTLS_PRIVKEY_X509;
+  st->cert.x509 = cert->certs;
+  st->ncerts = cert->ncerts;
+  st->key.x509 = cert->key;
+  st->deinit_all = 0;
+
+  return TRUE;
+}
+
+static void
+evd_tls_credentials_invoke_cert_cb (CertCbData *data)
+{
+  EvdTlsCredentials *self = data->self;
+  CertCbData *prev;
+
+  /* evd_tls_credentials_add_certificate() fills this request */
+  prev = self->priv->current_cert_cb;
+  self->priv->current_cert_cb = data;
+
+  data->result = 0;
+  if (! self->priv->cert_cb (self,
+                             data->session,
+                             NULL,
+                             NULL,
+                             self->priv->cert_cb_user_data))
+    {
+      data->result = -1;
+    }
+
+  self->priv->current_cert_cb = prev;
+}
+
+static gboolean
+evd_tls_credentials_cert_cb_in_context (gpointer user_data)
+{
+  CertCbData *data = user_data;
+
+  evd_tls_credentials_invoke_cert_cb (data);
+
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+  g_mutex_lock (data->mutex);
+  data->done = TRUE;
+  g_cond_signal (data->cond);
+  g_mutex_unlock (data->mutex);
+#else
+  g_mutex_lock (&data->mutex);
+  data->done = TRUE;
+  g_cond_signal (&data->cond);
+  g_mutex_unlock (&data->mutex);
+#endif
+
+  return FALSE;
+}
+
 static gint
 evd_tls_credentials_server_cert_cb (gnutls_session_t             session,
                                     const gnutls_datum_t        *req_ca_dn,
@@ -273,33 +1116,81 @@ evd_tls_credentials_server_cert_cb (gnutls_session_t             session,
 {
   EvdTlsCredentials *self;
   EvdTlsSession *tls_session;
+  CertCbData *data;
 
   tls_session = gnutls_transport_get_ptr (session);
   g_assert (EVD_IS_TLS_SESSION (tls_session));
 
   self = evd_tls_session_get_credentials (tls_session);
 
-  g_assert (self->priv->cert_cb != NULL);
+  st->ncerts = 0;
+  st->deinit_all = 0;
+
+  if (self->priv->sni_enabled &&
+      evd_tls_credentials_sni_retrieve (self, tls_session, st))
+    {
+      return 0;
+    }
 
-  self->priv->cert_cb_ret_st = st;
-  self->priv->cert_cb_ret_st->ncerts = 0;
-  self->priv->cert_cb_ret_st->deinit_all = 0;
+  if (self->priv->cert_cb == NULL)
+    return -1;
 
-  self->priv->cert_cb_result = 0;
-  self->priv->inside_cert_cb = TRUE;
+  /* the session keeps the array of certificates handed to GnuTLS */
+  data = g_new0 (CertCbData, 1);
+  data->self = self;
+  data->session = tls_session;
+  data->st = st;
+  g_object_set_data_full (G_OBJECT (tls_session),
+                          CERT_CB_DATA_KEY,
+                          data,
+                          g_free);
 
-  if (! self->priv->cert_cb (self,
-                             tls_session,
-                             NULL,
-                             NULL,
-                             self->priv->cert_cb_user_data))
+  if (g_thread_self () == self->priv->cert_cb_thread)
     {
-      self->priv->cert_cb_result = -1;
+      evd_tls_credentials_invoke_cert_cb (data);
+    }
+  else
+    {
+      GSource *src;
+
+      /* called from a threaded handshake: run the application's callback
+         in its own context and wait for it */
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+      data->mutex = g_mutex_new ();
+      data->cond = g_cond_new ();
+      g_mutex_lock (data->mutex);
+#else
+      g_mutex_init (&data->mutex);
+      g_cond_init (&data->cond);
+      g_mutex_lock (&data->mutex);
+#endif
+
+      src = g_idle_source_new ();
+      g_source_set_callback (src,
+                             evd_tls_credentials_cert_cb_in_context,
+                             data,
+                             NULL);
+      g_source_attach (src, self->priv->cert_cb_context);
+      g_source_unref (src);
+
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+      while (! data->done)
+        g_cond_wait (data->cond, data->mutex);
+      g_mutex_unlock (data->mutex);
+
+      g_mutex_free (data->mutex);
+      g_cond_free (data->cond);
+#else
+      while (! data->done)
+        g_cond_wait (&data->cond, &data->mutex);
+      g_mutex_unlock (&data->mutex);
+
+      g_mutex_clear (&data->mutex);
+      g_cond_clear (&data->cond);
+#endif
     }
 
-  self->priv->inside_cert_cb = FALSE;
-
-  return self->priv->cert_cb_result;
+  return data->result;
 }
 
 /* @TODO
@@ -324,7 +1215,7 @@ evd_tls_credentials_prepare_finish (EvdTlsCredentials  *self,
   if (self->priv->cred == NULL)
     gnutls_certificate_allocate_credentials (&self->priv->cred);
 
-  if (self->priv->cert_cb != NULL)
+  if (self->priv->cert_cb != NULL || self->priv->sni_enabled)
     {
       gnutls_certificate_set_retrieve_function (self->priv->cred,
                                             evd_tls_credentials_server_cert_cb);
@@ -353,6 +1244,32 @@ evd_tls_credentials_prepare_finish (EvdTlsCredentials  *self,
   return TRUE;
 }
 
+/* picks up the generator's current params, which change when rotated */
+static void
+evd_tls_credentials_update_dh_params (EvdTlsCredentials *self)
+{
+  gnutls_dh_params_t dh_params;
+
+  dh_params = evd_tls_get_dh_params (self->priv->dh_bits);
+  if (dh_params == NULL)
+    return;
+
+  if (dh_params == self->priv->dh_params)
+    {
+      evd_tls_release_dh_params (dh_params);
+      return;
+    }
+
+  /* sessions already handshaking may still use the previous params, so
+     they are released on the next rotation */
+  evd_tls_release_dh_params (self->priv->prev_dh_params);
+  self->priv->prev_dh_params = self->priv->dh_params;
+  self->priv->dh_params = dh_params;
+
+  if (self->priv->ready && self->priv->cred != NULL)
+    gnutls_certificate_set_dh_params (self->priv->cred, dh_params);
+}
+
 static void
 evd_tls_credentials_dh_params_ready (GObject      *source_obj,
                                      GAsyncResult *res,
@@ -361,10 +1278,9 @@ evd_tls_credentials_dh_params_ready (GObject      *source_obj,
   EvdTlsCredentials *self = EVD_TLS_CREDENTIALS (user_data);
   GError *error = NULL;
 
-  if ( (self->priv->dh_params =
-        evd_tls_generate_dh_params_finish (res,
-                                           &error)) != NULL)
+  if (evd_tls_generate_dh_params_finish (res, &error) != NULL)
     {
+      evd_tls_credentials_update_dh_params (self);
       evd_tls_credentials_prepare_finish (self, &error);
     }
   else
@@ -471,6 +1387,10 @@ evd_tls_credentials_get_credentials (EvdTlsCredentials *self)
  * @self:
  * @callback: (allow-none):
  * @user_data: (allow-none):
+ *
+ * @callback is always called from the thread-default main context of the
+ * thread that created @self, even for sessions doing their handshake in
+ * a worker thread.
  **/
 void
 evd_tls_credentials_set_cert_callback (EvdTlsCredentials       *self,
@@ -558,11 +1478,12 @@ evd_tls_credentials_add_certificate (EvdTlsCredentials  *self,
       return FALSE;
     }
 
-  if (self->priv->inside_cert_cb)
+  if (self->priv->current_cert_cb != NULL)
     {
+      CertCbData *data = self->priv->current_cert_cb;
       gnutls_retr2_st *ret_st;
 
-      ret_st = self->priv->cert_cb_ret_st;
+      ret_st = data->st;
 
       if (ret_st->ncerts >= MAX_DYNAMIC_CERTS)
         {
@@ -574,13 +1495,13 @@ evd_tls_credentials_add_certificate (EvdTlsCredentials  *self,
         }
       else
         {
-          self->priv->cert_cb_certs[ret_st->ncerts] = _cert;
+          data->certs[ret_st->ncerts] = _cert;
           ret_st->ncerts++;
 
           if (cert_type == EVD_TLS_CERTIFICATE_TYPE_X509)
             {
               ret_st->cert_type = GNUTLS_CRT_X509;
-              ret_st->cert.x509 = (gnutls_x509_crt_t *) self->priv->cert_cb_certs;
+              ret_st->cert.x509 = (gnutls_x509_crt_t *) data->certs;
               ret_st->key.x509 = (gnutls_x509_privkey_t) _privkey;
             }
           else
@@ -619,6 +1540,109 @@ evd_tls_credentials_add_certificate (EvdTlsCredentials  *self,
   return TRUE;
 }
 
+/**
+ * evd_tls_credentials_set_session_cache_size:
+ * @self: The #EvdTlsCredentials
+ * @size: Maximum number of sessions to cache, or 0 to disable caching
+ *
+ * Sets the maximum number of server-side TLS sessions that will be kept
+ * for resumption by session ID. The cache is shared by all sessions using
+ * these credentials, and least recently used entries are evicted first.
+ **/
+void
+evd_tls_credentials_set_session_cache_size (EvdTlsCredentials *self,
+                                            guint              size)
+{
+  g_return_if_fail (EVD_IS_TLS_CREDENTIALS (self));
+
+  evd_tls_credentials_cache_lock (self);
+
+  self->priv->session_cache_size = size;
+  evd_tls_credentials_cache_trim (self, size);
+
+  evd_tls_credentials_cache_unlock (self);
+}
+
+guint
+evd_tls_credentials_get_session_cache_size (EvdTlsCredentials *self)
+{
+  g_return_val_if_fail (EVD_IS_TLS_CREDENTIALS (self), 0);
+
+  return self->priv->session_cache_size;
+}
+
+/**
+ * evd_tls_credentials_setup_session:
+ * @self: The #EvdTlsCredentials
+ * @session: The #EvdTlsSession about to handshake
+ * @error: (allow-none):
+ *
+ * Configures server-side session resumption (session ID cache and
+ * session tickets) on @session, according to the properties of @self,
+ * and picks up Diffie-Hellman parameters rotated since the last handshake.
+ * Called by #EvdTlsSession when binding credentials.
+ *
+ * Returns: %TRUE on success, %FALSE on error
+ **/
+gboolean
+evd_tls_credentials_setup_session (EvdTlsCredentials  *self,
+                                   EvdTlsSession      *session,
+                                   GError            **error)
+{
+  gnutls_session_t _session;
+  EvdTlsMode mode;
+  gboolean result = TRUE;
+
+  g_return_val_if_fail (EVD_IS_TLS_CREDENTIALS (self), FALSE);
+  g_return_val_if_fail (EVD_IS_TLS_SESSION (session), FALSE);
+
+  g_object_get (session, "mode", &mode, NULL);
+  if (mode != EVD_TLS_MODE_SERVER)
+    return TRUE;
+
+  if (self->priv->dh_bits != 0 && self->priv->dh_params != NULL)
+    evd_tls_credentials_update_dh_params (self);
+
+  _session = evd_tls_session_get_native (session);
+  if (_session == NULL)
+    return TRUE;
+
+  if (self->priv->session_cache_size > 0)
+    {
+      gnutls_db_set_ptr (_session, self);
+      gnutls_db_set_store_function (_session, evd_tls_credentials_cache_store);
+      gnutls_db_set_retrieve_function (_session,
+                                       evd_tls_credentials_cache_retrieve);
+      gnutls_db_set_remove_function (_session,
+                                     evd_tls_credentials_cache_remove);
+      gnutls_db_set_cache_expiration (_session,
+                                      self->priv->session_cache_timeout);
+    }
+
+  if (self->priv->session_tickets)
+    {
+      gint err_code;
+
+      evd_tls_credentials_cache_lock (self);
+
+      if (evd_tls_credentials_rotate_ticket_key (self, error))
+        {
+          err_code = gnutls_session_ticket_enable_server (_session,
+                                                      &self->priv->ticket_key);
+          if (evd_error_propagate_gnutls (err_code, error))
+            result = FALSE;
+        }
+      else
+        {
+          result = FALSE;
+        }
+
+      evd_tls_credentials_cache_unlock (self);
+    }
+
+  return result;
+}
+
 /**
  * evd_tls_credentials_add_certificate_from_file:
  * @cancellable: (allow-none):
@@ -674,3 +1698,90 @@ evd_tls_credentials_add_certificate_from_file_finish (EvdTlsCredentials  *self,
     ! g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (result),
                                              error);
 }
+
+static void
+evd_tls_credentials_enable_sni (EvdTlsCredentials *self)
+{
+  if (self->priv->sni_enabled)
+    return;
+
+  self->priv->sni_enabled = TRUE;
+
+  if (self->priv->cred == NULL)
+    gnutls_certificate_allocate_credentials (&self->priv->cred);
+
+  gnutls_certificate_set_retrieve_function (self->priv->cred,
+                                            evd_tls_credentials_server_cert_cb);
+}
+
+/**
+ * evd_tls_credentials_add_sni_certificate_from_file:
+ * @self: The #EvdTlsCredentials
+ * @server_name: (allow-none): A server name like "www.example.com" or
+ * "*.example.com", or %NULL for the default certificate
+ * @cert_file: Path to a PEM file with the certificate chain
+ * @key_file: Path to a PEM file with the X.509 private key
+ *
+ * Registers a certificate to be presented to peers requesting @server_name
+ * through SNI. Files are not read until a peer asks for that name, and
+ * parsed certificates are kept in a LRU cache of
+ * #EvdTlsCredentials:sni-cache-size entries.
+ **/
+void
+evd_tls_credentials_add_sni_certificate_from_file (EvdTlsCredentials *self,
+                                                   const gchar       *server_name,
+                                                   const gchar       *cert_file,
+                                                   const gchar       *key_file)
+{
+  EvdTlsSniEntry *old;
+  gchar *name;
+
+  g_return_if_fail (EVD_IS_TLS_CREDENTIALS (self));
+  g_return_if_fail (cert_file != NULL);
+  g_return_if_fail (key_file != NULL);
+
+  name = g_ascii_strdown (server_name != NULL ? server_name : "", -1);
+
+  evd_tls_credentials_sni_lock (self);
+
+  /* drop a previous entry from the LRU before it gets replaced */
+  old = g_hash_table_lookup (self->priv->sni_index, name);
+  if (old != NULL && old->lru_link != NULL)
+    g_queue_delete_link (self->priv->sni_lru, old->lru_link);
+
+  evd_tls_credentials_sni_add_entry (self, name, cert_file, key_file);
+
+  evd_tls_credentials_sni_unlock (self);
+
+  g_free (name);
+
+  evd_tls_credentials_enable_sni (self);
+}
+
+/**
+ * evd_tls_credentials_set_sni_directory:
+ * @self: The #EvdTlsCredentials
+ * @path: (allow-none): A directory, or %NULL
+ *
+ * Sets a directory to look up certificates for server names not registered
+ * with evd_tls_credentials_add_sni_certificate_from_file(). For a name like
+ * "www.example.com", the files "www.example.com.crt" and "www.example.com.key"
+ * are tried first, then "_.example.com.crt" and "_.example.com.key" for the
+ * wildcard "*.example.com".
+ **/
+void
+evd_tls_credentials_set_sni_directory (EvdTlsCredentials *self,
+                                       const gchar       *path)
+{
+  g_return_if_fail (EVD_IS_TLS_CREDENTIALS (self));
+
+  evd_tls_credentials_sni_lock (self);
+
+  g_free (self->priv->sni_dir);
+  self->priv->sni_dir = g_strdup (path);
+
+  evd_tls_credentials_sni_unlock (self);
+
+  if (path != NULL)
+    evd_tls_credentials_enable_sni (self);
+}
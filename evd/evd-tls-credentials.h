@@ -108,6 +108,21 @@ gboolean           evd_tls_credentials_add_certificate_from_file_finish (EvdTlsC
                                                                          GAsyncResult       *result,
                                                                          GError            **error);
 
+void               evd_tls_credentials_set_session_cache_size           (EvdTlsCredentials *self,
+                                                                         guint              size);
+guint              evd_tls_credentials_get_session_cache_size           (EvdTlsCredentials *self);
+
+void               evd_tls_credentials_add_sni_certificate_from_file    (EvdTlsCredentials *self,
+                                                                         const gchar       *server_name,
+                                                                         const gchar       *cert_file,
+                                                                         const gchar       *key_file);
+void               evd_tls_credentials_set_sni_directory                (EvdTlsCredentials *self,
+                                                                         const gchar       *path);
+
+gboolean           evd_tls_credentials_setup_session                    (EvdTlsCredentials  *self,
+                                                                         EvdTlsSession      *session,
+                                                                         GError            **error);
+
 
 void               evd_tls_session_set_credentials                      (EvdTlsSession     *self,
                                                                          EvdTlsCredentials *credentials);
@@ -20,6 +20,8 @@
  * for more details.
  */
 
+#include <glib/gstdio.h>
+
 #include "evd-error.h"
 #include "evd-tls-dh-generator.h"
 #include "evd-tls-common.h"
@@ -38,6 +40,14 @@ struct _EvdTlsDhGeneratorPrivate
 #else
   GMutex      cache_mutex;
 #endif
+
+  /* references held on every params handed out, freed when they drop
+     to zero after being replaced by a regeneration */
+  GHashTable *refs;
+
+  gchar *cache_dir;
+  guint max_age;
+  gboolean use_ffdhe;
 };
 
 typedef struct _EvdTlsDhParamsSource EvdTlsDhParamsSource;
@@ -53,8 +63,27 @@ struct _EvdTlsDhParamsSource
   GMutex              mutex;
 #endif
   EvdTlsDhGenerator  *parent;
+  gchar              *cache_dir;
+
+  gint64              created;
+  gboolean            fixed;
+  gboolean            regenerating;
 };
 
+typedef struct
+{
+  guint              dh_bits;
+  gnutls_dh_params_t dh_params;
+  gchar             *cache_dir;
+} EvdTlsDhRotation;
+
+/* keeps the params of a completed request alive until the result goes */
+typedef struct
+{
+  EvdTlsDhGenerator  *generator;
+  gnutls_dh_params_t  dh_params;
+} EvdTlsDhResultRef;
+
 static void     evd_tls_dh_generator_class_init         (EvdTlsDhGeneratorClass *class);
 static void     evd_tls_dh_generator_init               (EvdTlsDhGenerator *self);
 
@@ -90,6 +119,12 @@ evd_tls_dh_generator_init (EvdTlsDhGenerator *self)
 #else
   g_mutex_init (&priv->cache_mutex);
 #endif
+
+  priv->refs = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  priv->cache_dir = NULL;
+  priv->max_age = 0;
+  priv->use_ffdhe = FALSE;
 }
 
 static gboolean
@@ -102,6 +137,14 @@ evd_tls_dh_generator_free_cache_item (gpointer key,
   return TRUE;
 }
 
+static void
+evd_tls_dh_generator_free_params (gpointer key,
+                                  gpointer value,
+                                  gpointer user_data)
+{
+  gnutls_dh_params_deinit ((gnutls_dh_params_t) key);
+}
+
 static void
 evd_tls_dh_generator_finalize (GObject *obj)
 {
@@ -118,19 +161,108 @@ evd_tls_dh_generator_finalize (GObject *obj)
   g_mutex_clear (&self->priv->cache_mutex);
 #endif
 
+  g_hash_table_foreach (self->priv->refs,
+                        evd_tls_dh_generator_free_params,
+                        NULL);
+  g_hash_table_destroy (self->priv->refs);
+
+  g_free (self->priv->cache_dir);
+
   G_OBJECT_CLASS (evd_tls_dh_generator_parent_class)->finalize (obj);
 }
 
 static void
-evd_tls_dh_generator_free_source (EvdTlsDhParamsSource *source)
+evd_tls_dh_generator_lock (EvdTlsDhGenerator *self)
 {
-  GSimpleAsyncResult *item;
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+  g_mutex_lock (self->priv->cache_mutex);
+#else
+  g_mutex_lock (&self->priv->cache_mutex);
+#endif
+}
 
+static void
+evd_tls_dh_generator_unlock (EvdTlsDhGenerator *self)
+{
 #if (! GLIB_CHECK_VERSION(2, 31, 0))
-  g_mutex_lock (source->mutex);
+  g_mutex_unlock (self->priv->cache_mutex);
 #else
-  g_mutex_lock (&source->mutex);
+  g_mutex_unlock (&self->priv->cache_mutex);
 #endif
+}
+
+/* must be called with the cache mutex held */
+static void
+evd_tls_dh_generator_ref_params_locked (EvdTlsDhGenerator  *self,
+                                        gnutls_dh_params_t  dh_params)
+{
+  guint count;
+
+  count = GPOINTER_TO_UINT (g_hash_table_lookup (self->priv->refs, dh_params));
+  g_hash_table_insert (self->priv->refs,
+                       dh_params,
+                       GUINT_TO_POINTER (count + 1));
+}
+
+/* must be called with the cache mutex held */
+static void
+evd_tls_dh_generator_unref_params_locked (EvdTlsDhGenerator  *self,
+                                          gnutls_dh_params_t  dh_params)
+{
+  guint count;
+
+  if (dh_params == NULL)
+    return;
+
+  count = GPOINTER_TO_UINT (g_hash_table_lookup (self->priv->refs, dh_params));
+  g_return_if_fail (count > 0);
+
+  if (count > 1)
+    {
+      g_hash_table_insert (self->priv->refs,
+                           dh_params,
+                           GUINT_TO_POINTER (count - 1));
+    }
+  else
+    {
+      g_hash_table_remove (self->priv->refs, dh_params);
+      gnutls_dh_params_deinit (dh_params);
+    }
+}
+
+static void
+evd_tls_dh_generator_free_result_ref (gpointer data)
+{
+  EvdTlsDhResultRef *ref = data;
+
+  evd_tls_dh_generator_unref_params (ref->generator, ref->dh_params);
+  g_object_unref (ref->generator);
+
+  g_slice_free (EvdTlsDhResultRef, ref);
+}
+
+/* must be called with the cache mutex held */
+static void
+evd_tls_dh_generator_set_result (EvdTlsDhGenerator  *self,
+                                 GSimpleAsyncResult *result,
+                                 gnutls_dh_params_t  dh_params)
+{
+  EvdTlsDhResultRef *ref;
+
+  ref = g_slice_new (EvdTlsDhResultRef);
+  ref->generator = g_object_ref (self);
+  ref->dh_params = dh_params;
+  evd_tls_dh_generator_ref_params_locked (self, dh_params);
+
+  g_simple_async_result_set_op_res_gpointer (result,
+                                       ref,
+                                       evd_tls_dh_generator_free_result_ref);
+}
+
+static void
+evd_tls_dh_generator_free_source (EvdTlsDhParamsSource *source)
+{
+  GSimpleAsyncResult *item;
 
   if (source->queue != NULL)
     {
@@ -143,40 +275,201 @@ evd_tls_dh_generator_free_source (EvdTlsDhParamsSource *source)
       g_queue_free (source->queue);
     }
 
-  if (source->dh_params != NULL)
-    gnutls_dh_params_deinit (source->dh_params);
+  /* drop the cache's reference, whoever got the params keeps its own */
+  evd_tls_dh_generator_unref_params_locked (source->parent, source->dh_params);
 
-#if (! GLIB_CHECK_VERSION(2, 31, 0))
-  g_mutex_unlock (source->mutex);
+  g_free (source->cache_dir);
 
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
   g_mutex_free (source->mutex);
 #else
-  g_mutex_unlock (&source->mutex);
-
   g_mutex_clear (&source->mutex);
 #endif
 
   g_slice_free (EvdTlsDhParamsSource, source);
 }
 
+static gchar *
+evd_tls_dh_generator_get_cache_file (const gchar *cache_dir, guint dh_bits)
+{
+  gchar *filename;
+  gchar *path;
+
+  if (cache_dir == NULL)
+    return NULL;
+
+  filename = g_strdup_printf ("dh-params-%u.pem", dh_bits);
+  path = g_build_filename (cache_dir, filename, NULL);
+  g_free (filename);
+
+  return path;
+}
+
+static gboolean
+evd_tls_dh_generator_import_ffdhe (guint              dh_bits,
+                                   gnutls_dh_params_t dh_params)
+{
+#if GNUTLS_VERSION_NUMBER >= 0x030506
+  const gnutls_datum_t *prime;
+  const gnutls_datum_t *generator;
+  guint key_bits;
+
+  switch (dh_bits)
+    {
+    case 2048:
+      prime = &gnutls_ffdhe_2048_group_prime;
+      generator = &gnutls_ffdhe_2048_group_generator;
+      key_bits = gnutls_ffdhe_2048_key_bits;
+      break;
+
+    case 3072:
+      prime = &gnutls_ffdhe_3072_group_prime;
+      generator = &gnutls_ffdhe_3072_group_generator;
+      key_bits = gnutls_ffdhe_3072_key_bits;
+      break;
+
+    case 4096:
+      prime = &gnutls_ffdhe_4096_group_prime;
+      generator = &gnutls_ffdhe_4096_group_generator;
+      key_bits = gnutls_ffdhe_4096_key_bits;
+      break;
+
+    default:
+      return FALSE;
+    }
+
+  return gnutls_dh_params_import_raw2 (dh_params,
+                                       prime,
+                                       generator,
+                                       key_bits) == GNUTLS_E_SUCCESS;
+#else
+  return FALSE;
+#endif
+}
+
+static gboolean
+evd_tls_dh_generator_load (const gchar        *cache_dir,
+                           guint               dh_bits,
+                           gnutls_dh_params_t  dh_params,
+                           gint64             *created)
+{
+  gchar *path;
+  gchar *contents = NULL;
+  gsize size;
+  GStatBuf st;
+  gboolean result = FALSE;
+
+  path = evd_tls_dh_generator_get_cache_file (cache_dir, dh_bits);
+  if (path == NULL)
+    return FALSE;
+
+  if (g_stat (path, &st) == 0 &&
+      g_file_get_contents (path, &contents, &size, NULL))
+    {
+      gnutls_datum_t datum;
+
+      datum.data = (guchar *) contents;
+      datum.size = size;
+
+      if (gnutls_dh_params_import_pkcs3 (dh_params,
+                                         &datum,
+                                         GNUTLS_X509_FMT_PEM)
+          == GNUTLS_E_SUCCESS)
+        {
+          *created = st.st_mtime;
+          result = TRUE;
+        }
+      else
+        {
+          g_debug ("Ignoring invalid DH params file '%s'", path);
+        }
+
+      g_free (contents);
+    }
+
+  g_free (path);
+
+  return result;
+}
+
+static void
+evd_tls_dh_generator_save (const gchar        *cache_dir,
+                           guint               dh_bits,
+                           gnutls_dh_params_t  dh_params)
+{
+  gchar *path;
+  gnutls_datum_t datum;
+  GError *error = NULL;
+
+  path = evd_tls_dh_generator_get_cache_file (cache_dir, dh_bits);
+  if (path == NULL)
+    return;
+
+  if (gnutls_dh_params_export2_pkcs3 (dh_params,
+                                      GNUTLS_X509_FMT_PEM,
+                                      &datum) == GNUTLS_E_SUCCESS)
+    {
+      g_mkdir_with_parents (cache_dir, 0700);
+
+      /* g_file_set_contents() replaces the file atomically */
+      if (! g_file_set_contents (path,
+                                 (const gchar *) datum.data,
+                                 datum.size,
+                                 &error))
+        {
+          g_debug ("Failed to save DH params: %s", error->message);
+          g_error_free (error);
+        }
+
+      gnutls_free (datum.data);
+    }
+
+  g_free (path);
+}
+
 static void
 evd_tls_dh_generator_generate_func (GSimpleAsyncResult *res,
                                     GObject            *object,
                                     GCancellable       *cancellable)
 {
   EvdTlsDhParamsSource *source;
+  EvdTlsDhGenerator *self;
   gnutls_dh_params_t dh_params;
   gint err_code;
   GSimpleAsyncResult *item;
   GError *error = NULL;
+  gint64 created;
+  gboolean fixed = FALSE;
 
   source = (EvdTlsDhParamsSource *) g_simple_async_result_get_source_tag (res);
+  self = source->parent;
 
   /* @TODO: handle cancellation */
 
+  created = g_get_real_time () / G_USEC_PER_SEC;
+
   err_code = gnutls_dh_params_init (&dh_params);
   if (err_code == GNUTLS_E_SUCCESS)
-    err_code = gnutls_dh_params_generate2 (dh_params, source->dh_bits);
+    {
+      if (self->priv->use_ffdhe &&
+          evd_tls_dh_generator_import_ffdhe (source->dh_bits, dh_params))
+        {
+          fixed = TRUE;
+        }
+      else if (! evd_tls_dh_generator_load (source->cache_dir,
+                                            source->dh_bits,
+                                            dh_params,
+                                            &created))
+        {
+          err_code = gnutls_dh_params_generate2 (dh_params, source->dh_bits);
+          if (err_code == GNUTLS_E_SUCCESS)
+            evd_tls_dh_generator_save (source->cache_dir,
+                                       source->dh_bits,
+                                       dh_params);
+        }
+    }
+
+  evd_tls_dh_generator_lock (self);
 
 #if (! GLIB_CHECK_VERSION(2, 31, 0))
   g_mutex_lock (source->mutex);
@@ -185,7 +478,13 @@ evd_tls_dh_generator_generate_func (GSimpleAsyncResult *res,
 #endif
 
   if (! evd_error_propagate_gnutls (err_code, &error))
-    source->dh_params = dh_params;
+    {
+      source->dh_params = dh_params;
+      source->created = created;
+      source->fixed = fixed;
+
+      evd_tls_dh_generator_ref_params_locked (self, dh_params);
+    }
 
   while ( (item =
            G_SIMPLE_ASYNC_RESULT (g_queue_pop_head (source->queue)))
@@ -197,9 +496,7 @@ evd_tls_dh_generator_generate_func (GSimpleAsyncResult *res,
         }
       else
         {
-          g_simple_async_result_set_op_res_gpointer (item,
-                                                   (gpointer) source->dh_params,
-                                                   NULL);
+          evd_tls_dh_generator_set_result (self, item, source->dh_params);
         }
 
       if (item != res)
@@ -210,20 +507,165 @@ evd_tls_dh_generator_generate_func (GSimpleAsyncResult *res,
   g_queue_free (source->queue);
   source->queue = NULL;
 
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+  g_mutex_unlock (source->mutex);
+#else
+  g_mutex_unlock (&source->mutex);
+#endif
+
   if (error != NULL)
     {
       g_error_free (error);
 
-      g_hash_table_remove (source->parent->priv->cache, &source->dh_bits);
+      g_hash_table_remove (self->priv->cache, &source->dh_bits);
 
       evd_tls_dh_generator_free_source (source);
     }
 
+  evd_tls_dh_generator_unlock (self);
+}
+
+static void
+evd_tls_dh_generator_rotate_func (GSimpleAsyncResult *res,
+                                  GObject            *object,
+                                  GCancellable       *cancellable)
+{
+  EvdTlsDhGenerator *self = EVD_TLS_DH_GENERATOR (object);
+  EvdTlsDhRotation *rotation;
+
+  rotation = g_simple_async_result_get_op_res_gpointer (res);
+
+  if (gnutls_dh_params_init (&rotation->dh_params) != GNUTLS_E_SUCCESS)
+    {
+      rotation->dh_params = NULL;
+      return;
+    }
+
+  if (gnutls_dh_params_generate2 (rotation->dh_params, rotation->dh_bits)
+      != GNUTLS_E_SUCCESS)
+    {
+      gnutls_dh_params_deinit (rotation->dh_params);
+      rotation->dh_params = NULL;
+      return;
+    }
+
+  evd_tls_dh_generator_save (rotation->cache_dir,
+                             rotation->dh_bits,
+                             rotation->dh_params);
+}
+
+static void
+evd_tls_dh_generator_on_rotated (GObject      *obj,
+                                 GAsyncResult *res,
+                                 gpointer      user_data)
+{
+  EvdTlsDhGenerator *self = EVD_TLS_DH_GENERATOR (obj);
+  EvdTlsDhRotation *rotation;
+  EvdTlsDhParamsSource *source;
+
+  rotation =
+    g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (res));
+
+  evd_tls_dh_generator_lock (self);
+
+  source = g_hash_table_lookup (self->priv->cache, &rotation->dh_bits);
+  if (source != NULL)
+    {
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+      g_mutex_lock (source->mutex);
+#else
+      g_mutex_lock (&source->mutex);
+#endif
+
+      source->regenerating = FALSE;
+
+      if (rotation->dh_params != NULL && source->dh_params != NULL)
+        {
+          evd_tls_dh_generator_unref_params_locked (self, source->dh_params);
+          source->dh_params = rotation->dh_params;
+          source->created = g_get_real_time () / G_USEC_PER_SEC;
+          evd_tls_dh_generator_ref_params_locked (self, source->dh_params);
+          rotation->dh_params = NULL;
+        }
+
 #if (! GLIB_CHECK_VERSION(2, 31, 0))
-  g_mutex_unlock (source->mutex);
+      g_mutex_unlock (source->mutex);
 #else
-  g_mutex_unlock (&source->mutex);
+      g_mutex_unlock (&source->mutex);
 #endif
+    }
+
+  /* never handed out */
+  if (rotation->dh_params != NULL)
+    gnutls_dh_params_deinit (rotation->dh_params);
+
+  evd_tls_dh_generator_unlock (self);
+}
+
+static void
+evd_tls_dh_generator_free_rotation (gpointer data)
+{
+  EvdTlsDhRotation *rotation = data;
+
+  g_free (rotation->cache_dir);
+  g_slice_free (EvdTlsDhRotation, rotation);
+}
+
+/* must be called with the cache and source mutexes held */
+static void
+evd_tls_dh_generator_check_age (EvdTlsDhGenerator    *self,
+                                EvdTlsDhParamsSource *source)
+{
+  EvdTlsDhRotation *rotation;
+  GSimpleAsyncResult *res;
+
+  if (self->priv->max_age == 0 ||
+      source->fixed ||
+      source->regenerating ||
+      source->dh_params == NULL ||
+      g_get_real_time () / G_USEC_PER_SEC - source->created <
+      self->priv->max_age)
+    {
+      return;
+    }
+
+  /* current params keep being served until the new ones are ready */
+  source->regenerating = TRUE;
+
+  rotation = g_slice_new (EvdTlsDhRotation);
+  rotation->dh_bits = source->dh_bits;
+  rotation->dh_params = NULL;
+  rotation->cache_dir = g_strdup (self->priv->cache_dir);
+
+  res = g_simple_async_result_new (G_OBJECT (self),
+                                   evd_tls_dh_generator_on_rotated,
+                                   NULL,
+                                   evd_tls_dh_generator_check_age);
+  g_simple_async_result_set_op_res_gpointer (res,
+                                             rotation,
+                                             evd_tls_dh_generator_free_rotation);
+
+  g_simple_async_result_run_in_thread (res,
+                                       evd_tls_dh_generator_rotate_func,
+                                       G_PRIORITY_LOW,
+                                       NULL);
+  g_object_unref (res);
+}
+
+static void
+evd_tls_dh_generator_on_pregenerated (GObject      *obj,
+                                      GAsyncResult *res,
+                                      gpointer      user_data)
+{
+  GError *error = NULL;
+
+  if (evd_tls_dh_generator_generate_finish (EVD_TLS_DH_GENERATOR (user_data),
+                                            res,
+                                            &error) == NULL)
+    {
+      g_debug ("Error pre-generating DH params: %s", error->message);
+      g_error_free (error);
+    }
 }
 
 /* public methods */
@@ -252,21 +694,11 @@ evd_tls_dh_generator_generate (EvdTlsDhGenerator   *self,
   g_return_if_fail (bit_length > 0);
   g_return_if_fail (callback != NULL);
 
-#if (! GLIB_CHECK_VERSION(2, 31, 0))
-  g_mutex_lock (self->priv->cache_mutex);
-#else
-  g_mutex_lock (&self->priv->cache_mutex);
-#endif
+  evd_tls_dh_generator_lock (self);
 
   source = g_hash_table_lookup (self->priv->cache,
                                 &bit_length);
 
-#if (! GLIB_CHECK_VERSION(2, 31, 0))
-  g_mutex_unlock (self->priv->cache_mutex);
-#else
-  g_mutex_unlock (&self->priv->cache_mutex);
-#endif
-
   if (source != NULL)
     {
       gboolean params_ready;
@@ -289,32 +721,22 @@ evd_tls_dh_generator_generate (EvdTlsDhGenerator   *self,
         {
           if (! regenerate)
             {
-              g_simple_async_result_set_op_res_gpointer (result,
-                                                   (gpointer) source->dh_params,
-                                                   NULL);
+              evd_tls_dh_generator_set_result (self,
+                                               result,
+                                               source->dh_params);
               g_simple_async_result_complete_in_idle (result);
               g_object_unref (result);
 
+              evd_tls_dh_generator_check_age (self, source);
+
               done = TRUE;
             }
           else
             {
               g_object_unref (result);
 
-#if (! GLIB_CHECK_VERSION(2, 31, 0))
-              g_mutex_lock (self->priv->cache_mutex);
-#else
-              g_mutex_lock (&self->priv->cache_mutex);
-#endif
-
               g_hash_table_remove (self->priv->cache, &source->dh_bits);
 
-#if (! GLIB_CHECK_VERSION(2, 31, 0))
-              g_mutex_unlock (self->priv->cache_mutex);
-#else
-              g_mutex_unlock (&self->priv->cache_mutex);
-#endif
-
 #if (! GLIB_CHECK_VERSION(2, 31, 0))
               g_mutex_unlock (source->mutex);
 #else
@@ -343,13 +765,22 @@ evd_tls_dh_generator_generate (EvdTlsDhGenerator   *self,
         }
 
       if (done)
-        return;
+        {
+          evd_tls_dh_generator_unlock (self);
+          return;
+        }
     }
 
   source = g_slice_new (EvdTlsDhParamsSource);
   source->dh_bits = bit_length;
   source->dh_params = NULL;
   source->queue = g_queue_new ();
+  source->created = 0;
+  source->fixed = FALSE;
+  source->regenerating = FALSE;
+
+  /* the worker must not read the generator's settings unlocked */
+  source->cache_dir = g_strdup (self->priv->cache_dir);
 
 #if (! GLIB_CHECK_VERSION(2, 31, 0))
   source->mutex = g_mutex_new ();
@@ -359,22 +790,10 @@ evd_tls_dh_generator_generate (EvdTlsDhGenerator   *self,
 
   source->parent = self;
 
-#if (! GLIB_CHECK_VERSION(2, 31, 0))
-  g_mutex_lock (self->priv->cache_mutex);
-#else
-  g_mutex_lock (&self->priv->cache_mutex);
-#endif
-
   g_hash_table_insert (self->priv->cache,
                        &source->dh_bits,
                        source);
 
-#if (! GLIB_CHECK_VERSION(2, 31, 0))
-  g_mutex_unlock (self->priv->cache_mutex);
-#else
-  g_mutex_unlock (&self->priv->cache_mutex);
-#endif
-
   result = g_simple_async_result_new (NULL,
                                       callback,
                                       user_data,
@@ -382,19 +801,9 @@ evd_tls_dh_generator_generate (EvdTlsDhGenerator   *self,
 
   /* append the result to the source queue, only to allow
      destroying it in case of premature freeing of the generator */
-#if (! GLIB_CHECK_VERSION(2, 31, 0))
-  g_mutex_lock (source->mutex);
-#else
-  g_mutex_lock (&source->mutex);
-#endif
-
   g_queue_push_tail (source->queue, result);
 
-#if (! GLIB_CHECK_VERSION(2, 31, 0))
-  g_mutex_unlock (source->mutex);
-#else
-  g_mutex_unlock (&source->mutex);
-#endif
+  evd_tls_dh_generator_unlock (self);
 
   g_simple_async_result_run_in_thread (result,
                                        evd_tls_dh_generator_generate_func,
@@ -405,7 +814,8 @@ evd_tls_dh_generator_generate (EvdTlsDhGenerator   *self,
 /**
  * evd_tls_dh_generator_generate_finish:
  *
- * Returns: (transfer none):
+ * Returns: (transfer none): the params, valid as long as @result is alive.
+ * Use evd_tls_dh_generator_get_params() to keep a reference.
  **/
 gpointer
 evd_tls_dh_generator_generate_finish (EvdTlsDhGenerator  *self,
@@ -427,6 +837,160 @@ evd_tls_dh_generator_generate_finish (EvdTlsDhGenerator  *self,
     }
   else
     {
-      return g_simple_async_result_get_op_res_gpointer (res);
+      EvdTlsDhResultRef *ref;
+
+      ref = g_simple_async_result_get_op_res_gpointer (res);
+
+      return ref->dh_params;
+    }
+}
+
+/**
+ * evd_tls_dh_generator_get_params:
+ * @self: The #EvdTlsDhGenerator
+ * @bit_length: Bit depth of the DH params
+ *
+ * Returns the current params of @bit_length, if they have already been
+ * generated, and starts regenerating them in background if they are older
+ * than the maximum age. Holders of DH params should call this every now and
+ * then to pick up rotated ones.
+ *
+ * Returns: (transfer full): the params, to be released with
+ * evd_tls_dh_generator_unref_params(), or %NULL if not ready yet.
+ *
+ * Since: 0.2.0
+ **/
+gpointer
+evd_tls_dh_generator_get_params (EvdTlsDhGenerator *self, guint bit_length)
+{
+  EvdTlsDhParamsSource *source;
+  gnutls_dh_params_t dh_params = NULL;
+
+  g_return_val_if_fail (EVD_IS_TLS_DH_GENERATOR (self), NULL);
+
+  evd_tls_dh_generator_lock (self);
+
+  source = g_hash_table_lookup (self->priv->cache, &bit_length);
+  if (source != NULL)
+    {
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+      g_mutex_lock (source->mutex);
+#else
+      g_mutex_lock (&source->mutex);
+#endif
+
+      dh_params = source->dh_params;
+      if (dh_params != NULL)
+        {
+          evd_tls_dh_generator_ref_params_locked (self, dh_params);
+          evd_tls_dh_generator_check_age (self, source);
+        }
+
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+      g_mutex_unlock (source->mutex);
+#else
+      g_mutex_unlock (&source->mutex);
+#endif
     }
+
+  evd_tls_dh_generator_unlock (self);
+
+  return dh_params;
+}
+
+/**
+ * evd_tls_dh_generator_unref_params:
+ * @self: The #EvdTlsDhGenerator
+ * @dh_params: DH params obtained from evd_tls_dh_generator_get_params()
+ *
+ * Releases a reference to @dh_params. Params replaced by a rotation are
+ * freed once their last reference is released.
+ *
+ * Since: 0.2.0
+ **/
+void
+evd_tls_dh_generator_unref_params (EvdTlsDhGenerator *self,
+                                   gpointer           dh_params)
+{
+  g_return_if_fail (EVD_IS_TLS_DH_GENERATOR (self));
+
+  evd_tls_dh_generator_lock (self);
+  evd_tls_dh_generator_unref_params_locked (self, dh_params);
+  evd_tls_dh_generator_unlock (self);
+}
+
+/**
+ * evd_tls_dh_generator_pregenerate:
+ * @self: The #EvdTlsDhGenerator
+ * @bit_length: Bit depth of the DH params
+ *
+ * Starts loading or generating DH params of @bit_length in background, so
+ * that credentials requesting them later don't have to wait.
+ **/
+void
+evd_tls_dh_generator_pregenerate (EvdTlsDhGenerator *self, guint bit_length)
+{
+  g_return_if_fail (EVD_IS_TLS_DH_GENERATOR (self));
+
+  evd_tls_dh_generator_generate (self,
+                                 bit_length,
+                                 FALSE,
+                                 evd_tls_dh_generator_on_pregenerated,
+                                 NULL,
+                                 self);
+}
+
+/**
+ * evd_tls_dh_generator_set_cache_dir:
+ * @self: The #EvdTlsDhGenerator
+ * @cache_dir: (allow-none): Directory to persist DH params into, or %NULL
+ *
+ * Generated params are saved into @cache_dir as PKCS#3 PEM files, and loaded
+ * from there instead of being generated again.
+ **/
+void
+evd_tls_dh_generator_set_cache_dir (EvdTlsDhGenerator *self,
+                                    const gchar       *cache_dir)
+{
+  g_return_if_fail (EVD_IS_TLS_DH_GENERATOR (self));
+
+  evd_tls_dh_generator_lock (self);
+
+  g_free (self->priv->cache_dir);
+  self->priv->cache_dir = g_strdup (cache_dir);
+
+  evd_tls_dh_generator_unlock (self);
+}
+
+/**
+ * evd_tls_dh_generator_set_max_age:
+ * @self: The #EvdTlsDhGenerator
+ * @max_age: Seconds after which params are regenerated, or 0 for never
+ *
+ * Params older than @max_age are regenerated in background the next time
+ * they are requested. The old params are served until the new ones are ready.
+ **/
+void
+evd_tls_dh_generator_set_max_age (EvdTlsDhGenerator *self, guint max_age)
+{
+  g_return_if_fail (EVD_IS_TLS_DH_GENERATOR (self));
+
+  self->priv->max_age = max_age;
+}
+
+/**
+ * evd_tls_dh_generator_set_use_ffdhe:
+ * @self: The #EvdTlsDhGenerator
+ * @use_ffdhe: Whether to use RFC 7919 groups
+ *
+ * If %TRUE, requests for 2048, 3072 and 4096 bits are served with the
+ * well-known RFC 7919 FFDHE groups instead of generated params.
+ **/
+void
+evd_tls_dh_generator_set_use_ffdhe (EvdTlsDhGenerator *self,
+                                    gboolean           use_ffdhe)
+{
+  g_return_if_fail (EVD_IS_TLS_DH_GENERATOR (self));
+
+  self->priv->use_ffdhe = use_ffdhe;
 }
@@ -68,6 +68,21 @@ gpointer           evd_tls_dh_generator_generate_finish (EvdTlsDhGenerator  *sel
                                                          GAsyncResult       *result,
                                                          GError            **error);
 
+gpointer           evd_tls_dh_generator_get_params      (EvdTlsDhGenerator *self,
+                                                         guint              bit_length);
+void               evd_tls_dh_generator_unref_params    (EvdTlsDhGenerator *self,
+                                                         gpointer           dh_params);
+
+void               evd_tls_dh_generator_pregenerate     (EvdTlsDhGenerator *self,
+                                                         guint              bit_length);
+
+void               evd_tls_dh_generator_set_cache_dir   (EvdTlsDhGenerator *self,
+                                                         const gchar       *cache_dir);
+void               evd_tls_dh_generator_set_max_age     (EvdTlsDhGenerator *self,
+                                                         guint              max_age);
+void               evd_tls_dh_generator_set_use_ffdhe   (EvdTlsDhGenerator *self,
+                                                         gboolean           use_ffdhe);
+
 G_END_DECLS
 
 #endif /* __EVD_TLS_DH_GENERATOR_H__ */
@@ -32,6 +32,11 @@
 
 #define EVD_TLS_SESSION_DEFAULT_PRIORITY "NORMAL"
 
+#define HANDSHAKE_READ_BLOCK_SIZE 4096
+
+/* a full TLS record plus header and expansion */
+#define VEC_PUSH_STACK_SIZE (16384 + 2048 + 5)
+
 G_DEFINE_TYPE (EvdTlsSession, evd_tls_session, G_TYPE_OBJECT)
 
 #define EVD_TLS_SESSION_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), \
@@ -63,7 +68,20 @@ struct _EvdTlsSessionPrivate
 
   gboolean write_shutdown;
 
+  gboolean transport_drained;
+
   gchar *server_name;
+
+  gchar *resume_data;
+  gsize  resume_data_size;
+
+  gboolean threaded_handshake;
+  gboolean handshake_in_thread;
+  gboolean reset_pending;
+  gint handshake_err_code;
+  GByteArray *handshake_input;
+  guint handshake_input_offset;
+  GByteArray *handshake_output;
 };
 
 
@@ -74,7 +92,8 @@ enum
   PROP_CREDENTIALS,
   PROP_MODE,
   PROP_PRIORITY,
-  PROP_REQUIRE_PEER_CERT
+  PROP_REQUIRE_PEER_CERT,
+  PROP_THREADED_HANDSHAKE
 };
 
 static void     evd_tls_session_class_init         (EvdTlsSessionClass *class);
@@ -138,6 +157,14 @@ evd_tls_session_class_init (EvdTlsSessionClass *class)
                                                          G_PARAM_READWRITE |
                                                          G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (obj_class, PROP_THREADED_HANDSHAKE,
+                                   g_param_spec_boolean ("threaded-handshake",
+                                                         "Threaded handshake",
+                                                         "Whether handshake steps run in the TLS worker pool when using evd_tls_session_handshake_async()",
+                                                         FALSE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_STRINGS));
+
   g_type_class_add_private (obj_class, sizeof (EvdTlsSessionPrivate));
 }
 
@@ -171,7 +198,19 @@ evd_tls_session_init (EvdTlsSession *self)
 
   priv->write_shutdown = FALSE;
 
+  priv->transport_drained = FALSE;
+
   priv->server_name = NULL;
+
+  priv->resume_data = NULL;
+  priv->resume_data_size = 0;
+
+  priv->threaded_handshake = FALSE;
+  priv->handshake_in_thread = FALSE;
+  priv->reset_pending = FALSE;
+  priv->handshake_input = g_byte_array_new ();
+  priv->handshake_input_offset = 0;
+  priv->handshake_output = g_byte_array_new ();
 }
 
 static void
@@ -220,6 +259,11 @@ evd_tls_session_finalize (GObject *obj)
   if (self->priv->server_name != NULL)
     g_free (self->priv->server_name);
 
+  g_free (self->priv->resume_data);
+
+  g_byte_array_unref (self->priv->handshake_input);
+  g_byte_array_unref (self->priv->handshake_output);
+
   G_OBJECT_CLASS (evd_tls_session_parent_class)->finalize (obj);
 }
 
@@ -253,6 +297,10 @@ evd_tls_session_set_property (GObject      *obj,
       self->priv->require_peer_cert = g_value_get_boolean (value);
       break;
 
+    case PROP_THREADED_HANDSHAKE:
+      self->priv->threaded_handshake = g_value_get_boolean (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
       break;
@@ -287,6 +335,10 @@ evd_tls_session_get_property (GObject    *obj,
       g_value_set_boolean (value, self->priv->require_peer_cert);
       break;
 
+    case PROP_THREADED_HANDSHAKE:
+      g_value_set_boolean (value, self->priv->threaded_handshake);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (obj, prop_id, pspec);
       break;
@@ -302,6 +354,14 @@ evd_tls_session_push (gnutls_transport_ptr_t  ptr,
   gssize res;
   GError *error = NULL;
 
+  /* while a handshake step runs in a worker thread, records are queued
+     and written to the transport from the main loop afterwards */
+  if (self->priv->handshake_in_thread)
+    {
+      g_byte_array_append (self->priv->handshake_output, buf, size);
+      return size;
+    }
+
   res = self->priv->push_func (self,
                                buf,
                                size,
@@ -323,6 +383,46 @@ evd_tls_session_push (gnutls_transport_ptr_t  ptr,
   return res;
 }
 
+static gssize
+evd_tls_session_vec_push (gnutls_transport_ptr_t  ptr,
+                          const giovec_t         *iov,
+                          gint                    iovcnt)
+{
+  EvdTlsSession *self = EVD_TLS_SESSION (ptr);
+  gchar stack_buf[VEC_PUSH_STACK_SIZE];
+  gchar *buf;
+  gsize total = 0;
+  gsize offset = 0;
+  gssize res;
+  gint i;
+
+  if (iovcnt == 1)
+    return evd_tls_session_push (ptr, iov[0].iov_base, iov[0].iov_len);
+
+  /* gather the record header and payload so that the whole record goes
+     to the transport in a single write */
+  for (i = 0; i < iovcnt; i++)
+    total += iov[i].iov_len;
+
+  if (total <= VEC_PUSH_STACK_SIZE)
+    buf = stack_buf;
+  else
+    buf = g_malloc (total);
+
+  for (i = 0; i < iovcnt; i++)
+    {
+      memcpy (buf + offset, iov[i].iov_base, iov[i].iov_len);
+      offset += iov[i].iov_len;
+    }
+
+  res = evd_tls_session_push (ptr, buf, total);
+
+  if (buf != stack_buf)
+    g_free (buf);
+
+  return res;
+}
+
 static gssize
 evd_tls_session_pull (gnutls_transport_ptr_t  ptr,
                       void                   *buf,
@@ -332,6 +432,33 @@ evd_tls_session_pull (gnutls_transport_ptr_t  ptr,
   gssize res;
   GError *error = NULL;
 
+  /* serve input read ahead for a threaded handshake first */
+  if (self->priv->handshake_in_thread ||
+      self->priv->handshake_input_offset < self->priv->handshake_input->len)
+    {
+      GByteArray *input = self->priv->handshake_input;
+
+      res = MIN (size, input->len - self->priv->handshake_input_offset);
+      if (res == 0)
+        {
+          gnutls_transport_set_errno (self->priv->session, EAGAIN);
+          return -1;
+        }
+
+      memcpy (buf, input->data + self->priv->handshake_input_offset, res);
+      self->priv->handshake_input_offset += res;
+
+      return res;
+    }
+
+  /* a previous short read already emptied the transport, don't go down
+     the stream stack just to hit EAGAIN */
+  if (self->priv->transport_drained)
+    {
+      gnutls_transport_set_errno (self->priv->session, EAGAIN);
+      return -1;
+    }
+
   res = self->priv->pull_func (self,
                                buf,
                                size,
@@ -340,8 +467,10 @@ evd_tls_session_pull (gnutls_transport_ptr_t  ptr,
 
   if (res < 0)
     {
-      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK))
+      if (error == NULL ||
+          g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK))
         {
+          self->priv->transport_drained = TRUE;
           gnutls_transport_set_errno (self->priv->session, EAGAIN);
           res = -1;
         }
@@ -351,12 +480,17 @@ evd_tls_session_pull (gnutls_transport_ptr_t  ptr,
           g_debug ("TLS transport error during pull: %s", error->message);
         }
 
-      g_error_free (error);
+      if (error != NULL)
+        g_error_free (error);
     }
   else if (res == 0)
     {
       /* @TODO: handle end of stream */
     }
+  else if (res < size)
+    {
+      self->priv->transport_drained = TRUE;
+    }
 
   return res;
 }
@@ -367,6 +501,8 @@ evd_tls_session_handshake_internal (EvdTlsSession  *self,
 {
   gint err_code;
 
+  self->priv->transport_drained = FALSE;
+
   err_code = gnutls_handshake (self->priv->session);
   if (err_code == GNUTLS_E_SUCCESS)
     {
@@ -416,6 +552,10 @@ evd_tls_session_bind_credentials (EvdTlsSession      *self,
     {
       return FALSE;
     }
+  else if (! evd_tls_credentials_setup_session (cred, self, error))
+    {
+      return FALSE;
+    }
   else
     {
       self->priv->cred_bound = TRUE;
@@ -456,6 +596,8 @@ evd_tls_session_shutdown (EvdTlsSession           *self,
     {
       gint err_code;
 
+      self->priv->transport_drained = FALSE;
+
       err_code = gnutls_bye (self->priv->session, how);
       if (err_code < 0 && gnutls_error_is_fatal (err_code) != 0)
         {
@@ -604,15 +746,13 @@ evd_tls_session_set_transport_push_func (EvdTlsSession         *self,
   self->priv->push_user_data_free_func = user_data_free_func;
 }
 
-gint
-evd_tls_session_handshake (EvdTlsSession  *self,
-                           GError        **error)
+static gint
+evd_tls_session_prepare (EvdTlsSession  *self,
+                         GError        **error)
 {
   EvdTlsCredentials *cred;
   gint err_code;
 
-  g_return_val_if_fail (EVD_IS_TLS_SESSION (self), FALSE);
-
   if (self->priv->session == NULL)
     {
       err_code = gnutls_init (&self->priv->session, self->priv->mode);
@@ -643,9 +783,26 @@ evd_tls_session_handshake (EvdTlsSession  *self,
           gnutls_transport_set_ptr2 (self->priv->session, self, self);
           gnutls_transport_set_push_function (self->priv->session,
                                               evd_tls_session_push);
+          gnutls_transport_set_vec_push_function (self->priv->session,
+                                                  evd_tls_session_vec_push);
           gnutls_transport_set_pull_function (self->priv->session,
                                               evd_tls_session_pull);
 
+#if GNUTLS_VERSION_NUMBER < 0x030600
+          /* newer GnuTLS accepts tickets on the client by default */
+          if (self->priv->mode == EVD_TLS_MODE_CLIENT)
+            gnutls_session_ticket_enable_client (self->priv->session);
+#endif
+
+          if (self->priv->resume_data != NULL &&
+              self->priv->mode == EVD_TLS_MODE_CLIENT)
+            {
+              /* a failure here only means a full handshake will happen */
+              gnutls_session_set_data (self->priv->session,
+                                       self->priv->resume_data,
+                                       self->priv->resume_data_size);
+            }
+
           cred = evd_tls_session_get_credentials (self);
           if (! evd_tls_credentials_ready (cred))
             {
@@ -668,10 +825,280 @@ evd_tls_session_handshake (EvdTlsSession  *self,
         }
     }
 
-  if (self->priv->cred_bound)
-    return evd_tls_session_handshake_internal (self, error);
-  else
+  return self->priv->cred_bound ? 1 : 0;
+}
+
+gint
+evd_tls_session_handshake (EvdTlsSession  *self,
+                           GError        **error)
+{
+  gint result;
+
+  g_return_val_if_fail (EVD_IS_TLS_SESSION (self), -1);
+
+  if (self->priv->handshake_in_thread)
     return 0;
+
+  result = evd_tls_session_prepare (self, error);
+  if (result <= 0)
+    return result;
+
+  return evd_tls_session_handshake_internal (self, error);
+}
+
+static gssize
+evd_tls_session_read_handshake_input (EvdTlsSession  *self,
+                                      GError        **error)
+{
+  GByteArray *input = self->priv->handshake_input;
+  gchar buf[HANDSHAKE_READ_BLOCK_SIZE];
+  gssize total = 0;
+  gssize size;
+  GError *_error = NULL;
+
+  if (self->priv->handshake_input_offset == input->len)
+    {
+      g_byte_array_set_size (input, 0);
+      self->priv->handshake_input_offset = 0;
+    }
+
+  do
+    {
+      size = self->priv->pull_func (self,
+                                    buf,
+                                    HANDSHAKE_READ_BLOCK_SIZE,
+                                    self->priv->pull_user_data,
+                                    &_error);
+      if (size > 0)
+        {
+          g_byte_array_append (input, (guint8 *) buf, size);
+          total += size;
+        }
+    }
+  while (size == HANDSHAKE_READ_BLOCK_SIZE);
+
+  /* -1 without error is a would-block from the transport */
+  if (size < 0 && _error != NULL)
+    {
+      if (g_error_matches (_error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK))
+        {
+          g_error_free (_error);
+        }
+      else
+        {
+          g_propagate_error (error, _error);
+          return -1;
+        }
+    }
+
+  return total;
+}
+
+static gboolean
+evd_tls_session_flush_handshake_output (EvdTlsSession  *self,
+                                        GError        **error)
+{
+  GByteArray *output = self->priv->handshake_output;
+  gssize size;
+
+  if (output->len == 0)
+    return TRUE;
+
+  size = self->priv->push_func (self,
+                                (const gchar *) output->data,
+                                output->len,
+                                self->priv->push_user_data,
+                                error);
+  if (size < 0)
+    return FALSE;
+
+  g_byte_array_remove_range (output, 0, size);
+
+  return TRUE;
+}
+
+static void
+evd_tls_session_handshake_thread (GSimpleAsyncResult *res,
+                                  GObject            *object,
+                                  GCancellable       *cancellable)
+{
+  EvdTlsSession *self = EVD_TLS_SESSION (object);
+
+  self->priv->handshake_err_code = gnutls_handshake (self->priv->session);
+}
+
+static void evd_tls_session_on_handshake_step (GObject      *obj,
+                                               GAsyncResult *res,
+                                               gpointer      user_data);
+
+static void
+evd_tls_session_run_handshake_step (EvdTlsSession      *self,
+                                    GSimpleAsyncResult *res)
+{
+  GSimpleAsyncResult *step;
+
+  step = g_simple_async_result_new (G_OBJECT (self),
+                                    evd_tls_session_on_handshake_step,
+                                    res,
+                                    evd_tls_session_run_handshake_step);
+
+  self->priv->handshake_in_thread = TRUE;
+  evd_tls_run_in_worker_thread (step,
+                                evd_tls_session_handshake_thread,
+                                G_OBJECT (self),
+                                NULL);
+  g_object_unref (step);
+}
+
+static void
+evd_tls_session_on_handshake_step (GObject      *obj,
+                                   GAsyncResult *res,
+                                   gpointer      user_data)
+{
+  EvdTlsSession *self = EVD_TLS_SESSION (obj);
+  GSimpleAsyncResult *outer = G_SIMPLE_ASYNC_RESULT (user_data);
+  gint err_code = self->priv->handshake_err_code;
+  GError *error = NULL;
+  gssize size;
+
+  self->priv->handshake_in_thread = FALSE;
+
+  if (self->priv->reset_pending)
+    {
+      self->priv->reset_pending = FALSE;
+      g_byte_array_set_size (self->priv->handshake_output, 0);
+      evd_tls_session_reset (self);
+
+      g_simple_async_result_set_error (outer,
+                                       G_IO_ERROR,
+                                       G_IO_ERROR_CANCELLED,
+                                       "TLS session reset during handshake");
+    }
+  else if (! evd_tls_session_flush_handshake_output (self, &error))
+    {
+      g_simple_async_result_take_error (outer, error);
+    }
+  else if (err_code == GNUTLS_E_SUCCESS)
+    {
+      g_simple_async_result_set_op_res_gssize (outer, 1);
+    }
+  else if (gnutls_error_is_fatal (err_code) == 1)
+    {
+      evd_error_propagate_gnutls (err_code, &error);
+      g_simple_async_result_take_error (outer, error);
+    }
+  else if ( (size = evd_tls_session_read_handshake_input (self, &error)) < 0)
+    {
+      g_simple_async_result_take_error (outer, error);
+    }
+  else if (size > 0)
+    {
+      /* more records arrived while the worker was busy, keep going */
+      evd_tls_session_run_handshake_step (self, outer);
+      return;
+    }
+  else
+    {
+      g_simple_async_result_set_op_res_gssize (outer, 0);
+    }
+
+  g_simple_async_result_complete (outer);
+  g_object_unref (outer);
+}
+
+/**
+ * evd_tls_session_handshake_async:
+ * @self: The #EvdTlsSession
+ * @cancellable: (allow-none): A #GCancellable, or %NULL
+ * @callback: (allow-none): A #GAsyncReadyCallback to call when the step completes
+ * @user_data: (allow-none): User data for @callback
+ *
+ * Asynchronous version of evd_tls_session_handshake(). If the
+ * #EvdTlsSession:threaded-handshake property is %TRUE, the handshake
+ * step runs in the TLS worker pool (see evd_tls_run_in_worker_thread()),
+ * with records exchanged with the transport from the calling thread.
+ * Otherwise, the step runs synchronously and @callback is called in idle.
+ **/
+void
+evd_tls_session_handshake_async (EvdTlsSession       *self,
+                                 GCancellable        *cancellable,
+                                 GAsyncReadyCallback  callback,
+                                 gpointer             user_data)
+{
+  GSimpleAsyncResult *res;
+  GError *error = NULL;
+  gint result;
+
+  g_return_if_fail (EVD_IS_TLS_SESSION (self));
+
+  res = g_simple_async_result_new (G_OBJECT (self),
+                                   callback,
+                                   user_data,
+                                   evd_tls_session_handshake_async);
+
+  if (self->priv->handshake_in_thread)
+    {
+      g_simple_async_result_set_error (res,
+                                       G_IO_ERROR,
+                                       G_IO_ERROR_PENDING,
+                                       "A handshake step is already in progress");
+      goto out;
+    }
+
+  result = evd_tls_session_prepare (self, &error);
+  if (result > 0)
+    {
+      if (! self->priv->threaded_handshake)
+        {
+          result = evd_tls_session_handshake_internal (self, &error);
+        }
+      else if (evd_tls_session_read_handshake_input (self, &error) >= 0)
+        {
+          evd_tls_session_run_handshake_step (self, res);
+          return;
+        }
+      else
+        {
+          result = -1;
+        }
+    }
+
+  if (result < 0)
+    g_simple_async_result_take_error (res, error);
+  else
+    g_simple_async_result_set_op_res_gssize (res, result);
+
+ out:
+  g_simple_async_result_complete_in_idle (res);
+  g_object_unref (res);
+}
+
+/**
+ * evd_tls_session_handshake_finish:
+ * @self: The #EvdTlsSession
+ * @result: The #GAsyncResult
+ * @error: (allow-none):
+ *
+ * Returns: 1 if the handshake completed, 0 if more data from the peer is
+ *          needed, or -1 on error.
+ **/
+gint
+evd_tls_session_handshake_finish (EvdTlsSession  *self,
+                                  GAsyncResult   *result,
+                                  GError        **error)
+{
+  g_return_val_if_fail (EVD_IS_TLS_SESSION (self), -1);
+  g_return_val_if_fail (g_simple_async_result_is_valid (result,
+                                                        G_OBJECT (self),
+                                                        evd_tls_session_handshake_async),
+                        -1);
+
+  if (g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (result),
+                                             error))
+    return -1;
+
+  return (gint) g_simple_async_result_get_op_res_gssize (
+                                               G_SIMPLE_ASYNC_RESULT (result));
 }
 
 gssize
@@ -686,6 +1113,8 @@ evd_tls_session_read (EvdTlsSession  *self,
   g_return_val_if_fail (size > 0, -1);
   g_return_val_if_fail (buffer != NULL, -1);
 
+  self->priv->transport_drained = FALSE;
+
   result = gnutls_record_recv (self->priv->session, buffer, size);
 
   if (result == 0)
@@ -743,7 +1172,7 @@ evd_tls_session_get_direction (EvdTlsSession *self)
 {
   g_return_val_if_fail (EVD_IS_TLS_SESSION (self), 0);
 
-  if (self->priv->session == NULL)
+  if (self->priv->session == NULL || self->priv->handshake_in_thread)
     return 0;
   else
     if (gnutls_record_get_direction (self->priv->session) == 0)
@@ -775,6 +1204,7 @@ evd_tls_session_copy_properties (EvdTlsSession *self,
                 "credentials", evd_tls_session_get_credentials (self),
                 "priority", self->priv->priority,
                 "require-peer-cert", self->priv->require_peer_cert,
+                "threaded-handshake", self->priv->threaded_handshake,
                 NULL);
 }
 
@@ -906,6 +1336,16 @@ evd_tls_session_reset (EvdTlsSession *self)
 {
   g_return_if_fail (EVD_IS_TLS_SESSION (self));
 
+  /* the worker owns the gnutls session; reset when the step returns */
+  if (self->priv->handshake_in_thread)
+    {
+      self->priv->reset_pending = TRUE;
+      return;
+    }
+
+  g_byte_array_set_size (self->priv->handshake_input, 0);
+  self->priv->handshake_input_offset = 0;
+
   if (self->priv->session != NULL)
     {
       if (self->priv->cred_ready_sig_id != 0)
@@ -957,13 +1397,14 @@ evd_tls_session_get_server_name (EvdTlsSession *self)
       && self->priv->session != NULL)
     {
       gint err;
-      gsize len = 16;
-      gchar buf[16] = {0, };
+      gsize len;
+      gchar buf[256]; /* DNS names are at most 255 bytes */
       guint type;
       guint index = 0;
 
       do
         {
+          len = sizeof (buf);
           err = gnutls_server_name_get (self->priv->session,
                                         buf,
                                         &len,
@@ -971,26 +1412,9 @@ evd_tls_session_get_server_name (EvdTlsSession *self)
                                         index);
 
           if (err == GNUTLS_E_SUCCESS && type == GNUTLS_NAME_DNS)
-            {
-              self->priv->server_name = g_new0 (gchar, len + 1);
-
-              if (err == GNUTLS_E_SHORT_MEMORY_BUFFER)
-                {
-                  err = gnutls_server_name_get (self->priv->session,
-                                                self->priv->server_name,
-                                                &len,
-                                                &type,
-                                                index);
-                }
-              else
-                {
-                  memmove (self->priv->server_name, buf, len);
-                }
-            }
+            self->priv->server_name = g_strndup (buf, len);
           else
-            {
-              index++;
-            }
+            index++;
         }
       while (err != GNUTLS_E_REQUESTED_DATA_NOT_AVAILABLE
              && self->priv->server_name == NULL);
@@ -998,3 +1422,101 @@ evd_tls_session_get_server_name (EvdTlsSession *self)
 
   return self->priv->server_name;
 }
+
+/**
+ * evd_tls_session_get_native:
+ *
+ * Returns: (transfer none): The underlying GnuTLS session, or %NULL if
+ * the handshake has not been started yet.
+ **/
+gpointer
+evd_tls_session_get_native (EvdTlsSession *self)
+{
+  g_return_val_if_fail (EVD_IS_TLS_SESSION (self), NULL);
+
+  return self->priv->session;
+}
+
+/**
+ * evd_tls_session_set_resume_data:
+ * @self: The #EvdTlsSession
+ * @data: (allow-none) (array length=size): Session data as returned by
+ * evd_tls_session_get_resume_data(), or %NULL to clear it
+ * @size: Size of @data
+ *
+ * Sets the data of a previous session to try to resume during the next
+ * client-side handshake. If the server refuses to resume it, a full
+ * handshake is performed transparently.
+ **/
+void
+evd_tls_session_set_resume_data (EvdTlsSession *self,
+                                 const gchar   *data,
+                                 gsize          size)
+{
+  g_return_if_fail (EVD_IS_TLS_SESSION (self));
+
+  g_free (self->priv->resume_data);
+  self->priv->resume_data = NULL;
+  self->priv->resume_data_size = 0;
+
+  if (data != NULL && size > 0)
+    {
+      self->priv->resume_data = g_memdup (data, size);
+      self->priv->resume_data_size = size;
+    }
+}
+
+/**
+ * evd_tls_session_get_resume_data:
+ * @self: The #EvdTlsSession
+ * @size: (out): Return location for the size of the data
+ * @error: (allow-none):
+ *
+ * Exports the parameters of the current session, which can later be passed to
+ * evd_tls_session_set_resume_data() on a new client session to resume it.
+ *
+ * Returns: (transfer full) (array length=size): A newly allocated buffer, or
+ * %NULL on error.
+ **/
+gchar *
+evd_tls_session_get_resume_data (EvdTlsSession  *self,
+                                 gsize          *size,
+                                 GError        **error)
+{
+  gnutls_datum_t datum;
+  gchar *data;
+  gint err_code;
+
+  g_return_val_if_fail (EVD_IS_TLS_SESSION (self), NULL);
+  g_return_val_if_fail (size != NULL, NULL);
+
+  if (! evd_tls_session_check_initialized (self, error))
+    return NULL;
+
+  err_code = gnutls_session_get_data2 (self->priv->session, &datum);
+  if (evd_error_propagate_gnutls (err_code, error))
+    return NULL;
+
+  data = g_memdup (datum.data, datum.size);
+  *size = datum.size;
+  gnutls_free (datum.data);
+
+  return data;
+}
+
+/**
+ * evd_tls_session_is_resumed:
+ *
+ * Returns: %TRUE if the last handshake resumed a previous session instead of
+ * performing a full key exchange.
+ **/
+gboolean
+evd_tls_session_is_resumed (EvdTlsSession *self)
+{
+  g_return_val_if_fail (EVD_IS_TLS_SESSION (self), FALSE);
+
+  if (self->priv->session == NULL)
+    return FALSE;
+
+  return gnutls_session_is_resumed (self->priv->session) != 0;
+}
@@ -39,6 +39,8 @@ typedef struct _EvdTlsSession EvdTlsSession;
 typedef struct _EvdTlsSessionClass EvdTlsSessionClass;
 typedef struct _EvdTlsSessionPrivate EvdTlsSessionPrivate;
 
+/* a pull function may return -1 without setting @error to signal that
+   no more data is available (would block) */
 typedef gssize (* EvdTlsSessionPullFunc) (EvdTlsSession  *self,
                                           gchar          *buf,
                                           gsize           size,
@@ -95,6 +97,13 @@ void               evd_tls_session_set_transport_push_func (EvdTlsSession
 
 gint               evd_tls_session_handshake               (EvdTlsSession   *self,
                                                             GError         **error);
+void               evd_tls_session_handshake_async         (EvdTlsSession       *self,
+                                                            GCancellable        *cancellable,
+                                                            GAsyncReadyCallback  callback,
+                                                            gpointer             user_data);
+gint               evd_tls_session_handshake_finish        (EvdTlsSession  *self,
+                                                            GAsyncResult   *result,
+                                                            GError        **error);
 
 gssize             evd_tls_session_read                    (EvdTlsSession  *self,
                                                             gchar          *buffer,
@@ -129,6 +138,16 @@ gboolean           evd_tls_session_set_server_name         (EvdTlsSession  *self
                                                             GError        **error);
 const gchar       *evd_tls_session_get_server_name         (EvdTlsSession  *self);
 
+gpointer           evd_tls_session_get_native              (EvdTlsSession *self);
+
+void               evd_tls_session_set_resume_data         (EvdTlsSession *self,
+                                                            const gchar   *data,
+                                                            gsize          size);
+gchar             *evd_tls_session_get_resume_data         (EvdTlsSession  *self,
+                                                            gsize          *size,
+                                                            GError        **error);
+gboolean           evd_tls_session_is_resumed              (EvdTlsSession *self);
+
 G_END_DECLS
 
 #endif /* __EVD_TLS_SESSION_H__ */
@@ -27,6 +27,7 @@
 #include "evd-utils.h"
 #include "evd-marshal.h"
 #include "evd-peer-manager.h"
+#include "evd-metrics.h"
 
 #define PEER_MSG_KEY     "org.eventdance.lib.transport.PEER_MESSAGE"
 #define PEER_CLOSING_KEY "org.eventdance.lib.Transport.PEER_CLOSING"
@@ -48,12 +49,34 @@ typedef struct
   gsize size;
 } EvdTransportPeerMessage;
 
+typedef struct
+{
+  guint id;
+  EvdTransportReceiveFunc func;
+  gpointer user_data;
+  GDestroyNotify user_data_free_func;
+} EvdTransportReceiveHandler;
+
+typedef struct
+{
+  GArray *handlers;
+  guint last_id;
+  guint dispatching;
+  gboolean pending_removal;
+} EvdTransportReceiveHandlers;
+
 static guint evd_transport_signals[SIGNAL_LAST] = { 0 };
 
-static void     evd_transport_receive_internal         (EvdTransport *self,
-                                                        EvdPeer      *peer,
-                                                        const gchar  *buffer,
-                                                        gsize         size);
+static GQuark receive_handlers_quark = 0;
+
+static EvdMetric *metric_received = NULL;
+static EvdMetric *metric_sent = NULL;
+
+static void     evd_transport_receive_internal         (EvdTransport   *self,
+                                                        EvdPeer        *peer,
+                                                        const gchar    *buffer,
+                                                        gsize           size,
+                                                        EvdMessageType  type);
 static void     evd_transport_notify_receive           (EvdTransport *self,
                                                         EvdPeer      *peer);
 
@@ -129,6 +152,9 @@ evd_transport_base_init (gpointer g_class)
                       G_TYPE_UINT, 1,
                       EVD_TYPE_PEER);
 
+      receive_handlers_quark =
+        g_quark_from_static_string ("org.eventdance.lib.Transport.RECEIVE_HANDLERS");
+
       is_initialized = TRUE;
     }
 
@@ -199,15 +225,118 @@ evd_transport_notify_receive (EvdTransport *self, EvdPeer *peer)
 }
 
 static void
-evd_transport_receive_internal (EvdTransport *self,
-                                EvdPeer      *peer,
-                                const gchar  *buffer,
-                                gsize         size)
+evd_transport_receive_handlers_free (gpointer data)
+{
+  EvdTransportReceiveHandlers *handlers = data;
+  guint i;
+
+  for (i = 0; i < handlers->handlers->len; i++)
+    {
+      EvdTransportReceiveHandler *handler;
+
+      handler = &g_array_index (handlers->handlers,
+                                EvdTransportReceiveHandler,
+                                i);
+      if (handler->func != NULL && handler->user_data_free_func != NULL)
+        handler->user_data_free_func (handler->user_data);
+    }
+
+  g_array_free (handlers->handlers, TRUE);
+  g_slice_free (EvdTransportReceiveHandlers, handlers);
+}
+
+static void
+evd_transport_receive_handlers_compact (EvdTransportReceiveHandlers *handlers)
+{
+  guint i = 0;
+
+  while (i < handlers->handlers->len)
+    {
+      if (g_array_index (handlers->handlers,
+                         EvdTransportReceiveHandler,
+                         i).func == NULL)
+        g_array_remove_index (handlers->handlers, i);
+      else
+        i++;
+    }
+
+  handlers->pending_removal = FALSE;
+}
+
+static void
+evd_transport_dispatch_receive (EvdTransport   *self,
+                                EvdPeer        *peer,
+                                const gchar    *buffer,
+                                gsize           size,
+                                EvdMessageType  type)
 {
+  EvdTransportReceiveHandlers *handlers;
+  guint i;
+
+  handlers = g_object_get_qdata (G_OBJECT (self), receive_handlers_quark);
+  if (handlers == NULL || handlers->handlers->len == 0)
+    return;
+
+  handlers->dispatching++;
+
+  /* handlers added during dispatch are appended and also see this message,
+     removed ones are only marked and get compacted afterwards */
+  for (i = 0; i < handlers->handlers->len; i++)
+    {
+      EvdTransportReceiveHandler *handler;
+
+      handler = &g_array_index (handlers->handlers,
+                                EvdTransportReceiveHandler,
+                                i);
+      if (handler->func != NULL)
+        handler->func (self, peer, buffer, size, type, handler->user_data);
+    }
+
+  handlers->dispatching--;
+
+  if (handlers->dispatching == 0 && handlers->pending_removal)
+    evd_transport_receive_handlers_compact (handlers);
+}
+
+static void
+evd_transport_receive_internal (EvdTransport   *self,
+                                EvdPeer        *peer,
+                                const gchar    *buffer,
+                                gsize           size,
+                                EvdMessageType  type)
+{
+  EvdTransport *transport;
   EvdTransportPeerMessage *msg;
 
+  evd_metric_add (EVD_METRIC (metric_received,
+                              "evd_transport_received_messages_total",
+                              EVD_METRIC_COUNTER,
+                              "Messages received by transports"),
+                  1);
+  evd_peer_count_message (peer, size, TRUE);
+
+  /* the peer's transport may be a wrapper around @self, like
+     EvdWebTransportServer, so handlers are looked up there */
+  transport = evd_peer_get_transport (peer);
+
+  g_object_ref (transport);
   g_object_ref (peer);
 
+  evd_transport_dispatch_receive (transport, peer, buffer, size, type);
+
+  /* the 'receive' signal is kept for compatibility, and only paid for when
+     someone is connected to it */
+  if (EVD_TRANSPORT_GET_INTERFACE (transport)->signal_receive == NULL &&
+      ! g_signal_has_handler_pending (transport,
+                                      evd_transport_signals[SIGNAL_RECEIVE],
+                                      0,
+                                      FALSE))
+    {
+      g_object_unref (peer);
+      g_object_unref (transport);
+      return;
+    }
+
   msg = g_object_get_data (G_OBJECT (peer), PEER_MSG_KEY);
   if (msg == NULL)
     {
@@ -233,6 +362,7 @@ evd_transport_receive_internal (EvdTransport *self,
   msg->size = 0;
 
   g_object_unref (peer);
+  g_object_unref (transport);
 }
 
 static void
@@ -317,6 +447,43 @@ evd_transport_accept_peer_internal (EvdTransport *self, EvdPeer *peer)
   return TRUE;
 }
 
+static gboolean
+send_frame_full (EvdTransport    *self,
+                 EvdPeer         *peer,
+                 const gchar     *buffer,
+                 gsize            size,
+                 GByteArray      *shared,
+                 EvdMessageType   type,
+                 GError         **error)
+{
+  gboolean queued;
+
+  g_return_val_if_fail (EVD_IS_TRANSPORT (self), FALSE);
+  g_return_val_if_fail (EVD_IS_PEER (peer), FALSE);
+
+  evd_metric_add (EVD_METRIC (metric_sent,
+                              "evd_transport_sent_messages_total",
+                              EVD_METRIC_COUNTER,
+                              "Messages sent through transports, delivered or queued"),
+                  1);
+  evd_peer_count_message (peer, size, FALSE);
+
+  if (EVD_TRANSPORT_GET_INTERFACE (self)->send (self,
+                                                peer,
+                                                buffer,
+                                                size,
+                                                type,
+                                                NULL))
+    return TRUE;
+
+  if (shared != NULL)
+    queued = evd_peer_push_shared_message (peer, shared, type, error);
+  else
+    queued = evd_peer_push_message (peer, buffer, size, type, error);
+
+  return queued;
+}
+
 static gboolean
 send_frame (EvdTransport    *self,
             EvdPeer         *peer,
@@ -325,27 +492,7 @@ send_frame (EvdTransport    *self,
             EvdMessageType   type,
             GError         **error)
 {
-  g_return_val_if_fail (EVD_IS_TRANSPORT (self), FALSE);
-  g_return_val_if_fail (EVD_IS_PEER (peer), FALSE);
-
-  if (! EVD_TRANSPORT_GET_INTERFACE (self)->send (self,
-                                                  peer,
-                                                  buffer,
-                                                  size,
-                                                  type,
-                                                  NULL)
-      && ! evd_peer_push_message (peer,
-                                  buffer,
-                                  size,
-                                  type,
-                                  error))
-    {
-      return FALSE;
-    }
-  else
-    {
-      return TRUE;
-    }
+  return send_frame_full (self, peer, buffer, size, NULL, type, error);
 }
 
 /* public methods */
@@ -373,6 +520,36 @@ evd_transport_send_text (EvdTransport  *self,
   return send_frame (self, peer, text, size, EVD_MESSAGE_TYPE_TEXT, error);
 }
 
+/**
+ * evd_transport_send_shared:
+ * @message: the payload, which must not be modified afterwards
+ *
+ * Sends @message to @peer. If the message has to be queued in the peer's
+ * backlog, a reference to @message is kept instead of a copy, so the same
+ * payload can be fanned out to many peers cheaply.
+ *
+ * Returns: %TRUE if the message was delivered or queued.
+ *
+ * Since: 0.2.0
+ **/
+gboolean
+evd_transport_send_shared (EvdTransport    *self,
+                           EvdPeer         *peer,
+                           GByteArray      *message,
+                           EvdMessageType   type,
+                           GError         **error)
+{
+  g_return_val_if_fail (message != NULL, FALSE);
+
+  return send_frame_full (self,
+                          peer,
+                          (const gchar *) message->data,
+                          message->len,
+                          message,
+                          type,
+                          error);
+}
+
 /**
  * evd_transport_receive:
  * @size: (out):
@@ -425,6 +602,108 @@ evd_transport_receive_text (EvdTransport *self,
   return msg->text_buffer;
 }
 
+/**
+ * evd_transport_add_receive_handler:
+ * @func: (scope notified):
+ * @user_data: (allow-none):
+ * @user_data_free_func: (allow-none):
+ *
+ * Registers @func to be called directly for every message received on @self,
+ * with the message buffer, size and type. This avoids the 'receive' signal
+ * emission and the evd_transport_receive() lookup, and is the preferred way
+ * to consume messages from C.
+ *
+ * Returns: an id to be used with evd_transport_remove_receive_handler().
+ *
+ * Since: 0.2.0
+ **/
+guint
+evd_transport_add_receive_handler (EvdTransport            *self,
+                                   EvdTransportReceiveFunc  func,
+                                   gpointer                 user_data,
+                                   GDestroyNotify           user_data_free_func)
+{
+  EvdTransportReceiveHandlers *handlers;
+  EvdTransportReceiveHandler handler;
+
+  g_return_val_if_fail (EVD_IS_TRANSPORT (self), 0);
+  g_return_val_if_fail (func != NULL, 0);
+
+  handlers = g_object_get_qdata (G_OBJECT (self), receive_handlers_quark);
+  if (handlers == NULL)
+    {
+      handlers = g_slice_new0 (EvdTransportReceiveHandlers);
+      handlers->handlers = g_array_new (FALSE,
+                                        FALSE,
+                                        sizeof (EvdTransportReceiveHandler));
+      g_object_set_qdata_full (G_OBJECT (self),
+                               receive_handlers_quark,
+                               handlers,
+                               evd_transport_receive_handlers_free);
+    }
+
+  handlers->last_id++;
+
+  handler.id = handlers->last_id;
+  handler.func = func;
+  handler.user_data = user_data;
+  handler.user_data_free_func = user_data_free_func;
+
+  g_array_append_val (handlers->handlers, handler);
+
+  return handler.id;
+}
+
+/**
+ * evd_transport_remove_receive_handler:
+ * @handler_id: the id returned by evd_transport_add_receive_handler()
+ *
+ * Since: 0.2.0
+ **/
+void
+evd_transport_remove_receive_handler (EvdTransport *self, guint handler_id)
+{
+  EvdTransportReceiveHandlers *handlers;
+  guint i;
+
+  g_return_if_fail (EVD_IS_TRANSPORT (self));
+
+  handlers = g_object_get_qdata (G_OBJECT (self), receive_handlers_quark);
+  if (handlers == NULL)
+    return;
+
+  for (i = 0; i < handlers->handlers->len; i++)
+    {
+      EvdTransportReceiveHandler *handler;
+      GDestroyNotify free_func;
+      gpointer user_data;
+
+      handler = &g_array_index (handlers->handlers,
+                                EvdTransportReceiveHandler,
+                                i);
+      if (handler->id != handler_id || handler->func == NULL)
+        continue;
+
+      free_func = handler->user_data_free_func;
+      user_data = handler->user_data;
+
+      if (handlers->dispatching > 0)
+        {
+          handler->func = NULL;
+          handlers->pending_removal = TRUE;
+        }
+      else
+        {
+          g_array_remove_index (handlers->handlers, i);
+        }
+
+      if (free_func != NULL)
+        free_func (user_data);
+
+      return;
+    }
+}
+
 gboolean
 evd_transport_peer_is_connected (EvdTransport *self,
                                  EvdPeer       *peer)
@@ -39,6 +39,13 @@ G_BEGIN_DECLS
 typedef struct _EvdTransport               EvdTransport;
 typedef struct _EvdTransportInterface      EvdTransportInterface;
 
+typedef void (* EvdTransportReceiveFunc) (EvdTransport   *transport,
+                                          EvdPeer        *peer,
+                                          const gchar    *buffer,
+                                          gsize           size,
+                                          EvdMessageType  type,
+                                          gpointer        user_data);
+
 struct _EvdTransportInterface
 {
   GTypeInterface parent_iface;
@@ -52,10 +59,11 @@ struct _EvdTransportInterface
                                       GError         **error);
   void      (* notify_receive)       (EvdTransport *self,
                                       EvdPeer      *peer);
-  void      (* receive)              (EvdTransport *self,
-                                      EvdPeer      *peer,
-                                      const gchar  *buffer,
-                                      gsize         size);
+  void      (* receive)              (EvdTransport   *self,
+                                      EvdPeer        *peer,
+                                      const gchar    *buffer,
+                                      gsize           size,
+                                      EvdMessageType  type);
 
   void      (* notify_new_peer)      (EvdTransport *self, EvdPeer *peer);
   EvdPeer * (* create_new_peer)      (EvdTransport *self);
@@ -126,12 +134,24 @@ gboolean        evd_transport_send_text                     (EvdTransport  *self
                                                              EvdPeer       *peer,
                                                              const gchar   *text,
                                                              GError       **error);
+gboolean        evd_transport_send_shared                   (EvdTransport    *self,
+                                                             EvdPeer         *peer,
+                                                             GByteArray      *message,
+                                                             EvdMessageType   type,
+                                                             GError         **error);
 const gchar    *evd_transport_receive                       (EvdTransport *self,
                                                              EvdPeer      *peer,
                                                              gsize        *size);
 const gchar    *evd_transport_receive_text                  (EvdTransport *self,
                                                              EvdPeer      *peer);
 
+guint           evd_transport_add_receive_handler           (EvdTransport            *self,
+                                                             EvdTransportReceiveFunc  func,
+                                                             gpointer                 user_data,
+                                                             GDestroyNotify           user_data_free_func);
+void            evd_transport_remove_receive_handler        (EvdTransport *self,
+                                                             guint         handler_id);
+
 gboolean        evd_transport_peer_is_connected             (EvdTransport *self,
                                                              EvdPeer       *peer);
 
@@ -164,6 +184,9 @@ gboolean        evd_transport_open_finish                   (EvdTransport  *self
 
 /* defines here get_transport() method of EvdPeer to avoid cyclic dependency */
 EvdTransport *  evd_peer_get_transport                      (EvdPeer *self);
+void            evd_peer_count_message                      (EvdPeer  *self,
+                                                             gsize     size,
+                                                             gboolean  received);
 
 G_END_DECLS
 
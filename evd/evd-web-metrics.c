@@ -0,0 +1,113 @@
+/*
+ * evd-web-metrics.c
+ *
+ * EventDance, Peer-to-peer IPC library <http://eventdance.org>
+ *
+ * Copyright (C) 2026, the EventDance contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 3, or (at your option) any later version as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License at http://www.gnu.org/licenses/lgpl-3.0.txt
+ * for more details.
+ */
+
+#include <string.h>
+#include <libsoup/soup.h>
+
+#include "evd-web-metrics.h"
+
+#include "evd-metrics.h"
+
+G_DEFINE_TYPE (EvdWebMetrics, evd_web_metrics, EVD_TYPE_WEB_SERVICE)
+
+#define CONTENT_TYPE "text/plain; version=0.0.4; charset=utf-8"
+
+static void     evd_web_metrics_class_init           (EvdWebMetricsClass *class);
+static void     evd_web_metrics_init                 (EvdWebMetrics *self);
+
+static void     evd_web_metrics_request_handler      (EvdWebService     *self,
+                                                      EvdHttpConnection *conn,
+                                                      EvdHttpRequest    *request);
+
+static void
+evd_web_metrics_class_init (EvdWebMetricsClass *class)
+{
+  EvdWebServiceClass *web_service_class = EVD_WEB_SERVICE_CLASS (class);
+
+  web_service_class->request_handler = evd_web_metrics_request_handler;
+}
+
+static void
+evd_web_metrics_init (EvdWebMetrics *self)
+{
+}
+
+static void
+evd_web_metrics_request_handler (EvdWebService     *web_service,
+                                 EvdHttpConnection *conn,
+                                 EvdHttpRequest    *request)
+{
+  const gchar *method;
+  SoupMessageHeaders *headers;
+  gchar *content = NULL;
+  gsize size = 0;
+  guint status_code = SOUP_STATUS_OK;
+
+  headers = soup_message_headers_new (SOUP_MESSAGE_HEADERS_RESPONSE);
+
+  method = evd_http_request_get_method (request);
+  if (g_strcmp0 (method, SOUP_METHOD_GET) == 0)
+    {
+      content = evd_metrics_render ();
+      size = strlen (content);
+
+      soup_message_headers_replace (headers, "Content-Type", CONTENT_TYPE);
+      soup_message_headers_replace (headers, "Cache-Control", "no-cache");
+    }
+  else
+    {
+      status_code = SOUP_STATUS_METHOD_NOT_ALLOWED;
+      soup_message_headers_replace (headers, "Allow", SOUP_METHOD_GET);
+    }
+
+  evd_web_service_respond (web_service,
+                           conn,
+                           status_code,
+                           headers,
+                           content,
+                           size,
+                           NULL);
+
+  EVD_WEB_SERVICE_LOG (web_service,
+                       conn,
+                       request,
+                       status_code,
+                       size,
+                       NULL);
+
+  soup_message_headers_free (headers);
+  g_free (content);
+}
+
+/* public methods */
+
+/**
+ * evd_web_metrics_new:
+ *
+ * Creates a web service that exposes the process metrics registry, in the
+ * Prometheus text format, to GET requests. It is typically mounted on a
+ * #EvdWebSelector under a path like "/metrics".
+ *
+ * Returns: (transfer full):
+ **/
+EvdWebMetrics *
+evd_web_metrics_new (void)
+{
+  return g_object_new (EVD_TYPE_WEB_METRICS, NULL);
+}
@@ -0,0 +1,58 @@
+/*
+ * evd-web-metrics.h
+ *
+ * EventDance, Peer-to-peer IPC library <http://eventdance.org>
+ *
+ * Copyright (C) 2026, the EventDance contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 3, or (at your option) any later version as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License at http://www.gnu.org/licenses/lgpl-3.0.txt
+ * for more details.
+ */
+
+#ifndef __EVD_WEB_METRICS_H__
+#define __EVD_WEB_METRICS_H__
+
+#if !defined (__EVD_H_INSIDE__) && !defined (EVD_COMPILATION)
+#error "Only <evd.h> can be included directly."
+#endif
+
+#include "evd-web-service.h"
+
+G_BEGIN_DECLS
+
+typedef struct _EvdWebMetrics EvdWebMetrics;
+typedef struct _EvdWebMetricsClass EvdWebMetricsClass;
+
+struct _EvdWebMetrics
+{
+  EvdWebService parent;
+};
+
+struct _EvdWebMetricsClass
+{
+  EvdWebServiceClass parent_class;
+};
+
+#define EVD_TYPE_WEB_METRICS           (evd_web_metrics_get_type ())
+#define EVD_WEB_METRICS(obj)           (G_TYPE_CHECK_INSTANCE_CAST ((obj), EVD_TYPE_WEB_METRICS, EvdWebMetrics))
+#define EVD_WEB_METRICS_CLASS(obj)     (G_TYPE_CHECK_CLASS_CAST ((obj), EVD_TYPE_WEB_METRICS, EvdWebMetricsClass))
+#define EVD_IS_WEB_METRICS(obj)        (G_TYPE_CHECK_INSTANCE_TYPE ((obj), EVD_TYPE_WEB_METRICS))
+#define EVD_IS_WEB_METRICS_CLASS(obj)  (G_TYPE_CHECK_CLASS_TYPE ((obj), EVD_TYPE_WEB_METRICS))
+#define EVD_WEB_METRICS_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS ((obj), EVD_TYPE_WEB_METRICS, EvdWebMetricsClass))
+
+
+GType               evd_web_metrics_get_type          (void) G_GNUC_CONST;
+
+EvdWebMetrics      *evd_web_metrics_new               (void);
+
+G_END_DECLS
+
+#endif /* __EVD_WEB_METRICS_H__ */
@@ -28,6 +28,7 @@
 
 #include "evd-utils.h"
 #include "evd-error.h"
+#include "evd-metrics.h"
 #include "evd-http-connection.h"
 #include "evd-peer-manager.h"
 #include "evd-web-dir.h"
@@ -44,10 +45,13 @@
 #define MECHANISM_HEADER_NAME "X-Org-EventDance-WebTransport-Mechanism"
 #define PEER_ID_HEADER_NAME   "X-Org-EventDance-WebTransport-Peer-Id"
 #define URL_HEADER_NAME       "X-Org-EventDance-WebTransport-Url"
+#define ACK_HEADER_NAME       "X-Org-EventDance-WebTransport-Ack"
+#define TOKEN_HEADER_NAME     "X-Org-EventDance-WebTransport-Resume-Token"
 
 #define HANDSHAKE_TOKEN_NAME    "handshake"
 #define LONG_POLLING_TOKEN_NAME "lp"
 #define WEB_SOCKET_TOKEN_NAME   "ws"
+#define ACK_TOKEN_NAME          "ack"
 
 #define LONG_POLLING_MECHANISM_NAME "long-polling"
 #define WEB_SOCKET_MECHANISM_NAME   "websocket"
@@ -55,6 +59,9 @@
 #define HANDSHAKE_DATA_KEY "org.eventdance.lib.WebTransport.HANDSHAKE_DATA"
 
 #define PEER_DATA_KEY "org.eventdance.lib.WebTransportServer.PEER_DATA"
+#define RESUME_DATA_KEY "org.eventdance.lib.WebTransportServer.RESUME_DATA"
+
+#define DEFAULT_RESUME_WINDOW 0 /* disabled */
 
 /* handshake data */
 typedef struct
@@ -64,8 +71,27 @@ typedef struct
   EvdHttpRequest *request;
   JsonNode *request_data;
   JsonNode *response_data;
+  gboolean resumed;
+  guint64 last_seq;
 } HandshakeData;
 
+/* messages sent to a peer and not yet acknowledged by it, numbered from 1 */
+typedef struct
+{
+  gchar *token;
+  guint64 next_seq;
+  guint64 acked_seq;
+  GQueue *window;
+} ResumeData;
+
+typedef struct
+{
+  guint64 seq;
+  gchar *message;
+  gsize size;
+  EvdMessageType type;
+} ResumeFrame;
+
 /* private data */
 struct _EvdWebTransportServerPrivate
 {
@@ -78,6 +104,9 @@ struct _EvdWebTransportServerPrivate
   EvdWebsocketServer *ws;
   gchar *ws_base_path;
 
+  gchar *ack_base_path;
+  guint resume_window;
+
   gboolean enable_ws;
 
   HandshakeData *current_handshake_data;
@@ -142,6 +171,9 @@ G_DEFINE_TYPE_WITH_CODE (EvdWebTransportServer, evd_web_transport_server, EVD_TY
                          G_IMPLEMENT_INTERFACE (EVD_TYPE_TRANSPORT,
                                                 evd_web_transport_server_transport_iface_init));
 
+static EvdMetric *metric_resumed = NULL;
+static EvdMetric *metric_replayed = NULL;
+
 static void
 evd_web_transport_server_class_init (EvdWebTransportServerClass *class)
 {
@@ -212,6 +244,8 @@ evd_web_transport_server_init (EvdWebTransportServer *self)
 
   priv->enable_ws = TRUE;
 
+  priv->resume_window = DEFAULT_RESUME_WINDOW;
+
   priv->current_handshake_data = NULL;
 
   priv->external_url = NULL;
@@ -234,6 +268,8 @@ evd_web_transport_server_finalize (GObject *obj)
   g_free (self->priv->ws_base_path);
   g_object_unref (self->priv->ws);
 
+  g_free (self->priv->ack_base_path);
+
   g_free (self->priv->hs_base_path);
   g_free (self->priv->base_path);
 
@@ -294,6 +330,155 @@ evd_web_transport_server_get_property (GObject    *obj,
     }
 }
 
+static void
+free_resume_frame (gpointer data, gpointer user_data)
+{
+  ResumeFrame *frame = data;
+
+  g_free (frame->message);
+  g_slice_free (ResumeFrame, frame);
+}
+
+static void
+free_resume_data (gpointer _data)
+{
+  ResumeData *data = _data;
+
+  g_queue_foreach (data->window, free_resume_frame, NULL);
+  g_queue_free (data->window);
+
+  g_free (data->token);
+
+  g_slice_free (ResumeData, data);
+}
+
+static ResumeData *
+get_resume_data (EvdPeer *peer)
+{
+  ResumeData *data;
+
+  data = g_object_get_data (G_OBJECT (peer), RESUME_DATA_KEY);
+  if (data == NULL)
+    {
+      data = g_slice_new0 (ResumeData);
+      data->token = evd_uuid_new ();
+      data->next_seq = 1;
+      data->window = g_queue_new ();
+
+      g_object_set_data_full (G_OBJECT (peer),
+                              RESUME_DATA_KEY,
+                              data,
+                              free_resume_data);
+    }
+
+  return data;
+}
+
+/* forgets everything the peer has confirmed up to @seq */
+static void
+resume_data_ack (ResumeData *data, guint64 seq)
+{
+  ResumeFrame *frame;
+
+  if (seq <= data->acked_seq || seq >= data->next_seq)
+    return;
+
+  while ((frame = g_queue_peek_head (data->window)) != NULL &&
+         frame->seq <= seq)
+    {
+      g_queue_pop_head (data->window);
+      free_resume_frame (frame, NULL);
+    }
+
+  data->acked_seq = seq;
+}
+
+static void
+resume_data_append (ResumeData     *data,
+                    const gchar    *buffer,
+                    gsize           size,
+                    EvdMessageType  type,
+                    guint           max_length)
+{
+  ResumeFrame *frame;
+
+  frame = g_slice_new (ResumeFrame);
+  frame->seq = data->next_seq++;
+  frame->message = g_malloc (size + 1);
+  memcpy (frame->message, buffer, size);
+  frame->message[size] = '\0';
+  frame->size = size;
+  frame->type = type;
+
+  g_queue_push_tail (data->window, frame);
+
+  /* the oldest messages are lost for good, so a peer that has not
+     seen them yet can no longer resume */
+  while (g_queue_get_length (data->window) > max_length)
+    {
+      frame = g_queue_pop_head (data->window);
+      data->acked_seq = frame->seq;
+      free_resume_frame (frame, NULL);
+    }
+}
+
+/* Replaces the peer's backlog with the messages after @last_seq. The backlog
+   only ever holds the tail of the window, so nothing is delivered twice. */
+static gboolean
+resume_peer (EvdWebTransportServer *self,
+             EvdPeer               *peer,
+             guint64                last_seq)
+{
+  ResumeData *data;
+  ResumeFrame *frame;
+  gchar *message;
+  GList *node;
+  guint replayed = 0;
+
+  data = g_object_get_data (G_OBJECT (peer), RESUME_DATA_KEY);
+  if (data == NULL ||
+      last_seq < data->acked_seq ||
+      last_seq >= data->next_seq)
+    return FALSE;
+
+  resume_data_ack (data, last_seq);
+
+  /* whatever mechanism the peer was using is considered gone */
+  g_object_set_data (G_OBJECT (peer), PEER_DATA_KEY, NULL);
+
+  while ((message = evd_peer_pop_message (peer, NULL, NULL)) != NULL)
+    g_free (message);
+
+  for (node = data->window->head; node != NULL; node = node->next)
+    {
+      frame = node->data;
+
+      if (! evd_peer_push_message (peer,
+                                   frame->message,
+                                   frame->size,
+                                   frame->type,
+                                   NULL))
+        break;
+
+      replayed++;
+    }
+
+  evd_peer_touch (peer);
+
+  evd_metric_add (EVD_METRIC (metric_resumed,
+                              "evd_web_transport_resumed_peers_total",
+                              EVD_METRIC_COUNTER,
+                              "Web transport peers that resumed a session"),
+                  1);
+  evd_metric_add (EVD_METRIC (metric_replayed,
+                              "evd_web_transport_replayed_messages_total",
+                              EVD_METRIC_COUNTER,
+                              "Unacknowledged messages replayed to resumed peers"),
+                  replayed);
+
+  return TRUE;
+}
+
 static gboolean
 evd_web_transport_server_send (EvdTransport    *transport,
                                EvdPeer         *peer,
@@ -302,8 +487,18 @@ evd_web_transport_server_send (EvdTransport    *transport,
                                EvdMessageType   type,
                                GError         **error)
 {
+  EvdWebTransportServer *self = EVD_WEB_TRANSPORT_SERVER (transport);
   EvdTransport *_transport;
 
+  /* every message is numbered here exactly once, whether it is delivered
+     now or queued in the backlog by the caller */
+  if (self->priv->resume_window > 0)
+    resume_data_append (get_resume_data (peer),
+                        buffer,
+                        size,
+                        type,
+                        self->priv->resume_window);
+
   _transport = g_object_get_data (G_OBJECT (peer), PEER_DATA_KEY);
   if (_transport == NULL)
     {
@@ -337,7 +532,7 @@ evd_web_transport_server_peer_is_connected (EvdTransport *transport,
     evd_transport_peer_is_connected (_transport, peer);
 }
 
-static void
+static JsonObject *
 add_mechanism_to_response_list (JsonArray   *mech_list,
                                 const gchar *mechanism_name,
                                 const gchar *mechanism_url)
@@ -350,6 +545,8 @@ add_mechanism_to_response_list (JsonArray   *mech_list,
   json_object_set_string_member (obj, "url", mechanism_url);
 
   json_array_add_object_element (mech_list, obj);
+
+  return obj;
 }
 
 static gboolean
@@ -418,6 +615,15 @@ evd_web_transport_server_respond_handshake (HandshakeData *data,
                                  "peer-id",
                                  evd_peer_get_id (peer));
 
+  /* the peer presents the token back in a later handshake to resume */
+  if (self->priv->resume_window > 0)
+    {
+      json_object_set_string_member (response_obj,
+                                     "resume-token",
+                                     get_resume_data (peer)->token);
+      json_object_set_boolean_member (response_obj, "resumed", data->resumed);
+    }
+
   /* set the list of mechanisms in response data */
   response_mechs = json_array_new ();
   json_object_set_array_member (response_obj, "mechanisms", response_mechs);
@@ -481,6 +687,7 @@ evd_web_transport_server_respond_handshake (HandshakeData *data,
   if (has_mechanism (request_mechs, LONG_POLLING_MECHANISM_NAME))
     {
       SoupURI *lp_uri;
+      JsonObject *mech_obj;
 
       if (self->priv->external_url != NULL)
         lp_uri = soup_uri_new (self->priv->external_url);
@@ -491,10 +698,16 @@ evd_web_transport_server_respond_handshake (HandshakeData *data,
       mechanism_url = soup_uri_to_string (lp_uri, FALSE);
       soup_uri_free (lp_uri);
 
-      add_mechanism_to_response_list (response_mechs,
-                                      LONG_POLLING_MECHANISM_NAME,
-                                      mechanism_url);
+      mech_obj = add_mechanism_to_response_list (response_mechs,
+                                                 LONG_POLLING_MECHANISM_NAME,
+                                                 mechanism_url);
       g_free (mechanism_url);
+
+      /* peers that can handle binary framing get the message type of each
+         frame, and binary payloads travel unencoded */
+      if (json_object_has_member (request_obj, "binary") &&
+          json_object_get_boolean_member (request_obj, "binary"))
+        json_object_set_boolean_member (mech_obj, "binary", TRUE);
     }
 
   /* generate JSON data for the response */
@@ -547,6 +760,70 @@ evd_web_transport_server_conn_on_close (EvdConnection *conn, gpointer user_data)
   g_object_unref (peer);
 }
 
+static EvdPeer *
+lookup_resumable_peer (EvdWebTransportServer *self,
+                       JsonObject            *request_obj,
+                       guint64               *last_seq)
+{
+  const gchar *peer_id;
+  const gchar *token;
+  EvdPeer *peer;
+  ResumeData *resume_data;
+
+  if (self->priv->resume_window == 0 ||
+      ! json_object_has_member (request_obj, "peer-id") ||
+      ! json_object_has_member (request_obj, "resume-token") ||
+      ! json_object_has_member (request_obj, "last-seq"))
+    return NULL;
+
+  peer_id = json_object_get_string_member (request_obj, "peer-id");
+  token = json_object_get_string_member (request_obj, "resume-token");
+  if (peer_id == NULL || token == NULL)
+    return NULL;
+
+  peer = evd_transport_lookup_peer (EVD_TRANSPORT (self), peer_id);
+  if (peer == NULL ||
+      evd_peer_is_closed (peer) ||
+      g_object_get_data (G_OBJECT (peer), HANDSHAKE_DATA_KEY) != NULL)
+    return NULL;
+
+  resume_data = g_object_get_data (G_OBJECT (peer), RESUME_DATA_KEY);
+  if (resume_data == NULL || g_strcmp0 (resume_data->token, token) != 0)
+    return NULL;
+
+  *last_seq = json_object_get_int_member (request_obj, "last-seq");
+  if (*last_seq < resume_data->acked_seq ||
+      *last_seq >= resume_data->next_seq)
+    return NULL;
+
+  return peer;
+}
+
+/* Responds to an accepted handshake. A resumed peer only gets its backlog
+   replaced now, since validation may have been pending for a while; if the
+   window moved past it meanwhile the session is lost and the peer closed. */
+static void
+evd_web_transport_server_finish_handshake (HandshakeData *data,
+                                           EvdPeer       *peer)
+{
+  if (data->resumed && ! resume_peer (data->self, peer, data->last_seq))
+    {
+      EVD_WEB_SERVICE_GET_CLASS (data->self)->
+        respond (EVD_WEB_SERVICE (data->self),
+                 data->conn,
+                 SOUP_STATUS_GONE,
+                 NULL,
+                 NULL,
+                 0,
+                 NULL);
+
+      evd_transport_close_peer (EVD_TRANSPORT (data->self), peer, FALSE, NULL);
+      return;
+    }
+
+  evd_web_transport_server_respond_handshake (data, peer);
+}
+
 static void
 evd_web_transport_handshake (HandshakeData *data)
 {
@@ -581,8 +858,19 @@ evd_web_transport_handshake (HandshakeData *data)
       return;
     }
 
-  /* create peer */
-  peer = g_object_new (EVD_TYPE_PEER, "transport", self, NULL);
+  /* resume a previous session if the peer can still be served from where
+     it left off, otherwise it gets a new peer and has to start over. Either
+     way the application gets to validate it. */
+  peer = lookup_resumable_peer (self, request_obj, &data->last_seq);
+  if (peer != NULL)
+    {
+      data->resumed = TRUE;
+      g_object_ref (peer);
+    }
+  else
+    {
+      peer = g_object_new (EVD_TYPE_PEER, "transport", self, NULL);
+    }
 
   /* setup peer arguments for validation */
   self->priv->current_handshake_data = data;
@@ -600,7 +888,7 @@ evd_web_transport_handshake (HandshakeData *data)
       /* accept peer */
       evd_web_transport_server_accept_peer (EVD_TRANSPORT (self), peer);
 
-      evd_web_transport_server_respond_handshake (data, peer);
+      evd_web_transport_server_finish_handshake (data, peer);
 
       free_handshake_data (data);
     }
@@ -616,6 +904,10 @@ evd_web_transport_handshake (HandshakeData *data)
                  0,
                  NULL);
 
+      /* a rejected session is not kept around to be resumed later */
+      if (data->resumed)
+        evd_transport_close_peer (EVD_TRANSPORT (self), peer, FALSE, NULL);
+
       free_handshake_data (data);
     }
   else
@@ -737,6 +1029,59 @@ evd_web_transport_server_read_handshake_data (EvdWebTransportServer *self,
                                         data);
 }
 
+static void
+evd_web_transport_server_on_ack (EvdWebTransportServer *self,
+                                 EvdHttpConnection     *conn,
+                                 EvdHttpRequest        *request)
+{
+  SoupURI *uri;
+  SoupMessageHeaders *headers;
+  EvdPeer *peer = NULL;
+  ResumeData *data = NULL;
+  const gchar *seq_str;
+  const gchar *token;
+  guint status = SOUP_STATUS_OK;
+
+  uri = evd_http_request_get_uri (request);
+  if (uri->query != NULL)
+    peer = evd_transport_lookup_peer (EVD_TRANSPORT (self), uri->query);
+
+  headers = evd_http_message_get_headers (EVD_HTTP_MESSAGE (request));
+  seq_str = soup_message_headers_get_one (headers, ACK_HEADER_NAME);
+  token = soup_message_headers_get_one (headers, TOKEN_HEADER_NAME);
+
+  if (peer != NULL)
+    data = g_object_get_data (G_OBJECT (peer), RESUME_DATA_KEY);
+
+  if (peer == NULL)
+    {
+      status = SOUP_STATUS_NOT_FOUND;
+    }
+  else if (seq_str == NULL || token == NULL)
+    {
+      status = SOUP_STATUS_BAD_REQUEST;
+    }
+  else if (data == NULL || g_strcmp0 (data->token, token) != 0)
+    {
+      /* knowing the peer id is not enough to drop its messages */
+      status = SOUP_STATUS_FORBIDDEN;
+    }
+  else
+    {
+      evd_peer_touch (peer);
+
+      resume_data_ack (data, g_ascii_strtoull (seq_str, NULL, 10));
+    }
+
+  EVD_WEB_SERVICE_GET_CLASS (self)->respond (EVD_WEB_SERVICE (self),
+                                             conn,
+                                             status,
+                                             NULL,
+                                             NULL,
+                                             0,
+                                             NULL);
+}
+
 static EvdWebService *
 get_actual_transport_from_path (EvdWebTransportServer *self,
                                 const gchar           *path)
@@ -766,6 +1111,11 @@ evd_web_transport_server_on_request (EvdWebService     *web_service,
     {
       evd_web_transport_server_read_handshake_data (self, conn, request);
     }
+  /* acknowledgement of received messages? */
+  else if (g_strcmp0 (uri->path, self->priv->ack_base_path) == 0)
+    {
+      evd_web_transport_server_on_ack (self, conn, request);
+    }
   /* longpolling or websocket? */
   else if ((actual_service =
             get_actual_transport_from_path (self, uri->path)) != NULL)
@@ -825,6 +1175,9 @@ evd_web_transport_server_set_base_path (EvdWebTransportServer *self,
   self->priv->ws_base_path = g_strdup_printf ("%s%s",
                                               self->priv->base_path,
                                               WEB_SOCKET_TOKEN_NAME);
+  self->priv->ack_base_path = g_strdup_printf ("%s%s",
+                                               self->priv->base_path,
+                                               ACK_TOKEN_NAME);
 
   evd_web_dir_set_alias (EVD_WEB_DIR (self), base_path);
 }
@@ -854,7 +1207,7 @@ evd_web_transport_server_accept_peer (EvdTransport *transport, EvdPeer *peer)
                                         evd_web_transport_server_conn_on_close,
                                         peer);
 
-  evd_web_transport_server_respond_handshake (data, peer);
+  evd_web_transport_server_finish_handshake (data, peer);
 
   g_object_set_data (G_OBJECT (peer), HANDSHAKE_DATA_KEY, NULL);
   g_object_unref (peer);
@@ -866,6 +1219,7 @@ static gboolean
 evd_web_transport_server_reject_peer (EvdTransport *transport, EvdPeer *peer)
 {
   HandshakeData *data;
+  gboolean resumed;
 
   data = g_object_get_data (G_OBJECT (peer), HANDSHAKE_DATA_KEY);
   if (data == NULL)
@@ -883,7 +1237,12 @@ evd_web_transport_server_reject_peer (EvdTransport *transport, EvdPeer *peer)
                                                   0,
                                                   NULL);
 
+  resumed = data->resumed;
   g_object_set_data (G_OBJECT (peer), HANDSHAKE_DATA_KEY, NULL);
+
+  if (resumed)
+    evd_transport_close_peer (transport, peer, FALSE, NULL);
+
   g_object_unref (peer);
 
   return TRUE;
@@ -1017,3 +1376,43 @@ evd_web_transport_server_set_external_base_url (EvdWebTransportServer *self,
   if (base_url != NULL)
     self->priv->external_url = g_strdup (base_url);
 }
+
+/**
+ * evd_web_transport_server_set_resume_window:
+ * @max_messages: how many unacknowledged messages to keep per peer, or 0
+ *
+ * Sets how many sent messages each peer keeps until the remote end
+ * acknowledges them. A peer that drops its connection can present the
+ * resume token it got in the handshake and have the messages it missed
+ * replayed, over whichever mechanism it negotiates this time. The resumed
+ * handshake goes through #EvdTransport::validate-peer like any other, and
+ * a rejected peer is closed.
+ *
+ * Every message sent to a peer is copied into its window, so resuming is
+ * off (0) by default and has to be enabled here.
+ *
+ * Since: 0.2.0
+ **/
+void
+evd_web_transport_server_set_resume_window (EvdWebTransportServer *self,
+                                            guint                  max_messages)
+{
+  g_return_if_fail (EVD_IS_WEB_TRANSPORT_SERVER (self));
+
+  self->priv->resume_window = max_messages;
+}
+
+/**
+ * evd_web_transport_server_get_resume_window:
+ *
+ * Returns: the maximum number of unacknowledged messages kept per peer.
+ *
+ * Since: 0.2.0
+ **/
+guint
+evd_web_transport_server_get_resume_window (EvdWebTransportServer *self)
+{
+  g_return_val_if_fail (EVD_IS_WEB_TRANSPORT_SERVER (self), 0);
+
+  return self->priv->resume_window;
+}
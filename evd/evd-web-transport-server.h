@@ -88,6 +88,10 @@ void                    evd_web_transport_server_get_validate_peer_arguments (Ev
 void                    evd_web_transport_server_set_external_base_url       (EvdWebTransportServer *self,
                                                                               const gchar           *base_url);
 
+void                    evd_web_transport_server_set_resume_window           (EvdWebTransportServer *self,
+                                                                              guint                  max_messages);
+guint                   evd_web_transport_server_get_resume_window           (EvdWebTransportServer *self);
+
 G_END_DECLS
 
 #endif /* __EVD_WEB_TRANSPORT_SERVER_H__ */
@@ -240,7 +240,11 @@ on_frame_received (EvdHttpConnection *conn,
 
   iface = EVD_TRANSPORT_GET_INTERFACE (transport);
 
-  iface->receive (transport, conn_data->peer, frame, frame_len);
+  iface->receive (transport,
+                  conn_data->peer,
+                  frame,
+                  frame_len,
+                  is_binary ? EVD_MESSAGE_TYPE_BINARY : EVD_MESSAGE_TYPE_TEXT);
 }
 
 static void
@@ -148,7 +148,11 @@ on_frame_received (EvdHttpConnection *conn,
   if (peer == NULL || evd_peer_is_closed (peer))
     return;
 
-  iface->receive (transport, peer, frame, frame_len);
+  iface->receive (transport,
+                  peer,
+                  frame,
+                  frame_len,
+                  is_binary ? EVD_MESSAGE_TYPE_BINARY : EVD_MESSAGE_TYPE_TEXT);
 }
 
 static void
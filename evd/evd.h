@@ -61,6 +61,9 @@
 #include "evd-jsonrpc-http-client.h"
 #include "evd-jsonrpc-http-server.h"
 #include "evd-promise.h"
+#include "evd-metrics.h"
+#include "evd-web-metrics.h"
+#include "evd-peer-cluster.h"
 
 #undef __EVD_H_INSIDE__
 
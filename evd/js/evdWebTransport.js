@@ -67,6 +67,32 @@ if (! Evd["Object"] || typeof (Evd["Object"]) != "object") {
     };
 }
 
+// Evd.Utf8
+Evd.Utf8 = {
+    encode: function (str) {
+        if (window["TextEncoder"])
+            return new TextEncoder ().encode (str);
+
+        var bin = unescape (encodeURIComponent (str));
+        var bytes = new Uint8Array (bin.length);
+        for (var i=0; i<bin.length; i++)
+            bytes[i] = bin.charCodeAt (i);
+
+        return bytes;
+    },
+
+    decode: function (bytes) {
+        if (window["TextDecoder"])
+            return new TextDecoder ("utf-8").decode (bytes);
+
+        var bin = "";
+        for (var i=0; i<bytes.length; i++)
+            bin += String.fromCharCode (bytes[i]);
+
+        return decodeURIComponent (escape (bin));
+    }
+};
+
 // Evd.Peer
 Evd.Peer = new Evd.Constructor ();
 Evd.Peer.prototype = new Evd.Object (Evd.Peer);
@@ -116,12 +142,28 @@ Evd.Object.extend (Evd.Peer.prototype, {
 Evd.LongPolling = new Evd.Constructor ();
 Evd.LongPolling.prototype = new Evd.Object (Evd.LongPolling);
 
+Evd.Object.extend (Evd.LongPolling, {
+    BINARY_CONTENT_TYPE: "application/octet-stream",
+
+    // in binary framing, the first header byte holds the message type in
+    // its high bit and the length, or how it is encoded, in the rest
+    BINARY_TYPE_BIT: 0x80,
+    BINARY_LEN_16: 126,
+    BINARY_LEN_64: 127,
+
+    supportsBinary: function () {
+        return window["ArrayBuffer"] && window["Uint8Array"] &&
+            ("responseType" in new XMLHttpRequest ());
+    }
+});
+
 Evd.Object.extend (Evd.LongPolling.prototype, {
     PEER_DATA_KEY: "org.eventdance.lib.LongPolling",
 
     _init: function (args) {
         this._peerId = args.peerId;
         this._onError = args.onError;
+        this._binary = args.binary ? true : false;
 
         this._nrReceivers = 1;
         this._nrSenders = 1;
@@ -170,7 +212,47 @@ Evd.Object.extend (Evd.LongPolling.prototype, {
         return [hdr_len, msg_len];
     },
 
+    _readBinaryMsgs: function (data) {
+        var bytes = new Uint8Array (data);
+        var frames = [];
+        var i = 0;
+
+        while (i < bytes.length) {
+            var hdr = bytes[i];
+            var binary = (hdr & Evd.LongPolling.BINARY_TYPE_BIT) != 0;
+            var msg_len = hdr & ~Evd.LongPolling.BINARY_TYPE_BIT;
+            var hdr_len = 1;
+
+            if (msg_len == Evd.LongPolling.BINARY_LEN_16)
+                hdr_len = 3;
+            else if (msg_len == Evd.LongPolling.BINARY_LEN_64)
+                hdr_len = 9;
+
+            if (hdr_len > 1) {
+                msg_len = 0;
+                for (var j=1; j<hdr_len; j++)
+                    msg_len = msg_len * 256 + bytes[i + j];
+            }
+
+            i += hdr_len;
+
+            if (binary)
+                frames.push (data.slice (i, i + msg_len));
+            else
+                frames.push (Evd.Utf8.decode (bytes.subarray (i, i + msg_len)));
+
+            i += msg_len;
+        }
+
+        return frames;
+    },
+
     _xhrOnLoad: function (data) {
+        if (this._binary) {
+            this._fireEvent ("receive", [this._readBinaryMsgs (data), null]);
+            return;
+        }
+
         var hdr_len, msg_len, msg, t;
         var frames = [];
         while (data != "") {
@@ -231,7 +313,13 @@ Evd.Object.extend (Evd.LongPolling.prototype, {
                     self._fireEvent ("receive", [null, error]);
             }
             else {
-                var data = xhr.responseText.toString ();
+                var data;
+
+                if (self._binary)
+                    data = xhr.response && xhr.response.byteLength > 0 ?
+                        xhr.response : null;
+                else
+                    data = xhr.responseText.toString ();
 
                 if (this._sender)
                     self._fireEvent ("send", [true, null]);
@@ -257,8 +345,17 @@ Evd.Object.extend (Evd.LongPolling.prototype, {
             this._senders.push (xhr);
     },
 
+    _openXhr: function (xhr, method, action) {
+        xhr.open (method, this._addr + "/" + action + "?" + this._peerId, true);
+
+        if (this._binary) {
+            xhr.responseType = "arraybuffer";
+            xhr.setRequestHeader ("Accept", Evd.LongPolling.BINARY_CONTENT_TYPE);
+        }
+    },
+
     _connectXhr: function (xhr) {
-        xhr.open ("GET", this._addr + "/receive?" + this._peerId, true);
+        this._openXhr (xhr, "GET", "receive");
 
         this._activeXhrs.push (xhr);
 
@@ -301,17 +398,65 @@ Evd.Object.extend (Evd.LongPolling.prototype, {
         return hdr_st + msg;
     },
 
+    _buildBinaryMsgs: function (msgs) {
+        var payloads = [];
+        var size = 0;
+        var i, j;
+
+        for (i=0; i<msgs.length; i++) {
+            var binary = typeof (msgs[i]) != "string";
+            var payload = binary ?
+                new Uint8Array (msgs[i]) : Evd.Utf8.encode (msgs[i]);
+            var len = payload.length;
+            var hdr;
+
+            if (len < Evd.LongPolling.BINARY_LEN_16) {
+                hdr = [len];
+            }
+            else if (len <= 0xFFFF) {
+                hdr = [Evd.LongPolling.BINARY_LEN_16, len >> 8, len & 0xFF];
+            }
+            else {
+                hdr = [Evd.LongPolling.BINARY_LEN_64];
+                for (j=7; j>=0; j--)
+                    hdr.push (j < 4 ? (len >>> (j * 8)) & 0xFF : 0);
+            }
+
+            if (binary)
+                hdr[0] |= Evd.LongPolling.BINARY_TYPE_BIT;
+
+            payloads.push (hdr, payload);
+            size += hdr.length + len;
+        }
+
+        var buf = new Uint8Array (size);
+        var offset = 0;
+        for (i=0; i<payloads.length; i++) {
+            buf.set (payloads[i], offset);
+            offset += payloads[i].length;
+        }
+
+        return buf.buffer;
+    },
+
     send: function (msgs) {
-        var buf = "";
-        var msg;
-        for (var i in msgs) {
-            msg = msgs[i];
-            buf += this._buildMsg (msg);
+        var buf;
+
+        if (this._binary) {
+            buf = this._buildBinaryMsgs (msgs);
+        }
+        else {
+            buf = "";
+            var msg;
+            for (var i in msgs) {
+                msg = msgs[i];
+                buf += this._buildMsg (msg);
+            }
         }
 
         var xhr = this._senders.shift ();
 
-        xhr.open ("POST", this._addr + "/send?" + this._peerId, true);
+        this._openXhr (xhr, "POST", "send");
 
         this._activeXhrs.push (xhr);
 
@@ -322,6 +467,10 @@ Evd.Object.extend (Evd.LongPolling.prototype, {
         return this._senders.length > 0;
     },
 
+    canSendBinary: function () {
+        return this._binary;
+    },
+
     open: function (address, callback) {
         this._addr = address;
         this._opened = true;
@@ -336,9 +485,10 @@ Evd.Object.extend (Evd.LongPolling.prototype, {
         var xhr;
 
         // cancel all active XHRs
-        for (xhr in this._activeXhrs)
-            xhr.abort ();
+        var xhrs = this._activeXhrs;
         this._activeXhrs = [];
+        for (var i=0; i<xhrs.length; i++)
+            xhrs[i].abort ();
 
         if (gracefully) {
             // send a 'close' command
@@ -359,6 +509,10 @@ Evd.Object.extend (Evd.LongPolling.prototype, {
 Evd.WebSocket = new Evd.Constructor ();
 Evd.WebSocket.prototype = new Evd.Object (Evd.WebSocket);
 
+Evd.Object.extend (Evd.WebSocket, {
+    CLOSE_DETACH: 4000
+});
+
 Evd.Object.extend (Evd.WebSocket.prototype, {
 
     _init: function (args) {
@@ -384,6 +538,7 @@ Evd.Object.extend (Evd.WebSocket.prototype, {
         }
 
         this._ws = new WebSocket (this._addr + "?" + this._peerId);
+        this._ws.binaryType = "arraybuffer";
         this._ws.onopen = function () {
             self._connected = true;
 
@@ -392,7 +547,10 @@ Evd.Object.extend (Evd.WebSocket.prototype, {
         };
 
         this._ws.onmessage = function (e) {
-            if (typeof (e.data) == "object") {
+            if (e.data instanceof ArrayBuffer) {
+                self._fireEvent ("receive", [[e.data], null]);
+            }
+            else if (typeof (e.data) == "object") {
                 var reader = new FileReader ();
                 reader.readAsArrayBuffer (e.data);
                 reader.onload = function () {
@@ -423,6 +581,10 @@ Evd.Object.extend (Evd.WebSocket.prototype, {
         return this._opened && this._ws != null && this._ws.readyState == 1;
     },
 
+    canSendBinary: function () {
+        return true;
+    },
+
     send: function (msgs) {
         for (var i in msgs)
             this._ws.send (msgs[i]);
@@ -440,8 +602,10 @@ Evd.Object.extend (Evd.WebSocket.prototype, {
         this._connected = false;
         this._peerId = null;
 
+        // the server only closes the peer on a normal closure, any other
+        // code just drops this connection and keeps the peer around
         if (this._ws)
-            this._ws.close ();
+            this._ws.close (gracefully ? 1000 : Evd.WebSocket.CLOSE_DETACH);
     }
 });
 
@@ -451,7 +615,11 @@ Evd.WebTransport.prototype = new Evd.Object (Evd.WebTransport);
 
 Evd.Object.extend (Evd.WebTransport, {
     DEFAULT_ADDR: "/transport/",
-    PEER_DATA_KEY: "org.eventdance.lib.WebTransport.data"
+    PEER_DATA_KEY: "org.eventdance.lib.WebTransport.data",
+    ACK_HEADER_NAME: "X-Org-EventDance-WebTransport-Ack",
+    TOKEN_HEADER_NAME: "X-Org-EventDance-WebTransport-Resume-Token",
+    ACK_BATCH: 32,
+    ACK_DELAY: 1000
 });
 
 Evd.Object.extend (Evd.WebTransport.prototype, {
@@ -478,6 +646,13 @@ Evd.Object.extend (Evd.WebTransport.prototype, {
             this._availableMechs.unshift ("websocket");
         this._negotiatedMechs = null;
         this._currentMechIndex = 0;
+
+        // messages received from the server, and how many of them it
+        // knows about; used to resume the session after a disconnection
+        this._resumeToken = null;
+        this._recvSeq = 0;
+        this._ackedSeq = 0;
+        this._ackTimer = null;
     },
 
     _onDisconnect: function (fatal) {
@@ -488,7 +663,11 @@ Evd.Object.extend (Evd.WebTransport.prototype, {
             else {
                 this._retryCount = 0;
                 this._currentMechIndex++;
-                this._setupMechanism (this._peer.id, this._currentMechIndex);
+
+                if (this._resumeToken)
+                    this._handshake (true);
+                else
+                    this._setupMechanism (this._peer.id, this._currentMechIndex);
 
                 return;
             }
@@ -499,7 +678,10 @@ Evd.Object.extend (Evd.WebTransport.prototype, {
 
     _setupMechanism: function (peerId, mechIndex) {
         if (this._transport != null) {
+            // anything still arriving through the old mechanism would be
+            // missed, so make sure the server stops using it
             this._transport.removeAllEventListeners ();
+            this._transport.close (false);
             this._transport = null;
         }
 
@@ -521,7 +703,10 @@ Evd.Object.extend (Evd.WebTransport.prototype, {
 
         var self = this;
 
-        this._transport = new transportProto ({ peerId: peerId });
+        this._transport = new transportProto ({
+            peerId: peerId,
+            binary: this._negotiatedMechs[mechIndex].binary
+        });
 
         this._transport.addEventListener ("connect",
             function (result, error) {
@@ -543,13 +728,15 @@ Evd.Object.extend (Evd.WebTransport.prototype, {
         this._transport.open (mechUrl);
     },
 
-    _handshake: function () {
+    _handshake: function (resume) {
         if (this._handshaking == true)
             return;
 
         var self = this;
 
-        this._currentMechIndex = 0;
+        resume = resume && this._peer && this._resumeToken;
+        if (! resume)
+            this._currentMechIndex = 0;
 
         var xhr = new XMLHttpRequest ();
 
@@ -572,6 +759,24 @@ Evd.Object.extend (Evd.WebTransport.prototype, {
                 var peerId = self._handshakeData["peer-id"];
                 self._negotiatedMechs = self._handshakeData["mechanisms"];
 
+                if (self._handshakeData["resumed"] &&
+                    self._peer && self._peer.id == peerId) {
+                    // the server replays whatever we missed
+                    if (self._currentMechIndex >= self._negotiatedMechs.length)
+                        self._currentMechIndex = 0;
+
+                    self._setupMechanism (peerId, self._currentMechIndex);
+                    return;
+                }
+
+                if (self._peer)
+                    self._closePeer (self._peer, false);
+
+                self._currentMechIndex = 0;
+                self._resumeToken = self._handshakeData["resume-token"] || null;
+                self._recvSeq = 0;
+                self._ackedSeq = 0;
+
                 // create new peer
                 var peer = new Evd.Peer ({
                     id: peerId,
@@ -583,6 +788,11 @@ Evd.Object.extend (Evd.WebTransport.prototype, {
 
                 self._setupMechanism (peerId, self._currentMechIndex);
             }
+            else if (resume) {
+                setTimeout (function () {
+                                self._handshake (true);
+                            }, self._retryInterval);
+            }
             else {
                 // @TODO: Check why handshake failed and decide if retry
             }
@@ -590,9 +800,16 @@ Evd.Object.extend (Evd.WebTransport.prototype, {
 
         var hsData = {
             mechanisms: this._availableMechs,
-            url: this._addr
+            url: this._addr,
+            binary: Evd.LongPolling.supportsBinary () ? true : false
         };
 
+        if (resume) {
+            hsData["peer-id"] = this._peer.id;
+            hsData["resume-token"] = this._resumeToken;
+            hsData["last-seq"] = this._recvSeq;
+        }
+
         this._handshaking = true;
         xhr.open ("POST", this._addr + "handshake", true);
         xhr.send (JSON.stringify (hsData));
@@ -605,6 +822,16 @@ Evd.Object.extend (Evd.WebTransport.prototype, {
         this._retryCount = 0;
 
         this._connected = true;
+
+        // messages held while there was no mechanism can go out now
+        if (this._outBuf.length > 0 && ! this._flushing ())
+            this._flush ();
+
+        // a resumed or reconnected peer is not new to the application
+        if (this._peer[Evd.WebTransport.PEER_DATA_KEY].announced)
+            return;
+
+        this._peer[Evd.WebTransport.PEER_DATA_KEY].announced = true;
         this._fireEvent ("new-peer", [this._peer]);
     },
 
@@ -625,15 +852,53 @@ Evd.Object.extend (Evd.WebTransport.prototype, {
     },
 
     _flush: function () {
-        if (this._transport && this._transport.canSend ()) {
-            this._flushBuf = this._outBuf;
-            this._outBuf = [];
-            this._transport.send (this._flushBuf);
+        if (! this._transport || ! this._transport.canSend ())
+            return;
+
+        var count = this._outBuf.length;
+
+        // binary messages queued before a mechanism was set up wait for
+        // one that can carry them, and so does everything after them
+        if (! this._transport.canSendBinary ()) {
+            count = 0;
+            while (count < this._outBuf.length &&
+                   typeof (this._outBuf[count]) == "string")
+                count++;
+
+            if (count == 0 && this._outBuf.length > 0)
+                return;
         }
+
+        this._flushBuf = this._outBuf.splice (0, count);
+        this._transport.send (this._flushBuf);
     },
 
     send: function (peer, data, size) {
-        throw ("Sending raw data is not implemented. Use 'sendText()' instead");
+        if (peer != this._peer)
+            throw ("Send failed, invalid peer");
+
+        if (! data)
+            return;
+
+        // without a mechanism yet, the message is held until there is one
+        // that can send binary data, see _flush()
+        if (this._transport && ! this._transport.canSendBinary ())
+            throw ("Sending binary data is not supported by the current mechanism");
+
+        // typed arrays are sent as a copy of the bytes they view
+        if (data.buffer instanceof ArrayBuffer) {
+            if (size == undefined)
+                size = data.byteLength;
+            data = data.buffer.slice (data.byteOffset, data.byteOffset + size);
+        }
+        else if (size != undefined && size < data.byteLength) {
+            data = data.slice (0, size);
+        }
+
+        this._outBuf.push (data);
+
+        if (! this._dispatching && ! this._flushing ())
+            this._flush ();
     },
 
     sendText: function (peer, data) {
@@ -660,6 +925,8 @@ Evd.Object.extend (Evd.WebTransport.prototype, {
             for (var i in msgs) {
                 msg = msgs[i];
 
+                this._recvSeq++;
+
                 this._peer[Evd.WebTransport.PEER_DATA_KEY].msg = msg;
                 this._fireEvent ("receive", [this._peer]);
                 this._peer[Evd.WebTransport.PEER_DATA_KEY].msg = null;
@@ -667,6 +934,8 @@ Evd.Object.extend (Evd.WebTransport.prototype, {
 
             this._dispatching = false;
 
+            this._scheduleAck ();
+
             if (! this._flushing ()) {
                 this._retryCount = 0;
                 this._flush ();
@@ -678,10 +947,61 @@ Evd.Object.extend (Evd.WebTransport.prototype, {
         }
     },
 
+    receive: function (peer) {
+        return peer[Evd.WebTransport.PEER_DATA_KEY].msg;
+    },
+
     receiveText: function (peer) {
         return peer[Evd.WebTransport.PEER_DATA_KEY].msg;
     },
 
+    _scheduleAck: function () {
+        if (! this._resumeToken)
+            return;
+
+        if (this._recvSeq - this._ackedSeq >= Evd.WebTransport.ACK_BATCH) {
+            this._sendAck ();
+            return;
+        }
+
+        if (this._ackTimer)
+            return;
+
+        var self = this;
+        this._ackTimer = setTimeout (function () {
+                                         self._ackTimer = null;
+                                         self._sendAck ();
+                                     }, Evd.WebTransport.ACK_DELAY);
+    },
+
+    _sendAck: function () {
+        if (this._ackTimer) {
+            clearTimeout (this._ackTimer);
+            this._ackTimer = null;
+        }
+
+        if (! this._peer || this._recvSeq == this._ackedSeq)
+            return;
+
+        // a lost ack only makes the server keep messages a bit longer
+        var xhr = new XMLHttpRequest ();
+        xhr.open ("POST", this._addr + "ack?" + this._peer.id, true);
+        xhr.setRequestHeader (Evd.WebTransport.ACK_HEADER_NAME,
+                              this._recvSeq.toString ());
+        xhr.setRequestHeader (Evd.WebTransport.TOKEN_HEADER_NAME,
+                              this._resumeToken);
+        xhr.send ();
+
+        this._ackedSeq = this._recvSeq;
+    },
+
+    _reconnect: function () {
+        if (this._resumeToken)
+            this._handshake (true);
+        else if (this._transport)
+            this._transport.reconnect ();
+    },
+
     _onFlush: function (result, error) {
         if (! error) {
             this._flushBuf = [];
@@ -722,15 +1042,13 @@ Evd.Object.extend (Evd.WebTransport.prototype, {
         else if (! this._connected) {
             // try reconnect
             setTimeout (function () {
-                            if (self._transport)
-                                self._transport.reconnect ();
+                            self._reconnect ();
                         }, 1);
         }
         else {
             // try reconnect
             setTimeout (function () {
-                            if (self._transport)
-                                self._transport.reconnect ();
+                            self._reconnect ();
                         }, self._retryInterval);
 
             // retry send
@@ -746,6 +1064,12 @@ Evd.Object.extend (Evd.WebTransport.prototype, {
     _closePeer: function (peer, gracefully) {
         this._peer = null;
 
+        if (this._ackTimer) {
+            clearTimeout (this._ackTimer);
+            this._ackTimer = null;
+        }
+        this._resumeToken = null;
+
         peer.close (gracefully);
 
         this._fireEvent ("peer-closed", [peer, gracefully]);
@@ -0,0 +1,193 @@
+/*
+ * bench-common.c
+ *
+ * EventDance, Peer-to-peer IPC library <http://eventdance.org>
+ *
+ * Copyright (C) 2026, the EventDance contributors
+ */
+
+/* Shared harness for the benchmark programs. Results are printed to stdout
+   as one JSON object per line, so that runs can be stored and compared by
+   regression tracking scripts. */
+
+#include <string.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <glib-object.h>
+
+typedef void (* BenchFunc) (gpointer data, guint64 iterations);
+
+static const gchar *bench_suite = NULL;
+
+static gint bench_rounds = 5;
+static gdouble bench_min_time = 0.2;
+static gchar *bench_filter = NULL;
+
+static GOptionEntry bench_entries[] =
+  {
+    { "rounds", 'r', 0, G_OPTION_ARG_INT, &bench_rounds,
+      "Rounds per benchmark, the best one is reported (default: 5)", "N" },
+    { "min-time", 't', 0, G_OPTION_ARG_DOUBLE, &bench_min_time,
+      "Minimum duration of a round, in seconds (default: 0.2)", "SECS" },
+    { "filter", 'f', 0, G_OPTION_ARG_STRING, &bench_filter,
+      "Only run benchmarks whose name contains STRING", "STRING" },
+    { NULL }
+  };
+
+static const gchar *
+bench_fmt (gchar *buf, gdouble value)
+{
+  return g_ascii_formatd (buf, G_ASCII_DTOSTR_BUF_SIZE, "%.3f", value);
+}
+
+static void
+bench_init (gint *argc, gchar ***argv, const gchar *suite)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+
+#ifndef GLIB_VERSION_2_36
+  g_type_init ();
+#endif
+
+  bench_suite = suite;
+
+  context = g_option_context_new ("- EventDance benchmarks");
+  g_option_context_add_main_entries (context, bench_entries, NULL);
+  if (! g_option_context_parse (context, argc, argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      exit (1);
+    }
+  g_option_context_free (context);
+
+  bench_rounds = MAX (bench_rounds, 1);
+
+  /* same payloads on every run */
+  g_random_set_seed (0);
+
+  g_print ("{\"suite\":\"%s\",\"name\":\"env\","
+           "\"glib\":\"%u.%u.%u\",\"rounds\":%d}\n",
+           bench_suite,
+           glib_major_version,
+           glib_minor_version,
+           glib_micro_version,
+           bench_rounds);
+}
+
+static gboolean
+bench_enabled (const gchar *name)
+{
+  return bench_filter == NULL || strstr (name, bench_filter) != NULL;
+}
+
+static gint
+bench_compare_int64 (gconstpointer a, gconstpointer b)
+{
+  gint64 v1 = * (const gint64 *) a;
+  gint64 v2 = * (const gint64 *) b;
+
+  return v1 < v2 ? -1 : (v1 > v2 ? 1 : 0);
+}
+
+/* @latencies, if not NULL, holds one duration in microseconds per operation */
+static void
+bench_report (const gchar *name,
+              guint64      ops,
+              guint64      bytes,
+              gint64       usec,
+              GArray      *latencies)
+{
+  GString *str;
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+  gdouble secs;
+
+  secs = MAX (usec, 1) / (gdouble) G_USEC_PER_SEC;
+
+  str = g_string_new ("");
+  g_string_append_printf (str,
+                          "{\"suite\":\"%s\",\"name\":\"%s\","
+                          "\"ops\":%" G_GUINT64_FORMAT ",",
+                          bench_suite,
+                          name,
+                          ops);
+  g_string_append_printf (str, "\"seconds\":%s,", bench_fmt (buf, secs));
+  g_string_append_printf (str, "\"ns_per_op\":%s,",
+                          bench_fmt (buf, secs * 1e9 / MAX (ops, 1)));
+  g_string_append_printf (str, "\"ops_per_sec\":%s",
+                          bench_fmt (buf, ops / secs));
+
+  if (bytes > 0)
+    g_string_append_printf (str, ",\"mb_per_sec\":%s",
+                            bench_fmt (buf, bytes / secs / (1024 * 1024)));
+
+  if (latencies != NULL && latencies->len > 0)
+    {
+      gint64 *values;
+      guint n;
+
+      g_array_sort (latencies, bench_compare_int64);
+      values = (gint64 *) latencies->data;
+      n = latencies->len;
+
+      g_string_append_printf (str,
+                              ",\"p50_us\":%" G_GINT64_FORMAT
+                              ",\"p99_us\":%" G_GINT64_FORMAT
+                              ",\"max_us\":%" G_GINT64_FORMAT,
+                              values[n / 2],
+                              values[MIN (n - 1, (guint) (n * 0.99))],
+                              values[n - 1]);
+    }
+
+  g_string_append (str, "}\n");
+  g_print ("%s", str->str);
+  g_string_free (str, TRUE);
+}
+
+/* Finds an iteration count that lasts at least --min-time, then reports the
+   fastest of --rounds runs with that count. */
+static void
+bench_run (const gchar *name,
+           BenchFunc    func,
+           gpointer     data,
+           gsize        bytes_per_op)
+{
+  guint64 iterations = 1;
+  gint64 min_usec;
+  gint64 start;
+  gint64 elapsed;
+  gint64 best;
+  gint i;
+
+  if (! bench_enabled (name))
+    return;
+
+  min_usec = (gint64) (bench_min_time * G_USEC_PER_SEC);
+
+  while (TRUE)
+    {
+      start = g_get_monotonic_time ();
+      func (data, iterations);
+      elapsed = g_get_monotonic_time () - start;
+
+      if (elapsed >= min_usec)
+        break;
+
+      if (elapsed <= 0)
+        iterations *= 100;
+      else
+        iterations *= CLAMP ((min_usec * 1.2) / elapsed, 2, 100);
+    }
+
+  best = elapsed;
+  for (i = 1; i < bench_rounds; i++)
+    {
+      start = g_get_monotonic_time ();
+      func (data, iterations);
+      elapsed = g_get_monotonic_time () - start;
+
+      best = MIN (best, elapsed);
+    }
+
+  bench_report (name, iterations, iterations * bytes_per_op, best, NULL);
+}
@@ -0,0 +1,776 @@
+/*
+ * bench-macro.c
+ *
+ * EventDance, Peer-to-peer IPC library <http://eventdance.org>
+ *
+ * Copyright (C) 2026, the EventDance contributors
+ */
+
+/* Loopback benchmarks of complete services. Servers run on the main loop;
+   clients are plain blocking GIO sockets on a separate thread, so that they
+   don't share the event loop being measured. Every benchmark does a fixed
+   number of sequential round-trips and reports their latency. */
+
+#include <unistd.h>
+#include <gio/gio.h>
+
+#include <evd.h>
+
+#include "bench-common.c"
+
+#define WARMUP_REQUESTS 100
+
+typedef struct _Macro Macro;
+
+typedef gboolean (* MacroRoundTrip) (Macro *m, GError **error);
+
+struct _Macro
+{
+  const gchar *name;
+  guint port;
+  guint64 requests;
+
+  gchar *msg;
+  gsize msg_size;
+
+  MacroRoundTrip round_trip;
+
+  /* request for HTTP benchmarks */
+  gchar *path;
+  gchar *body;
+  gsize body_len;
+
+  GSocketClient *client;
+  GSocketConnection *conn;
+  GDataInputStream *input;
+  GOutputStream *output;
+
+  GArray *latencies;
+  gint64 elapsed;
+  GError *error;
+
+  GMainLoop *main_loop;
+  GThread *client_thread;
+};
+
+static guint next_port = 0;
+
+static void
+macro_init (Macro       *m,
+            const gchar *name,
+            guint64      requests,
+            gsize        msg_size)
+{
+  memset (m, 0, sizeof (Macro));
+
+  m->name = name;
+  m->requests = requests;
+
+  m->msg_size = msg_size;
+  m->msg = g_malloc (msg_size + 1);
+  memset (m->msg, 'x', msg_size);
+  m->msg[msg_size] = '\0';
+
+  if (next_port == 0)
+    next_port = 20000 + getpid () % 20000;
+  m->port = next_port++;
+
+  m->latencies = g_array_sized_new (FALSE, FALSE, sizeof (gint64), requests);
+  m->main_loop = g_main_loop_new (NULL, FALSE);
+}
+
+static void
+macro_disconnect (Macro *m)
+{
+  if (m->conn == NULL)
+    return;
+
+  g_object_unref (m->input);
+  m->input = NULL;
+
+  g_io_stream_close (G_IO_STREAM (m->conn), NULL, NULL);
+  g_object_unref (m->conn);
+  m->conn = NULL;
+}
+
+static void
+macro_free (Macro *m)
+{
+  macro_disconnect (m);
+
+  if (m->client != NULL)
+    g_object_unref (m->client);
+
+  if (m->error != NULL)
+    g_error_free (m->error);
+
+  g_array_free (m->latencies, TRUE);
+  g_main_loop_unref (m->main_loop);
+  g_free (m->msg);
+  g_free (m->path);
+  g_free (m->body);
+}
+
+static gboolean
+macro_connect (Macro *m, GError **error)
+{
+  if (m->client == NULL)
+    m->client = g_socket_client_new ();
+
+  m->conn = g_socket_client_connect_to_host (m->client,
+                                             "127.0.0.1",
+                                             m->port,
+                                             NULL,
+                                             error);
+  if (m->conn == NULL)
+    return FALSE;
+
+  m->input =
+    g_data_input_stream_new (g_io_stream_get_input_stream (G_IO_STREAM (m->conn)));
+  m->output = g_io_stream_get_output_stream (G_IO_STREAM (m->conn));
+
+  return TRUE;
+}
+
+static gboolean
+macro_skip (Macro *m, gsize size, GError **error)
+{
+  gchar buf[4096];
+  gsize bytes_read;
+
+  while (size > 0)
+    {
+      if (! g_input_stream_read_all (G_INPUT_STREAM (m->input),
+                                     buf,
+                                     MIN (size, sizeof (buf)),
+                                     &bytes_read,
+                                     NULL,
+                                     error))
+        return FALSE;
+
+      if (bytes_read == 0)
+        {
+          g_set_error_literal (error,
+                               G_IO_ERROR,
+                               G_IO_ERROR_CLOSED,
+                               "Connection closed by server");
+          return FALSE;
+        }
+
+      size -= bytes_read;
+    }
+
+  return TRUE;
+}
+
+static gchar *
+macro_read_line (Macro *m, GError **error)
+{
+  gchar *line;
+
+  line = g_data_input_stream_read_line (m->input, NULL, NULL, error);
+  if (line == NULL && error != NULL && *error == NULL)
+    g_set_error_literal (error,
+                         G_IO_ERROR,
+                         G_IO_ERROR_CLOSED,
+                         "Connection closed by server");
+
+  return line != NULL ? g_strchomp (line) : NULL;
+}
+
+/* a minimal HTTP/1.1 client, just enough for the services benchmarked here */
+static gboolean
+macro_http_post (Macro        *m,
+                 const gchar  *body,
+                 gsize         body_len,
+                 GError      **error)
+{
+  GString *req;
+  gchar *line;
+  gboolean ok;
+  gboolean chunked = FALSE;
+  gboolean keepalive = TRUE;
+  gssize content_len = -1;
+
+  if (m->conn == NULL && ! macro_connect (m, error))
+    return FALSE;
+
+  req = g_string_new ("");
+  g_string_append_printf (req,
+                          "POST %s HTTP/1.1\r\n"
+                          "Host: 127.0.0.1:%u\r\n"
+                          "Connection: keep-alive\r\n"
+                          "Content-Type: text/plain\r\n"
+                          "Content-Length: %" G_GSIZE_FORMAT "\r\n"
+                          "\r\n",
+                          m->path,
+                          m->port,
+                          body_len);
+  g_string_append_len (req, body, body_len);
+
+  ok = g_output_stream_write_all (m->output,
+                                  req->str,
+                                  req->len,
+                                  NULL,
+                                  NULL,
+                                  error);
+  g_string_free (req, TRUE);
+  if (! ok)
+    return FALSE;
+
+  /* status line */
+  if ( (line = macro_read_line (m, error)) == NULL)
+    return FALSE;
+
+  if (strstr (line, " 200 ") == NULL)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_FAILED,
+                   "Unexpected response: %s",
+                   line);
+      g_free (line);
+      return FALSE;
+    }
+  g_free (line);
+
+  /* headers */
+  while (TRUE)
+    {
+      if ( (line = macro_read_line (m, error)) == NULL)
+        return FALSE;
+
+      if (line[0] == '\0')
+        {
+          g_free (line);
+          break;
+        }
+
+      if (g_ascii_strncasecmp (line, "Content-Length:", 15) == 0)
+        content_len = g_ascii_strtoll (line + 15, NULL, 10);
+      else if (g_ascii_strncasecmp (line, "Transfer-Encoding:", 18) == 0)
+        chunked = strstr (line + 18, "chunked") != NULL;
+      else if (g_ascii_strncasecmp (line, "Connection:", 11) == 0)
+        keepalive = strstr (line + 11, "close") == NULL;
+
+      g_free (line);
+    }
+
+  /* body */
+  if (chunked)
+    {
+      gsize chunk_len;
+
+      do
+        {
+          if ( (line = macro_read_line (m, error)) == NULL)
+            return FALSE;
+          chunk_len = g_ascii_strtoull (line, NULL, 16);
+          g_free (line);
+
+          /* chunk data, and its trailing CRLF */
+          if (! macro_skip (m, chunk_len + 2, error))
+            return FALSE;
+        }
+      while (chunk_len > 0);
+    }
+  else if (content_len > 0)
+    {
+      if (! macro_skip (m, content_len, error))
+        return FALSE;
+    }
+
+  if (! keepalive)
+    macro_disconnect (m);
+
+  return TRUE;
+}
+
+static gboolean
+macro_http_round_trip (Macro *m, GError **error)
+{
+  return macro_http_post (m, m->body, m->body_len, error);
+}
+
+static gboolean
+quit_main_loop (gpointer user_data)
+{
+  Macro *m = user_data;
+
+  g_main_loop_quit (m->main_loop);
+
+  return FALSE;
+}
+
+static gpointer
+macro_client_thread (gpointer user_data)
+{
+  Macro *m = user_data;
+  guint64 i;
+  gint64 start;
+  gint64 t;
+
+  for (i = 0; i < WARMUP_REQUESTS && m->error == NULL; i++)
+    m->round_trip (m, &m->error);
+
+  start = g_get_monotonic_time ();
+
+  for (i = 0; i < m->requests && m->error == NULL; i++)
+    {
+      t = g_get_monotonic_time ();
+
+      if (m->round_trip (m, &m->error))
+        {
+          t = g_get_monotonic_time () - t;
+          g_array_append_val (m->latencies, t);
+        }
+    }
+
+  m->elapsed = g_get_monotonic_time () - start;
+
+  macro_disconnect (m);
+
+  g_idle_add (quit_main_loop, m);
+
+  return NULL;
+}
+
+static void
+macro_start_client (Macro *m)
+{
+#if (! GLIB_CHECK_VERSION(2, 31, 0))
+  if (! g_thread_get_initialized ())
+    g_thread_init (NULL);
+
+  m->client_thread = g_thread_create (macro_client_thread, m, TRUE, NULL);
+#else
+  m->client_thread = g_thread_new ("BenchClient", macro_client_thread, m);
+#endif
+}
+
+static void
+macro_on_listen (GObject      *obj,
+                 GAsyncResult *res,
+                 gpointer      user_data)
+{
+  Macro *m = user_data;
+
+  if (! evd_service_listen_finish (EVD_SERVICE (obj), res, &m->error))
+    g_main_loop_quit (m->main_loop);
+  else
+    macro_start_client (m);
+}
+
+/* Reports the results of a benchmark whose main loop has finished, once
+   its client thread (if any) is done. Every round-trip carries the message
+   in both directions. */
+static void
+macro_report (Macro *m)
+{
+  if (m->client_thread != NULL)
+    {
+      g_thread_join (m->client_thread);
+      m->client_thread = NULL;
+    }
+
+  if (m->error != NULL)
+    {
+      g_printerr ("%s: %s\n", m->name, m->error->message);
+      exit (1);
+    }
+
+  bench_report (m->name,
+                m->latencies->len,
+                m->latencies->len * m->msg_size * 2,
+                m->elapsed,
+                m->latencies);
+}
+
+static void
+macro_run_service (Macro *m, EvdService *service)
+{
+  gchar *addr;
+
+  addr = g_strdup_printf ("127.0.0.1:%u", m->port);
+  evd_service_listen (service, addr, NULL, macro_on_listen, m);
+  g_free (addr);
+
+  g_main_loop_run (m->main_loop);
+
+  macro_report (m);
+}
+
+/* echo service */
+
+#define ECHO_BUF_SIZE 65536
+
+static void echo_read (EvdConnection *conn);
+
+static void
+echo_on_read (GObject      *obj,
+              GAsyncResult *res,
+              gpointer      user_data)
+{
+  EvdConnection *conn = EVD_CONNECTION (user_data);
+  GOutputStream *output;
+  gchar *buf;
+  gssize size;
+
+  buf = g_object_get_data (G_OBJECT (conn), "buf");
+  output = g_io_stream_get_output_stream (G_IO_STREAM (conn));
+
+  size = g_input_stream_read_finish (G_INPUT_STREAM (obj), res, NULL);
+
+  if (size > 0 &&
+      g_output_stream_write (output, buf, size, NULL, NULL) == size)
+    echo_read (conn);
+  else
+    g_io_stream_close (G_IO_STREAM (conn), NULL, NULL);
+
+  g_object_unref (conn);
+}
+
+static void
+echo_read (EvdConnection *conn)
+{
+  GInputStream *input;
+
+  input = g_io_stream_get_input_stream (G_IO_STREAM (conn));
+
+  g_object_ref (conn);
+  g_input_stream_read_async (input,
+                             g_object_get_data (G_OBJECT (conn), "buf"),
+                             ECHO_BUF_SIZE,
+                             G_PRIORITY_DEFAULT,
+                             NULL,
+                             echo_on_read,
+                             conn);
+}
+
+static guint
+echo_on_validate_connection (EvdService    *service,
+                             EvdConnection *conn,
+                             gpointer       user_data)
+{
+  g_object_set_data_full (G_OBJECT (conn),
+                          "buf",
+                          g_malloc (ECHO_BUF_SIZE),
+                          g_free);
+  echo_read (conn);
+
+  return EVD_VALIDATE_ACCEPT;
+}
+
+static gboolean
+echo_round_trip (Macro *m, GError **error)
+{
+  gsize bytes_read;
+
+  if (m->conn == NULL && ! macro_connect (m, error))
+    return FALSE;
+
+  if (! g_output_stream_write_all (m->output,
+                                   m->msg,
+                                   m->msg_size,
+                                   NULL,
+                                   NULL,
+                                   error) ||
+      ! g_input_stream_read_all (G_INPUT_STREAM (m->input),
+                                 m->msg,
+                                 m->msg_size,
+                                 &bytes_read,
+                                 NULL,
+                                 error))
+    return FALSE;
+
+  if (bytes_read != m->msg_size)
+    {
+      g_set_error_literal (error,
+                           G_IO_ERROR,
+                           G_IO_ERROR_CLOSED,
+                           "Connection closed by server");
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+run_echo (const gchar *name, gsize msg_size)
+{
+  Macro m;
+  EvdService *service;
+
+  if (! bench_enabled (name))
+    return;
+
+  macro_init (&m, name, 20000, msg_size);
+  m.round_trip = echo_round_trip;
+
+  service = evd_service_new ();
+  g_signal_connect (service,
+                    "validate-connection",
+                    G_CALLBACK (echo_on_validate_connection),
+                    NULL);
+
+  macro_run_service (&m, service);
+
+  g_object_unref (service);
+  macro_free (&m);
+}
+
+/* long-polling */
+
+static void
+longpolling_on_receive (EvdTransport   *transport,
+                        EvdPeer        *peer,
+                        const gchar    *buf,
+                        gsize           size,
+                        EvdMessageType  type,
+                        gpointer        user_data)
+{
+  evd_transport_send (transport, peer, buf, size, NULL);
+}
+
+static void
+run_longpolling (const gchar *name, gsize msg_size)
+{
+  Macro m;
+  EvdLongpollingServer *server;
+  EvdPeer *peer;
+  GString *frame;
+
+  if (! bench_enabled (name))
+    return;
+
+  macro_init (&m, name, 5000, msg_size);
+
+  server = evd_longpolling_server_new ();
+  evd_transport_add_receive_handler (EVD_TRANSPORT (server),
+                                     longpolling_on_receive,
+                                     NULL,
+                                     NULL);
+
+  peer = evd_transport_create_new_peer (EVD_TRANSPORT (server));
+
+  /* a single long-polling frame; only single-byte frame headers are
+     needed here. Since the peer has no receive request pending, the echo
+     comes back in the response to the same POST. */
+  g_assert_cmpuint (msg_size, <=, 0x7F - 2);
+  frame = g_string_new ("");
+  g_string_append_c (frame, (gchar) msg_size);
+  g_string_append_len (frame, m.msg, msg_size);
+
+  m.round_trip = macro_http_round_trip;
+  m.path = g_strdup_printf ("/lp/send?%s", evd_peer_get_id (peer));
+  m.body_len = frame->len;
+  m.body = g_string_free (frame, FALSE);
+
+  macro_run_service (&m, EVD_SERVICE (server));
+
+  g_object_unref (server);
+  macro_free (&m);
+}
+
+/* JSON-RPC over HTTP */
+
+static void
+jsonrpc_on_method_call (EvdJsonrpcHttpServer *self,
+                        const gchar          *method_name,
+                        JsonNode             *params,
+                        guint                 invocation_id,
+                        EvdHttpConnection    *connection,
+                        EvdHttpRequest       *request,
+                        gpointer              user_data)
+{
+  evd_jsonrpc_http_server_respond (self, invocation_id, params, NULL);
+}
+
+static void
+run_jsonrpc (const gchar *name, gsize msg_size)
+{
+  Macro m;
+  EvdJsonrpcHttpServer *server;
+
+  if (! bench_enabled (name))
+    return;
+
+  macro_init (&m, name, 5000, msg_size);
+
+  server = evd_jsonrpc_http_server_new ();
+  evd_jsonrpc_http_server_set_method_call_callback (server,
+                                                    jsonrpc_on_method_call,
+                                                    NULL,
+                                                    NULL);
+
+  m.round_trip = macro_http_round_trip;
+  m.path = g_strdup ("/rpc");
+  m.body = g_strdup_printf ("{\"id\":1,\"method\":\"echo\",\"params\":[\"%s\"]}",
+                            m.msg);
+  m.body_len = strlen (m.body);
+
+  macro_run_service (&m, EVD_SERVICE (server));
+
+  g_object_unref (server);
+  macro_free (&m);
+}
+
+/* websocket */
+
+typedef struct
+{
+  Macro *m;
+  EvdWebsocketClient *client;
+  guint64 count;
+  gint64 start;
+  gint64 sent_at;
+} WebsocketData;
+
+static void
+websocket_send (WebsocketData *data, EvdTransport *transport, EvdPeer *peer)
+{
+  data->sent_at = g_get_monotonic_time ();
+  evd_transport_send (transport, peer, data->m->msg, data->m->msg_size, NULL);
+}
+
+static void
+websocket_on_new_peer (EvdTransport *transport,
+                       EvdPeer      *peer,
+                       gpointer      user_data)
+{
+  WebsocketData *data = user_data;
+
+  if (! EVD_IS_WEBSOCKET_CLIENT (transport))
+    return;
+
+  data->start = g_get_monotonic_time ();
+  websocket_send (data, transport, peer);
+}
+
+static void
+websocket_on_receive (EvdTransport   *transport,
+                      EvdPeer        *peer,
+                      const gchar    *buf,
+                      gsize           size,
+                      EvdMessageType  type,
+                      gpointer        user_data)
+{
+  WebsocketData *data = user_data;
+  Macro *m = data->m;
+  gint64 t;
+
+  if (EVD_IS_WEBSOCKET_SERVER (transport))
+    {
+      evd_transport_send (transport, peer, buf, size, NULL);
+      return;
+    }
+
+  data->count++;
+  if (data->count == WARMUP_REQUESTS)
+    {
+      data->start = g_get_monotonic_time ();
+    }
+  else if (data->count > WARMUP_REQUESTS)
+    {
+      t = g_get_monotonic_time () - data->sent_at;
+      g_array_append_val (m->latencies, t);
+    }
+
+  if (m->latencies->len < m->requests)
+    {
+      websocket_send (data, transport, peer);
+    }
+  else
+    {
+      m->elapsed = g_get_monotonic_time () - data->start;
+      g_main_loop_quit (m->main_loop);
+    }
+}
+
+static void
+websocket_on_open (GObject      *obj,
+                   GAsyncResult *res,
+                   gpointer      user_data)
+{
+  WebsocketData *data = user_data;
+  gchar *addr;
+
+  if (! evd_transport_open_finish (EVD_TRANSPORT (obj), res, &data->m->error))
+    {
+      g_main_loop_quit (data->m->main_loop);
+      return;
+    }
+
+  if (EVD_IS_WEBSOCKET_SERVER (obj))
+    {
+      addr = g_strdup_printf ("ws://127.0.0.1:%u/", data->m->port);
+      evd_transport_open (EVD_TRANSPORT (data->client),
+                          addr,
+                          NULL,
+                          websocket_on_open,
+                          data);
+      g_free (addr);
+    }
+}
+
+/* Both ends run in this process and loop, so this measures the framing, and
+   the masking of client frames, on both sides of the connection. */
+static void
+run_websocket (const gchar *name, gsize msg_size)
+{
+  Macro m;
+  WebsocketData data = { 0 };
+  EvdWebsocketServer *server;
+  EvdWebsocketClient *client;
+  gchar *addr;
+
+  if (! bench_enabled (name))
+    return;
+
+  macro_init (&m, name, 20000, msg_size);
+  data.m = &m;
+
+  server = evd_websocket_server_new ();
+  client = evd_websocket_client_new ();
+  data.client = client;
+
+  evd_transport_add_receive_handler (EVD_TRANSPORT (server),
+                                     websocket_on_receive,
+                                     &data,
+                                     NULL);
+  evd_transport_add_receive_handler (EVD_TRANSPORT (client),
+                                     websocket_on_receive,
+                                     &data,
+                                     NULL);
+  g_signal_connect (client, "new-peer", G_CALLBACK (websocket_on_new_peer), &data);
+
+  addr = g_strdup_printf ("127.0.0.1:%u", m.port);
+  evd_transport_open (EVD_TRANSPORT (server), addr, NULL, websocket_on_open, &data);
+  g_free (addr);
+
+  g_main_loop_run (m.main_loop);
+
+  macro_report (&m);
+
+  g_object_unref (client);
+  g_object_unref (server);
+  macro_free (&m);
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+  bench_init (&argc, &argv, "macro");
+
+  run_echo ("service/echo-64b", 64);
+  run_echo ("service/echo-16k", 16384);
+
+  run_websocket ("websocket/echo-64b", 64);
+  run_websocket ("websocket/echo-16k", 16384);
+
+  run_longpolling ("longpolling/echo-64b", 64);
+
+  run_jsonrpc ("jsonrpc-http/echo-64b", 64);
+
+  return 0;
+}
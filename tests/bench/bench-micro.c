@@ -0,0 +1,285 @@
+/*
+ * bench-micro.c
+ *
+ * EventDance, Peer-to-peer IPC library <http://eventdance.org>
+ *
+ * Copyright (C) 2026, the EventDance contributors
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+
+#include <evd.h>
+#include "evd-poll.h"
+#include "evd-json-filter.h"
+
+#include "bench-common.c"
+
+#define JSON_OBJECT \
+  "{\"id\":1234,\"method\":\"echo\"," \
+  "\"params\":[\"Hello World!\",42,3.14,true,null," \
+  "{\"nested\":[1,2,3],\"text\":\"with \\\"escaped\\\" quotes\"}]}"
+
+/* json filter */
+
+typedef struct
+{
+  EvdJsonFilter *filter;
+  const gchar *buf;
+  gsize size;
+  gsize chunk_size;
+  guint64 packets;
+} JsonData;
+
+static void
+json_on_packet (EvdJsonFilter *filter,
+                const gchar   *buffer,
+                gsize          size,
+                gpointer       user_data)
+{
+  JsonData *data = user_data;
+
+  data->packets++;
+}
+
+static void
+bench_json_filter (gpointer user_data, guint64 iterations)
+{
+  JsonData *data = user_data;
+  guint64 i;
+  gsize j;
+
+  data->packets = 0;
+
+  for (i = 0; i < iterations; i++)
+    for (j = 0; j < data->size; j += data->chunk_size)
+      evd_json_filter_feed_len (data->filter,
+                                data->buf + j,
+                                MIN (data->chunk_size, data->size - j),
+                                NULL);
+
+  g_assert_cmpuint (data->packets, ==, iterations);
+}
+
+static void
+run_json_filter (void)
+{
+  JsonData data;
+
+  data.filter = evd_json_filter_new ();
+  evd_json_filter_set_packet_handler (data.filter,
+                                      json_on_packet,
+                                      &data,
+                                      NULL);
+  data.buf = JSON_OBJECT;
+  data.size = strlen (JSON_OBJECT);
+
+  data.chunk_size = data.size;
+  bench_run ("json-filter/object", bench_json_filter, &data, data.size);
+
+  /* as if it arrived in small network reads */
+  data.chunk_size = 7;
+  bench_run ("json-filter/object-chunked", bench_json_filter, &data, data.size);
+
+  g_object_unref (data.filter);
+}
+
+/* buffered input stream unread */
+
+typedef struct
+{
+  EvdBufferedInputStream *stream;
+  gchar *buf;
+  gsize size;
+  guint pieces;
+} UnreadData;
+
+static void
+bench_unread (gpointer user_data, guint64 iterations)
+{
+  UnreadData *data = user_data;
+  gsize piece;
+  guint64 i;
+  guint j;
+
+  piece = data->size / data->pieces;
+
+  for (i = 0; i < iterations; i++)
+    {
+      for (j = 0; j < data->pieces; j++)
+        evd_buffered_input_stream_unread (data->stream,
+                                          data->buf + data->size - (j + 1) * piece,
+                                          piece,
+                                          NULL,
+                                          NULL);
+
+      g_input_stream_read_all (G_INPUT_STREAM (data->stream),
+                               data->buf,
+                               piece * data->pieces,
+                               NULL,
+                               NULL,
+                               NULL);
+    }
+}
+
+static void
+run_unread (void)
+{
+  UnreadData data;
+  GInputStream *base;
+
+  base = g_memory_input_stream_new ();
+  data.stream = evd_buffered_input_stream_new (base);
+  g_object_unref (base);
+
+  data.size = 4096;
+  data.buf = g_malloc (data.size);
+  memset (data.buf, 'x', data.size);
+
+  data.pieces = 1;
+  bench_run ("buffered-input-stream/unread-4k", bench_unread, &data, data.size);
+
+  /* a parser giving back what it couldn't consume, one token at a time */
+  data.pieces = 64;
+  bench_run ("buffered-input-stream/unread-64x64",
+             bench_unread,
+             &data,
+             data.size);
+
+  g_free (data.buf);
+  g_object_unref (data.stream);
+}
+
+/* poll dispatch */
+
+typedef struct
+{
+  EvdPoll *poll;
+  gint fds[2];
+  GMainLoop *main_loop;
+  guint64 remaining;
+} PollData;
+
+static GIOCondition
+poll_on_condition (EvdPoll      *poll,
+                   GIOCondition  condition,
+                   gpointer      user_data)
+{
+  PollData *data = user_data;
+  gchar buf[64];
+
+  while (read (data->fds[0], buf, sizeof (buf)) > 0)
+    ;
+
+  data->remaining--;
+  if (data->remaining == 0)
+    g_main_loop_quit (data->main_loop);
+  else if (write (data->fds[1], "x", 1) != 1)
+    g_assert_not_reached ();
+
+  return 0;
+}
+
+static void
+bench_poll_dispatch (gpointer user_data, guint64 iterations)
+{
+  PollData *data = user_data;
+
+  data->remaining = iterations;
+
+  if (write (data->fds[1], "x", 1) != 1)
+    g_assert_not_reached ();
+
+  g_main_loop_run (data->main_loop);
+}
+
+static void
+run_poll_dispatch (void)
+{
+  PollData data;
+  EvdPollSession *session;
+  GError *error = NULL;
+
+  if (pipe (data.fds) != 0)
+    g_error ("Failed to create pipe");
+
+  fcntl (data.fds[0], F_SETFL, O_NONBLOCK);
+
+  data.poll = evd_poll_get_default ();
+  data.main_loop = g_main_loop_new (NULL, FALSE);
+
+  session = evd_poll_add (data.poll,
+                          data.fds[0],
+                          G_IO_IN,
+                          G_PRIORITY_DEFAULT,
+                          poll_on_condition,
+                          &data,
+                          NULL,
+                          &error);
+  g_assert_no_error (error);
+
+  /* write, epoll_wait() wakeup, hop to the main context, callback */
+  bench_run ("poll/dispatch", bench_poll_dispatch, &data, 0);
+
+  evd_poll_del (data.poll, session, NULL);
+
+  g_main_loop_unref (data.main_loop);
+  g_object_unref (data.poll);
+
+  close (data.fds[0]);
+  close (data.fds[1]);
+}
+
+/* stream throttle */
+
+static void
+bench_throttle (gpointer user_data, guint64 iterations)
+{
+  EvdStreamThrottle *throttle = user_data;
+  guint wait;
+  gsize size;
+  guint64 i;
+
+  for (i = 0; i < iterations; i++)
+    {
+      size = evd_stream_throttle_request (throttle, 4096, &wait);
+      evd_stream_throttle_report (throttle, size);
+    }
+}
+
+static void
+run_throttle (void)
+{
+  EvdStreamThrottle *throttle;
+  EvdStreamThrottle *parent;
+
+  throttle = evd_stream_throttle_new ();
+  bench_run ("stream-throttle/unlimited", bench_throttle, throttle, 0);
+
+  /* high enough to never make the caller wait, so only the
+     accounting is measured */
+  g_object_set (throttle, "bandwidth", 1e9, NULL);
+  bench_run ("stream-throttle/limited", bench_throttle, throttle, 0);
+
+  parent = evd_stream_throttle_new ();
+  g_object_set (parent, "bandwidth", 1e9, NULL);
+  evd_stream_throttle_set_parent (throttle, parent);
+  bench_run ("stream-throttle/hierarchy", bench_throttle, throttle, 0);
+
+  g_object_unref (throttle);
+  g_object_unref (parent);
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+  bench_init (&argc, &argv, "micro");
+
+  run_json_filter ();
+  run_unread ();
+  run_poll_dispatch ();
+  run_throttle ();
+
+  return 0;
+}
@@ -178,6 +178,92 @@ test_func (Fixture *f, gconstpointer test_data)
   g_main_loop_run (f->main_loop);
 }
 
+static void
+test_fair_share (void)
+{
+  EvdIoStreamGroup *group;
+  EvdStreamThrottle *parent;
+  EvdStreamThrottle *bulk;
+  EvdStreamThrottle *interactive;
+  guint wait = 0;
+  gsize size;
+
+  group = evd_io_stream_group_new ();
+  parent = evd_io_stream_group_get_output_throttle (group);
+  g_object_set (parent, "bandwidth", 100.0, NULL);
+
+  bulk = evd_stream_throttle_new ();
+  g_object_set (bulk, "parent", parent, "weight", 1, NULL);
+
+  interactive = evd_stream_throttle_new ();
+  g_object_set (interactive, "parent", parent, "weight", 3, NULL);
+
+  /* let the group see both children as active */
+  evd_stream_throttle_request (bulk, 1, NULL);
+  evd_stream_throttle_request (interactive, 1, NULL);
+  g_usleep (20000);
+
+  /* the bulk transfer can't drain the whole burst... */
+  size = evd_stream_throttle_request (bulk, 1024 * 1024, &wait);
+  g_assert_cmpuint (size, >, 0);
+  g_assert_cmpuint (size, <, 10240);
+  g_assert_cmpuint (wait, >, 0);
+  evd_stream_throttle_report (bulk, size);
+
+  g_assert_cmpuint (evd_stream_throttle_get_total (parent), ==, size);
+
+  /* ...so the interactive one still gets its share right away */
+  size = evd_stream_throttle_request (interactive, 4096, NULL);
+  g_assert_cmpuint (size, ==, 4096);
+
+  g_object_unref (bulk);
+  g_object_unref (interactive);
+  g_object_unref (group);
+}
+
+static void
+test_nesting_cycles (void)
+{
+  EvdIoStreamGroup *a;
+  EvdIoStreamGroup *b;
+  EvdIoStreamGroup *c;
+
+  a = evd_io_stream_group_new ();
+  b = evd_io_stream_group_new ();
+  c = evd_io_stream_group_new ();
+
+  g_assert (evd_io_stream_group_set_parent (b, a));
+  g_assert (evd_io_stream_group_set_parent (c, b));
+
+  /* a group can't be nested in itself nor in any of its descendants */
+  g_assert (! evd_io_stream_group_set_parent (a, a));
+  g_assert (! evd_io_stream_group_set_parent (a, c));
+  g_assert (! evd_io_stream_group_set_parent (a, b));
+
+  g_assert (evd_io_stream_group_get_parent (a) == NULL);
+  g_assert (evd_stream_throttle_get_parent (
+              evd_io_stream_group_get_input_throttle (a)) == NULL);
+  g_assert (evd_stream_throttle_get_parent (
+              evd_io_stream_group_get_output_throttle (a)) == NULL);
+
+  /* nor can its throttles, when re-parented directly */
+  g_assert (! evd_stream_throttle_set_parent (
+              evd_io_stream_group_get_output_throttle (a),
+              evd_io_stream_group_get_output_throttle (c)));
+
+  /* once detached, the former ancestor can be nested again */
+  g_assert (evd_io_stream_group_set_parent (c, NULL));
+  g_assert (evd_io_stream_group_set_parent (a, c));
+  g_assert (evd_io_stream_group_get_parent (a) == c);
+  g_assert (evd_stream_throttle_get_parent (
+              evd_io_stream_group_get_input_throttle (a)) ==
+            evd_io_stream_group_get_input_throttle (c));
+
+  g_object_unref (b);
+  g_object_unref (a);
+  g_object_unref (c);
+}
+
 gint
 main (gint argc, gchar *argv[])
 {
@@ -194,5 +280,8 @@ main (gint argc, gchar *argv[])
               test_func,
               fixture_teardown);
 
+  g_test_add_func ("/evd/io-stream-group/fair-share", test_fair_share);
+  g_test_add_func ("/evd/io-stream-group/nesting-cycles", test_nesting_cycles);
+
   return g_test_run ();
 }
@@ -0,0 +1,194 @@
+/*
+ * test-metrics.c
+ *
+ * EventDance, Peer-to-peer IPC library <http://eventdance.org>
+ *
+ * Copyright (C) 2026, the EventDance contributors
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include <evd.h>
+#include "evd-poll.h"
+
+static void
+test_counter_and_gauge (void)
+{
+  EvdMetric *counter;
+  EvdMetric *gauge;
+
+  counter = evd_metrics_get ("test_counter_total",
+                             EVD_METRIC_COUNTER,
+                             "A counter");
+  g_assert (counter != NULL);
+  g_assert (counter == evd_metrics_get ("test_counter_total",
+                                        EVD_METRIC_COUNTER,
+                                        NULL));
+
+  evd_metric_add (counter, 3);
+  evd_metric_add (counter, 4);
+  g_assert_cmpint (evd_metric_get_value (counter), ==, 7);
+
+  gauge = evd_metrics_get ("test_gauge", EVD_METRIC_GAUGE, NULL);
+  evd_metric_add (gauge, 5);
+  evd_metric_add (gauge, -2);
+  g_assert_cmpint (evd_metric_get_value (gauge), ==, 3);
+
+  evd_metric_set (gauge, 10);
+  g_assert_cmpint (evd_metric_get_value (gauge), ==, 10);
+}
+
+static void
+test_histogram (void)
+{
+  EvdMetric *latency;
+  gchar *text;
+
+  latency = evd_metrics_get ("test_latency_seconds",
+                             EVD_METRIC_LATENCY,
+                             "A latency");
+
+  evd_metric_observe (latency, 1);
+  evd_metric_observe (latency, 1000);
+  evd_metric_observe (latency, 1000000);
+
+  g_assert_cmpuint (evd_metric_get_count (latency), ==, 3);
+  g_assert_cmpint (evd_metric_get_value (latency), ==, 1001001);
+
+  text = evd_metrics_render ();
+
+  g_assert (strstr (text, "# HELP test_latency_seconds A latency\n") != NULL);
+  g_assert (strstr (text, "# TYPE test_latency_seconds histogram\n") != NULL);
+  g_assert (strstr (text, "test_latency_seconds_bucket{le=\"1e-06\"} 1\n") != NULL);
+  g_assert (strstr (text, "test_latency_seconds_bucket{le=\"+Inf\"} 3\n") != NULL);
+  g_assert (strstr (text, "test_latency_seconds_sum 1.001001\n") != NULL);
+  g_assert (strstr (text, "test_latency_seconds_count 3\n") != NULL);
+
+  g_free (text);
+}
+
+static void
+test_labels (void)
+{
+  EvdMetric *a;
+  EvdMetric *b;
+  gchar *text;
+
+  a = evd_metrics_get_labeled ("test_labeled_total",
+                               EVD_METRIC_COUNTER,
+                               "A labeled counter",
+                               "context=\"a\"");
+  b = evd_metrics_get_labeled ("test_labeled_total",
+                               EVD_METRIC_COUNTER,
+                               NULL,
+                               "context=\"b\"");
+  g_assert (a != b);
+  g_assert_cmpstr (evd_metric_get_labels (a), ==, "context=\"a\"");
+
+  evd_metric_add (a, 1);
+  evd_metric_add (b, 2);
+
+  text = evd_metrics_render ();
+
+  g_assert (strstr (text, "# TYPE test_labeled_total counter\n"
+                    "test_labeled_total{context=\"a\"} 1\n"
+                    "test_labeled_total{context=\"b\"} 2\n") != NULL);
+
+  g_free (text);
+}
+
+static GIOCondition
+on_poll_event (EvdPoll      *poll,
+               GIOCondition  condition,
+               gpointer      user_data)
+{
+  GMainLoop *main_loop = user_data;
+  gint *fds = g_object_get_data (G_OBJECT (poll), "fds");
+  gchar buf;
+
+  g_assert (read (fds[0], &buf, 1) == 1);
+
+  g_main_loop_quit (main_loop);
+
+  return 0;
+}
+
+static void
+test_poll_tracing (void)
+{
+  EvdPoll *poll;
+  EvdPollSession *session;
+  EvdMetric *lag;
+  EvdMetric *run;
+  GMainLoop *main_loop;
+  GError *error = NULL;
+  guint64 lag_count;
+  guint64 run_count;
+  gint fds[2];
+
+  /* sessions on the default main context are labeled after it */
+  lag = evd_metrics_get_labeled ("evd_poll_context_lag_seconds",
+                                 EVD_METRIC_LATENCY,
+                                 NULL,
+                                 "context=\"default\"");
+  run = evd_metrics_get_labeled ("evd_poll_context_callback_seconds",
+                                 EVD_METRIC_LATENCY,
+                                 NULL,
+                                 "context=\"default\"");
+  lag_count = evd_metric_get_count (lag);
+  run_count = evd_metric_get_count (run);
+
+  g_assert (pipe (fds) == 0);
+
+  main_loop = g_main_loop_new (NULL, FALSE);
+
+  poll = evd_poll_new ();
+  evd_poll_set_tracing (poll, TRUE);
+  g_assert (evd_poll_get_tracing (poll));
+  g_object_set_data (G_OBJECT (poll), "fds", fds);
+
+  session = evd_poll_add (poll,
+                          fds[0],
+                          G_IO_IN,
+                          G_PRIORITY_DEFAULT,
+                          on_poll_event,
+                          main_loop,
+                          NULL,
+                          &error);
+  g_assert_no_error (error);
+  g_assert (session != NULL);
+
+  g_assert (write (fds[1], "x", 1) == 1);
+  g_main_loop_run (main_loop);
+
+  g_assert_cmpuint (evd_metric_get_count (lag), ==, lag_count + 1);
+  g_assert_cmpuint (evd_metric_get_count (run), ==, run_count + 1);
+
+  g_assert (evd_poll_del (poll, session, &error));
+  g_assert_no_error (error);
+
+  g_object_unref (poll);
+  g_main_loop_unref (main_loop);
+
+  close (fds[0]);
+  close (fds[1]);
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+#ifndef GLIB_VERSION_2_36
+  g_type_init ();
+#endif
+
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/evd/metrics/counter-and-gauge", test_counter_and_gauge);
+  g_test_add_func ("/evd/metrics/histogram", test_histogram);
+  g_test_add_func ("/evd/metrics/labels", test_labels);
+  g_test_add_func ("/evd/metrics/poll-tracing", test_poll_tracing);
+
+  return g_test_run ();
+}
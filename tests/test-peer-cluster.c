@@ -0,0 +1,322 @@
+/*
+ * test-peer-cluster.c
+ *
+ * EventDance, Peer-to-peer IPC library <http://eventdance.org>
+ *
+ * Copyright (C) 2026, the EventDance contributors
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#ifdef HAVE_GIO_UNIX
+#include <gio/gunixsocketaddress.h>
+#endif
+
+#include <evd.h>
+
+#define MSG "Hello from another node!"
+
+#define WAIT_TIMEOUT 5 /* seconds */
+
+typedef gboolean (* ConditionFunc) (gpointer data);
+
+typedef struct
+{
+  gchar *path;
+
+  EvdLongpollingServer *transport;
+  EvdPeer *peer;
+
+  EvdPeerManager *remote_peer_manager;
+
+  EvdPeerCluster *node_a;
+  EvdPeerCluster *node_b;
+} Fixture;
+
+static gboolean
+wake_up (gpointer user_data)
+{
+  return TRUE;
+}
+
+static gboolean
+wait_for (ConditionFunc func, gpointer data)
+{
+  gint64 deadline;
+  guint src_id;
+
+  deadline = g_get_monotonic_time () + WAIT_TIMEOUT * G_USEC_PER_SEC;
+  src_id = g_timeout_add (10, wake_up, NULL);
+
+  while (! func (data) && g_get_monotonic_time () < deadline)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_source_remove (src_id);
+
+  return func (data);
+}
+
+static void
+on_started (GObject      *obj,
+            GAsyncResult *res,
+            gpointer      user_data)
+{
+  gboolean *started = user_data;
+  GError *error = NULL;
+
+  *started = evd_peer_cluster_start_finish (EVD_PEER_CLUSTER (obj), res, &error);
+  g_assert_no_error (error);
+}
+
+static gboolean
+is_true (gpointer data)
+{
+  return * (gboolean *) data;
+}
+
+static void
+start_node (EvdPeerCluster *node)
+{
+  gboolean started = FALSE;
+
+  evd_peer_cluster_start (node, NULL, on_started, &started);
+  g_assert (wait_for (is_true, &started));
+}
+
+static void
+fixture_setup (Fixture       *f,
+               gconstpointer  data)
+{
+  EvdPeerManager *peer_manager;
+
+  f->path = g_strdup_printf ("%s/evd-test-cluster-%d",
+                             g_get_tmp_dir (),
+                             (gint) getpid ());
+
+  f->transport = evd_longpolling_server_new ();
+  peer_manager = evd_transport_get_peer_manager (EVD_TRANSPORT (f->transport));
+
+  /* a peer without a connection, so what it receives stays in its backlog */
+  f->peer = evd_transport_create_new_peer (EVD_TRANSPORT (f->transport));
+  g_object_ref (f->peer);
+
+  /* as if it was another process, with its own peers */
+  f->remote_peer_manager = evd_peer_manager_new ();
+
+  f->node_a = evd_peer_cluster_new (peer_manager, f->path, "a");
+  f->node_b = evd_peer_cluster_new (f->remote_peer_manager, f->path, "b");
+}
+
+static void
+fixture_teardown (Fixture       *f,
+                  gconstpointer  data)
+{
+  g_object_unref (f->node_a);
+  g_object_unref (f->node_b);
+
+  g_object_unref (f->remote_peer_manager);
+
+  if (! evd_peer_is_closed (f->peer))
+    evd_transport_close_peer (EVD_TRANSPORT (f->transport), f->peer, FALSE, NULL);
+  g_object_unref (f->peer);
+  g_object_unref (f->transport);
+
+  g_rmdir (f->path);
+  g_free (f->path);
+}
+
+static gboolean
+peer_is_announced (gpointer data)
+{
+  Fixture *f = data;
+
+  return evd_peer_cluster_is_remote_peer (f->node_b, evd_peer_get_id (f->peer));
+}
+
+static gboolean
+message_arrived (gpointer data)
+{
+  Fixture *f = data;
+
+  return evd_peer_backlog_get_length (f->peer) > 0;
+}
+
+static gboolean
+proxy_is_closed (gpointer data)
+{
+  return evd_peer_is_closed (EVD_PEER (data));
+}
+
+static void
+test_forward (Fixture       *f,
+              gconstpointer  data)
+{
+  EvdPeer *proxy;
+  GError *error = NULL;
+  gchar *msg;
+  gsize size;
+  EvdMessageType type;
+
+  start_node (f->node_a);
+  start_node (f->node_b);
+
+  g_assert (wait_for (peer_is_announced, f));
+  g_assert_cmpuint (evd_peer_cluster_get_num_nodes (f->node_b), ==, 1);
+
+  /* local peers are returned as they are */
+  proxy = evd_peer_cluster_lookup_peer (f->node_a, evd_peer_get_id (f->peer));
+  g_assert (proxy == f->peer);
+  g_object_unref (proxy);
+
+  g_assert (evd_peer_cluster_lookup_peer (f->node_b, "no-such-peer") == NULL);
+
+  proxy = evd_peer_cluster_lookup_peer (f->node_b, evd_peer_get_id (f->peer));
+  g_assert (EVD_IS_PEER (proxy));
+  g_assert (proxy != f->peer);
+  g_assert_cmpstr (evd_peer_get_id (proxy), ==, evd_peer_get_id (f->peer));
+  g_assert (evd_peer_get_transport (proxy) == EVD_TRANSPORT (f->node_b));
+
+  g_assert (evd_peer_send_text (proxy, MSG, &error));
+  g_assert_no_error (error);
+
+  g_assert (wait_for (message_arrived, f));
+
+  msg = evd_peer_pop_message (f->peer, &size, &type);
+  g_assert_cmpstr (msg, ==, MSG);
+  g_assert_cmpuint (size, ==, strlen (MSG));
+  g_assert_cmpint (type, ==, EVD_MESSAGE_TYPE_TEXT);
+  g_free (msg);
+
+  /* closing the peer in its node closes the proxy in the other */
+  evd_transport_close_peer (EVD_TRANSPORT (f->transport), f->peer, TRUE, NULL);
+
+  g_assert (wait_for (proxy_is_closed, proxy));
+  g_assert (! evd_peer_cluster_is_remote_peer (f->node_b,
+                                               evd_peer_get_id (f->peer)));
+
+  g_object_unref (proxy);
+}
+
+#ifdef HAVE_GIO_UNIX
+
+typedef struct
+{
+  gchar buf[256];
+  gboolean eof;
+} RawLink;
+
+static void
+raw_link_on_read (GObject      *obj,
+                  GAsyncResult *res,
+                  gpointer      user_data)
+{
+  RawLink *raw = user_data;
+  gssize size;
+
+  size = g_input_stream_read_finish (G_INPUT_STREAM (obj), res, NULL);
+  if (size <= 0)
+    {
+      raw->eof = TRUE;
+      return;
+    }
+
+  g_input_stream_read_async (G_INPUT_STREAM (obj),
+                             raw->buf,
+                             sizeof (raw->buf),
+                             G_PRIORITY_DEFAULT,
+                             NULL,
+                             raw_link_on_read,
+                             raw);
+}
+
+static void
+test_oversized_frame (Fixture       *f,
+                      gconstpointer  data)
+{
+  GSocketClient *client;
+  GSocketAddress *addr;
+  GSocketConnection *conn;
+  GError *error = NULL;
+  gchar *sock_path;
+  RawLink raw = { { 0 }, FALSE };
+
+  /* a CMD_SEND header announcing a 4 GiB payload */
+  const guint8 frame[] = { 4, 0, 0, 0, 0xff, 0xff, 0xff, 0xff };
+
+  start_node (f->node_a);
+  start_node (f->node_b);
+  g_assert (wait_for (peer_is_announced, f));
+
+  /* a misbehaving node, talking directly to node a */
+  sock_path = g_strdup_printf ("%s/a.sock", f->path);
+  addr = g_unix_socket_address_new (sock_path);
+  g_free (sock_path);
+
+  client = g_socket_client_new ();
+  conn = g_socket_client_connect (client,
+                                  G_SOCKET_CONNECTABLE (addr),
+                                  NULL,
+                                  &error);
+  g_assert_no_error (error);
+
+  g_input_stream_read_async (g_io_stream_get_input_stream (G_IO_STREAM (conn)),
+                             raw.buf,
+                             sizeof (raw.buf),
+                             G_PRIORITY_DEFAULT,
+                             NULL,
+                             raw_link_on_read,
+                             &raw);
+
+  g_output_stream_write_all (g_io_stream_get_output_stream (G_IO_STREAM (conn)),
+                             frame,
+                             sizeof (frame),
+                             NULL,
+                             NULL,
+                             &error);
+  g_assert_no_error (error);
+
+  /* node a drops the link instead of buffering the payload */
+  g_assert (wait_for (is_true, &raw.eof));
+
+  /* and keeps its link to node b */
+  g_assert (evd_peer_cluster_is_remote_peer (f->node_b,
+                                             evd_peer_get_id (f->peer)));
+  g_assert_cmpuint (evd_peer_cluster_get_num_nodes (f->node_a), ==, 1);
+
+  g_object_unref (conn);
+  g_object_unref (client);
+  g_object_unref (addr);
+}
+
+#endif /* HAVE_GIO_UNIX */
+
+gint
+main (gint argc, gchar *argv[])
+{
+#ifndef GLIB_VERSION_2_36
+  g_type_init ();
+#endif
+
+  g_test_init (&argc, &argv, NULL);
+
+#ifdef HAVE_GIO_UNIX
+  g_test_add ("/evd/peer-cluster/forward",
+              Fixture,
+              NULL,
+              fixture_setup,
+              test_forward,
+              fixture_teardown);
+
+  g_test_add ("/evd/peer-cluster/oversized-frame",
+              Fixture,
+              NULL,
+              fixture_setup,
+              test_oversized_frame,
+              fixture_teardown);
+#endif
+
+  return g_test_run ();
+}
@@ -0,0 +1,164 @@
+/*
+ * test-peer-groups.c
+ *
+ * EventDance, Peer-to-peer IPC library <http://eventdance.org>
+ *
+ * Copyright (C) 2026, the EventDance contributors
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include <evd.h>
+
+#define MSG "Hello room!"
+
+typedef struct
+{
+  EvdLongpollingServer *transport;
+  EvdPeerManager *peer_manager;
+  EvdPeer *peers[3];
+} Fixture;
+
+static void
+fixture_setup (Fixture       *f,
+               gconstpointer  data)
+{
+  gint i;
+
+  f->transport = evd_longpolling_server_new ();
+  f->peer_manager = evd_transport_get_peer_manager (EVD_TRANSPORT (f->transport));
+
+  /* peers without a connection, so everything sent to them gets queued */
+  for (i = 0; i < 3; i++)
+    {
+      f->peers[i] = evd_transport_create_new_peer (EVD_TRANSPORT (f->transport));
+      g_assert (EVD_IS_PEER (f->peers[i]));
+    }
+}
+
+static void
+fixture_teardown (Fixture       *f,
+                  gconstpointer  data)
+{
+  gint i;
+
+  for (i = 0; i < 3; i++)
+    if (f->peers[i] != NULL)
+      evd_transport_close_peer (EVD_TRANSPORT (f->transport),
+                                f->peers[i],
+                                FALSE,
+                                NULL);
+
+  g_object_unref (f->transport);
+}
+
+static void
+test_membership (Fixture       *f,
+                 gconstpointer  data)
+{
+  GList *peers;
+  EvdPeer *peer;
+
+  g_assert (evd_peer_manager_join_group (f->peer_manager, f->peers[0], "a"));
+  g_assert (evd_peer_manager_join_group (f->peer_manager, f->peers[1], "a"));
+  g_assert (evd_peer_manager_join_group (f->peer_manager, f->peers[1], "b"));
+  g_assert (! evd_peer_manager_join_group (f->peer_manager, f->peers[0], "a"));
+
+  g_assert_cmpuint (evd_peer_manager_get_group_size (f->peer_manager, "a"), ==, 2);
+  g_assert_cmpuint (evd_peer_manager_get_group_size (f->peer_manager, "b"), ==, 1);
+  g_assert (evd_peer_manager_is_in_group (f->peer_manager, f->peers[1], "b"));
+  g_assert (! evd_peer_manager_is_in_group (f->peer_manager, f->peers[2], "a"));
+
+  peers = evd_peer_manager_get_group_peers (f->peer_manager, "b");
+  g_assert_cmpuint (g_list_length (peers), ==, 1);
+  g_assert (peers->data == f->peers[1]);
+  g_list_free (peers);
+
+  g_assert (evd_peer_manager_leave_group (f->peer_manager, f->peers[1], "b"));
+  g_assert (! evd_peer_manager_leave_group (f->peer_manager, f->peers[1], "b"));
+  g_assert_cmpuint (evd_peer_manager_get_group_size (f->peer_manager, "b"), ==, 0);
+  g_assert (evd_peer_manager_get_group_peers (f->peer_manager, "b") == NULL);
+
+  /* closing a peer takes it out of its groups */
+  peer = f->peers[0];
+  g_object_ref (peer);
+  evd_transport_close_peer (EVD_TRANSPORT (f->transport), peer, TRUE, NULL);
+  g_assert_cmpuint (evd_peer_manager_get_group_size (f->peer_manager, "a"), ==, 1);
+  g_assert (! evd_peer_manager_join_group (f->peer_manager, peer, "a"));
+  g_object_unref (peer);
+  f->peers[0] = NULL;
+}
+
+static void
+test_send (Fixture       *f,
+           gconstpointer  data)
+{
+  guint count;
+  gchar *msg;
+  gsize size;
+  EvdMessageType type;
+  gint i;
+
+  for (i = 0; i < 3; i++)
+    evd_peer_manager_join_group (f->peer_manager, f->peers[i], "room");
+
+  count = evd_peer_manager_send_to_group (f->peer_manager,
+                                          "room",
+                                          MSG,
+                                          strlen (MSG),
+                                          EVD_MESSAGE_TYPE_TEXT,
+                                          f->peers[0]);
+  g_assert_cmpuint (count, ==, 2);
+
+  g_assert_cmpuint (evd_peer_backlog_get_length (f->peers[0]), ==, 0);
+
+  for (i = 1; i < 3; i++)
+    {
+      EvdPeerStats stats;
+
+      evd_peer_get_stats (f->peers[i], &stats);
+      g_assert_cmpuint (stats.messages_sent, ==, 1);
+      g_assert_cmpuint (stats.backlog_size, ==, strlen (MSG));
+
+      msg = evd_peer_pop_message (f->peers[i], &size, &type);
+      g_assert_cmpstr (msg, ==, MSG);
+      g_assert_cmpuint (size, ==, strlen (MSG));
+      g_assert_cmpint (type, ==, EVD_MESSAGE_TYPE_TEXT);
+      g_free (msg);
+    }
+
+  count = evd_peer_manager_send_to_group (f->peer_manager,
+                                          "nobody",
+                                          MSG,
+                                          strlen (MSG),
+                                          EVD_MESSAGE_TYPE_TEXT,
+                                          NULL);
+  g_assert_cmpuint (count, ==, 0);
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+#ifndef GLIB_VERSION_2_36
+  g_type_init ();
+#endif
+
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add ("/evd/peer-manager/groups/membership",
+              Fixture,
+              NULL,
+              fixture_setup,
+              test_membership,
+              fixture_teardown);
+
+  g_test_add ("/evd/peer-manager/groups/send",
+              Fixture,
+              NULL,
+              fixture_setup,
+              test_send,
+              fixture_teardown);
+
+  return g_test_run ();
+}
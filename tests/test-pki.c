@@ -411,6 +411,93 @@ test_privkey_sign (Fixture       *f,
   g_main_loop_run (f->main_loop);
 }
 
+#define BATCH_SIZE 8
+
+static const gchar *batch_data[BATCH_SIZE];
+static gsize batch_sizes[BATCH_SIZE];
+static gchar **batch_sigs;
+static gsize *batch_sig_sizes;
+
+static void
+pubkey_on_verify_batch (GObject      *obj,
+                        GAsyncResult *result,
+                        gpointer      user_data)
+{
+  GError *error = NULL;
+  Fixture *f = user_data;
+  gboolean *verified;
+  gint i;
+
+  verified = evd_pki_pubkey_verify_data_batch_finish (EVD_PKI_PUBKEY (obj),
+                                                      result,
+                                                      &error);
+  g_assert_no_error (error);
+  g_assert (verified != NULL);
+
+  for (i = 0; i < BATCH_SIZE; i++)
+    g_assert (verified[i] == TRUE);
+
+  g_free (verified);
+  g_strfreev (batch_sigs);
+  g_free (batch_sig_sizes);
+
+  g_main_loop_quit (f->main_loop);
+}
+
+static void
+privkey_on_sign_batch (GObject      *obj,
+                       GAsyncResult *result,
+                       gpointer      user_data)
+{
+  GError *error = NULL;
+  Fixture *f = user_data;
+
+  batch_sigs = evd_pki_privkey_sign_data_batch_finish (EVD_PKI_PRIVKEY (obj),
+                                                       result,
+                                                       &batch_sig_sizes,
+                                                       &error);
+  g_assert_no_error (error);
+  g_assert (batch_sigs != NULL);
+  g_assert (g_strv_length (batch_sigs) == BATCH_SIZE);
+
+  evd_pki_pubkey_verify_data_batch (f->pubkey,
+                                    batch_data,
+                                    batch_sizes,
+                                    (const gchar * const *) batch_sigs,
+                                    batch_sig_sizes,
+                                    BATCH_SIZE,
+                                    NULL,
+                                    pubkey_on_verify_batch,
+                                    f);
+}
+
+static void
+test_privkey_sign_batch (Fixture       *f,
+                         gconstpointer  test_data)
+{
+  gint i;
+
+  load_cert_and_key (f,
+                     f->test_case->cert_filename,
+                     f->test_case->key_filename);
+
+  for (i = 0; i < BATCH_SIZE; i++)
+    {
+      batch_data[i] = msg;
+      batch_sizes[i] = strlen (msg) - i;
+    }
+
+  evd_pki_privkey_sign_data_batch (f->privkey,
+                                   batch_data,
+                                   batch_sizes,
+                                   BATCH_SIZE,
+                                   NULL,
+                                   privkey_on_sign_batch,
+                                   f);
+
+  g_main_loop_run (f->main_loop);
+}
+
 gint
 main (gint argc, gchar *argv[])
 {
@@ -462,6 +549,19 @@ main (gint argc, gchar *argv[])
                   fixture_teardown);
 
       g_free (test_name);
+
+      /* batched sign and verify */
+      test_name = g_strdup_printf ("/evd/pki/%s/sign-verify-batch",
+                                   test_cases[i].test_name);
+
+      g_test_add (test_name,
+                  Fixture,
+                  &test_cases[i],
+                  fixture_setup,
+                  test_privkey_sign_batch,
+                  fixture_teardown);
+
+      g_free (test_name);
     }
 
   /* generate RSA key-pair */
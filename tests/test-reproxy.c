@@ -0,0 +1,105 @@
+/*
+ * test-reproxy.c
+ *
+ * EventDance, Peer-to-peer IPC library <http://eventdance.org>
+ *
+ * Copyright (C) 2026, the EventDance contributors
+ */
+
+#include <glib.h>
+
+#include <evd.h>
+
+/* TEST-NET-1 (RFC 5737), connecting to it either fails right away or never
+   completes, depending on the routes available */
+#define UNREACHABLE_ADDR "192.0.2.1:80"
+
+#define CHECK_INTERVAL  50
+#define CHECK_THRESHOLD  2
+#define TEST_TIMEOUT  5000
+
+typedef struct
+{
+  EvdReproxy *reproxy;
+  EvdConnectionPool *backend;
+  GMainLoop *main_loop;
+  gboolean timed_out;
+} Fixture;
+
+static gboolean
+check_ejected (gpointer user_data)
+{
+  Fixture *f = user_data;
+
+  if (evd_reproxy_backend_is_healthy (f->reproxy, f->backend))
+    return TRUE;
+
+  g_main_loop_quit (f->main_loop);
+
+  return FALSE;
+}
+
+static gboolean
+on_timeout (gpointer user_data)
+{
+  Fixture *f = user_data;
+
+  f->timed_out = TRUE;
+  g_main_loop_quit (f->main_loop);
+
+  return FALSE;
+}
+
+static void
+test_unreachable_backend (void)
+{
+  Fixture *f;
+  guint timeout_src_id;
+
+  f = g_slice_new0 (Fixture);
+
+  f->main_loop = g_main_loop_new (NULL, FALSE);
+
+  f->reproxy = evd_reproxy_new ();
+  g_object_set (f->reproxy,
+                "health-check-interval", CHECK_INTERVAL,
+                "health-check-threshold", CHECK_THRESHOLD,
+                NULL);
+
+  f->backend = evd_reproxy_add_backend (f->reproxy, UNREACHABLE_ADDR);
+  g_assert (EVD_IS_CONNECTION_POOL (f->backend));
+  g_assert (evd_reproxy_backend_is_healthy (f->reproxy, f->backend));
+
+  /* probes that never complete must count as failures too, so the backend
+     gets ejected after a few check rounds */
+  g_timeout_add (CHECK_INTERVAL / 2, check_ejected, f);
+  timeout_src_id = g_timeout_add (TEST_TIMEOUT, on_timeout, f);
+
+  g_main_loop_run (f->main_loop);
+
+  g_assert (! f->timed_out);
+  g_assert (! evd_reproxy_backend_is_healthy (f->reproxy, f->backend));
+
+  g_source_remove (timeout_src_id);
+
+  evd_reproxy_remove_backend (f->reproxy, f->backend);
+  g_object_unref (f->reproxy);
+  g_main_loop_unref (f->main_loop);
+
+  g_slice_free (Fixture, f);
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+#ifndef GLIB_VERSION_2_36
+  g_type_init ();
+#endif
+
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/evd/reproxy/health-check/unreachable-backend",
+                   test_unreachable_backend);
+
+  return g_test_run ();
+}
@@ -25,6 +25,7 @@
 #define RESOLVE_CANCEL         "localhost:80"
 #define NONEXISTANT_1          "127.0.0.0.1"
 #define NONEXISTANT_2          "nonexistentdomain"
+#define CACHE_HOST             "cache-test.localhost"
 
 typedef struct
 {
@@ -274,7 +275,6 @@ resolve_good_localhost (Fixture       *f,
 
 /* cancel */
 
-/*
 static void
 resolve_cancel_on_resolve (GObject      *obj,
                            GAsyncResult *res,
@@ -298,13 +298,168 @@ resolve_cancel_on_resolve (GObject      *obj,
 
   g_main_loop_quit (f->main_loop);
 }
-*/
 
 static void
 resolve_cancel (Fixture       *f,
                 gconstpointer  test_data)
 {
-  /* @TODO: completes this test once EvdResolver supports cancelling */
+  GCancellable *cancellable;
+
+  cancellable = g_cancellable_new ();
+
+  evd_resolver_resolve (f->resolver,
+                        RESOLVE_CANCEL,
+                        cancellable,
+                        resolve_cancel_on_resolve,
+                        f);
+  g_cancellable_cancel (cancellable);
+
+  g_main_loop_run (f->main_loop);
+
+  g_object_unref (cancellable);
+}
+
+/* cache */
+
+static gint cache_pending = 0;
+static guint16 cache_port = 0;
+
+/* a GResolver that answers every name with the loopback address, counting
+   how many lookups reach it */
+
+typedef GResolver      CountingResolver;
+typedef GResolverClass CountingResolverClass;
+
+G_DEFINE_TYPE (CountingResolver, counting_resolver, G_TYPE_RESOLVER)
+
+static guint counting_resolver_lookups = 0;
+
+static void
+counting_resolver_lookup_by_name_async (GResolver           *resolver,
+                                        const gchar         *hostname,
+                                        GCancellable        *cancellable,
+                                        GAsyncReadyCallback  callback,
+                                        gpointer             user_data)
+{
+  GSimpleAsyncResult *res;
+
+  counting_resolver_lookups++;
+
+  res = g_simple_async_result_new (G_OBJECT (resolver),
+                                   callback,
+                                   user_data,
+                                   counting_resolver_lookup_by_name_async);
+  g_simple_async_result_complete_in_idle (res);
+  g_object_unref (res);
+}
+
+static GList *
+counting_resolver_lookup_by_name_finish (GResolver     *resolver,
+                                         GAsyncResult  *result,
+                                         GError       **error)
+{
+  return g_list_append (NULL,
+                        g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4));
+}
+
+static void
+counting_resolver_class_init (CountingResolverClass *class)
+{
+  class->lookup_by_name_async = counting_resolver_lookup_by_name_async;
+  class->lookup_by_name_finish = counting_resolver_lookup_by_name_finish;
+}
+
+static void
+counting_resolver_init (CountingResolver *self)
+{
+}
+
+static void
+resolve_cache_on_resolve (GObject      *obj,
+                          GAsyncResult *res,
+                          gpointer      user_data)
+{
+  Fixture *f = (Fixture *) user_data;
+  GError *error = NULL;
+  GList *addresses;
+  GList *node;
+
+  addresses = evd_resolver_resolve_finish (EVD_RESOLVER (obj), res, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (g_list_length (addresses), >=, 1);
+
+  for (node = addresses; node != NULL; node = node->next)
+    g_assert_cmpint (g_inet_socket_address_get_port (G_INET_SOCKET_ADDRESS (node->data)),
+                     ==,
+                     cache_port);
+
+  evd_resolver_free_addresses (addresses);
+
+  cache_pending--;
+  if (cache_pending == 0)
+    g_main_loop_quit (f->main_loop);
+}
+
+static void
+resolve_cache (Fixture       *f,
+               gconstpointer  test_data)
+{
+  EvdResolver *resolver;
+  GResolver *system_resolver;
+  GResolver *counting_resolver;
+
+  system_resolver = g_resolver_get_default ();
+  counting_resolver = g_object_new (counting_resolver_get_type (), NULL);
+  g_resolver_set_default (counting_resolver);
+
+  /* a resolver of its own and a name no other test uses, so that no
+     lookup left pending by a previous test is joined */
+  resolver = g_object_new (EVD_TYPE_RESOLVER, NULL);
+  counting_resolver_lookups = 0;
+
+  /* two concurrent requests share the same lookup */
+  cache_pending = 2;
+  cache_port = 80;
+  evd_resolver_resolve (resolver,
+                        CACHE_HOST ":80",
+                        NULL,
+                        resolve_cache_on_resolve,
+                        f);
+  evd_resolver_resolve (resolver,
+                        CACHE_HOST ":80",
+                        NULL,
+                        resolve_cache_on_resolve,
+                        f);
+  g_main_loop_run (f->main_loop);
+  g_assert_cmpuint (counting_resolver_lookups, ==, 1);
+
+  /* and a later one is served from cache, on its own port */
+  cache_pending = 1;
+  cache_port = 81;
+  evd_resolver_resolve (resolver,
+                        "CACHE-TEST.LOCALHOST:81",
+                        NULL,
+                        resolve_cache_on_resolve,
+                        f);
+  g_main_loop_run (f->main_loop);
+  g_assert_cmpuint (counting_resolver_lookups, ==, 1);
+
+  /* until the cache is cleared */
+  evd_resolver_clear_cache (resolver);
+  cache_pending = 1;
+  cache_port = 80;
+  evd_resolver_resolve (resolver,
+                        CACHE_HOST ":80",
+                        NULL,
+                        resolve_cache_on_resolve,
+                        f);
+  g_main_loop_run (f->main_loop);
+  g_assert_cmpuint (counting_resolver_lookups, ==, 2);
+
+  g_object_unref (resolver);
+  g_resolver_set_default (system_resolver);
+  g_object_unref (system_resolver);
+  g_object_unref (counting_resolver);
 }
 
 /* error */
@@ -407,6 +562,13 @@ main (gint argc, gchar **argv)
               resolve_cancel,
               fixture_teardown);
 
+  g_test_add ("/evd/resolver/cache",
+              Fixture,
+              NULL,
+              fixture_setup,
+              resolve_cache,
+              fixture_teardown);
+
   if (g_test_slow ())
     g_test_add ("/evd/resolver/error",
                 Fixture,
@@ -0,0 +1,366 @@
+/*
+ * test-stats.c
+ *
+ * EventDance, Peer-to-peer IPC library <http://eventdance.org>
+ *
+ * Copyright (C) 2026, the EventDance contributors
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include <evd.h>
+
+#define LISTEN_ADDR "127.0.0.1:%d"
+#define MSG         "Hello stats!"
+
+/* connection */
+
+typedef struct
+{
+  GMainLoop *main_loop;
+
+  EvdSocket *listener;
+  EvdSocket *client;
+  gchar *addr;
+
+  GIOStream *client_conn;
+  GIOStream *server_conn;
+
+  gchar buf[64];
+  gsize total_read;
+} ConnFixture;
+
+static void
+conn_fixture_setup (ConnFixture   *f,
+                    gconstpointer  test_data)
+{
+  f->main_loop = g_main_loop_new (NULL, FALSE);
+
+  f->listener = evd_socket_new ();
+  f->client = evd_socket_new ();
+  f->addr = g_strdup_printf (LISTEN_ADDR, g_random_int_range (1025, 65535));
+
+  f->client_conn = NULL;
+  f->server_conn = NULL;
+  f->total_read = 0;
+}
+
+static void
+conn_fixture_teardown (ConnFixture   *f,
+                       gconstpointer  test_data)
+{
+  if (f->client_conn != NULL)
+    g_object_unref (f->client_conn);
+  if (f->server_conn != NULL)
+    g_object_unref (f->server_conn);
+
+  evd_socket_close (f->listener, NULL);
+  g_object_unref (f->listener);
+  g_object_unref (f->client);
+
+  g_free (f->addr);
+  g_main_loop_unref (f->main_loop);
+}
+
+static void
+conn_on_read (GObject      *obj,
+              GAsyncResult *res,
+              gpointer      user_data)
+{
+  ConnFixture *f = user_data;
+  GError *error = NULL;
+  gssize size;
+
+  size = g_input_stream_read_finish (G_INPUT_STREAM (obj), res, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (size, >, 0);
+
+  f->total_read += size;
+
+  if (f->total_read < strlen (MSG))
+    g_input_stream_read_async (G_INPUT_STREAM (obj),
+                               f->buf + f->total_read,
+                               sizeof (f->buf) - f->total_read,
+                               G_PRIORITY_DEFAULT,
+                               NULL,
+                               conn_on_read,
+                               f);
+  else
+    g_main_loop_quit (f->main_loop);
+}
+
+static void
+conn_on_new_connection (EvdSocket *listener,
+                        GIOStream *conn,
+                        gpointer   user_data)
+{
+  ConnFixture *f = user_data;
+
+  g_assert (EVD_IS_CONNECTION (conn));
+  f->server_conn = g_object_ref (conn);
+
+  g_input_stream_read_async (g_io_stream_get_input_stream (conn),
+                             f->buf,
+                             sizeof (f->buf),
+                             G_PRIORITY_DEFAULT,
+                             NULL,
+                             conn_on_read,
+                             f);
+}
+
+static void
+conn_on_connect (GObject      *obj,
+                 GAsyncResult *res,
+                 gpointer      user_data)
+{
+  ConnFixture *f = user_data;
+  GError *error = NULL;
+  gssize size;
+
+  f->client_conn = evd_socket_connect_finish (EVD_SOCKET (obj), res, &error);
+  g_assert_no_error (error);
+  g_assert (EVD_IS_CONNECTION (f->client_conn));
+
+  size = g_output_stream_write (g_io_stream_get_output_stream (f->client_conn),
+                                MSG,
+                                strlen (MSG),
+                                NULL,
+                                &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (size, ==, strlen (MSG));
+}
+
+static void
+conn_on_listen (GObject      *obj,
+                GAsyncResult *res,
+                gpointer      user_data)
+{
+  ConnFixture *f = user_data;
+  GError *error = NULL;
+
+  g_assert (evd_socket_listen_finish (EVD_SOCKET (obj), res, &error));
+  g_assert_no_error (error);
+
+  evd_socket_connect_to (f->client, f->addr, NULL, conn_on_connect, f);
+}
+
+static void
+test_connection (ConnFixture   *f,
+                 gconstpointer  test_data)
+{
+  EvdConnectionStats stats;
+
+  g_signal_connect (f->listener,
+                    "new-connection",
+                    G_CALLBACK (conn_on_new_connection),
+                    f);
+  evd_socket_listen (f->listener, f->addr, NULL, conn_on_listen, f);
+
+  g_main_loop_run (f->main_loop);
+
+  g_assert_cmpuint (f->total_read, ==, strlen (MSG));
+  g_assert (memcmp (f->buf, MSG, strlen (MSG)) == 0);
+
+  evd_connection_get_stats (EVD_CONNECTION (f->client_conn), &stats);
+  g_assert_cmpuint (stats.bytes_written, ==, strlen (MSG));
+  g_assert_cmpuint (stats.bytes_read, ==, 0);
+  g_assert_cmpuint (stats.write_queue, ==, 0);
+  g_assert_cmpint (stats.last_activity, >, 0);
+  g_assert_cmpint (stats.tls_handshake_time, ==, -1);
+
+  evd_connection_get_stats (EVD_CONNECTION (f->server_conn), &stats);
+  g_assert_cmpuint (stats.bytes_read, ==, strlen (MSG));
+  g_assert_cmpuint (stats.bytes_written, ==, 0);
+  g_assert_cmpint (stats.last_activity, >, 0);
+  g_assert_cmpint (stats.tls_handshake_time, ==, -1);
+}
+
+/* peers */
+
+typedef struct
+{
+  EvdLongpollingServer *transport;
+  EvdPeerManager *peer_manager;
+  EvdPeer *peers[3];
+
+  guint calls;
+  guint closed;
+} PeerFixture;
+
+static void
+peer_fixture_on_peer_closed (EvdPeerManager *peer_manager,
+                             EvdPeer        *peer,
+                             gboolean        gracefully,
+                             gpointer        user_data)
+{
+  PeerFixture *f = user_data;
+
+  f->closed++;
+}
+
+static void
+peer_fixture_setup (PeerFixture   *f,
+                    gconstpointer  test_data)
+{
+  gint i;
+
+  f->transport = evd_longpolling_server_new ();
+  f->peer_manager = evd_transport_get_peer_manager (EVD_TRANSPORT (f->transport));
+
+  /* peers without a connection, so everything sent to them gets queued */
+  for (i = 0; i < 3; i++)
+    f->peers[i] = evd_transport_create_new_peer (EVD_TRANSPORT (f->transport));
+
+  f->calls = 0;
+  f->closed = 0;
+
+  g_signal_connect (f->peer_manager,
+                    "peer-closed",
+                    G_CALLBACK (peer_fixture_on_peer_closed),
+                    f);
+}
+
+static void
+peer_fixture_teardown (PeerFixture   *f,
+                       gconstpointer  test_data)
+{
+  gint i;
+
+  g_signal_handlers_disconnect_by_func (f->peer_manager,
+                                        peer_fixture_on_peer_closed,
+                                        f);
+
+  for (i = 0; i < 3; i++)
+    if (! evd_peer_is_closed (f->peers[i]))
+      evd_transport_close_peer (EVD_TRANSPORT (f->transport),
+                                f->peers[i],
+                                FALSE,
+                                NULL);
+
+  g_object_unref (f->transport);
+}
+
+static void
+test_peer (PeerFixture   *f,
+           gconstpointer  test_data)
+{
+  EvdPeer *peer = f->peers[0];
+  EvdPeerStats stats;
+  GError *error = NULL;
+
+  evd_peer_get_stats (peer, &stats);
+  g_assert_cmpuint (stats.messages_sent, ==, 0);
+  g_assert_cmpuint (stats.messages_received, ==, 0);
+  g_assert_cmpuint (stats.backlog_length, ==, 0);
+
+  g_assert (evd_transport_send_text (EVD_TRANSPORT (f->transport),
+                                     peer,
+                                     MSG,
+                                     &error));
+  g_assert_no_error (error);
+  g_assert (evd_transport_send (EVD_TRANSPORT (f->transport),
+                                peer,
+                                MSG,
+                                4,
+                                &error));
+  g_assert_no_error (error);
+
+  evd_peer_get_stats (peer, &stats);
+  g_assert_cmpuint (stats.messages_sent, ==, 2);
+  g_assert_cmpuint (stats.bytes_sent, ==, strlen (MSG) + 4);
+  g_assert_cmpuint (stats.backlog_length, ==, 2);
+  g_assert_cmpuint (stats.backlog_size, >=, strlen (MSG) + 4);
+  g_assert_cmpuint (stats.backlog_high_water, ==, 2);
+
+  /* what transports account for each incoming message */
+  evd_peer_count_message (peer, strlen (MSG), TRUE);
+
+  evd_peer_get_stats (peer, &stats);
+  g_assert_cmpuint (stats.messages_received, ==, 1);
+  g_assert_cmpuint (stats.bytes_received, ==, strlen (MSG));
+  g_assert_cmpint (stats.last_activity, >, 0);
+
+  /* the other peers are not affected */
+  evd_peer_get_stats (f->peers[1], &stats);
+  g_assert_cmpuint (stats.messages_sent, ==, 0);
+  g_assert_cmpuint (stats.backlog_length, ==, 0);
+}
+
+static gboolean
+foreach_stats_func (EvdPeer      *peer,
+                    EvdPeerStats *stats,
+                    gpointer      user_data)
+{
+  PeerFixture *f = user_data;
+
+  g_assert (! evd_peer_is_closed (peer));
+  f->calls++;
+
+  /* closing another peer from within the callback is safe, and that
+     peer is not visited afterwards */
+  if (peer != f->peers[2] && ! evd_peer_is_closed (f->peers[2]))
+    evd_peer_manager_close_peer (f->peer_manager, f->peers[2], FALSE);
+
+  return stats->messages_sent > 0;
+}
+
+static void
+test_foreach (PeerFixture   *f,
+              gconstpointer  test_data)
+{
+  GList *peers;
+
+  g_assert (evd_transport_send_text (EVD_TRANSPORT (f->transport),
+                                     f->peers[0],
+                                     MSG,
+                                     NULL));
+
+  evd_peer_manager_foreach_stats (f->peer_manager, foreach_stats_func, f);
+
+  g_assert_cmpuint (f->calls, >=, 1);
+  g_assert_cmpuint (f->calls, <=, 3);
+  g_assert_cmpuint (f->closed, ==, 2);
+
+  g_assert (evd_peer_is_closed (f->peers[0]));
+  g_assert (! evd_peer_is_closed (f->peers[1]));
+  g_assert (evd_peer_is_closed (f->peers[2]));
+
+  peers = evd_peer_manager_get_all_peers (f->peer_manager);
+  g_assert_cmpuint (g_list_length (peers), ==, 1);
+  g_assert (peers->data == f->peers[1]);
+  g_list_free (peers);
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+#ifndef GLIB_VERSION_2_36
+  g_type_init ();
+#endif
+
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add ("/evd/stats/connection",
+              ConnFixture,
+              NULL,
+              conn_fixture_setup,
+              test_connection,
+              conn_fixture_teardown);
+
+  g_test_add ("/evd/stats/peer",
+              PeerFixture,
+              NULL,
+              peer_fixture_setup,
+              test_peer,
+              peer_fixture_teardown);
+
+  g_test_add ("/evd/stats/foreach",
+              PeerFixture,
+              NULL,
+              peer_fixture_setup,
+              test_foreach,
+              peer_fixture_teardown);
+
+  return g_test_run ();
+}
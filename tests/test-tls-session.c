@@ -0,0 +1,450 @@
+/*
+ * test-tls-session.c
+ *
+ * EventDance, Peer-to-peer IPC library <http://eventdance.org>
+ *
+ * Copyright (C) 2026, the EventDance contributors
+ */
+
+#include <string.h>
+
+#include <evd.h>
+
+/* resumption by session ID does not exist in TLS 1.3, so pin TLS 1.2 to
+   exercise both the session cache and the tickets */
+#define PRIORITY "NORMAL:-VERS-TLS-ALL:+VERS-TLS1.2"
+
+#define MAX_HANDSHAKE_STEPS 16
+
+typedef struct
+{
+  GByteArray *data;
+
+  /* caps the size of each pull, 0 for no cap */
+  gsize max_pull;
+
+  /* whether every push must carry whole TLS records */
+  gboolean check_records;
+} Pipe;
+
+typedef struct
+{
+  GMainLoop *main_loop;
+
+  EvdTlsCredentials *server_cred;
+  EvdTlsCredentials *client_cred;
+
+  EvdTlsSession *client;
+  EvdTlsSession *server;
+
+  Pipe to_client;
+  Pipe to_server;
+} Fixture;
+
+/* an in-memory transport: each session pushes into the other's buffer, and
+   an empty buffer is reported as would-block */
+static gssize
+pipe_pull (EvdTlsSession  *session,
+           gchar          *buf,
+           gsize           size,
+           gpointer        user_data,
+           GError        **error)
+{
+  Pipe *input = user_data;
+
+  if (input->data->len == 0)
+    return -1;
+
+  size = MIN (size, input->data->len);
+  if (input->max_pull > 0)
+    size = MIN (size, input->max_pull);
+
+  memcpy (buf, input->data->data, size);
+  g_byte_array_remove_range (input->data, 0, size);
+
+  return size;
+}
+
+static void
+assert_whole_records (const guint8 *buf, gsize size)
+{
+  gsize offset = 0;
+
+  while (offset < size)
+    {
+      g_assert_cmpuint (size - offset, >=, 5);
+      offset += 5 + ((buf[offset + 3] << 8) | buf[offset + 4]);
+    }
+
+  g_assert_cmpuint (offset, ==, size);
+}
+
+static gssize
+pipe_push (EvdTlsSession  *session,
+           const gchar    *buf,
+           gsize           size,
+           gpointer        user_data,
+           GError        **error)
+{
+  Pipe *output = user_data;
+
+  if (output->check_records)
+    assert_whole_records ((const guint8 *) buf, size);
+
+  g_byte_array_append (output->data, (const guint8 *) buf, size);
+
+  return size;
+}
+
+static void
+on_certificate_added (GObject      *obj,
+                      GAsyncResult *res,
+                      gpointer      user_data)
+{
+  Fixture *f = user_data;
+  GError *error = NULL;
+
+  g_assert (evd_tls_credentials_add_certificate_from_file_finish (
+                                                  EVD_TLS_CREDENTIALS (obj),
+                                                  res,
+                                                  &error));
+  g_assert_no_error (error);
+
+  g_main_loop_quit (f->main_loop);
+}
+
+static void
+fixture_setup (Fixture       *f,
+               gconstpointer  test_data)
+{
+  GError *error = NULL;
+
+  f->main_loop = g_main_loop_new (NULL, FALSE);
+
+  f->server_cred = evd_tls_credentials_new ();
+  evd_tls_credentials_add_certificate_from_file (f->server_cred,
+                                         TESTS_DIR "certs/x509-server.pem",
+                                         TESTS_DIR "certs/x509-server-key.pem",
+                                                 NULL,
+                                                 on_certificate_added,
+                                                 f);
+  g_main_loop_run (f->main_loop);
+
+  g_assert (evd_tls_credentials_prepare (f->server_cred, &error));
+  g_assert_no_error (error);
+  g_assert (evd_tls_credentials_ready (f->server_cred));
+
+  f->client_cred = evd_tls_credentials_new ();
+  g_assert (evd_tls_credentials_prepare (f->client_cred, &error));
+  g_assert_no_error (error);
+
+  f->to_client.data = g_byte_array_new ();
+  f->to_server.data = g_byte_array_new ();
+}
+
+static void
+fixture_free_sessions (Fixture *f)
+{
+  if (f->client != NULL)
+    g_object_unref (f->client);
+  f->client = NULL;
+
+  if (f->server != NULL)
+    g_object_unref (f->server);
+  f->server = NULL;
+
+  g_byte_array_set_size (f->to_client.data, 0);
+  g_byte_array_set_size (f->to_server.data, 0);
+}
+
+static void
+fixture_teardown (Fixture       *f,
+                  gconstpointer  test_data)
+{
+  fixture_free_sessions (f);
+
+  g_byte_array_unref (f->to_client.data);
+  g_byte_array_unref (f->to_server.data);
+
+  g_object_unref (f->client_cred);
+  g_object_unref (f->server_cred);
+
+  g_main_loop_unref (f->main_loop);
+}
+
+static EvdTlsSession *
+new_session (EvdTlsMode          mode,
+             EvdTlsCredentials  *cred,
+             Pipe               *input,
+             Pipe               *output)
+{
+  EvdTlsSession *session;
+
+  session = g_object_new (EVD_TYPE_TLS_SESSION,
+                          "mode", mode,
+                          "priority", PRIORITY,
+                          "credentials", cred,
+                          NULL);
+
+  evd_tls_session_set_transport_pull_func (session, pipe_pull, input, NULL);
+  evd_tls_session_set_transport_push_func (session, pipe_push, output, NULL);
+
+  return session;
+}
+
+static void
+new_sessions (Fixture *f)
+{
+  fixture_free_sessions (f);
+
+  f->client = new_session (EVD_TLS_MODE_CLIENT,
+                           f->client_cred,
+                           &f->to_client,
+                           &f->to_server);
+  f->server = new_session (EVD_TLS_MODE_SERVER,
+                           f->server_cred,
+                           &f->to_server,
+                           &f->to_client);
+}
+
+static void
+handshake (Fixture *f)
+{
+  GError *error = NULL;
+  gint client_result = 0;
+  gint server_result = 0;
+  guint i;
+
+  for (i = 0; i < MAX_HANDSHAKE_STEPS; i++)
+    {
+      if (client_result == 0)
+        client_result = evd_tls_session_handshake (f->client, &error);
+      g_assert_no_error (error);
+      g_assert_cmpint (client_result, >=, 0);
+
+      if (server_result == 0)
+        server_result = evd_tls_session_handshake (f->server, &error);
+      g_assert_no_error (error);
+      g_assert_cmpint (server_result, >=, 0);
+
+      if (client_result == 1 && server_result == 1)
+        break;
+    }
+
+  g_assert_cmpint (client_result, ==, 1);
+  g_assert_cmpint (server_result, ==, 1);
+}
+
+static void
+assert_resumes (Fixture *f)
+{
+  GError *error = NULL;
+  gchar *data;
+  gsize size;
+
+  new_sessions (f);
+  handshake (f);
+
+  g_assert (! evd_tls_session_is_resumed (f->client));
+  g_assert (! evd_tls_session_is_resumed (f->server));
+
+  data = evd_tls_session_get_resume_data (f->client, &size, &error);
+  g_assert_no_error (error);
+  g_assert (data != NULL);
+  g_assert_cmpuint (size, >, 0);
+
+  new_sessions (f);
+  evd_tls_session_set_resume_data (f->client, data, size);
+  handshake (f);
+
+  g_assert (evd_tls_session_is_resumed (f->client));
+  g_assert (evd_tls_session_is_resumed (f->server));
+
+  g_free (data);
+}
+
+static void
+test_resume_session_id (Fixture       *f,
+                        gconstpointer  test_data)
+{
+  g_object_set (f->server_cred,
+                "session-cache-size", 64,
+                "session-tickets", FALSE,
+                NULL);
+
+  assert_resumes (f);
+}
+
+static void
+test_resume_ticket (Fixture       *f,
+                    gconstpointer  test_data)
+{
+  /* with the cache disabled, only the ticket can resume the session */
+  g_object_set (f->server_cred,
+                "session-cache-size", 0,
+                "session-tickets", TRUE,
+                NULL);
+
+  assert_resumes (f);
+}
+
+static void
+test_resume_disabled (Fixture       *f,
+                      gconstpointer  test_data)
+{
+  GError *error = NULL;
+  gchar *data;
+  gsize size;
+
+  new_sessions (f);
+  handshake (f);
+
+  data = evd_tls_session_get_resume_data (f->client, &size, &error);
+  g_assert_no_error (error);
+
+  /* a full handshake happens transparently */
+  new_sessions (f);
+  evd_tls_session_set_resume_data (f->client, data, size);
+  handshake (f);
+
+  g_assert (! evd_tls_session_is_resumed (f->client));
+  g_assert (! evd_tls_session_is_resumed (f->server));
+
+  g_free (data);
+}
+
+static void
+transfer (EvdTlsSession *from,
+          EvdTlsSession *to,
+          Pipe          *pipe,
+          gsize          size)
+{
+  GError *error = NULL;
+  gchar *msg;
+  gchar *buf;
+  gsize sent = 0;
+  gsize received = 0;
+  gssize n;
+  gsize i;
+
+  msg = g_malloc (size);
+  for (i = 0; i < size; i++)
+    msg[i] = (gchar) (i * 31);
+
+  /* records carry at most 16KB, so large messages take several writes */
+  while (sent < size)
+    {
+      n = evd_tls_session_write (from, msg + sent, size - sent, &error);
+      g_assert_no_error (error);
+      g_assert_cmpint (n, >, 0);
+
+      sent += n;
+    }
+
+  buf = g_malloc (size);
+  while (received < size)
+    {
+      n = evd_tls_session_read (to, buf + received, size - received, &error);
+      g_assert_no_error (error);
+      g_assert_cmpint (n, >=, 0);
+
+      /* a would-block with nothing left in the transport means records
+         were lost */
+      if (n == 0)
+        g_assert_cmpuint (pipe->data->len, >, 0);
+
+      received += n;
+    }
+
+  g_assert (memcmp (msg, buf, size) == 0);
+  g_assert_cmpuint (pipe->data->len, ==, 0);
+
+  /* once drained, a read is a would-block and not an error */
+  n = evd_tls_session_read (to, buf, size, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (n, ==, 0);
+
+  g_free (buf);
+  g_free (msg);
+}
+
+static void
+test_round_trip (Fixture       *f,
+                 gconstpointer  test_data)
+{
+  /* from a single byte to several records, over the size the vectored
+     push gathers on the stack */
+  const gsize sizes[] = { 1, 1000, 16384, 16384 * 2 + 2048 + 7 };
+  guint i;
+
+  new_sessions (f);
+  handshake (f);
+
+  f->to_client.check_records = TRUE;
+  f->to_server.check_records = TRUE;
+
+  f->to_client.max_pull = GPOINTER_TO_SIZE (test_data);
+  f->to_server.max_pull = GPOINTER_TO_SIZE (test_data);
+
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++)
+    {
+      transfer (f->client, f->server, &f->to_server, sizes[i]);
+      transfer (f->server, f->client, &f->to_client, sizes[i]);
+    }
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+  gint result;
+
+#ifndef GLIB_VERSION_2_36
+  g_type_init ();
+#endif
+
+  evd_tls_init (NULL);
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add ("/evd/tls/session/resume/session-id",
+              Fixture,
+              NULL,
+              fixture_setup,
+              test_resume_session_id,
+              fixture_teardown);
+
+  g_test_add ("/evd/tls/session/resume/ticket",
+              Fixture,
+              NULL,
+              fixture_setup,
+              test_resume_ticket,
+              fixture_teardown);
+
+  g_test_add ("/evd/tls/session/resume/disabled",
+              Fixture,
+              NULL,
+              fixture_setup,
+              test_resume_disabled,
+              fixture_teardown);
+
+  g_test_add ("/evd/tls/session/round-trip",
+              Fixture,
+              GSIZE_TO_POINTER (0),
+              fixture_setup,
+              test_round_trip,
+              fixture_teardown);
+
+  /* the transport hands out a few bytes per pull, so records arrive in
+     pieces across several reads */
+  g_test_add ("/evd/tls/session/round-trip/fragmented",
+              Fixture,
+              GSIZE_TO_POINTER (7),
+              fixture_setup,
+              test_round_trip,
+              fixture_teardown);
+
+  result = g_test_run ();
+
+  evd_tls_deinit ();
+
+  return result;
+}
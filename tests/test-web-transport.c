@@ -0,0 +1,839 @@
+/*
+ * test-web-transport.c
+ *
+ * EventDance, Peer-to-peer IPC library <http://eventdance.org>
+ *
+ * Copyright (C) 2026, the EventDance contributors
+ */
+
+#include <string.h>
+#include <json-glib/json-glib.h>
+
+#include <evd.h>
+
+#define LISTEN_ADDR "127.0.0.1:%d"
+#define BASE_URL    "http://127.0.0.1:%d/transport/"
+
+#define ACK_HEADER_NAME   "X-Org-EventDance-WebTransport-Ack"
+#define TOKEN_HEADER_NAME "X-Org-EventDance-WebTransport-Resume-Token"
+
+#define RESUME_WINDOW 16
+
+typedef struct
+{
+  GMainLoop *main_loop;
+
+  EvdWebTransportServer *transport;
+  gchar *addr;
+  gchar *base_url;
+
+  guint validate_result;
+  guint validate_count;
+  guint new_peer_count;
+  guint peer_closed_count;
+  EvdPeer *peer;
+
+  /* the request in flight, and the response to it */
+  EvdHttpRequest *request;
+  const gchar *body;
+  gsize body_len;
+  EvdHttpConnection *conn;
+  guint status;
+  gchar *content;
+  gssize content_len;
+} Fixture;
+
+static guint
+on_validate_peer (EvdTransport *transport,
+                  EvdPeer      *peer,
+                  gpointer      user_data)
+{
+  Fixture *f = user_data;
+
+  f->validate_count++;
+
+  return f->validate_result;
+}
+
+static void
+on_new_peer (EvdTransport *transport,
+             EvdPeer      *peer,
+             gpointer      user_data)
+{
+  Fixture *f = user_data;
+
+  f->new_peer_count++;
+
+  if (f->peer != NULL)
+    g_object_unref (f->peer);
+  f->peer = g_object_ref (peer);
+}
+
+static void
+on_peer_closed (EvdTransport *transport,
+                EvdPeer      *peer,
+                gboolean      gracefully,
+                gpointer      user_data)
+{
+  Fixture *f = user_data;
+
+  f->peer_closed_count++;
+}
+
+static void
+on_transport_open (GObject      *obj,
+                   GAsyncResult *res,
+                   gpointer      user_data)
+{
+  Fixture *f = user_data;
+  GError *error = NULL;
+
+  g_assert (evd_transport_open_finish (EVD_TRANSPORT (obj), res, &error));
+  g_assert_no_error (error);
+
+  g_main_loop_quit (f->main_loop);
+}
+
+static void
+fixture_setup (Fixture       *f,
+               gconstpointer  test_data)
+{
+  guint port;
+
+  f->main_loop = g_main_loop_new (NULL, FALSE);
+
+  port = g_random_int_range (1025, 65535);
+  f->addr = g_strdup_printf (LISTEN_ADDR, port);
+  f->base_url = g_strdup_printf (BASE_URL, port);
+
+  f->transport = evd_web_transport_server_new (NULL);
+  evd_web_transport_server_set_enable_websocket (f->transport, FALSE);
+
+  f->validate_result = EVD_VALIDATE_ACCEPT;
+  f->validate_count = 0;
+  f->new_peer_count = 0;
+  f->peer_closed_count = 0;
+  f->peer = NULL;
+
+  f->content = NULL;
+
+  g_signal_connect (f->transport,
+                    "validate-peer",
+                    G_CALLBACK (on_validate_peer),
+                    f);
+  g_signal_connect (f->transport,
+                    "new-peer",
+                    G_CALLBACK (on_new_peer),
+                    f);
+  g_signal_connect (f->transport,
+                    "peer-closed",
+                    G_CALLBACK (on_peer_closed),
+                    f);
+
+  evd_transport_open (EVD_TRANSPORT (f->transport),
+                      f->addr,
+                      NULL,
+                      on_transport_open,
+                      f);
+  g_main_loop_run (f->main_loop);
+}
+
+static void
+fixture_teardown (Fixture       *f,
+                  gconstpointer  test_data)
+{
+  g_signal_handlers_disconnect_by_func (f->transport, on_validate_peer, f);
+  g_signal_handlers_disconnect_by_func (f->transport, on_new_peer, f);
+  g_signal_handlers_disconnect_by_func (f->transport, on_peer_closed, f);
+
+  if (f->peer != NULL)
+    {
+      if (! evd_peer_is_closed (f->peer))
+        evd_transport_close_peer (EVD_TRANSPORT (f->transport),
+                                  f->peer,
+                                  FALSE,
+                                  NULL);
+      g_object_unref (f->peer);
+    }
+
+  g_object_unref (f->transport);
+
+  g_free (f->content);
+  g_free (f->base_url);
+  g_free (f->addr);
+  g_main_loop_unref (f->main_loop);
+}
+
+/* a tiny HTTP client, enough to play the role of evdWebTransport.js */
+
+static void
+on_content (GObject      *obj,
+            GAsyncResult *res,
+            gpointer      user_data)
+{
+  Fixture *f = user_data;
+  GError *error = NULL;
+
+  f->content = evd_http_connection_read_all_content_finish (f->conn,
+                                                            res,
+                                                            &f->content_len,
+                                                            &error);
+  g_assert_no_error (error);
+
+  g_io_stream_close (G_IO_STREAM (f->conn), NULL, NULL);
+  g_object_unref (f->conn);
+  f->conn = NULL;
+
+  g_main_loop_quit (f->main_loop);
+}
+
+static void
+on_response_headers (GObject      *obj,
+                     GAsyncResult *res,
+                     gpointer      user_data)
+{
+  Fixture *f = user_data;
+  SoupMessageHeaders *headers;
+  GError *error = NULL;
+
+  headers = evd_http_connection_read_response_headers_finish (f->conn,
+                                                              res,
+                                                              NULL,
+                                                              &f->status,
+                                                              NULL,
+                                                              &error);
+  g_assert_no_error (error);
+  g_assert (headers != NULL);
+  soup_message_headers_free (headers);
+
+  evd_http_connection_read_all_content (f->conn, NULL, on_content, f);
+}
+
+static void
+on_request_sent (GObject      *obj,
+                 GAsyncResult *res,
+                 gpointer      user_data)
+{
+  Fixture *f = user_data;
+  GError *error = NULL;
+
+  g_assert (evd_http_connection_write_request_headers_finish (f->conn,
+                                                              res,
+                                                              &error));
+  g_assert_no_error (error);
+
+  if (f->body_len > 0)
+    {
+      gssize size;
+
+      size = g_output_stream_write (g_io_stream_get_output_stream (G_IO_STREAM (f->conn)),
+                                    f->body,
+                                    f->body_len,
+                                    NULL,
+                                    &error);
+      g_assert_no_error (error);
+      g_assert_cmpint (size, ==, f->body_len);
+    }
+
+  evd_http_connection_read_response_headers (f->conn,
+                                             NULL,
+                                             on_response_headers,
+                                             f);
+}
+
+static void
+on_connect (GObject      *obj,
+            GAsyncResult *res,
+            gpointer      user_data)
+{
+  Fixture *f = user_data;
+  GError *error = NULL;
+
+  f->conn = EVD_HTTP_CONNECTION (evd_socket_connect_finish (EVD_SOCKET (obj),
+                                                            res,
+                                                            &error));
+  g_assert_no_error (error);
+
+  evd_http_connection_write_request_headers (f->conn,
+                                             f->request,
+                                             NULL,
+                                             on_request_sent,
+                                             f);
+}
+
+/* performs a request to @path under the transport's base url, with a
+   NULL-terminated list of header name/value pairs, and waits for the
+   response to arrive in @f. A negative @body_len means @body is text. */
+static void
+http_request (Fixture     *f,
+              const gchar *path,
+              const gchar *body,
+              gssize       body_len,
+              ...)
+{
+  EvdSocket *socket;
+  SoupMessageHeaders *headers;
+  gchar *url;
+  const gchar *name;
+  va_list args;
+
+  url = g_strdup_printf ("%s%s", f->base_url, path);
+  f->request = evd_http_request_new ("POST", url);
+  g_free (url);
+
+  headers = evd_http_message_get_headers (EVD_HTTP_MESSAGE (f->request));
+  soup_message_headers_replace (headers, "Connection", "close");
+  if (body_len < 0)
+    body_len = body != NULL ? strlen (body) : 0;
+  soup_message_headers_set_content_length (headers, body_len);
+
+  va_start (args, body_len);
+  while ((name = va_arg (args, const gchar *)) != NULL)
+    soup_message_headers_replace (headers, name, va_arg (args, const gchar *));
+  va_end (args);
+
+  f->body = body;
+  f->body_len = body_len;
+  f->status = 0;
+  g_free (f->content);
+  f->content = NULL;
+  f->content_len = 0;
+
+  socket = evd_socket_new ();
+  g_object_set (socket, "io-stream-type", EVD_TYPE_HTTP_CONNECTION, NULL);
+  evd_socket_connect_to (socket, f->addr, NULL, on_connect, f);
+
+  g_main_loop_run (f->main_loop);
+
+  g_object_unref (socket);
+  g_object_unref (f->request);
+  f->request = NULL;
+}
+
+static JsonObject *
+handshake (Fixture     *f,
+           const gchar *peer_id,
+           const gchar *token,
+           guint64      last_seq)
+{
+  gchar *body;
+  JsonParser *parser;
+  JsonObject *obj;
+  GError *error = NULL;
+
+  if (peer_id == NULL)
+    body = g_strdup_printf ("{\"mechanisms\": [\"long-polling\"],"
+                            " \"url\": \"%s\"}",
+                            f->base_url);
+  else
+    body = g_strdup_printf ("{\"mechanisms\": [\"long-polling\"],"
+                            " \"url\": \"%s\","
+                            " \"peer-id\": \"%s\","
+                            " \"resume-token\": \"%s\","
+                            " \"last-seq\": %" G_GUINT64_FORMAT "}",
+                            f->base_url,
+                            peer_id,
+                            token,
+                            last_seq);
+
+  http_request (f, "handshake", body, -1, NULL);
+  g_free (body);
+
+  if (f->status != SOUP_STATUS_OK)
+    return NULL;
+
+  parser = json_parser_new ();
+  g_assert (json_parser_load_from_data (parser,
+                                        f->content,
+                                        f->content_len,
+                                        &error));
+  g_assert_no_error (error);
+
+  obj = json_object_ref (json_node_get_object (json_parser_get_root (parser)));
+  g_object_unref (parser);
+
+  return obj;
+}
+
+static void
+ack (Fixture     *f,
+     const gchar *peer_id,
+     const gchar *token,
+     const gchar *seq)
+{
+  gchar *path;
+
+  path = g_strdup_printf ("ack?%s", peer_id);
+
+  if (token != NULL)
+    http_request (f, path, NULL, 0,
+                  ACK_HEADER_NAME, seq,
+                  TOKEN_HEADER_NAME, token,
+                  NULL);
+  else
+    http_request (f, path, NULL, 0, ACK_HEADER_NAME, seq, NULL);
+
+  g_free (path);
+}
+
+static void
+test_resume (Fixture       *f,
+             gconstpointer  test_data)
+{
+  JsonObject *obj;
+  gchar *peer_id;
+  gchar *token;
+  gchar *path;
+  const gchar *msgs[] = { "one", "two", "three" };
+  gint i;
+
+  /* resuming is opt-in */
+  g_assert_cmpuint (evd_web_transport_server_get_resume_window (f->transport),
+                    ==,
+                    0);
+  evd_web_transport_server_set_resume_window (f->transport, RESUME_WINDOW);
+
+  obj = handshake (f, NULL, NULL, 0);
+  g_assert_cmpuint (f->status, ==, SOUP_STATUS_OK);
+  g_assert_cmpuint (f->validate_count, ==, 1);
+  g_assert_cmpuint (f->new_peer_count, ==, 1);
+  g_assert (! json_object_get_boolean_member (obj, "resumed"));
+
+  peer_id = g_strdup (json_object_get_string_member (obj, "peer-id"));
+  token = g_strdup (json_object_get_string_member (obj, "resume-token"));
+  json_object_unref (obj);
+
+  g_assert (token != NULL);
+  g_assert_cmpstr (peer_id, ==, evd_peer_get_id (f->peer));
+
+  /* no mechanism is connected yet, so these end up in the backlog, and
+     get numbered 1 to 3 */
+  for (i = 0; i < 3; i++)
+    g_assert (evd_transport_send_text (EVD_TRANSPORT (f->transport),
+                                       f->peer,
+                                       msgs[i],
+                                       NULL));
+
+  /* acks need the resume token, not just the peer id */
+  ack (f, peer_id, NULL, "1");
+  g_assert_cmpuint (f->status, ==, SOUP_STATUS_BAD_REQUEST);
+
+  ack (f, peer_id, "not-the-token", "1");
+  g_assert_cmpuint (f->status, ==, SOUP_STATUS_FORBIDDEN);
+
+  ack (f, peer_id, token, "1");
+  g_assert_cmpuint (f->status, ==, SOUP_STATUS_OK);
+
+  /* the first message is acknowledged, so it can no longer be replayed
+     and resuming from before it starts a new session */
+  obj = handshake (f, peer_id, token, 0);
+  g_assert_cmpuint (f->status, ==, SOUP_STATUS_OK);
+  g_assert (! json_object_get_boolean_member (obj, "resumed"));
+  g_assert_cmpstr (json_object_get_string_member (obj, "peer-id"), !=, peer_id);
+  json_object_unref (obj);
+
+  evd_transport_close_peer (EVD_TRANSPORT (f->transport), f->peer, FALSE, NULL);
+  g_object_unref (f->peer);
+  f->peer = evd_transport_lookup_peer (EVD_TRANSPORT (f->transport), peer_id);
+  g_assert (f->peer != NULL);
+  g_object_ref (f->peer);
+
+  /* resuming after the second message is validated again, does not
+     announce a new peer, and only replays the third one */
+  obj = handshake (f, peer_id, token, 2);
+  g_assert_cmpuint (f->status, ==, SOUP_STATUS_OK);
+  g_assert_cmpuint (f->validate_count, ==, 3);
+  g_assert_cmpuint (f->new_peer_count, ==, 2);
+  g_assert (json_object_get_boolean_member (obj, "resumed"));
+  g_assert_cmpstr (json_object_get_string_member (obj, "peer-id"), ==, peer_id);
+  g_assert_cmpstr (json_object_get_string_member (obj, "resume-token"), ==, token);
+  json_object_unref (obj);
+
+  g_assert_cmpuint (evd_peer_backlog_get_length (f->peer), ==, 1);
+
+  path = g_strdup_printf ("lp/receive?%s", peer_id);
+  http_request (f, path, NULL, 0, NULL);
+  g_free (path);
+
+  g_assert_cmpuint (f->status, ==, SOUP_STATUS_OK);
+  g_assert_cmpint (f->content_len, ==, 1 + strlen ("three"));
+  g_assert_cmpint (f->content[0], ==, strlen ("three"));
+  g_assert (memcmp (f->content + 1, "three", strlen ("three")) == 0);
+
+  g_free (token);
+  g_free (peer_id);
+}
+
+static void
+test_resume_rejected (Fixture       *f,
+                      gconstpointer  test_data)
+{
+  JsonObject *obj;
+  gchar *peer_id;
+  gchar *token;
+
+  evd_web_transport_server_set_resume_window (f->transport, RESUME_WINDOW);
+
+  obj = handshake (f, NULL, NULL, 0);
+  g_assert_cmpuint (f->status, ==, SOUP_STATUS_OK);
+
+  peer_id = g_strdup (json_object_get_string_member (obj, "peer-id"));
+  token = g_strdup (json_object_get_string_member (obj, "resume-token"));
+  json_object_unref (obj);
+
+  /* a resumed session goes through validation like a new one, and a
+     rejected peer is closed rather than kept for later */
+  f->validate_result = EVD_VALIDATE_REJECT;
+
+  obj = handshake (f, peer_id, token, 0);
+  g_assert (obj == NULL);
+  g_assert_cmpuint (f->status, ==, SOUP_STATUS_FORBIDDEN);
+  g_assert_cmpuint (f->validate_count, ==, 2);
+  g_assert_cmpuint (f->peer_closed_count, ==, 1);
+
+  g_assert (evd_peer_is_closed (f->peer));
+  g_assert (evd_transport_lookup_peer (EVD_TRANSPORT (f->transport),
+                                       peer_id) == NULL);
+
+  g_free (token);
+  g_free (peer_id);
+}
+
+/* long-polling binary framing */
+
+#define BINARY_CONTENT_TYPE "application/octet-stream"
+#define BINARY_TYPE_BIT     0x80
+#define BINARY_LEN_16       126
+#define BINARY_LEN_64       127
+
+typedef struct
+{
+  EvdMessageType type;
+  GByteArray *data;
+} Message;
+
+static void
+message_free (gpointer data)
+{
+  Message *msg = data;
+
+  g_byte_array_unref (msg->data);
+  g_slice_free (Message, msg);
+}
+
+static Message *
+message_new (EvdMessageType  type,
+             const gchar    *data,
+             gsize           size)
+{
+  Message *msg;
+
+  msg = g_slice_new (Message);
+  msg->type = type;
+  msg->data = g_byte_array_sized_new (size);
+  g_byte_array_append (msg->data, (const guint8 *) data, size);
+
+  return msg;
+}
+
+/* the same encoding evdWebTransport.js uses for its binary requests */
+static void
+append_binary_frame (GByteArray *buf, const Message *msg)
+{
+  guint8 hdr[9];
+  gsize hdr_len;
+  guint64 len;
+  gint i;
+
+  len = msg->data->len;
+
+  if (len < BINARY_LEN_16)
+    {
+      hdr[0] = len;
+      hdr_len = 1;
+    }
+  else if (len <= 0xFFFF)
+    {
+      hdr[0] = BINARY_LEN_16;
+      hdr_len = 3;
+    }
+  else
+    {
+      hdr[0] = BINARY_LEN_64;
+      hdr_len = 9;
+    }
+
+  for (i = hdr_len - 1; i > 0; i--)
+    {
+      hdr[i] = len & 0xFF;
+      len >>= 8;
+    }
+
+  if (msg->type == EVD_MESSAGE_TYPE_BINARY)
+    hdr[0] |= BINARY_TYPE_BIT;
+
+  g_byte_array_append (buf, hdr, hdr_len);
+  g_byte_array_append (buf, msg->data->data, msg->data->len);
+}
+
+static Message *
+read_binary_frame (const gchar *buf, gsize size, gsize *offset)
+{
+  const guint8 *p;
+  guint64 len;
+  gsize hdr_len;
+  gsize i;
+  EvdMessageType type;
+
+  g_assert_cmpuint (*offset, <, size);
+
+  p = (const guint8 *) buf + *offset;
+
+  type = (p[0] & BINARY_TYPE_BIT) != 0 ?
+    EVD_MESSAGE_TYPE_BINARY : EVD_MESSAGE_TYPE_TEXT;
+  len = p[0] & ~BINARY_TYPE_BIT;
+
+  if (len == BINARY_LEN_16)
+    hdr_len = 3;
+  else if (len == BINARY_LEN_64)
+    hdr_len = 9;
+  else
+    hdr_len = 1;
+
+  g_assert_cmpuint (*offset + hdr_len, <=, size);
+
+  if (hdr_len > 1)
+    {
+      len = 0;
+      for (i = 1; i < hdr_len; i++)
+        len = (len << 8) | p[i];
+    }
+
+  g_assert_cmpuint (*offset + hdr_len + len, <=, size);
+
+  *offset += hdr_len + len;
+
+  return message_new (type, (const gchar *) p + hdr_len, len);
+}
+
+static void
+assert_message_equal (const Message *a, const Message *b)
+{
+  g_assert_cmpint (a->type, ==, b->type);
+  g_assert_cmpuint (a->data->len, ==, b->data->len);
+  g_assert (memcmp (a->data->data, b->data->data, a->data->len) == 0);
+}
+
+static void
+on_binary_receive (EvdTransport   *transport,
+                   EvdPeer        *peer,
+                   const gchar    *buffer,
+                   gsize           size,
+                   EvdMessageType  type,
+                   gpointer        user_data)
+{
+  GPtrArray *received = user_data;
+
+  g_ptr_array_add (received, message_new (type, buffer, size));
+}
+
+static void
+test_binary_framing (Fixture       *f,
+                     gconstpointer  test_data)
+{
+  /* "Grüße, 世界 ✓" */
+  const gchar *non_ascii =
+    "Gr\xc3\xbc\xc3\x9f" "e, \xe4\xb8\x96\xe7\x95\x8c \xe2\x9c\x93";
+
+  GPtrArray *msgs;
+  GPtrArray *received;
+  GByteArray *body;
+  JsonObject *obj;
+  gchar *path;
+  gchar *data;
+  guint handler_id;
+  gsize offset;
+  guint i;
+
+  obj = handshake (f, NULL, NULL, 0);
+  g_assert_cmpuint (f->status, ==, SOUP_STATUS_OK);
+  json_object_unref (obj);
+
+  /* one message for each length encoding and both message types */
+  msgs = g_ptr_array_new_with_free_func (message_free);
+
+  g_ptr_array_add (msgs, message_new (EVD_MESSAGE_TYPE_TEXT,
+                                      non_ascii,
+                                      strlen (non_ascii)));
+  g_ptr_array_add (msgs, message_new (EVD_MESSAGE_TYPE_BINARY,
+                                      "\x00\x01\x7f\x80\xff",
+                                      5));
+
+  data = g_malloc (300);
+  for (i = 0; i < 300; i++)
+    data[i] = i & 0xFF;
+  g_ptr_array_add (msgs, message_new (EVD_MESSAGE_TYPE_BINARY, data, 300));
+  g_free (data);
+
+  data = g_malloc (0x10000 + 10);
+  for (i = 0; i < 0x10000 + 10; i++)
+    data[i] = 'a' + i % 26;
+  g_ptr_array_add (msgs, message_new (EVD_MESSAGE_TYPE_TEXT,
+                                      data,
+                                      0x10000 + 10));
+  g_free (data);
+
+  /* server to client, delivered in the response to the send request */
+  for (i = 0; i < msgs->len; i++)
+    {
+      Message *msg = g_ptr_array_index (msgs, i);
+
+      if (msg->type == EVD_MESSAGE_TYPE_TEXT)
+        {
+          data = g_strndup ((const gchar *) msg->data->data, msg->data->len);
+          g_assert (evd_transport_send_text (EVD_TRANSPORT (f->transport),
+                                             f->peer,
+                                             data,
+                                             NULL));
+          g_free (data);
+        }
+      else
+        g_assert (evd_transport_send (EVD_TRANSPORT (f->transport),
+                                      f->peer,
+                                      (const gchar *) msg->data->data,
+                                      msg->data->len,
+                                      NULL));
+    }
+
+  /* client to server */
+  body = g_byte_array_new ();
+  for (i = 0; i < msgs->len; i++)
+    append_binary_frame (body, g_ptr_array_index (msgs, i));
+
+  received = g_ptr_array_new_with_free_func (message_free);
+  handler_id = evd_transport_add_receive_handler (EVD_TRANSPORT (f->transport),
+                                                  on_binary_receive,
+                                                  received,
+                                                  NULL);
+
+  path = g_strdup_printf ("lp/send?%s", evd_peer_get_id (f->peer));
+  http_request (f, path, (const gchar *) body->data, body->len,
+                "Accept", BINARY_CONTENT_TYPE,
+                "Content-Type", BINARY_CONTENT_TYPE,
+                NULL);
+  g_free (path);
+  g_byte_array_unref (body);
+
+  evd_transport_remove_receive_handler (EVD_TRANSPORT (f->transport),
+                                        handler_id);
+
+  g_assert_cmpuint (f->status, ==, SOUP_STATUS_OK);
+
+  g_assert_cmpuint (received->len, ==, msgs->len);
+  for (i = 0; i < msgs->len; i++)
+    assert_message_equal (g_ptr_array_index (received, i),
+                          g_ptr_array_index (msgs, i));
+
+  offset = 0;
+  for (i = 0; i < msgs->len; i++)
+    {
+      Message *msg;
+
+      msg = read_binary_frame (f->content, f->content_len, &offset);
+      assert_message_equal (msg, g_ptr_array_index (msgs, i));
+      message_free (msg);
+    }
+  g_assert_cmpuint (offset, ==, f->content_len);
+
+  g_ptr_array_unref (received);
+  g_ptr_array_unref (msgs);
+}
+
+static void
+test_malformed_frame (Fixture       *f,
+                      gconstpointer  test_data)
+{
+  GPtrArray *received;
+  GByteArray *body;
+  JsonObject *obj;
+  Message *msg;
+  gchar *path;
+  guint handler_id;
+
+  obj = handshake (f, NULL, NULL, 0);
+  g_assert_cmpuint (f->status, ==, SOUP_STATUS_OK);
+  json_object_unref (obj);
+
+  /* a good frame, then one announcing more bytes than follow */
+  body = g_byte_array_new ();
+  msg = message_new (EVD_MESSAGE_TYPE_TEXT, "hello", 5);
+  append_binary_frame (body, msg);
+  message_free (msg);
+  g_byte_array_append (body, (const guint8 *) "\x0a" "abc", 4);
+
+  received = g_ptr_array_new_with_free_func (message_free);
+  handler_id = evd_transport_add_receive_handler (EVD_TRANSPORT (f->transport),
+                                                  on_binary_receive,
+                                                  received,
+                                                  NULL);
+
+  path = g_strdup_printf ("lp/send?%s", evd_peer_get_id (f->peer));
+  http_request (f, path, (const gchar *) body->data, body->len,
+                "Accept", BINARY_CONTENT_TYPE,
+                "Content-Type", BINARY_CONTENT_TYPE,
+                NULL);
+  g_free (path);
+  g_byte_array_unref (body);
+
+  evd_transport_remove_receive_handler (EVD_TRANSPORT (f->transport),
+                                        handler_id);
+
+  g_assert_cmpuint (f->status, ==, SOUP_STATUS_BAD_REQUEST);
+  g_assert_cmpuint (f->peer_closed_count, ==, 1);
+  g_assert (evd_peer_is_closed (f->peer));
+
+  /* frames before the bad one were already delivered */
+  g_assert_cmpuint (received->len, ==, 1);
+
+  g_ptr_array_unref (received);
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+#ifndef GLIB_VERSION_2_36
+  g_type_init ();
+#endif
+
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add ("/evd/web-transport/resume",
+              Fixture,
+              NULL,
+              fixture_setup,
+              test_resume,
+              fixture_teardown);
+
+  g_test_add ("/evd/web-transport/resume-rejected",
+              Fixture,
+              NULL,
+              fixture_setup,
+              test_resume_rejected,
+              fixture_teardown);
+
+  g_test_add ("/evd/web-transport/long-polling/binary-framing",
+              Fixture,
+              NULL,
+              fixture_setup,
+              test_binary_framing,
+              fixture_teardown);
+
+  g_test_add ("/evd/web-transport/long-polling/malformed-frame",
+              Fixture,
+              NULL,
+              fixture_setup,
+              test_malformed_frame,
+              fixture_teardown);
+
+  return g_test_run ();
+}
@@ -9,6 +9,7 @@
  *   Eduardo Lima Mitev <elima@igalia.com>
  */
 
+#include <string.h>
 #include <evd.h>
 
 #define LISTEN_ADDR "0.0.0.0:%d"
@@ -31,6 +32,11 @@ typedef struct
   GMainLoop *main_loop;
   gboolean client_new_peer;
 
+  guint direct_received;
+  guint direct_once_received;
+  guint direct_once_id;
+  guint handlers_freed;
+
   guint listen_port;
 } Fixture;
 
@@ -62,6 +68,11 @@ fixture_setup (Fixture       *f,
 
   f->client_new_peer = FALSE;
 
+  f->direct_received = 0;
+  f->direct_once_received = 0;
+  f->direct_once_id = 0;
+  f->handlers_freed = 0;
+
   f->listen_port = g_random_int_range (1025, 65535);
 }
 
@@ -294,6 +305,155 @@ test_func (Fixture       *f,
   g_main_loop_run (f->main_loop);
 }
 
+static void
+on_receive_echo_twice (EvdTransport *transport,
+                       EvdPeer      *peer,
+                       gpointer      user_data)
+{
+  const gchar *msg;
+  GError *error = NULL;
+
+  msg = evd_transport_receive_text (transport, peer);
+
+  g_assert (evd_peer_send_text (peer, msg, &error));
+  g_assert_no_error (error);
+  g_assert (evd_peer_send_text (peer, msg, &error));
+  g_assert_no_error (error);
+
+  evd_transport_close_peer (transport, peer, TRUE, &error);
+  g_assert_no_error (error);
+}
+
+static void
+on_receive_direct (EvdTransport   *transport,
+                   EvdPeer        *peer,
+                   const gchar    *buffer,
+                   gsize           size,
+                   EvdMessageType  type,
+                   gpointer        user_data)
+{
+  Fixture *f = user_data;
+  gsize msg_len;
+
+  g_assert (EVD_IS_WEBSOCKET_SERVER (transport));
+  g_assert (EVD_IS_PEER (peer));
+
+  g_assert_cmpint (type, ==, EVD_MESSAGE_TYPE_TEXT);
+  g_assert_cmpuint (size, ==, strlen (f->test_case->msg));
+  g_assert (memcmp (buffer, f->test_case->msg, size) == 0);
+
+  /* nobody is connected to 'receive', so no message is kept for it */
+  g_assert (evd_transport_receive (transport, peer, &msg_len) == NULL);
+
+  f->direct_received++;
+}
+
+static void
+on_receive_direct_once (EvdTransport   *transport,
+                        EvdPeer        *peer,
+                        const gchar    *buffer,
+                        gsize           size,
+                        EvdMessageType  type,
+                        gpointer        user_data)
+{
+  Fixture *f = user_data;
+
+  f->direct_once_received++;
+
+  /* removing a handler while handlers are being dispatched */
+  evd_transport_remove_receive_handler (transport, f->direct_once_id);
+}
+
+static void
+on_receive_direct_removed (EvdTransport   *transport,
+                           EvdPeer        *peer,
+                           const gchar    *buffer,
+                           gsize           size,
+                           EvdMessageType  type,
+                           gpointer        user_data)
+{
+  g_assert_not_reached ();
+}
+
+static void
+on_receive_handler_freed (gpointer user_data)
+{
+  Fixture *f = user_data;
+
+  f->handlers_freed++;
+}
+
+static void
+test_receive_handler (Fixture       *f,
+                      gconstpointer  data)
+{
+  gchar *addr;
+  guint handler_id;
+
+  f->test_case = &test_cases[0];
+
+  g_signal_connect (f->ws_server,
+                    "new-peer",
+                    G_CALLBACK (on_new_peer),
+                    f);
+  g_signal_connect (f->ws_client,
+                    "new-peer",
+                    G_CALLBACK (on_new_peer),
+                    f);
+
+  g_signal_connect (f->ws_client,
+                    "receive",
+                    G_CALLBACK (on_receive_echo_twice),
+                    f);
+
+  evd_transport_add_receive_handler (EVD_TRANSPORT (f->ws_server),
+                                     on_receive_direct,
+                                     f,
+                                     NULL);
+  f->direct_once_id =
+    evd_transport_add_receive_handler (EVD_TRANSPORT (f->ws_server),
+                                       on_receive_direct_once,
+                                       f,
+                                       on_receive_handler_freed);
+  handler_id =
+    evd_transport_add_receive_handler (EVD_TRANSPORT (f->ws_server),
+                                       on_receive_direct_removed,
+                                       f,
+                                       on_receive_handler_freed);
+  g_assert_cmpuint (handler_id, >, 0);
+  g_assert_cmpuint (handler_id, !=, f->direct_once_id);
+
+  evd_transport_remove_receive_handler (EVD_TRANSPORT (f->ws_server),
+                                        handler_id);
+  g_assert_cmpuint (f->handlers_freed, ==, 1);
+
+  g_signal_connect (f->ws_server,
+                    "peer-closed",
+                    G_CALLBACK (on_peer_closed),
+                    f);
+  g_signal_connect (f->ws_client,
+                    "peer-closed",
+                    G_CALLBACK (on_peer_closed),
+                    f);
+
+  evd_websocket_server_set_standalone (f->ws_server, TRUE);
+
+  addr = g_strdup_printf (LISTEN_ADDR, f->listen_port);
+
+  evd_transport_open (EVD_TRANSPORT (f->ws_server),
+                      addr,
+                      NULL,
+                      on_server_open,
+                      f);
+  g_free (addr);
+
+  g_main_loop_run (f->main_loop);
+
+  g_assert_cmpuint (f->direct_received, ==, 2);
+  g_assert_cmpuint (f->direct_once_received, ==, 1);
+  g_assert_cmpuint (f->handlers_freed, ==, 2);
+}
+
 gint
 main (gint argc, gchar *argv[])
 {
@@ -327,6 +487,13 @@ main (gint argc, gchar *argv[])
       g_free (test_name);
     }
 
+  g_test_add ("/evd/websocket/transport/receive-handler",
+              Fixture,
+              NULL,
+              fixture_setup,
+              test_receive_handler,
+              fixture_teardown);
+
   exit_code = g_test_run ();
 
   evd_tls_deinit ();